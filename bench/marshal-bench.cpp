@@ -0,0 +1,224 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmarks of the strings crossing the JNI boundary (jni_string.h).
+//
+//   marshal-bench [-r runs] [-s kb] [payload ...]
+//
+// A payload is one of
+//   ascii   markup and English text, all ASCII
+//   cjk     markup around Chinese and Japanese text
+//   supp    markup around supplementary characters (emoji, CJK extension B)
+//
+// Every payload is a document of -s kilobytes (default 256), converted -r
+// times (default 200). For every payload and method one line is printed:
+//
+//   <payload> <method> mb_per_s=.. roundtrip=ok|broken
+//
+// The methods are
+//   convert      utf8ToUtf16 and utf16ToUtf8 alone, without a JVM
+//   jni          newJavaString and getJavaString through a JVM
+//   jni-utf      NewStringUTF and GetStringUTFChars, which the module used
+//                before, for comparison
+//
+// roundtrip tells whether the string read back is the one written;
+// jni-utf breaks on supplementary characters. The exit code is the number
+// of broken round trips of the other methods.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <jni.h>
+
+#include "jni_string.h"
+
+using namespace zorba::schematools;
+
+
+// the text of the payload, repeated as markup up to aSize bytes
+static std::string payload(const std::string& aKind, size_t aSize)
+{
+  const char* lText;
+  if (aKind == "ascii")
+    lText = "The quick brown fox jumps over the lazy dog 0123456789";
+  else if (aKind == "cjk")
+    lText = "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86"
+            "\xe3\x82\xad\xe3\x82\xb9\xe3\x83\x88\xe4\xb8\xad\xe6\x96\x87"
+            "\xe6\x95\xb0\xe6\x8d\xae";
+  else if (aKind == "supp")
+    lText = "\xf0\x9f\x98\x80 \xf0\xa0\x80\x8b\xf0\xa0\x80\x8c "
+            "\xf0\x9d\x84\x9e abc";
+  else
+    return std::string();
+
+  std::string lDoc("<doc>");
+  for (long i = 0; lDoc.size() < aSize; ++i)
+    lDoc += "<item n=\"" + std::to_string(i) + "\">" + lText + "</item>";
+  lDoc += "</doc>";
+  return lDoc;
+}
+
+
+static double megabytesPerSecond(size_t aBytes, int aRuns,
+    std::chrono::steady_clock::time_point aStart)
+{
+  double lSeconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - aStart).count();
+  return lSeconds > 0 ? aBytes * (double)aRuns / lSeconds / 1e6 : 0;
+}
+
+
+static bool convert(const std::string& aDoc, int aRuns, double& aSpeed)
+{
+  std::vector<jchar> lUnits;
+  std::string lBack;
+  std::chrono::steady_clock::time_point lStart =
+      std::chrono::steady_clock::now();
+  for (int r = 0; r < aRuns; ++r)
+  {
+    lUnits.clear();
+    lBack.clear();
+    utf8ToUtf16(aDoc.data(), aDoc.size(), lUnits);
+    utf16ToUtf8(lUnits.data(), lUnits.size(), lBack);
+  }
+  aSpeed = megabytesPerSecond(aDoc.size(), aRuns, lStart);
+  return lBack == aDoc;
+}
+
+
+static bool jni(JNIEnv* env, const std::string& aDoc, int aRuns,
+    double& aSpeed)
+{
+  std::string lBack;
+  std::chrono::steady_clock::time_point lStart =
+      std::chrono::steady_clock::now();
+  for (int r = 0; r < aRuns; ++r)
+  {
+    jstring lString = newJavaString(env, aDoc);
+    if (!lString || !getJavaString(env, lString, lBack))
+    {
+      env->ExceptionClear();
+      return false;
+    }
+    env->DeleteLocalRef(lString);
+  }
+  aSpeed = megabytesPerSecond(aDoc.size(), aRuns, lStart);
+  return lBack == aDoc;
+}
+
+
+static bool jniUtf(JNIEnv* env, const std::string& aDoc, int aRuns,
+    double& aSpeed)
+{
+  std::string lBack;
+  std::chrono::steady_clock::time_point lStart =
+      std::chrono::steady_clock::now();
+  for (int r = 0; r < aRuns; ++r)
+  {
+    jstring lString = env->NewStringUTF(aDoc.c_str());
+    if (!lString)
+    {
+      env->ExceptionClear();
+      return false;
+    }
+    const char* lChars = env->GetStringUTFChars(lString, 0);
+    lBack = lChars;
+    env->ReleaseStringUTFChars(lString, lChars);
+    env->DeleteLocalRef(lString);
+  }
+  aSpeed = megabytesPerSecond(aDoc.size(), aRuns, lStart);
+  return lBack == aDoc;
+}
+
+
+static void report(const std::string& aPayload, const char* aMethod,
+    bool aRoundTrip, double aSpeed)
+{
+  std::cout << aPayload << " " << aMethod
+            << " mb_per_s=" << aSpeed
+            << " roundtrip=" << (aRoundTrip ? "ok" : "broken") << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> lPayloads;
+  int lRuns = 200;
+  size_t lSize = 256 * 1024;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (argv[i][0] != '-')
+      lPayloads.push_back(argv[i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+      lRuns = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+      lSize = strtoul(argv[++i], NULL, 10) * 1024;
+  }
+  if (lPayloads.empty())
+  {
+    lPayloads.push_back("ascii");
+    lPayloads.push_back("cjk");
+    lPayloads.push_back("supp");
+  }
+
+  JavaVM* lVM = 0;
+  JNIEnv* env = 0;
+  JavaVMInitArgs lArgs;
+  lArgs.version = JNI_VERSION_1_6;
+  lArgs.nOptions = 0;
+  lArgs.options = 0;
+  lArgs.ignoreUnrecognized = JNI_TRUE;
+  if (JNI_CreateJavaVM(&lVM, (void**)&env, &lArgs) != JNI_OK)
+  {
+    std::cerr << "Could not start the Java VM" << std::endl;
+    return 1;
+  }
+
+  int lBroken = 0;
+  for (size_t p = 0; p < lPayloads.size(); ++p)
+  {
+    std::string lDoc = payload(lPayloads[p], lSize);
+    if (lDoc.empty())
+    {
+      std::cerr << "unknown payload " << lPayloads[p] << std::endl;
+      ++lBroken;
+      continue;
+    }
+
+    double lSpeed = 0;
+    bool lRoundTrip = convert(lDoc, lRuns, lSpeed);
+    report(lPayloads[p], "convert", lRoundTrip, lSpeed);
+    lBroken += !lRoundTrip;
+
+    lSpeed = 0;
+    lRoundTrip = jni(env, lDoc, lRuns, lSpeed);
+    report(lPayloads[p], "jni", lRoundTrip, lSpeed);
+    lBroken += !lRoundTrip;
+
+    lSpeed = 0;
+    lRoundTrip = jniUtf(env, lDoc, lRuns, lSpeed);
+    report(lPayloads[p], "jni-utf", lRoundTrip, lSpeed);
+  }
+
+  lVM->DestroyJavaVM();
+  return lBroken;
+}
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,508 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks inst2xsd and xsd2inst on generated corpora.
+//
+//   schema-tools-bench -p path [-p path ...] [options] case ...
+//
+// A case is one of
+//   inst2xsd:<design>:<shape>:<count>   design rdd|ssd|vbd,
+//                                       shape wide|deep|ns|tiny
+//   xsd2inst:<size>                     size small|large
+//
+// Options:
+//   -e engine      xmlbeans (default) or native
+//   -r runs        warm runs per case (default 5)
+//   -b file        baseline file to compare with
+//   -t tolerance   allowed slowdown against the baseline (default 0.5)
+//   -w file        append the measured numbers to file, in baseline format
+//
+// The corpus of a case is generated and parsed before the clock starts. The
+// first evaluation in the process is reported as cold: with the xmlbeans
+// engine it includes starting the JVM. The warm latency is the median of
+// the following runs. For every case one line is printed:
+//
+//   <case> <engine> cold_ms=.. warm_ms=.. docs_per_s=.. rss_kb=.. heap_kb=..
+//
+// rss_kb is the peak resident set of the process so far, heap_kb the peak
+// use of the JVM heap pools (0 if no JVM was started). The exit code is the
+// number of cases slower than their baseline.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <jni.h>
+
+#include <zorba/dynamic_context.h>
+#include <zorba/item.h>
+#include <zorba/iterator.h>
+#include <zorba/static_context.h>
+#include <zorba/store_manager.h>
+#include <zorba/vector_item_sequence.h>
+#include <zorba/xmldatamanager.h>
+#include <zorba/zorba.h>
+#include <zorba/zorba_exception.h>
+
+using namespace zorba;
+
+static const char* PROLOG =
+  "import module namespace st = \"http://www.zorba-xquery.com/modules/schema-tools\";\n"
+  "declare namespace sto = \"http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options\";\n"
+  "declare variable $input as document-node()* external;\n";
+
+
+/*******************************************************************************
+  Corpora
+*******************************************************************************/
+
+// flat documents with many distinct children and attributes
+static std::string wideInstance(long i)
+{
+  std::ostringstream s;
+  s << "<record id=\"" << i << "\" kind=\"k" << i % 5 << "\">";
+  for (int c = 0; c < 200; ++c)
+  {
+    if ((i + c) % 7 == 0)
+      continue;
+    s << "<f" << c << " a=\"" << (i * c) % 1000 << "\">";
+    if (c % 3 == 0)
+      s << i + c;
+    else if (c % 3 == 1)
+      s << "value " << c;
+    else
+      s << "2013-0" << c % 9 + 1 << "-1" << c % 10;
+    s << "</f" << c << ">";
+  }
+  s << "</record>";
+  return s.str();
+}
+
+
+// documents nested 60 levels deep, with a recursive element
+static std::string deepInstance(long i)
+{
+  std::ostringstream s;
+  const int lDepth = 60;
+  for (int d = 0; d < lDepth; ++d)
+    s << "<level" << d % 6 << " depth=\"" << d << "\">"
+      << (d % 4 == 0 ? "<node/>" : "");
+  s << "<leaf>" << i << "</leaf>";
+  for (int d = lDepth - 1; d >= 0; --d)
+    s << "</level" << d % 6 << ">";
+  return s.str();
+}
+
+
+// documents spreading their elements and attributes over 25 namespaces
+static std::string nsInstance(long i)
+{
+  const int lNamespaces = 25;
+  std::ostringstream s;
+  s << "<n0:doc";
+  for (int n = 0; n < lNamespaces; ++n)
+    s << " xmlns:n" << n << "=\"http://example.com/bench/ns" << n << "\"";
+  s << ">";
+  for (int c = 0; c < 50; ++c)
+  {
+    int n = (c + i) % lNamespaces;
+    s << "<n" << n << ":item n" << (n + 1) % lNamespaces << ":ref=\"" << c
+      << "\"><n" << n << ":value>" << (i + c) % 97 << "</n" << n
+      << ":value></n" << n << ":item>";
+  }
+  s << "</n0:doc>";
+  return s.str();
+}
+
+
+// small records, for scaling the number of instances
+static std::string tinyInstance(long i)
+{
+  std::ostringstream s;
+  s << "<order id=\"" << i << "\"><qty>" << i % 10 << "</qty>"
+    << (i % 3 == 0 ? "<rush/>" : "") << "</order>";
+  return s.str();
+}
+
+
+// n global elements of complex types that reference the following ones
+static std::string schema(int n)
+{
+  std::ostringstream s;
+  s << "<xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
+       " xmlns:b=\"http://example.com/bench\""
+       " targetNamespace=\"http://example.com/bench\""
+       " elementFormDefault=\"qualified\">";
+  for (int e = 0; e < n; ++e)
+  {
+    s << "<xs:element name=\"e" << e << "\" type=\"b:t" << e << "\"/>"
+      << "<xs:complexType name=\"t" << e << "\"><xs:sequence>"
+      << "<xs:element name=\"id\" type=\"xs:int\"/>"
+      << "<xs:element name=\"name\" type=\"xs:string\" minOccurs=\"0\"/>";
+    for (int r = 1; r <= 3 && e + r < n; ++r)
+      s << "<xs:element ref=\"b:e" << e + r << "\" minOccurs=\"0\""
+        << " maxOccurs=\"" << r << "\"/>";
+    s << "</xs:sequence>"
+      << "<xs:attribute name=\"version\" type=\"xs:decimal\"/>"
+      << "</xs:complexType>";
+  }
+  s << "</xs:schema>";
+  return s.str();
+}
+
+
+/*******************************************************************************
+  Measurements
+*******************************************************************************/
+
+static long peakRssKb()
+{
+  struct rusage lUsage;
+  getrusage(RUSAGE_SELF, &lUsage);
+  return lUsage.ru_maxrss;
+}
+
+
+// sum of the peak usage of the heap memory pools, 0 without a JVM
+static long peakHeapKb()
+{
+  JavaVM* lVM = 0;
+  jsize lCount = 0;
+  if (JNI_GetCreatedJavaVMs(&lVM, 1, &lCount) != JNI_OK || lCount == 0)
+    return 0;
+
+  JNIEnv* env = 0;
+  if (lVM->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK &&
+      lVM->AttachCurrentThread((void**)&env, NULL) != JNI_OK)
+    return 0;
+
+  jclass lFactory = env->FindClass("java/lang/management/ManagementFactory");
+  jclass lList = env->FindClass("java/util/List");
+  jclass lPool = env->FindClass("java/lang/management/MemoryPoolMXBean");
+  jclass lType = env->FindClass("java/lang/management/MemoryType");
+  jclass lUsage = env->FindClass("java/lang/management/MemoryUsage");
+  if (env->ExceptionCheck())
+  {
+    env->ExceptionClear();
+    return 0;
+  }
+
+  jobject lHeap = env->GetStaticObjectField(lType,
+      env->GetStaticFieldID(lType, "HEAP", "Ljava/lang/management/MemoryType;"));
+  jobject lPools = env->CallStaticObjectMethod(lFactory,
+      env->GetStaticMethodID(lFactory, "getMemoryPoolMXBeans", "()Ljava/util/List;"));
+  jmethodID lSize = env->GetMethodID(lList, "size", "()I");
+  jmethodID lGet = env->GetMethodID(lList, "get", "(I)Ljava/lang/Object;");
+  jmethodID lGetType = env->GetMethodID(lPool, "getType",
+      "()Ljava/lang/management/MemoryType;");
+  jmethodID lGetPeak = env->GetMethodID(lPool, "getPeakUsage",
+      "()Ljava/lang/management/MemoryUsage;");
+  jmethodID lGetUsed = env->GetMethodID(lUsage, "getUsed", "()J");
+
+  jlong lBytes = 0;
+  jint lPoolCount = env->CallIntMethod(lPools, lSize);
+  for (jint i = 0; i < lPoolCount; ++i)
+  {
+    jobject lBean = env->CallObjectMethod(lPools, lGet, i);
+    jobject lBeanType = env->CallObjectMethod(lBean, lGetType);
+    if (env->IsSameObject(lBeanType, lHeap))
+    {
+      jobject lPeak = env->CallObjectMethod(lBean, lGetPeak);
+      if (lPeak)
+        lBytes += env->CallLongMethod(lPeak, lGetUsed);
+      env->DeleteLocalRef(lPeak);
+    }
+    env->DeleteLocalRef(lBeanType);
+    env->DeleteLocalRef(lBean);
+  }
+  if (env->ExceptionCheck())
+  {
+    env->ExceptionClear();
+    return 0;
+  }
+  return (long)(lBytes / 1024);
+}
+
+
+class Result
+{
+  public:
+    double theColdMs;
+    double theWarmMs;
+    double theDocsPerSecond;
+    long theRssKb;
+    long theHeapKb;
+};
+
+
+class Bench
+{
+  private:
+    Zorba* theZorba;
+    std::vector<String> thePath;
+    std::string theEngine;
+    int theRuns;
+    bool theFirstRun;
+
+  public:
+    Bench(Zorba* aZorba, const std::vector<String>& aPath,
+          const std::string& aEngine, int aRuns) :
+      theZorba(aZorba),
+      thePath(aPath),
+      theEngine(aEngine),
+      theRuns(aRuns),
+      theFirstRun(true)
+    {}
+
+    const std::string& getEngine() const
+    { return theEngine; }
+
+    Result run(const std::string& aCase);
+
+  private:
+    double evaluate(const std::string& aQuery, const std::vector<Item>& aInput);
+
+    void parse(const std::vector<std::string>& aDocs, std::vector<Item>& aItems);
+};
+
+
+void Bench::parse(const std::vector<std::string>& aDocs, std::vector<Item>& aItems)
+{
+  XmlDataManager* lDataManager = theZorba->getXmlDataManager();
+  for (size_t i = 0; i < aDocs.size(); ++i)
+  {
+    std::istringstream lStream(aDocs[i]);
+    aItems.push_back(lDataManager->parseXML(lStream));
+  }
+}
+
+
+// milliseconds spent in execute
+double Bench::evaluate(const std::string& aQuery, const std::vector<Item>& aInput)
+{
+  StaticContext_t lSctx = theZorba->createStaticContext();
+  lSctx->setURIPath(thePath);
+  lSctx->setLibPath(thePath);
+
+  XQuery_t lQuery = theZorba->compileQuery(aQuery, lSctx);
+  VectorItemSequence lInput(aInput);
+  lQuery->getDynamicContext()->setVariable("input", lInput.getIterator());
+
+  std::ostringstream lResult;
+  std::chrono::steady_clock::time_point lStart = std::chrono::steady_clock::now();
+  lQuery->execute(lResult);
+  std::chrono::steady_clock::time_point lEnd = std::chrono::steady_clock::now();
+  lQuery->close();
+
+  return std::chrono::duration<double, std::milli>(lEnd - lStart).count();
+}
+
+
+Result Bench::run(const std::string& aCase)
+{
+  std::vector<std::string> lParts;
+  std::istringstream lCase(aCase);
+  std::string lPart;
+  while (std::getline(lCase, lPart, ':'))
+    lParts.push_back(lPart);
+
+  std::vector<std::string> lDocs;
+  std::string lQuery(PROLOG);
+  long lCount = 1;
+
+  if (lParts.size() == 4 && lParts[0] == "inst2xsd")
+  {
+    lCount = atol(lParts[3].c_str());
+    for (long i = 0; i < lCount; ++i)
+    {
+      if (lParts[2] == "wide")
+        lDocs.push_back(wideInstance(i));
+      else if (lParts[2] == "deep")
+        lDocs.push_back(deepInstance(i));
+      else if (lParts[2] == "ns")
+        lDocs.push_back(nsInstance(i));
+      else if (lParts[2] == "tiny")
+        lDocs.push_back(tinyInstance(i));
+      else
+        throw std::runtime_error("unknown shape " + lParts[2]);
+    }
+    // count() iterates the lazy result, so every schema is built
+    lQuery +=
+        "count(st:inst2xsd($input/*, <sto:inst2xsd-options>"
+        "<sto:design>" + lParts[1] + "</sto:design>"
+        "<sto:engine>" + theEngine + "</sto:engine>"
+        "</sto:inst2xsd-options>))";
+  }
+  else if (lParts.size() == 2 && lParts[0] == "xsd2inst")
+  {
+    lDocs.push_back(schema(lParts[1] == "large" ? 5000 : 3));
+    lQuery +=
+        "count(st:xsd2inst($input/*, \"e0\", <sto:xsd2inst-options>"
+        "<sto:engine>" + theEngine + "</sto:engine>"
+        "</sto:xsd2inst-options>)//*)";
+  }
+  else
+  {
+    throw std::runtime_error("unknown case " + aCase);
+  }
+
+  std::vector<Item> lInput;
+  parse(lDocs, lInput);
+  lDocs.clear();
+
+  Result lResult;
+  double lFirst = evaluate(lQuery, lInput);
+  lResult.theColdMs = theFirstRun ? lFirst : 0;
+  theFirstRun = false;
+
+  std::vector<double> lWarm;
+  for (int r = 0; r < theRuns; ++r)
+    lWarm.push_back(evaluate(lQuery, lInput));
+  std::sort(lWarm.begin(), lWarm.end());
+  lResult.theWarmMs = lWarm.empty() ? lFirst : lWarm[lWarm.size() / 2];
+
+  lResult.theDocsPerSecond =
+      lResult.theWarmMs > 0 ? lCount * 1000.0 / lResult.theWarmMs : 0;
+  lResult.theRssKb = peakRssKb();
+  lResult.theHeapKb = peakHeapKb();
+  return lResult;
+}
+
+
+/*******************************************************************************
+  Baselines
+*******************************************************************************/
+
+// "<case> <engine> <warm_ms>" per line, '#' starts a comment
+static std::map<std::string, double> readBaselines(const char* aFile)
+{
+  std::map<std::string, double> lBaselines;
+  std::ifstream lIn(aFile);
+  std::string lLine;
+  while (std::getline(lIn, lLine))
+  {
+    if (lLine.empty() || lLine[0] == '#')
+      continue;
+    std::istringstream lFields(lLine);
+    std::string lCase, lEngine;
+    double lWarmMs;
+    if (lFields >> lCase >> lEngine >> lWarmMs)
+      lBaselines[lCase + " " + lEngine] = lWarmMs;
+  }
+  return lBaselines;
+}
+
+
+int main(int argc, char** argv)
+{
+  std::vector<String> lPath;
+  std::vector<std::string> lCases;
+  std::string lEngine("xmlbeans");
+  int lRuns = 5;
+  const char* lBaselineFile = 0;
+  const char* lRecordFile = 0;
+  double lTolerance = 0.5;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (argv[i][0] != '-')
+      lCases.push_back(argv[i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+      lPath.push_back(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-e") == 0)
+      lEngine = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "-r") == 0)
+      lRuns = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-b") == 0)
+      lBaselineFile = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+      lTolerance = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-w") == 0)
+      lRecordFile = argv[++i];
+  }
+
+  std::map<std::string, double> lBaselines;
+  if (lBaselineFile)
+    lBaselines = readBaselines(lBaselineFile);
+
+  void* lStore = StoreManager::getStore();
+  Zorba* lZorba = Zorba::getInstance(lStore);
+  Bench lBench(lZorba, lPath, lEngine, lRuns);
+
+  int lRegressions = 0;
+  for (size_t c = 0; c < lCases.size(); ++c)
+  {
+    Result lResult;
+    try
+    {
+      lResult = lBench.run(lCases[c]);
+    }
+    catch (ZorbaException& e)
+    {
+      std::cerr << lCases[c] << ": " << e << std::endl;
+      ++lRegressions;
+      continue;
+    }
+    catch (std::exception& e)
+    {
+      std::cerr << lCases[c] << ": " << e.what() << std::endl;
+      ++lRegressions;
+      continue;
+    }
+
+    std::cout << lCases[c] << " " << lEngine
+              << " cold_ms=" << lResult.theColdMs
+              << " warm_ms=" << lResult.theWarmMs
+              << " docs_per_s=" << lResult.theDocsPerSecond
+              << " rss_kb=" << lResult.theRssKb
+              << " heap_kb=" << lResult.theHeapKb;
+
+    std::map<std::string, double>::const_iterator lBaseline =
+        lBaselines.find(lCases[c] + " " + lEngine);
+    if (lBaseline != lBaselines.end())
+    {
+      double lRatio = lResult.theWarmMs / lBaseline->second;
+      std::cout << " baseline_ratio=" << lRatio;
+      if (lRatio > 1 + lTolerance)
+      {
+        std::cout << " REGRESSION";
+        ++lRegressions;
+      }
+    }
+    std::cout << std::endl;
+
+    if (lRecordFile)
+    {
+      std::ofstream lOut(lRecordFile, std::ios::app);
+      lOut << lCases[c] << " " << lEngine << " " << lResult.theWarmMs << std::endl;
+    }
+  }
+
+  lZorba->shutdown();
+  StoreManager::shutdownStore(lStore);
+  return lRegressions;
+}
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iomanip>
+#include <sstream>
+
+#include "compiled_options.h"
+#include "result_cache.h"
+
+#define COMPILED_OPTIONS_HANDLE_PREFIX "urn:zorba:schema-tools:options:"
+
+namespace zorba
+{
+namespace schematools
+{
+
+jobject CompiledOptions::getJavaOptions(JNIEnv* env, const JniCache& aCache,
+                                        jthrowable& lException)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  // a VM started again has none of the objects of the previous one
+  JavaVM* lVM = 0;
+  env->GetJavaVM(&lVM);
+  if (theJavaOptions && lVM == theVM)
+    return theJavaOptions;
+
+  jobject lLocal = theInst2xsd ?
+      env->NewObject(aCache.theInst2XsdOptionsClass,
+          aCache.theInst2XsdOptionsInit) :
+      env->NewObject(aCache.theXsd2InstOptionsClass,
+          aCache.theXsd2InstOptionsInit);
+  CHECK_EXCEPTION(env);
+  if (theInst2xsd)
+    setInst2XsdOptions(env, aCache, lLocal, theOptions, lException);
+  else
+    setXsd2InstOptions(env, aCache, lLocal, theOptions, lException);
+
+  // released with the process, like the registry
+  theJavaOptions = env->NewGlobalRef(lLocal);
+  env->DeleteLocalRef(lLocal);
+  theVM = lVM;
+  return theJavaOptions;
+}
+
+
+
+CompiledOptionsRegistry& CompiledOptionsRegistry::getInstance()
+{
+  static CompiledOptionsRegistry lInstance;
+  return lInstance;
+}
+
+
+std::string CompiledOptionsRegistry::add(const STOptions& aOptions,
+                                         bool aInst2xsd)
+{
+  std::string lKey = (aInst2xsd ? "inst2xsd " : "xsd2inst ") + aOptions.key();
+
+  // the handle of other options with the same digest is hashed again
+  HashStreamBuf lHash;
+  lHash.update(lKey.data(), lKey.size());
+
+  std::lock_guard<std::mutex> lLock(theMutex);
+  for (;;)
+  {
+    std::ostringstream lHandle;
+    lHandle << COMPILED_OPTIONS_HANDLE_PREFIX << std::hex
+            << std::setw(16) << std::setfill('0') << lHash.getHash();
+
+    std::map<std::string, Entry>::iterator lIt =
+        theEntries.find(lHandle.str());
+    if (lIt == theEntries.end())
+    {
+      Entry& lEntry = theEntries[lHandle.str()];
+      lEntry.theKey = lKey;
+      lEntry.theOptions.reset(new CompiledOptions(aOptions, aInst2xsd));
+      return lHandle.str();
+    }
+    if (lIt->second.theKey == lKey)
+      return lIt->first;
+    lHash.update("\n", 1);
+  }
+}
+
+
+std::shared_ptr<CompiledOptions>
+CompiledOptionsRegistry::find(const std::string& aHandle)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+  std::map<std::string, Entry>::iterator lIt = theEntries.find(aHandle);
+  if (lIt == theEntries.end())
+    return std::shared_ptr<CompiledOptions>();
+  return lIt->second.theOptions;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
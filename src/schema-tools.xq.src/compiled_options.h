@@ -0,0 +1,120 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_COMPILED_OPTIONS_H
+#define ZORBA_SCHEMATOOLS_COMPILED_OPTIONS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <jni.h>
+
+#include "jni_cache.h"
+#include "st_options.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Options schema-tools:compile-options validated and parsed once, for
+ * inst2xsd or for xsd2inst, and the Java options object made from them the
+ * first time a call needs the JVM. Both are never changed afterwards, so
+ * the Java object is shared by all threads and sessions using the handle.
+ */
+class CompiledOptions
+{
+  private:
+    STOptions theOptions;
+    bool theInst2xsd;
+
+    std::mutex theMutex;
+    JavaVM* theVM;
+    // global reference to the Inst2XsdOptions or Xsd2InstOptions
+    jobject theJavaOptions;
+
+  public:
+    CompiledOptions(const STOptions& aOptions, bool aInst2xsd) :
+      theOptions(aOptions),
+      theInst2xsd(aInst2xsd),
+      theVM(0),
+      theJavaOptions(0)
+    {}
+
+    const STOptions& getOptions() const
+    { return theOptions; }
+
+    // whether the options are inst2xsd-options, or xsd2inst-options
+    bool isInst2xsd() const
+    { return theInst2xsd; }
+
+    // the Java options object, made on first use; throws JavaException like
+    // CHECK_EXCEPTION
+    jobject getJavaOptions(JNIEnv* env, const JniCache& aCache,
+        jthrowable& lException);
+
+  private:
+    CompiledOptions(const CompiledOptions&);
+    CompiledOptions& operator=(const CompiledOptions&);
+};
+
+
+/**
+ * The options compiled in this process, by handle, shared by all module
+ * instances. A handle is a digest of the options and their kind, so equal
+ * options get the same handle everywhere, and a handle made elsewhere,
+ * e.g. by another process, either names the same options or none.
+ *
+ * Entries are never dropped, since a query may still hold their handle:
+ * the registry grows by one entry per distinct options compiled in the
+ * process, and is meant for options that are compiled once and reused.
+ */
+class CompiledOptionsRegistry
+{
+  private:
+    struct Entry
+    {
+      std::string theKey;
+      std::shared_ptr<CompiledOptions> theOptions;
+    };
+
+    std::mutex theMutex;
+    std::map<std::string, Entry> theEntries;
+
+    CompiledOptionsRegistry()
+    {}
+
+  public:
+    static CompiledOptionsRegistry& getInstance();
+
+    // the handle of aOptions, compiled for inst2xsd if aInst2xsd
+    std::string add(const STOptions& aOptions, bool aInst2xsd);
+
+    // null if aHandle is not a handle of the registry
+    std::shared_ptr<CompiledOptions> find(const std::string& aHandle);
+
+  private:
+    CompiledOptionsRegistry(const CompiledOptionsRegistry&);
+    CompiledOptionsRegistry& operator=(const CompiledOptionsRegistry&);
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_COMPILED_OPTIONS_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,367 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <zorba/iterator.h>
+#include <zorba/store_consts.h>
+#include <zorba/user_exception.h>
+
+#include "event_stream.h"
+#include "schema-tools.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+void EventStreamWriter::write(const Item& aInstance)
+{
+  if (aInstance.getNodeKind() == store::StoreConsts::documentNode)
+  {
+    Iterator_t lChildren = aInstance.getChildren();
+    lChildren->open();
+    Item lChild;
+    while (lChildren->next(lChild))
+      writeNode(lChild, true);
+    lChildren->close();
+  }
+  else
+    writeNode(aInstance, true);
+
+  theOut.sputc(EVENT_END_DOCUMENT);
+}
+
+
+void EventStreamWriter::writeNode(const Item& aNode, bool aRoot)
+{
+  switch (aNode.getNodeKind())
+  {
+  case store::StoreConsts::textNode:
+    theOut.sputc(EVENT_TEXT);
+    writeText(aNode.getStringValue());
+    return;
+
+  case store::StoreConsts::elementNode:
+    break;
+
+  default:
+    return;
+  }
+
+  theOut.sputc(EVENT_START_ELEMENT);
+  writeName(aNode);
+
+  NsBindings lBindings;
+  aNode.getNamespaceBindings(lBindings, aRoot ?
+      store::StoreConsts::ALL_NAMESPACES :
+      store::StoreConsts::ONLY_LOCAL_NAMESPACES);
+  writeNumber(lBindings.size());
+  for (size_t i = 0; i < lBindings.size(); ++i)
+  {
+    writeString(lBindings[i].first);
+    writeString(lBindings[i].second);
+  }
+
+  // the attributes are counted first, the event carries their number
+  std::vector<Item> lAttributes;
+  Iterator_t lIter = aNode.getAttributes();
+  lIter->open();
+  Item lAttr;
+  while (lIter->next(lAttr))
+    lAttributes.push_back(lAttr);
+  lIter->close();
+
+  writeNumber(lAttributes.size());
+  for (size_t i = 0; i < lAttributes.size(); ++i)
+  {
+    writeName(lAttributes[i]);
+    writeText(lAttributes[i].getStringValue());
+  }
+
+  lIter = aNode.getChildren();
+  lIter->open();
+  Item lChild;
+  while (lIter->next(lChild))
+    writeNode(lChild, false);
+  lIter->close();
+
+  theOut.sputc(EVENT_END_ELEMENT);
+}
+
+
+void EventStreamWriter::writeName(const Item& aNode)
+{
+  Item lName;
+  aNode.getNodeName(lName);
+  String lUri = lName.getNamespace();
+  String lPrefix = lName.getPrefix();
+  String lLocal = lName.getLocalName();
+
+  theKey.assign(lUri.c_str(), lUri.size());
+  theKey += '\0';
+  theKey.append(lPrefix.c_str(), lPrefix.size());
+  theKey += '\0';
+  theKey.append(lLocal.c_str(), lLocal.size());
+
+  std::unordered_map<std::string, uint64_t>::iterator lIt = theNames.find(theKey);
+  if (lIt != theNames.end())
+  {
+    writeNumber(lIt->second);
+    return;
+  }
+
+  // numbered from 1, 0 introduces a new name
+  theNames.insert(std::make_pair(theKey, (uint64_t)theNames.size() + 1));
+  writeNumber(0);
+  writeString(lUri);
+  writeString(lPrefix);
+  writeString(lLocal);
+}
+
+
+void EventStreamWriter::writeString(const String& aString)
+{
+  theKey.assign(aString.c_str(), aString.size());
+  std::unordered_map<std::string, uint64_t>::iterator lIt = theStrings.find(theKey);
+  if (lIt != theStrings.end())
+  {
+    writeNumber(lIt->second);
+    return;
+  }
+
+  theStrings.insert(std::make_pair(theKey, (uint64_t)theStrings.size() + 1));
+  writeNumber(0);
+  writeText(aString);
+}
+
+
+void EventStreamWriter::writeText(const String& aText)
+{
+  writeNumber(aText.size());
+  theOut.sputn(aText.c_str(), aText.size());
+}
+
+
+void EventStreamWriter::writeNumber(uint64_t aValue)
+{
+  while (aValue >= 0x80)
+  {
+    theOut.sputc((char)(aValue | 0x80));
+    aValue >>= 7;
+  }
+  theOut.sputc((char)aValue);
+}
+
+
+
+EventStreamReader::EventStreamReader(const char* aData, size_t aSize) :
+  thePos((const unsigned char*)aData),
+  theEnd((const unsigned char*)aData + aSize)
+{
+  // numbered from 1
+  theStrings.push_back(std::string());
+  theNames.push_back(std::vector<std::string>());
+}
+
+
+XmlNode EventStreamReader::read()
+{
+  XmlNode lRoot;
+  bool lHasRoot = false;
+
+  // text and comments around the root element are dropped
+  for (int lEvent; (lEvent = readByte()) != EVENT_END_DOCUMENT; )
+  {
+    switch (lEvent)
+    {
+    case EVENT_START_ELEMENT:
+      if (lHasRoot)
+        throw EventStreamException("more than one root element");
+      readElement(lRoot);
+      lHasRoot = true;
+      break;
+    case EVENT_TEXT:
+    case EVENT_COMMENT:
+      readText();
+      break;
+    default:
+      throw EventStreamException("unexpected event");
+    }
+  }
+
+  if (!lHasRoot)
+    throw EventStreamException("no root element");
+  return lRoot;
+}
+
+
+void EventStreamReader::readElement(XmlNode& aElement)
+{
+  const std::vector<std::string>& lName = readName();
+  aElement.theNamespace = lName[0];
+  aElement.thePrefix = lName[1];
+  aElement.theLocalName = lName[2];
+
+  for (uint64_t i = readNumber(); i > 0; --i)
+  {
+    std::string lPrefix = readString();
+    aElement.theBindings.push_back(XmlNode::Binding(lPrefix, readString()));
+  }
+
+  for (uint64_t i = readNumber(); i > 0; --i)
+  {
+    const std::vector<std::string>& lAttr = readName();
+    if (lAttr[0].empty())
+      aElement.attr(lAttr[2], readText());
+    else
+    {
+      aElement.theQAttributes.push_back(lAttr);
+      aElement.theQAttributes.back().push_back(readText());
+    }
+  }
+
+  for (int lEvent; (lEvent = readByte()) != EVENT_END_ELEMENT; )
+  {
+    switch (lEvent)
+    {
+    case EVENT_START_ELEMENT:
+      aElement.theChildren.push_back(XmlNode());
+      readElement(aElement.theChildren.back());
+      break;
+    case EVENT_TEXT:
+      if (!aElement.theChildren.empty() &&
+          aElement.theChildren.back().theKind == XmlNode::TEXT_NODE)
+        aElement.theChildren.back().theLocalName += readText();
+      else
+        aElement.append(XmlNode::text(readText()));
+      break;
+    case EVENT_COMMENT:
+      aElement.append(XmlNode::comment(readText()));
+      break;
+    default:
+      throw EventStreamException("unexpected event");
+    }
+  }
+}
+
+
+const std::vector<std::string>& EventStreamReader::readName()
+{
+  uint64_t lId = readNumber();
+  if (lId != 0)
+  {
+    if (lId >= theNames.size())
+      throw EventStreamException("unknown name");
+    return theNames[lId];
+  }
+
+  std::vector<std::string> lName;
+  lName.push_back(readString());
+  lName.push_back(readString());
+  lName.push_back(readString());
+  theNames.push_back(lName);
+  return theNames.back();
+}
+
+
+const std::string& EventStreamReader::readString()
+{
+  uint64_t lId = readNumber();
+  if (lId != 0)
+  {
+    if (lId >= theStrings.size())
+      throw EventStreamException("unknown string");
+    return theStrings[lId];
+  }
+
+  theStrings.push_back(readText());
+  return theStrings.back();
+}
+
+
+std::string EventStreamReader::readText()
+{
+  uint64_t lSize = readNumber();
+  if (lSize > (uint64_t)(theEnd - thePos))
+    throw EventStreamException("text past the end");
+  std::string lText((const char*)thePos, lSize);
+  thePos += lSize;
+  return lText;
+}
+
+
+uint64_t EventStreamReader::readNumber()
+{
+  uint64_t lValue = 0;
+  for (int lShift = 0; lShift < 64; lShift += 7)
+  {
+    int lByte = readByte();
+    lValue |= (uint64_t)(lByte & 0x7f) << lShift;
+    if (!(lByte & 0x80))
+      return lValue;
+  }
+  throw EventStreamException("number too long");
+}
+
+
+int EventStreamReader::readByte()
+{
+  if (thePos == theEnd)
+    throw EventStreamException("events cut short");
+  return *thePos++;
+}
+
+
+
+Item buildEventDocument(const char* aData, size_t aSize, ItemFactory* aFactory,
+                        CallStats* aStats)
+{
+  PhaseTimer lResult(aStats, RESULT_PHASE);
+  try
+  {
+    EventStreamReader lReader(aData, aSize);
+    NodeBuilder lBuilder(aFactory, true);
+    Item lDoc = lBuilder.buildDocument(lReader.read());
+    aStats->count(DOCUMENTS_COUNTER);
+    aStats->count(BYTES_FROM_JVM_COUNTER, aSize);
+    return lDoc;
+  }
+  catch (EventStreamException& e)
+  {
+    Item lQName = aFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "JAVA-EXCEPTION");
+    throw USER_EXCEPTION(lQName, "Malformed result events from the JVM: " +
+        e.theMessage);
+  }
+}
+
+
+Item buildEventDocument(JNIEnv* env, jbyteArray aEvents, ItemFactory* aFactory,
+                        CallStats* aStats, jthrowable& lException)
+{
+  // one copy, the events are bytes already
+  PhaseTimer lMarshal(aStats, MARSHAL_PHASE);
+  std::vector<char> lEvents(env->GetArrayLength(aEvents));
+  env->GetByteArrayRegion(aEvents, 0, lEvents.size(), (jbyte*)lEvents.data());
+  CHECK_EXCEPTION(env);
+  lMarshal.stop();
+
+  return buildEventDocument(lEvents.data(), lEvents.size(), aFactory, aStats);
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_EVENT_STREAM_H
+#define ZORBA_SCHEMATOOLS_EVENT_STREAM_H
+
+#include <stdint.h>
+
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <jni.h>
+
+#include <zorba/item.h>
+#include <zorba/item_factory.h>
+
+#include "jni_cache.h"
+#include "node_builder.h"
+#include "stats.h"
+
+// event codes, mirrored in EventStreamReader.java and EventStreamWriter.java
+#define EVENT_END_DOCUMENT 0
+#define EVENT_START_ELEMENT 1
+#define EVENT_END_ELEMENT 2
+#define EVENT_TEXT 3
+#define EVENT_COMMENT 4
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Writes instances as the binary events EventStreamReader.java reads,
+ * instead of serializing them as XML text.
+ *
+ * Every instance is a sequence of events ended by EVENT_END_DOCUMENT:
+ *
+ *   EVENT_START_ELEMENT name
+ *       count (prefix:string uri:string)*  namespace declarations
+ *       count (name value:text)*           attributes
+ *   EVENT_END_ELEMENT
+ *   EVENT_TEXT text
+ *   EVENT_COMMENT text
+ *
+ * Numbers are unsigned LEB128 varints, a text is its length in bytes and
+ * its UTF-8 bytes. Strings and names are interned for the whole stream:
+ * a string is the number of a string written before, or 0 and the text of
+ * a new one; a name is likewise the number of a name or 0 and its uri,
+ * prefix and local name strings. Names and namespaces repeated in every
+ * element so take a byte or two.
+ *
+ * The instances are written without comments and processing instructions,
+ * the inference does not look at them. The results of the JVM come back in
+ * the same format, with comments.
+ */
+class EventStreamWriter
+{
+  private:
+    std::streambuf& theOut;
+    std::unordered_map<std::string, uint64_t> theStrings;
+    std::unordered_map<std::string, uint64_t> theNames;
+    std::string theKey;
+
+  public:
+    EventStreamWriter(std::streambuf& aOut) :
+      theOut(aOut)
+    {}
+
+    // writes the events of a document or element node; the streambuf
+    // reports its own failures
+    void write(const Item& aInstance);
+
+  private:
+    // aRoot elements declare all namespaces in scope, the others only
+    // their own
+    void writeNode(const Item& aNode, bool aRoot);
+
+    void writeName(const Item& aNode);
+
+    void writeString(const String& aString);
+
+    void writeText(const String& aText);
+
+    void writeNumber(uint64_t aValue);
+};
+
+
+
+/**
+ * Malformed events, which only a bug on either side can produce.
+ */
+class EventStreamException
+{
+  public:
+    std::string theMessage;
+
+  public:
+    EventStreamException(const std::string& aMessage) :
+      theMessage(aMessage)
+    {}
+};
+
+
+/**
+ * Reads the events of one document, as EventStreamWriter.java writes the
+ * results of the JVM, into an XmlNode tree. Adjacent texts are merged.
+ */
+class EventStreamReader
+{
+  private:
+    const unsigned char* thePos;
+    const unsigned char* theEnd;
+    std::vector<std::string> theStrings;
+    // namespace, prefix and local name
+    std::vector<std::vector<std::string> > theNames;
+
+  public:
+    EventStreamReader(const char* aData, size_t aSize);
+
+    // the root element of the document; throws EventStreamException
+    XmlNode read();
+
+  private:
+    void readElement(XmlNode& aElement);
+
+    const std::vector<std::string>& readName();
+
+    const std::string& readString();
+
+    std::string readText();
+
+    uint64_t readNumber();
+
+    int readByte();
+};
+
+
+/**
+ * The document of the aSize bytes of events at aData, built through
+ * aFactory with the whitespace XMLBeans' pretty printer writes, so it is
+ * the document the printed text parses into. Building is recorded as
+ * RESULT_PHASE. Throws schema-tools:JAVA-EXCEPTION if the events are
+ * malformed.
+ */
+Item buildEventDocument(const char* aData, size_t aSize, ItemFactory* aFactory,
+    CallStats* aStats);
+
+// same for the events in the Java byte[] aEvents; copying them out of the
+// JVM is recorded as MARSHAL_PHASE. Throws JavaException like
+// CHECK_EXCEPTION.
+Item buildEventDocument(JNIEnv* env, jbyteArray aEvents, ItemFactory* aFactory,
+    CallStats* aStats, jthrowable& lException);
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_EVENT_STREAM_H
+/* vim:set et sw=2 ts=2: */
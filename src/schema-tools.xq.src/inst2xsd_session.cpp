@@ -0,0 +1,653 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <exception>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+#include <zorba/iterator.h>
+#include <zorba/serializer.h>
+#include <zorba/singleton_item_sequence.h>
+#include <zorba/vector_item_sequence.h>
+#include <zorba/zorba.h>
+
+#include "event_stream.h"
+#include "inst2xsd_session.h"
+#include "instance_files.h"
+#include "instance_stream.h"
+#include "schema_model.h"
+#include "schema_sequence.h"
+
+// size of the ring buffer instances are serialized into for the JVM
+#define INSTANCE_STREAM_CAPACITY (256 * 1024)
+
+// instances one worker of a parallel inference takes at a time
+#define PARALLEL_CHUNK_SIZE 1024
+
+// files mapped and handed to the JVM at a time
+#define FILE_BATCH_SIZE 64
+
+// name of the InferenceSessions in the dynamic context
+#define INFERENCE_SESSIONS_PARAMETER "http://www.zorba-xquery.com/modules/schema-tools/inst2xsd-sessions"
+
+namespace zorba
+{
+namespace schematools
+{
+
+// serializes the instances sent to the JVM
+static Serializer_t newInstanceSerializer()
+{
+  Zorba_SerializerOptions_t lOptions;
+  lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
+  return Serializer::createSerializer(lOptions);
+}
+
+
+InferenceSession::InferenceSession(const STOptions& aOptions) :
+  theOptions(aOptions),
+  theNative(new NativeInst2Xsd(aOptions)),
+  theJvm(0),
+  theCache(0),
+  theSession(0),
+  theSeen(0),
+  theRandom(aOptions.getSeed())
+{
+}
+
+
+InferenceSession::InferenceSession(const STOptions& aOptions,
+                                   zorba::jvm::JavaVMSingleton* aJvm,
+                                   const JniCache& aCache,
+                                   jobject aJavaOptions,
+                                   jthrowable& lException) :
+  theOptions(aOptions),
+  theJvm(aJvm),
+  theCache(&aCache),
+  theSession(0),
+  theSeen(0),
+  theRandom(aOptions.getSeed())
+{
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+
+  // compiled options have an object of their own, the others reuse this
+  // thread's
+  jobject optObj = aJavaOptions ? aJavaOptions :
+      JavaOptionsCache::forCurrentThread().getInst2XsdOptions(
+          env, aCache, theOptions, lException);
+
+  jobject lSession = env->NewObject(aCache.theInst2XsdSessionClass,
+      aCache.theInst2XsdSessionInit, optObj);
+  CHECK_EXCEPTION(env);
+  theSession = env->NewGlobalRef(lSession);
+  env->DeleteLocalRef(lSession);
+}
+
+
+InferenceSession::InferenceSession(const STOptions& aOptions,
+                                   const StaticContext* aContext) :
+  theOptions(aOptions),
+  theJvm(0),
+  theCache(0),
+  theSession(0),
+  theWorker(WorkerPool::getInstance().acquire(aContext)),
+  theSeen(0),
+  theRandom(aOptions.getSeed())
+{
+  std::string lPayload;
+  appendInt(lPayload, theOptions.getDesign());
+  appendInt(lPayload, theOptions.getSimpleContentType());
+  appendInt(lPayload, theOptions.getUseEnumeration());
+  appendInt(lPayload, theOptions.isVerbose());
+  theWorker->send(WORKER_INST2XSD_OPEN, lPayload);
+}
+
+
+InferenceSession::~InferenceSession()
+{
+  // a session that was not finished, e.g. one the query never closed,
+  // leaves its connection unusable: the pool closes it rather than keep it
+  WorkerPool::getInstance().release(std::move(theWorker));
+
+  if (!theSession)
+    return;
+
+  try
+  {
+    currentThreadEnv(theJvm->getVM())->DeleteGlobalRef(theSession);
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    // this thread can not be attached, the session is left to the VM
+  }
+}
+
+
+JNIEnv* InferenceSession::getEnv() const
+{
+  return theJvm ? currentThreadEnv(theJvm->getVM()) : 0;
+}
+
+
+void InferenceSession::add(ItemSequence* aInstances, CallStats* aStats,
+                           jthrowable& lException)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  if (theOptions.getSampleSize() > 0)
+    sample(aInstances, aStats);
+  else
+    infer(aInstances, INSTANCES_COUNTER, aStats, lException);
+}
+
+
+void InferenceSession::seed(ItemSequence* aSchemas, CallStats* aStats)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  PhaseTimer lTimer(aStats, INFER_PHASE);
+  SchemaSet lSchemas;
+  Iterator_t lIter = aSchemas->getIterator();
+  Item item;
+  lIter->open();
+  while( lIter->next(item) )
+  {
+    lSchemas.add(item);
+    aStats->count(SCHEMAS_COUNTER);
+  }
+  lIter->close();
+  theNative->seed(lSchemas);
+}
+
+
+void InferenceSession::sample(ItemSequence* aInstances, CallStats* aStats)
+{
+  uint64_t lSize = theOptions.getSampleSize();
+  Iterator_t lIter = aInstances->getIterator();
+  Item item;
+  uint64_t lCount = 0;
+
+  lIter->open();
+  while( lIter->next(item) )
+  {
+    if (theSeen < lSize)
+      theReservoir.push_back(std::make_pair(theSeen, item));
+    else
+    {
+      // the instance replaces a random one with probability size/seen
+      uint64_t lSlot = theRandom() % (theSeen + 1);
+      if (lSlot < lSize)
+        theReservoir[lSlot] = std::make_pair(theSeen, item);
+    }
+    ++theSeen;
+    ++lCount;
+  }
+  lIter->close();
+  aStats->count(INSTANCES_COUNTER, lCount);
+}
+
+
+void InferenceSession::infer(ItemSequence* aInstances, counter_t aCounter,
+                             CallStats* aStats, jthrowable& lException)
+{
+  Iterator_t lIter = aInstances->getIterator();
+  Item item;
+
+  if (theNative)
+  {
+    lIter->open();
+    if (workerCount() > 1)
+      addParallel(lIter, aCounter, aStats);
+    else
+    {
+      PhaseTimer lTimer(aStats, INFER_PHASE);
+      uint64_t lCount = 0;
+      while( lIter->next(item) )
+      {
+        theNative->add(item);
+        ++lCount;
+      }
+      aStats->count(aCounter, lCount);
+    }
+    lIter->close();
+    return;
+  }
+
+  Serializer_t lSerializer = newInstanceSerializer();
+
+  if (theWorker)
+  {
+    // the instances are pipelined, the worker answers when the session is
+    // finished; it parses text, whatever the transfer option
+    PhaseTimer lTimer(aStats, SERIALIZE_PHASE);
+    uint64_t lCount = 0;
+    lIter->open();
+    while( lIter->next(item) )
+    {
+      std::ostringstream lOut;
+      SingletonItemSequence lSequence(item);
+      lSerializer->serialize(&lSequence, lOut);
+      std::string lInstance = lOut.str();
+      theWorker->send(WORKER_INST2XSD_ADD, lInstance);
+      aStats->count(BYTES_TO_JVM_COUNTER, lInstance.size());
+      ++lCount;
+    }
+    lIter->close();
+    theWorker->flush();
+    aStats->count(aCounter, lCount);
+    return;
+  }
+
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+  LocalFrame lFrame(env, LOCAL_FRAME_CAPACITY, lException);
+
+  // the reader thread of the session parses the instances while they are
+  // serialized into the ring buffer of the stream, or reads their events
+  bool lEvents = theOptions.getTransfer() == STOptions::EVENTS_TRANSFER;
+  jobject lStream = env->CallObjectMethod(theSession, lEvents ?
+      theCache->theInst2XsdSessionStartEventStream :
+      theCache->theInst2XsdSessionStartStream, (jint)INSTANCE_STREAM_CAPACITY);
+  CHECK_EXCEPTION(env);
+
+  {
+    InstanceStreamBuf lStreamBuf(env, *theCache, lStream);
+    std::ostream lOut(&lStreamBuf);
+    // interns names for all instances of the stream
+    EventStreamWriter lEventWriter(lStreamBuf);
+
+    // serializing writes straight into the ring, so this includes the copy
+    // into the JVM and any wait for the reader to make room
+    PhaseTimer lTimer(aStats, SERIALIZE_PHASE);
+    uint64_t lCount = 0;
+    lIter->open();
+    while( lIter->next(item) )
+    {
+      if (lEvents)
+        lEventWriter.write(item);
+      else
+      {
+        SingletonItemSequence lSequence(item);
+        lSerializer->serialize(&lSequence, lOut);
+      }
+      lStreamBuf.endDocument(lException);
+      ++lCount;
+    }
+    lIter->close();
+
+    lStreamBuf.endOfData(lException);
+    lTimer.stop();
+    aStats->count(aCounter, lCount);
+    aStats->count(BYTES_TO_JVM_COUNTER, lStreamBuf.getWritten());
+  }
+  env->DeleteLocalRef(lStream);
+
+  // the instances are processed when this batch returns
+  env->CallVoidMethod(theSession, theCache->theInst2XsdSessionAwait);
+  CHECK_EXCEPTION(env);
+
+  takeSessionTimes(env, aStats, lException);
+}
+
+
+void InferenceSession::addFiles(const std::vector<std::string>& aPaths,
+                                CallStats* aStats, jthrowable& lException)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  std::vector<std::string> lPaths = aPaths;
+  counter_t lCounter = INSTANCES_COUNTER;
+  if (theOptions.getSampleSize() > 0)
+  {
+    aStats->count(INSTANCES_COUNTER, aPaths.size());
+    lPaths = samplePaths(aPaths);
+    lCounter = SAMPLED_COUNTER;
+  }
+
+  if (theNative)
+  {
+    PhaseTimer lTimer(aStats, INFER_PHASE);
+    addNativeFiles(lPaths);
+    aStats->count(lCounter, lPaths.size());
+    return;
+  }
+
+  if (theWorker)
+  {
+    PhaseTimer lMarshal(aStats, MARSHAL_PHASE);
+    for (size_t i = 0; i < lPaths.size(); ++i)
+    {
+      MappedFile lFile(lPaths[i]);
+      theWorker->send(WORKER_INST2XSD_ADD, lFile.size() ?
+          std::string(lFile.data(), lFile.size()) : std::string());
+      aStats->count(BYTES_TO_JVM_COUNTER, lFile.size());
+    }
+    theWorker->flush();
+    aStats->count(lCounter, lPaths.size());
+    return;
+  }
+
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+  jint lParallelism = workerCount();
+
+  // NewDirectByteBuffer wants an address even for an empty file
+  static char lEmpty;
+
+  for (size_t lStart = 0; lStart < lPaths.size(); lStart += FILE_BATCH_SIZE)
+  {
+    size_t lEnd = std::min(lPaths.size(), lStart + FILE_BATCH_SIZE);
+
+    // the files stay mapped until the JVM has parsed them, the buffers of a
+    // batch go with its frame
+    PhaseTimer lMarshal(aStats, MARSHAL_PHASE);
+    LocalFrame lFrame(env, FILE_BATCH_SIZE + LOCAL_FRAME_CAPACITY, lException);
+    std::vector<std::unique_ptr<MappedFile> > lFiles;
+    jobjectArray lDocs = env->NewObjectArray(lEnd - lStart,
+        theCache->theByteBufferClass, NULL);
+    CHECK_EXCEPTION(env);
+    for (size_t i = lStart; i < lEnd; ++i)
+    {
+      lFiles.push_back(std::unique_ptr<MappedFile>(new MappedFile(lPaths[i])));
+      const MappedFile& lFile = *lFiles.back();
+      void* lData = lFile.size() ? (void*)lFile.data() : &lEmpty;
+      jobject lBuffer = env->NewDirectByteBuffer(lData, lFile.size());
+      CHECK_EXCEPTION(env);
+      env->SetObjectArrayElement(lDocs, i - lStart, lBuffer);
+      aStats->count(BYTES_TO_JVM_COUNTER, lFile.size());
+    }
+    lMarshal.stop();
+
+    env->CallVoidMethod(theSession, theCache->theInst2XsdSessionAddDocuments,
+        lDocs, lParallelism);
+    CHECK_EXCEPTION(env);
+    aStats->count(lCounter, lEnd - lStart);
+  }
+
+  takeSessionTimes(env, aStats, lException);
+}
+
+
+std::vector<std::string>
+InferenceSession::samplePaths(const std::vector<std::string>& aPaths)
+{
+  uint64_t lSize = theOptions.getSampleSize();
+  std::vector<std::pair<uint64_t, const std::string*> > lReservoir;
+
+  // as sample() does for instances
+  for (size_t i = 0; i < aPaths.size(); ++i, ++theSeen)
+  {
+    if (theSeen < lSize)
+      lReservoir.push_back(std::make_pair(theSeen, &aPaths[i]));
+    else
+    {
+      uint64_t lSlot = theRandom() % (theSeen + 1);
+      if (lSlot < lSize)
+        lReservoir[lSlot] = std::make_pair(theSeen, &aPaths[i]);
+    }
+  }
+
+  std::sort(lReservoir.begin(), lReservoir.end());
+  std::vector<std::string> lPaths;
+  for (size_t i = 0; i < lReservoir.size(); ++i)
+    lPaths.push_back(*lReservoir[i].second);
+  return lPaths;
+}
+
+
+// parses the document of aPath into a node, from the mapped file
+static Item parseFile(const std::string& aPath)
+{
+  MappedFile lFile(aPath);
+  MappedFileBuf lBuf(lFile);
+  std::istream lIn(&lBuf);
+  return Zorba::getInstance(0)->getXmlDataManager()->parseXML(lIn);
+}
+
+
+void InferenceSession::addNativeFiles(const std::vector<std::string>& aPaths)
+{
+  size_t lWorkers = std::min<size_t>(workerCount(), aPaths.size());
+  if (lWorkers <= 1)
+  {
+    // each document is dropped once added
+    for (size_t i = 0; i < aPaths.size(); ++i)
+      theNative->add(parseFile(aPaths[i]));
+    return;
+  }
+
+  // every worker reads a contiguous range of the files; the partial models
+  // are merged in order, so the result is the sequential one
+  size_t lPerWorker = (aPaths.size() + lWorkers - 1) / lWorkers;
+  std::vector<std::unique_ptr<NativeInst2Xsd> > lParts(lWorkers);
+  std::vector<std::exception_ptr> lErrors(lWorkers);
+  std::vector<std::thread> lThreads;
+
+  for (size_t k = 0; k < lWorkers; ++k)
+  {
+    lThreads.push_back(std::thread([&, k]()
+    {
+      try
+      {
+        lParts[k].reset(new NativeInst2Xsd(theOptions));
+        size_t lEnd = std::min(aPaths.size(), (k + 1) * lPerWorker);
+        for (size_t i = k * lPerWorker; i < lEnd; ++i)
+          lParts[k]->add(parseFile(aPaths[i]));
+      }
+      catch (...)
+      {
+        lErrors[k] = std::current_exception();
+      }
+    }));
+  }
+  for (size_t k = 0; k < lWorkers; ++k)
+    lThreads[k].join();
+
+  for (size_t k = 0; k < lWorkers; ++k)
+  {
+    if (lErrors[k])
+      std::rethrow_exception(lErrors[k]);
+    theNative->merge(*lParts[k]);
+  }
+}
+
+
+unsigned int InferenceSession::workerCount() const
+{
+  unsigned int lWorkers = theOptions.getParallelism();
+  if (lWorkers == 0)
+    lWorkers = std::max(std::thread::hardware_concurrency(), 1U);
+  return lWorkers;
+}
+
+
+void InferenceSession::addParallel(Iterator_t& aIter, counter_t aCounter,
+                                   CallStats* aStats)
+{
+  PhaseTimer lTimer(aStats, INFER_PHASE);
+  uint64_t lCount = 0;
+  unsigned int lWorkers = workerCount();
+  std::vector<Item> lBatch;
+  bool lMore = true;
+
+  // the iterator is only used on this thread: the instances are read in
+  // rounds of one chunk per worker, inferred concurrently and merged in
+  // order, so the result does not depend on the scheduling
+  while (lMore)
+  {
+    lBatch.clear();
+    Item item;
+    while (lBatch.size() < lWorkers * PARALLEL_CHUNK_SIZE &&
+           (lMore = aIter->next(item)))
+      lBatch.push_back(item);
+    if (lBatch.empty())
+      break;
+    lCount += lBatch.size();
+
+    size_t lChunks = (lBatch.size() + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    std::vector<std::unique_ptr<NativeInst2Xsd> > lParts(lChunks);
+    std::vector<std::exception_ptr> lErrors(lChunks);
+    std::vector<std::thread> lThreads;
+
+    for (size_t k = 0; k < lChunks; ++k)
+    {
+      lThreads.push_back(std::thread([&, k]()
+      {
+        try
+        {
+          lParts[k].reset(new NativeInst2Xsd(theOptions));
+          size_t lEnd = std::min(lBatch.size(), (k + 1) * PARALLEL_CHUNK_SIZE);
+          for (size_t i = k * PARALLEL_CHUNK_SIZE; i < lEnd; ++i)
+            lParts[k]->add(lBatch[i]);
+        }
+        catch (...)
+        {
+          lErrors[k] = std::current_exception();
+        }
+      }));
+    }
+    for (size_t k = 0; k < lChunks; ++k)
+      lThreads[k].join();
+
+    for (size_t k = 0; k < lChunks; ++k)
+    {
+      if (lErrors[k])
+        std::rethrow_exception(lErrors[k]);
+      theNative->merge(*lParts[k]);
+    }
+  }
+  aStats->count(aCounter, lCount);
+}
+
+
+ItemSequence_t InferenceSession::finish(ItemFactory* aFactory,
+                                        const CallStats_t& aStats,
+                                        jthrowable& lException)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  if (!theReservoir.empty())
+  {
+    // the sample goes to the engine in input order, as without sampling
+    std::sort(theReservoir.begin(), theReservoir.end(),
+        [](const std::pair<uint64_t, Item>& a, const std::pair<uint64_t, Item>& b)
+        { return a.first < b.first; });
+    std::vector<Item> lSample;
+    for (size_t i = 0; i < theReservoir.size(); ++i)
+      lSample.push_back(theReservoir[i].second);
+    theReservoir.clear();
+
+    VectorItemSequence lSequence(lSample);
+    infer(&lSequence, SAMPLED_COUNTER, aStats.get(), lException);
+  }
+
+  if (theNative)
+  {
+    PhaseTimer lTimer(aStats.get(), INFER_PHASE);
+    return ItemSequence_t(
+        new NativeSchemaSequence(theNative->schemas(), aFactory, aStats));
+  }
+
+  if (theWorker)
+  {
+    theWorker->send(WORKER_INST2XSD_FINISH, std::string(), true);
+    std::vector<Item> lSchemas =
+        theWorker->receiveResult(aFactory, aStats.get());
+    return ItemSequence_t(new VectorItemSequence(lSchemas));
+  }
+
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+  LocalFrame lFrame(env, LOCAL_FRAME_CAPACITY, lException);
+
+  jobjectArray lSchemas = (jobjectArray) env->CallObjectMethod(theSession,
+      theCache->theInst2XsdSessionFinishEvents);
+  CHECK_EXCEPTION(env);
+
+  takeSessionTimes(env, aStats.get(), lException);
+
+  // the events of the schemas stay in the JVM until the result is iterated
+  return ItemSequence_t(
+      new JavaSchemaSequence(theJvm, lSchemas, aFactory, aStats));
+}
+
+
+void InferenceSession::takeSessionTimes(JNIEnv* env, CallStats* aStats,
+                                        jthrowable& lException)
+{
+  jobject lTimes = env->CallObjectMethod(theSession,
+      theCache->theInst2XsdSessionTimes);
+  CHECK_EXCEPTION(env);
+  aStats->takeJavaTimes(env, *theCache, lTimes, lException);
+  env->DeleteLocalRef(lTimes);
+}
+
+
+
+InferenceSessions* InferenceSessions::get(const DynamicContext* aContext)
+{
+  InferenceSessions* lSessions = static_cast<InferenceSessions*>(
+      aContext->getExternalFunctionParameter(INFERENCE_SESSIONS_PARAMETER));
+  if (!lSessions)
+  {
+    lSessions = new InferenceSessions();
+    aContext->addExternalFunctionParameter(INFERENCE_SESSIONS_PARAMETER,
+        lSessions);
+  }
+  return lSessions;
+}
+
+
+std::string
+InferenceSessions::open(const std::shared_ptr<InferenceSession>& aSession)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+  std::ostringstream lHandle;
+  lHandle << "urn:zorba:schema-tools:inst2xsd-session:" << ++theLastId;
+  theSessions[lHandle.str()] = aSession;
+  return lHandle.str();
+}
+
+
+std::shared_ptr<InferenceSession>
+InferenceSessions::find(const std::string& aHandle)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+  std::map<std::string, std::shared_ptr<InferenceSession> >::iterator lIt =
+      theSessions.find(aHandle);
+  if (lIt == theSessions.end())
+    return std::shared_ptr<InferenceSession>();
+  return lIt->second;
+}
+
+
+std::shared_ptr<InferenceSession>
+InferenceSessions::close(const std::string& aHandle)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+  std::shared_ptr<InferenceSession> lSession;
+  std::map<std::string, std::shared_ptr<InferenceSession> >::iterator lIt =
+      theSessions.find(aHandle);
+  if (lIt != theSessions.end())
+  {
+    lSession = lIt->second;
+    theSessions.erase(lIt);
+  }
+  return lSession;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_INST2XSD_SESSION_H
+#define ZORBA_SCHEMATOOLS_INST2XSD_SESSION_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zorba/dynamic_context.h>
+#include <zorba/external_function_parameter.h>
+#include <zorba/item.h>
+#include <zorba/item_factory.h>
+#include <zorba/item_sequence.h>
+#include <zorba/iterator.h>
+
+#include "JavaVMSingleton.h"
+
+#include "jni_cache.h"
+#include "native_inst2xsd.h"
+#include "st_options.h"
+#include "stats.h"
+#include "worker_pool.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Inference state that instances are added to batch by batch.
+ *
+ * Only the inferred types are kept between batches: the native engine
+ * folds every instance into a NativeInst2Xsd, the XMLBeans engine streams
+ * it to a Java Inst2XsdSession that drops it once processed, in the JVM
+ * of the process or in a worker process of the WorkerPool.
+ *
+ * With a sample size, the batches only fill a reservoir of that many
+ * instances (Algorithm R); they are given to the engine, in input order,
+ * when the session is finished.
+ */
+class InferenceSession
+{
+  private:
+    STOptions theOptions;
+    std::unique_ptr<NativeInst2Xsd> theNative;
+
+    zorba::jvm::JavaVMSingleton* theJvm;
+    const JniCache* theCache;
+    // global reference to the Java Inst2XsdSession
+    jobject theSession;
+    // the connection the session is open on in a worker
+    std::unique_ptr<WorkerConnection> theWorker;
+
+    // batches of one session are added one after the other
+    std::mutex theMutex;
+
+    // the sampled instances and their positions in the input, and the
+    // number of instances seen
+    std::vector<std::pair<uint64_t, Item> > theReservoir;
+    uint64_t theSeen;
+    // mt19937_64 yields the same numbers everywhere, so does the sample
+    std::mt19937_64 theRandom;
+
+  public:
+    // a session of the native engine
+    InferenceSession(const STOptions& aOptions);
+
+    // a session of the XMLBeans engine, with the Java Inst2XsdOptions
+    // aJavaOptions, or null for the ones of aOptions; throws JavaException,
+    // with the pending exception in lException, if the Java session can
+    // not be made
+    InferenceSession(const STOptions& aOptions,
+        zorba::jvm::JavaVMSingleton* aJvm, const JniCache& aCache,
+        jobject aJavaOptions, jthrowable& lException);
+
+    // a session of the XMLBeans engine in a worker of the WorkerPool,
+    // started if need be with the jars aContext finds; throws
+    // WorkerException
+    InferenceSession(const STOptions& aOptions, const StaticContext* aContext);
+
+    ~InferenceSession();
+
+    const STOptions& getOptions() const
+    { return theOptions; }
+
+    // env of the calling thread, null for the native engine and workers
+    JNIEnv* getEnv() const;
+
+    bool isWorker() const
+    { return theWorker != 0; }
+
+    // starts the native engine from the schemas aSchemas inferred before,
+    // as SchemaReader reads them, so the instances added only widen them;
+    // throws SchemaException if they can not be read
+    void seed(ItemSequence* aSchemas, CallStats* aStats);
+
+    // the phases of the call are recorded in aStats
+    void add(ItemSequence* aInstances, CallStats* aStats,
+        jthrowable& lException);
+
+    // adds the instance documents in the files aPaths, in that order,
+    // without making them nodes for the XMLBeans engine; throws
+    // FileException if a file can not be read. In a worker, the errors of
+    // the instances added are only reported by finish().
+    void addFiles(const std::vector<std::string>& aPaths, CallStats* aStats,
+        jthrowable& lException);
+
+    // the schemas inferred from all instances added so far, as a sequence
+    // that builds each document when it is iterated to
+    ItemSequence_t finish(ItemFactory* aFactory, const CallStats_t& aStats,
+        jthrowable& lException);
+
+  private:
+    // worker threads of the native engine
+    unsigned int workerCount() const;
+
+    // gives aInstances to the engine, counted as aCounter
+    void infer(ItemSequence* aInstances, counter_t aCounter,
+        CallStats* aStats, jthrowable& lException);
+
+    // draws the reservoir sample from aInstances
+    void sample(ItemSequence* aInstances, CallStats* aStats);
+
+    // the reservoir sample of aPaths, in their order
+    std::vector<std::string> samplePaths(const std::vector<std::string>& aPaths);
+
+    // native engine reading files, in parallel with more than one worker
+    void addNativeFiles(const std::vector<std::string>& aPaths);
+
+    // native engine with more than one worker
+    void addParallel(Iterator_t& aIter, counter_t aCounter,
+        CallStats* aStats);
+
+    // records the Java times of the session since they were taken last
+    void takeSessionTimes(JNIEnv* env, CallStats* aStats,
+        jthrowable& lException);
+
+    InferenceSession(const InferenceSession&);
+    InferenceSession& operator=(const InferenceSession&);
+};
+
+
+/**
+ * The open sessions of a query, kept in its dynamic context. Sessions the
+ * query does not close are released with the dynamic context.
+ */
+class InferenceSessions : public ExternalFunctionParameter
+{
+  private:
+    std::mutex theMutex;
+    std::map<std::string, std::shared_ptr<InferenceSession> > theSessions;
+    unsigned long theLastId;
+
+    InferenceSessions() : theLastId(0)
+    {}
+
+  public:
+    // the sessions of aContext, created on first use
+    static InferenceSessions* get(const DynamicContext* aContext);
+
+    // registers aSession and returns its handle
+    std::string open(const std::shared_ptr<InferenceSession>& aSession);
+
+    // null if there is no open session aHandle
+    std::shared_ptr<InferenceSession> find(const std::string& aHandle);
+
+    // same, and removes the session
+    std::shared_ptr<InferenceSession> close(const std::string& aHandle);
+
+    virtual void destroy() throw()
+    { delete this; }
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_INST2XSD_SESSION_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "instance_files.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+std::vector<std::string> expandPaths(const std::vector<std::string>& aPatterns)
+{
+  std::vector<std::string> lPaths;
+  for (size_t i = 0; i < aPatterns.size(); ++i)
+  {
+    const std::string& lPattern = aPatterns[i];
+    if (lPattern.find_first_of("*?[") == std::string::npos)
+    {
+      lPaths.push_back(lPattern);
+      continue;
+    }
+
+#ifdef WIN32
+    // only the last path component can have wildcards
+    std::string lDir;
+    std::string::size_type lSlash = lPattern.find_last_of("/\\");
+    if (lSlash != std::string::npos)
+      lDir = lPattern.substr(0, lSlash + 1);
+
+    std::vector<std::string> lMatches;
+    WIN32_FIND_DATAA lData;
+    HANDLE lFind = FindFirstFileA(lPattern.c_str(), &lData);
+    if (lFind != INVALID_HANDLE_VALUE)
+    {
+      do
+      {
+        if (!(lData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+          lMatches.push_back(lDir + lData.cFileName);
+      } while (FindNextFileA(lFind, &lData));
+      FindClose(lFind);
+    }
+    std::sort(lMatches.begin(), lMatches.end());
+    lPaths.insert(lPaths.end(), lMatches.begin(), lMatches.end());
+#else
+    glob_t lGlob;
+    int lResult = glob(lPattern.c_str(), 0, NULL, &lGlob);
+    if (lResult == GLOB_NOMATCH)
+    {
+      globfree(&lGlob);
+      continue;
+    }
+    if (lResult != 0)
+    {
+      globfree(&lGlob);
+      throw FileException(lPattern, lResult == GLOB_NOSPACE ?
+          "out of memory expanding the pattern" :
+          "a directory of the pattern can not be read");
+    }
+    // like on Windows, directories and other files that are no regular
+    // files are skipped
+    for (size_t m = 0; m < lGlob.gl_pathc; ++m)
+    {
+      struct stat lStat;
+      if (stat(lGlob.gl_pathv[m], &lStat) == 0 && S_ISREG(lStat.st_mode))
+        lPaths.push_back(lGlob.gl_pathv[m]);
+    }
+    globfree(&lGlob);
+#endif
+  }
+  return lPaths;
+}
+
+
+#ifdef WIN32
+
+MappedFile::MappedFile(const std::string& aPath) :
+  theData(0),
+  theSize(0),
+  theFile(INVALID_HANDLE_VALUE),
+  theMapping(0)
+{
+  theFile = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (theFile == INVALID_HANDLE_VALUE)
+    throw FileException(aPath, "can not be opened");
+
+  LARGE_INTEGER lSize;
+  if (!GetFileSizeEx(theFile, &lSize))
+  {
+    CloseHandle(theFile);
+    throw FileException(aPath, "can not get its size");
+  }
+  theSize = (size_t)lSize.QuadPart;
+  if (theSize == 0)
+    return;
+
+  theMapping = CreateFileMappingA(theFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (theMapping)
+    theData = (const char*)MapViewOfFile(theMapping, FILE_MAP_READ, 0, 0, 0);
+  if (!theData)
+  {
+    if (theMapping)
+      CloseHandle(theMapping);
+    CloseHandle(theFile);
+    throw FileException(aPath, "can not be mapped");
+  }
+}
+
+
+MappedFile::~MappedFile()
+{
+  if (theData)
+    UnmapViewOfFile(theData);
+  if (theMapping)
+    CloseHandle(theMapping);
+  CloseHandle(theFile);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& aPath) :
+  theData(0),
+  theSize(0),
+  theFile(-1)
+{
+  theFile = open(aPath.c_str(), O_RDONLY);
+  if (theFile < 0)
+    throw FileException(aPath, strerror(errno));
+
+  struct stat lStat;
+  if (fstat(theFile, &lStat) != 0)
+  {
+    int lError = errno;
+    close(theFile);
+    throw FileException(aPath, strerror(lError));
+  }
+  if (!S_ISREG(lStat.st_mode))
+  {
+    close(theFile);
+    throw FileException(aPath, S_ISDIR(lStat.st_mode) ?
+        "is a directory" : "is not a regular file");
+  }
+  theSize = lStat.st_size;
+  // an empty file can not be mapped, and has no bytes to read anyway
+  if (theSize == 0)
+    return;
+
+  void* lData = mmap(NULL, theSize, PROT_READ, MAP_PRIVATE, theFile, 0);
+  if (lData == MAP_FAILED)
+  {
+    int lError = errno;
+    close(theFile);
+    throw FileException(aPath, strerror(lError));
+  }
+  // the parsers read each file once, front to back
+  madvise(lData, theSize, MADV_SEQUENTIAL);
+  theData = (const char*)lData;
+}
+
+
+MappedFile::~MappedFile()
+{
+  if (theData)
+    munmap((void*)theData, theSize);
+  close(theFile);
+}
+
+#endif
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
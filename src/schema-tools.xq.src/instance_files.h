@@ -0,0 +1,101 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_INSTANCE_FILES_H
+#define ZORBA_SCHEMATOOLS_INSTANCE_FILES_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Error reading an instance file, reported as schema-tools:FILE001.
+ */
+class FileException
+{
+  public:
+    std::string theMessage;
+
+  public:
+    FileException(const std::string& aPath, const std::string& aReason) :
+      theMessage("Could not read file \"" + aPath + "\": " + aReason)
+    {}
+};
+
+
+/**
+ * The files aPatterns name. A pattern with wildcards (*, ? or [) stands for
+ * the regular files it matches, in sorted order, and may match none; any
+ * other pattern is taken as the path of a file. Throws FileException if a
+ * pattern can not be expanded.
+ */
+std::vector<std::string> expandPaths(const std::vector<std::string>& aPatterns);
+
+
+/**
+ * A file mapped read-only into memory, unmapped by the destructor. Throws
+ * FileException if the file can not be opened or mapped.
+ */
+class MappedFile
+{
+  private:
+    const char* theData;
+    size_t theSize;
+#ifdef WIN32
+    void* theFile;
+    void* theMapping;
+#else
+    int theFile;
+#endif
+
+  public:
+    MappedFile(const std::string& aPath);
+
+    ~MappedFile();
+
+    const char* data() const
+    { return theData; }
+
+    size_t size() const
+    { return theSize; }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+
+/**
+ * streambuf reading the bytes of a MappedFile in place.
+ */
+class MappedFileBuf : public std::streambuf
+{
+  public:
+    MappedFileBuf(const MappedFile& aFile)
+    {
+      char* lData = const_cast<char*>(aFile.data());
+      setg(lData, lData, lData + aFile.size());
+    }
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_INSTANCE_FILES_H
+/* vim:set et sw=2 ts=2: */
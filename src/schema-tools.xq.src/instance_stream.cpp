@@ -0,0 +1,151 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "instance_stream.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+InstanceStreamBuf::InstanceStreamBuf(JNIEnv* env, const JniCache& aCache,
+    jobject aStream) :
+  theEnv(env),
+  theCache(aCache),
+  theStream(aStream),
+  theRing(0),
+  theCapacity(0),
+  theWritten(0),
+  theFailed(false),
+  theFinished(false)
+{
+  jobject lBuffer = theEnv->CallObjectMethod(theStream,
+      theCache.theCppInputStreamGetBuffer);
+  if (theEnv->ExceptionCheck())
+  {
+    theFailed = true;
+    return;
+  }
+  theRing = (char*)theEnv->GetDirectBufferAddress(lBuffer);
+  theCapacity = theEnv->GetDirectBufferCapacity(lBuffer);
+  theEnv->DeleteLocalRef(lBuffer);
+  if (!theRing || theCapacity <= 0)
+    theFailed = true;
+}
+
+
+InstanceStreamBuf::~InstanceStreamBuf()
+{
+  if (theFinished)
+    return;
+
+  // Unblock the reader thread even though the producer failed, keeping any
+  // pending exception for the caller.
+  jthrowable lPending = theEnv->ExceptionOccurred();
+  if (lPending)
+    theEnv->ExceptionClear();
+  theEnv->CallVoidMethod(theStream, theCache.theCppInputStreamEndOfData);
+  theEnv->ExceptionClear();
+  if (lPending)
+  {
+    theEnv->Throw(lPending);
+    theEnv->DeleteLocalRef(lPending);
+  }
+}
+
+
+bool InstanceStreamBuf::commit()
+{
+  std::ptrdiff_t lLen = pptr() - pbase();
+  if (lLen == 0)
+    return true;
+
+  theEnv->CallVoidMethod(theStream, theCache.theCppInputStreamCommit, (jint)lLen);
+  if (theEnv->ExceptionCheck())
+  {
+    theFailed = true;
+    return false;
+  }
+  theWritten += lLen;
+  setp(pptr(), pptr());
+  return true;
+}
+
+
+bool InstanceStreamBuf::reserve()
+{
+  jint lFree = theEnv->CallIntMethod(theStream, theCache.theCppInputStreamReserve);
+  if (theEnv->ExceptionCheck())
+  {
+    theFailed = true;
+    return false;
+  }
+
+  // only the part up to the end of the ring is contiguous
+  jlong lTail = theWritten % theCapacity;
+  jlong lContiguous = std::min((jlong)lFree, theCapacity - lTail);
+  setp(theRing + lTail, theRing + lTail + lContiguous);
+  return true;
+}
+
+
+InstanceStreamBuf::int_type InstanceStreamBuf::overflow(int_type c)
+{
+  if (theFailed || !commit() || !reserve())
+    return traits_type::eof();
+
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+  return traits_type::not_eof(c);
+}
+
+
+int InstanceStreamBuf::sync()
+{
+  if (theFailed || !commit())
+    return -1;
+  return 0;
+}
+
+
+void InstanceStreamBuf::endDocument(jthrowable& lException)
+{
+  if (!theFailed)
+    commit();
+  CHECK_EXCEPTION(theEnv);
+  theEnv->CallVoidMethod(theStream, theCache.theCppInputStreamEndDocument);
+  CHECK_EXCEPTION(theEnv);
+}
+
+
+void InstanceStreamBuf::endOfData(jthrowable& lException)
+{
+  if (!theFailed)
+    commit();
+  CHECK_EXCEPTION(theEnv);
+  theFinished = true;
+  theEnv->CallVoidMethod(theStream, theCache.theCppInputStreamEndOfData);
+  CHECK_EXCEPTION(theEnv);
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
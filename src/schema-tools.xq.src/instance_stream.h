@@ -0,0 +1,78 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_INSTANCE_STREAM_H
+#define ZORBA_SCHEMATOOLS_INSTANCE_STREAM_H
+
+#include <streambuf>
+
+#include <jni.h>
+
+#include "jni_cache.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * streambuf writing straight into the ring buffer of a Java CppInputStream.
+ *
+ * The put area is the contiguous free part of the ring, so serialized bytes
+ * are copied exactly once, into memory the Java reader thread parses from.
+ * A Java exception raised while writing makes the streambuf fail; it is
+ * reported, still pending, by the next endDocument() or endOfData().
+ */
+class InstanceStreamBuf : public std::streambuf
+{
+  private:
+    JNIEnv* theEnv;
+    const JniCache& theCache;
+    jobject theStream;
+    char* theRing;
+    jlong theCapacity;
+    jlong theWritten;
+    bool theFailed;
+    bool theFinished;
+
+  public:
+    InstanceStreamBuf(JNIEnv* env, const JniCache& aCache, jobject aStream);
+
+    // signals the end of data to the reader if endOfData() was not reached
+    ~InstanceStreamBuf();
+
+    void endDocument(jthrowable& lException);
+
+    void endOfData(jthrowable& lException);
+
+    // bytes written to the ring so far
+    jlong getWritten() const
+    { return theWritten + (pptr() - pbase()); }
+
+  protected:
+    virtual int_type overflow(int_type c);
+
+    virtual int sync();
+
+  private:
+    bool commit();
+
+    bool reserve();
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_INSTANCE_STREAM_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,391 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JavaVMSingleton.h"
+
+#include "jni_cache.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Detaches the thread it belongs to from the VM currentThreadEnv attached
+ * it to, if any, when the thread exits.
+ */
+class ThreadAttachment
+{
+  public:
+    JavaVM* theVM;
+
+  public:
+    ThreadAttachment() : theVM(0)
+    {}
+
+    ~ThreadAttachment()
+    {
+      if (theVM)
+        theVM->DetachCurrentThread();
+    }
+};
+
+
+JNIEnv* currentThreadEnv(JavaVM* aVM)
+{
+  static thread_local ThreadAttachment lAttachment;
+
+  JNIEnv* env = 0;
+  jint lRes = aVM->GetEnv((void**)&env, JNI_VERSION_1_6);
+  if (lRes == JNI_OK)
+    return env;
+
+  // daemon threads do not keep the VM from shutting down
+  if (lRes == JNI_EDETACHED &&
+      aVM->AttachCurrentThreadAsDaemon((void**)&env, NULL) == JNI_OK)
+  {
+    lAttachment.theVM = aVM;
+    return env;
+  }
+
+  throw zorba::jvm::VMOpenException();
+}
+
+
+void LocalFrame::push(JNIEnv* env, jint aCapacity, jthrowable& lException)
+{
+  pop();
+  if (env->PushLocalFrame(aCapacity) != 0)
+  {
+    CHECK_EXCEPTION(env);
+    return;
+  }
+  theEnv = env;
+  theException = &lException;
+}
+
+
+void LocalFrame::pop()
+{
+  if (!theEnv)
+    return;
+
+  // the exception gets a reference in the outer frame
+  *theException = (jthrowable)theEnv->PopLocalFrame(*theException);
+  theEnv = 0;
+  theException = 0;
+}
+
+
+// the class members of JniCache, all global references
+static jclass JniCache::* const CLASS_MEMBERS[] =
+{
+  &JniCache::theStringClass,
+  &JniCache::theByteBufferClass,
+  &JniCache::theInst2XsdOptionsClass,
+  &JniCache::theInst2XsdSessionClass,
+  &JniCache::theCppInputStreamClass,
+  &JniCache::theXsd2InstOptionsClass,
+  &JniCache::theXsd2InstHelperClass,
+  &JniCache::theSampleBatchClass,
+  &JniCache::thePhaseTimesClass
+};
+
+
+JniCache::JniCache() :
+  theVM(0)
+{
+  dropClasses();
+}
+
+
+void JniCache::releaseClasses(JNIEnv* env)
+{
+  for (size_t i = 0; i < sizeof(CLASS_MEMBERS) / sizeof(CLASS_MEMBERS[0]); ++i)
+  {
+    // allowed while the exception of the failed lookup is pending
+    if (this->*CLASS_MEMBERS[i])
+      env->DeleteGlobalRef(this->*CLASS_MEMBERS[i]);
+  }
+  dropClasses();
+}
+
+
+void JniCache::dropClasses()
+{
+  for (size_t i = 0; i < sizeof(CLASS_MEMBERS) / sizeof(CLASS_MEMBERS[0]); ++i)
+    this->*CLASS_MEMBERS[i] = 0;
+}
+
+
+jclass JniCache::findClass(JNIEnv* env, const char* aName, jthrowable& lException)
+{
+  jclass lLocal = env->FindClass(aName);
+  CHECK_EXCEPTION(env);
+  jclass lGlobal = (jclass)env->NewGlobalRef(lLocal);
+  env->DeleteLocalRef(lLocal);
+  return lGlobal;
+}
+
+
+void JniCache::resolve(JNIEnv* env, JavaVM* aVM, jthrowable& lException)
+{
+  std::lock_guard<std::mutex> lLock(theMutex);
+
+  if (theVM == aVM)
+    return;
+
+  // Either the first call or the VM was restarted: the references held so
+  // far belong to a VM that is gone, so they are dropped, not deleted.
+  theVM = 0;
+  dropClasses();
+
+  // a failed lookup keeps none of the classes it found before, the next
+  // call looks them all up again
+  try
+  {
+    lookUp(env, lException);
+  }
+  catch (...)
+  {
+    releaseClasses(env);
+    throw;
+  }
+
+  theVM = aVM;
+}
+
+
+void JniCache::lookUp(JNIEnv* env, jthrowable& lException)
+{
+  theStringClass = findClass(env, "java/lang/String", lException);
+  theByteBufferClass = findClass(env, "java/nio/ByteBuffer", lException);
+
+  theInst2XsdOptionsClass = findClass(env,
+      "org/apache/xmlbeans/impl/inst2xsd/Inst2XsdOptions", lException);
+  theInst2XsdOptionsInit = env->GetMethodID(theInst2XsdOptionsClass,
+      "<init>", "()V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdOptionsSetDesign = env->GetMethodID(theInst2XsdOptionsClass,
+      "setDesign", "(I)V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdOptionsSetUseEnumerations = env->GetMethodID(theInst2XsdOptionsClass,
+      "setUseEnumerations", "(I)V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdOptionsSetSimpleContentTypes = env->GetMethodID(theInst2XsdOptionsClass,
+      "setSimpleContentTypes", "(I)V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdOptionsSetVerbose = env->GetMethodID(theInst2XsdOptionsClass,
+      "setVerbose", "(Z)V");
+  CHECK_EXCEPTION(env);
+
+  theInst2XsdSessionClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/Inst2XsdSession", lException);
+  theInst2XsdSessionInit = env->GetMethodID(theInst2XsdSessionClass,
+      "<init>", "(Lorg/apache/xmlbeans/impl/inst2xsd/Inst2XsdOptions;)V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionStartStream = env->GetMethodID(theInst2XsdSessionClass,
+      "startStream", "(I)Lorg/zorbaxquery/modules/schemaTools/CppInputStream;");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionStartEventStream = env->GetMethodID(theInst2XsdSessionClass,
+      "startEventStream", "(I)Lorg/zorbaxquery/modules/schemaTools/CppInputStream;");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionAwait = env->GetMethodID(theInst2XsdSessionClass,
+      "await", "()V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionAddDocuments = env->GetMethodID(theInst2XsdSessionClass,
+      "addDocuments", "([Ljava/nio/ByteBuffer;I)V");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionFinishEvents = env->GetMethodID(theInst2XsdSessionClass,
+      "finishEvents", "()[[B");
+  CHECK_EXCEPTION(env);
+  theInst2XsdSessionTimes = env->GetMethodID(theInst2XsdSessionClass,
+      "times", "()Lorg/zorbaxquery/modules/schemaTools/PhaseTimes;");
+  CHECK_EXCEPTION(env);
+
+  theCppInputStreamClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/CppInputStream", lException);
+  theCppInputStreamGetBuffer = env->GetMethodID(theCppInputStreamClass,
+      "getBuffer", "()Ljava/nio/ByteBuffer;");
+  CHECK_EXCEPTION(env);
+  theCppInputStreamReserve = env->GetMethodID(theCppInputStreamClass,
+      "reserve", "()I");
+  CHECK_EXCEPTION(env);
+  theCppInputStreamCommit = env->GetMethodID(theCppInputStreamClass,
+      "commit", "(I)V");
+  CHECK_EXCEPTION(env);
+  theCppInputStreamEndDocument = env->GetMethodID(theCppInputStreamClass,
+      "endDocument", "()V");
+  CHECK_EXCEPTION(env);
+  theCppInputStreamEndOfData = env->GetMethodID(theCppInputStreamClass,
+      "endOfData", "()V");
+  CHECK_EXCEPTION(env);
+
+  theXsd2InstOptionsClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/Xsd2InstHelper$Xsd2InstOptions", lException);
+  theXsd2InstOptionsInit = env->GetMethodID(theXsd2InstOptionsClass,
+      "<init>", "()V");
+  CHECK_EXCEPTION(env);
+  theXsd2InstOptionsSetNetworkDownloads = env->GetMethodID(theXsd2InstOptionsClass,
+      "setNetworkDownloads", "(Z)V");
+  CHECK_EXCEPTION(env);
+  theXsd2InstOptionsSetNopvr = env->GetMethodID(theXsd2InstOptionsClass,
+      "setNopvr", "(Z)V");
+  CHECK_EXCEPTION(env);
+  theXsd2InstOptionsSetNoupa = env->GetMethodID(theXsd2InstOptionsClass,
+      "setNoupa", "(Z)V");
+  CHECK_EXCEPTION(env);
+
+  theXsd2InstHelperClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/Xsd2InstHelper", lException);
+  theXsd2InstHelperXsd2instEvents = env->GetStaticMethodID(theXsd2InstHelperClass,
+      "xsd2instEvents",
+      "([Ljava/lang/String;Ljava/lang/String;Lorg/zorbaxquery/modules/schemaTools/Xsd2InstHelper$Xsd2InstOptions;)[B");
+  CHECK_EXCEPTION(env);
+  theXsd2InstHelperXsd2instAll = env->GetStaticMethodID(theXsd2InstHelperClass,
+      "xsd2instAll",
+      "([Ljava/lang/String;[Ljava/lang/String;Lorg/zorbaxquery/modules/schemaTools/Xsd2InstHelper$Xsd2InstOptions;)Lorg/zorbaxquery/modules/schemaTools/Xsd2InstHelper$SampleBatch;");
+  CHECK_EXCEPTION(env);
+
+  theSampleBatchClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/Xsd2InstHelper$SampleBatch", lException);
+  theSampleBatchReset = env->GetMethodID(theSampleBatchClass,
+      "reset", "()V");
+  CHECK_EXCEPTION(env);
+  theSampleBatchHasNext = env->GetMethodID(theSampleBatchClass,
+      "hasNext", "()Z");
+  CHECK_EXCEPTION(env);
+  theSampleBatchNextEvents = env->GetMethodID(theSampleBatchClass,
+      "nextEvents", "()[B");
+  CHECK_EXCEPTION(env);
+
+  thePhaseTimesClass = findClass(env,
+      "org/zorbaxquery/modules/schemaTools/PhaseTimes", lException);
+  thePhaseTimesCurrent = env->GetStaticMethodID(thePhaseTimesClass,
+      "current", "()Lorg/zorbaxquery/modules/schemaTools/PhaseTimes;");
+  CHECK_EXCEPTION(env);
+  thePhaseTimesTake = env->GetMethodID(thePhaseTimesClass,
+      "take", "()[J");
+  CHECK_EXCEPTION(env);
+}
+
+
+
+void setInst2XsdOptions(JNIEnv* env, const JniCache& aCache, jobject aTarget,
+                        const STOptions& aOptions, jthrowable& lException)
+{
+  env->CallVoidMethod(aTarget,
+      aCache.theInst2XsdOptionsSetDesign, aOptions.getDesign());
+  CHECK_EXCEPTION(env);
+  env->CallVoidMethod(aTarget,
+      aCache.theInst2XsdOptionsSetUseEnumerations, aOptions.getUseEnumeration());
+  CHECK_EXCEPTION(env);
+  env->CallVoidMethod(aTarget,
+      aCache.theInst2XsdOptionsSetSimpleContentTypes, aOptions.getSimpleContentType());
+  CHECK_EXCEPTION(env);
+  env->CallVoidMethod(aTarget,
+      aCache.theInst2XsdOptionsSetVerbose, (jboolean)aOptions.isVerbose());
+  CHECK_EXCEPTION(env);
+}
+
+
+void setXsd2InstOptions(JNIEnv* env, const JniCache& aCache, jobject aTarget,
+                        const STOptions& aOptions, jthrowable& lException)
+{
+  env->CallVoidMethod(aTarget,
+      aCache.theXsd2InstOptionsSetNetworkDownloads, (jboolean)aOptions.isNetworkDownloads());
+  CHECK_EXCEPTION(env);
+  env->CallVoidMethod(aTarget,
+      aCache.theXsd2InstOptionsSetNopvr, (jboolean)aOptions.isNoPVR());
+  CHECK_EXCEPTION(env);
+  env->CallVoidMethod(aTarget,
+      aCache.theXsd2InstOptionsSetNoupa, (jboolean)aOptions.isNoUPA());
+  CHECK_EXCEPTION(env);
+}
+
+
+
+JavaOptionsCache& JavaOptionsCache::forCurrentThread()
+{
+  static thread_local JavaOptionsCache lCache;
+  return lCache;
+}
+
+
+void JavaOptionsCache::checkVM(JNIEnv* env)
+{
+  JavaVM* lVM = 0;
+  env->GetJavaVM(&lVM);
+  if (lVM != theVM)
+  {
+    theVM = lVM;
+    theInst2XsdOptions = 0;
+    theXsd2InstOptions = 0;
+  }
+}
+
+
+jobject JavaOptionsCache::getInst2XsdOptions(JNIEnv* env,
+    const JniCache& aCache, const STOptions& aOptions, jthrowable& lException)
+{
+  checkVM(env);
+
+  bool lFresh = false;
+  if (!theInst2XsdOptions)
+  {
+    jobject lLocal = env->NewObject(aCache.theInst2XsdOptionsClass,
+        aCache.theInst2XsdOptionsInit);
+    CHECK_EXCEPTION(env);
+    theInst2XsdOptions = env->NewGlobalRef(lLocal);
+    env->DeleteLocalRef(lLocal);
+    lFresh = true;
+  }
+
+  if (lFresh || !theInst2XsdValues.sameInst2xsdOptions(aOptions))
+  {
+    setInst2XsdOptions(env, aCache, theInst2XsdOptions, aOptions, lException);
+    theInst2XsdValues = aOptions;
+  }
+  return theInst2XsdOptions;
+}
+
+
+jobject JavaOptionsCache::getXsd2InstOptions(JNIEnv* env,
+    const JniCache& aCache, const STOptions& aOptions, jthrowable& lException)
+{
+  checkVM(env);
+
+  bool lFresh = false;
+  if (!theXsd2InstOptions)
+  {
+    jobject lLocal = env->NewObject(aCache.theXsd2InstOptionsClass,
+        aCache.theXsd2InstOptionsInit);
+    CHECK_EXCEPTION(env);
+    theXsd2InstOptions = env->NewGlobalRef(lLocal);
+    env->DeleteLocalRef(lLocal);
+    lFresh = true;
+  }
+
+  if (lFresh || !theXsd2InstValues.sameXsd2instOptions(aOptions))
+  {
+    setXsd2InstOptions(env, aCache, theXsd2InstOptions, aOptions, lException);
+    theXsd2InstValues = aOptions;
+  }
+  return theXsd2InstOptions;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
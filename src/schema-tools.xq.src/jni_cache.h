@@ -0,0 +1,216 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_JNI_CACHE_H
+#define ZORBA_SCHEMATOOLS_JNI_CACHE_H
+
+#include <mutex>
+
+#include <jni.h>
+
+#include "st_options.h"
+
+class JavaException {
+};
+
+// local references a call into the JVM holds at a time, at most
+#define LOCAL_FRAME_CAPACITY 32
+
+#define CHECK_EXCEPTION(env)  if ((lException = env->ExceptionOccurred())) throw JavaException()
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * The JNIEnv of the calling thread for aVM.
+ *
+ * A JNIEnv is only valid on the thread it belongs to, so it is looked up
+ * on every call and never kept in shared state. A thread that is not
+ * attached yet is attached as a daemon, and detached again when it exits.
+ * Throws a VMOpenException if the thread can not be attached.
+ */
+JNIEnv* currentThreadEnv(JavaVM* aVM);
+
+
+/**
+ * A frame of JNI local references, popped with all references made in it
+ * when the LocalFrame goes out of scope.
+ *
+ * The threads that call the module stay attached and never return to Java,
+ * so nothing frees their local references but DeleteLocalRef or a frame.
+ * Every call into the JVM makes its references in a frame of its own, and
+ * a pending Java exception, kept in lException, is passed out of the frame.
+ */
+class LocalFrame
+{
+  private:
+    JNIEnv* theEnv;
+    jthrowable* theException;
+
+  public:
+    LocalFrame() : theEnv(0), theException(0)
+    {}
+
+    // push() at once
+    LocalFrame(JNIEnv* env, jint aCapacity, jthrowable& lException) :
+      theEnv(0),
+      theException(0)
+    { push(env, aCapacity, lException); }
+
+    ~LocalFrame()
+    { pop(); }
+
+    // makes room for aCapacity references; throws JavaException like
+    // CHECK_EXCEPTION if there is none
+    void push(JNIEnv* env, jint aCapacity, jthrowable& lException);
+
+    void pop();
+
+  private:
+    LocalFrame(const LocalFrame&);
+    LocalFrame& operator=(const LocalFrame&);
+};
+
+
+/**
+ * Classes and method ids used to call into the Java helpers.
+ *
+ * They are resolved once, held as global references, and resolved again
+ * when the Java VM they belong to is no longer the current one.
+ */
+class JniCache
+{
+  public:
+    jclass theStringClass;
+    jclass theByteBufferClass;
+
+    jclass theInst2XsdOptionsClass;
+    jmethodID theInst2XsdOptionsInit;
+    jmethodID theInst2XsdOptionsSetDesign;
+    jmethodID theInst2XsdOptionsSetUseEnumerations;
+    jmethodID theInst2XsdOptionsSetSimpleContentTypes;
+    jmethodID theInst2XsdOptionsSetVerbose;
+
+    jclass theInst2XsdSessionClass;
+    jmethodID theInst2XsdSessionInit;
+    jmethodID theInst2XsdSessionStartStream;
+    jmethodID theInst2XsdSessionStartEventStream;
+    jmethodID theInst2XsdSessionAwait;
+    jmethodID theInst2XsdSessionAddDocuments;
+    jmethodID theInst2XsdSessionFinishEvents;
+    jmethodID theInst2XsdSessionTimes;
+
+    jclass theCppInputStreamClass;
+    jmethodID theCppInputStreamGetBuffer;
+    jmethodID theCppInputStreamReserve;
+    jmethodID theCppInputStreamCommit;
+    jmethodID theCppInputStreamEndDocument;
+    jmethodID theCppInputStreamEndOfData;
+
+    jclass theXsd2InstOptionsClass;
+    jmethodID theXsd2InstOptionsInit;
+    jmethodID theXsd2InstOptionsSetNetworkDownloads;
+    jmethodID theXsd2InstOptionsSetNopvr;
+    jmethodID theXsd2InstOptionsSetNoupa;
+
+    jclass theXsd2InstHelperClass;
+    jmethodID theXsd2InstHelperXsd2instEvents;
+    jmethodID theXsd2InstHelperXsd2instAll;
+
+    jclass theSampleBatchClass;
+    jmethodID theSampleBatchReset;
+    jmethodID theSampleBatchHasNext;
+    jmethodID theSampleBatchNextEvents;
+
+    jclass thePhaseTimesClass;
+    jmethodID thePhaseTimesCurrent;
+    jmethodID thePhaseTimesTake;
+
+  private:
+    JavaVM* theVM;
+    std::mutex theMutex;
+
+  public:
+    JniCache();
+
+    /**
+     * Makes sure all members belong to aVM. Throws JavaException, with the
+     * pending exception in lException, if a class or method is missing;
+     * the classes found before are released then.
+     */
+    void resolve(JNIEnv* env, JavaVM* aVM, jthrowable& lException);
+
+  private:
+    void lookUp(JNIEnv* env, jthrowable& lException);
+
+    // deletes the global references of the classes resolved so far
+    void releaseClasses(JNIEnv* env);
+
+    // forgets the classes without deleting them
+    void dropClasses();
+
+    jclass findClass(JNIEnv* env, const char* aName, jthrowable& lException);
+};
+
+
+// sets the fields of the Java Inst2XsdOptions aTarget to aOptions; throws
+// JavaException like CHECK_EXCEPTION
+void setInst2XsdOptions(JNIEnv* env, const JniCache& aCache, jobject aTarget,
+    const STOptions& aOptions, jthrowable& lException);
+
+// same for the Java Xsd2InstOptions aTarget
+void setXsd2InstOptions(JNIEnv* env, const JniCache& aCache, jobject aTarget,
+    const STOptions& aOptions, jthrowable& lException);
+
+
+/**
+ * Options objects of the calling thread.
+ *
+ * Every thread keeps one Inst2XsdOptions and one Xsd2InstOptions object and
+ * only calls the setters when the values of the STOptions change.
+ */
+class JavaOptionsCache
+{
+  private:
+    JavaVM* theVM;
+    jobject theInst2XsdOptions;
+    STOptions theInst2XsdValues;
+    jobject theXsd2InstOptions;
+    STOptions theXsd2InstValues;
+
+    JavaOptionsCache() : theVM(0), theInst2XsdOptions(0), theXsd2InstOptions(0)
+    {}
+
+  public:
+    // the global references are not released on thread exit: the VM may
+    // already be gone by then, and it is only two small objects per thread
+    static JavaOptionsCache& forCurrentThread();
+
+    jobject getInst2XsdOptions(JNIEnv* env, const JniCache& aCache,
+        const STOptions& aOptions, jthrowable& lException);
+
+    jobject getXsd2InstOptions(JNIEnv* env, const JniCache& aCache,
+        const STOptions& aOptions, jthrowable& lException);
+
+  private:
+    void checkVM(JNIEnv* env);
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_JNI_CACHE_H
+/* vim:set et sw=2 ts=2: */
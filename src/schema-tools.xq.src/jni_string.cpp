@@ -0,0 +1,291 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "jni_string.h"
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+// the conversion buffer of a thread is given back above this many units
+#define MAX_KEPT_BUFFER (1 << 20)
+
+namespace zorba
+{
+namespace schematools
+{
+
+static inline bool isContinuation(unsigned char aByte)
+{
+  return (aByte & 0xC0) == 0x80;
+}
+
+
+void utf8ToUtf16(const char* aData, size_t aSize, std::vector<jchar>& aOut)
+{
+  // never more code units than bytes
+  size_t lStart = aOut.size();
+  aOut.resize(lStart + aSize);
+  jchar* lOut = aOut.data() + lStart;
+
+  const unsigned char* p = (const unsigned char*)aData;
+  const unsigned char* lEnd = p + aSize;
+  while (p < lEnd)
+  {
+#ifdef __SSE2__
+    const __m128i lZero = _mm_setzero_si128();
+    while (lEnd - p >= 16)
+    {
+      __m128i lBytes = _mm_loadu_si128((const __m128i*)p);
+      if (_mm_movemask_epi8(lBytes) != 0)
+        break;
+      _mm_storeu_si128((__m128i*)lOut, _mm_unpacklo_epi8(lBytes, lZero));
+      _mm_storeu_si128((__m128i*)(lOut + 8), _mm_unpackhi_epi8(lBytes, lZero));
+      p += 16;
+      lOut += 16;
+    }
+#endif
+    while (lEnd - p >= 8)
+    {
+      uint64_t lWord;
+      memcpy(&lWord, p, 8);
+      if (lWord & 0x8080808080808080ULL)
+        break;
+      for (int i = 0; i < 8; ++i)
+        lOut[i] = p[i];
+      p += 8;
+      lOut += 8;
+    }
+    if (p == lEnd)
+      break;
+
+    unsigned char c = *p;
+    if (c < 0x80)
+    {
+      *lOut++ = c;
+      ++p;
+      continue;
+    }
+
+    // the length of the sequence and the range of its second byte, which
+    // rules out overlong forms, surrogates and code points past U+10FFFF
+    size_t lLength;
+    unsigned char lLow = 0x80, lHigh = 0xBF;
+    uint32_t lCode;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+      lLength = 2;
+      lCode = c & 0x1F;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      lLength = 3;
+      lCode = c & 0x0F;
+      if (c == 0xE0)
+        lLow = 0xA0;
+      else if (c == 0xED)
+        lHigh = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      lLength = 4;
+      lCode = c & 0x07;
+      if (c == 0xF0)
+        lLow = 0x90;
+      else if (c == 0xF4)
+        lHigh = 0x8F;
+    }
+    else
+    {
+      *lOut++ = REPLACEMENT_CHARACTER;
+      ++p;
+      continue;
+    }
+
+    // an ill-formed sequence is replaced up to its first bad byte
+    size_t i = 1;
+    for (; i < lLength && p + i < lEnd; ++i)
+    {
+      unsigned char b = p[i];
+      if (i == 1 ? (b < lLow || b > lHigh) : !isContinuation(b))
+        break;
+      lCode = (lCode << 6) | (b & 0x3F);
+    }
+    if (i < lLength)
+    {
+      *lOut++ = REPLACEMENT_CHARACTER;
+      p += i;
+      continue;
+    }
+
+    if (lCode >= 0x10000)
+    {
+      lCode -= 0x10000;
+      *lOut++ = (jchar)(0xD800 | (lCode >> 10));
+      *lOut++ = (jchar)(0xDC00 | (lCode & 0x3FF));
+    }
+    else
+      *lOut++ = (jchar)lCode;
+    p += lLength;
+  }
+
+  aOut.resize(lOut - aOut.data());
+}
+
+
+void utf16ToUtf8(const jchar* aData, size_t aSize, std::string& aOut)
+{
+  // never more than three bytes per code unit
+  size_t lStart = aOut.size();
+  aOut.resize(lStart + 3 * aSize);
+  unsigned char* lOut = (unsigned char*)&aOut[0] + lStart;
+
+  const jchar* p = aData;
+  const jchar* lEnd = p + aSize;
+  while (p < lEnd)
+  {
+#ifdef __SSE2__
+    const __m128i lZero = _mm_setzero_si128();
+    const __m128i lNonAscii = _mm_set1_epi16((short)0xFF80);
+    while (lEnd - p >= 8)
+    {
+      __m128i lUnits = _mm_loadu_si128((const __m128i*)p);
+      __m128i lAscii = _mm_cmpeq_epi16(_mm_and_si128(lUnits, lNonAscii), lZero);
+      if (_mm_movemask_epi8(lAscii) != 0xFFFF)
+        break;
+      _mm_storel_epi64((__m128i*)lOut, _mm_packus_epi16(lUnits, lUnits));
+      p += 8;
+      lOut += 8;
+    }
+#endif
+    while (lEnd - p >= 4)
+    {
+      uint64_t lWord;
+      memcpy(&lWord, p, 8);
+      if (lWord & 0xFF80FF80FF80FF80ULL)
+        break;
+      for (int i = 0; i < 4; ++i)
+        lOut[i] = (unsigned char)p[i];
+      p += 4;
+      lOut += 4;
+    }
+    if (p == lEnd)
+      break;
+
+    uint32_t c = *p++;
+    if (c < 0x80)
+    {
+      *lOut++ = (unsigned char)c;
+      continue;
+    }
+    if (c < 0x800)
+    {
+      *lOut++ = (unsigned char)(0xC0 | (c >> 6));
+      *lOut++ = (unsigned char)(0x80 | (c & 0x3F));
+      continue;
+    }
+    if (c >= 0xD800 && c <= 0xDFFF)
+    {
+      if (c <= 0xDBFF && p < lEnd && *p >= 0xDC00 && *p <= 0xDFFF)
+      {
+        // a pair is two units in and four bytes out
+        c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+        *lOut++ = (unsigned char)(0xF0 | (c >> 18));
+        *lOut++ = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+        *lOut++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        *lOut++ = (unsigned char)(0x80 | (c & 0x3F));
+        continue;
+      }
+      c = REPLACEMENT_CHARACTER;
+    }
+    *lOut++ = (unsigned char)(0xE0 | (c >> 12));
+    *lOut++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+    *lOut++ = (unsigned char)(0x80 | (c & 0x3F));
+  }
+
+  aOut.resize(lOut - (unsigned char*)&aOut[0]);
+}
+
+
+jstring newJavaString(JNIEnv* env, const char* aData, size_t aSize)
+{
+  // one buffer per thread, the schemas of a call are converted in turn
+  static thread_local std::vector<jchar> lUnits;
+  lUnits.clear();
+  utf8ToUtf16(aData, aSize, lUnits);
+
+  static const jchar lEmpty = 0;
+  jstring lString = env->NewString(lUnits.empty() ? &lEmpty : lUnits.data(),
+      (jsize)lUnits.size());
+
+  if (lUnits.capacity() > MAX_KEPT_BUFFER)
+    std::vector<jchar>().swap(lUnits);
+  return lString;
+}
+
+
+bool getJavaString(JNIEnv* env, jstring aString, std::string& aOut)
+{
+  jsize lLength = env->GetStringLength(aString);
+  if (env->ExceptionCheck())
+    return false;
+
+  std::vector<jchar> lUnits(lLength);
+  if (lLength > 0)
+  {
+    env->GetStringRegion(aString, 0, lLength, lUnits.data());
+    if (env->ExceptionCheck())
+      return false;
+  }
+
+  aOut.clear();
+  utf16ToUtf8(lUnits.data(), lUnits.size(), aOut);
+  return true;
+}
+
+
+jobjectArray newJavaStringArray(JNIEnv* env, jclass aStringClass,
+                                const std::vector<std::string>& aStrings)
+{
+  jobjectArray lArray = env->NewObjectArray((jsize)aStrings.size(),
+      aStringClass, NULL);
+  if (!lArray)
+    return 0;
+
+  for (jsize i = 0; i < (jsize)aStrings.size(); ++i)
+  {
+    jstring lString = newJavaString(env, aStrings[i]);
+    if (lString)
+    {
+      env->SetObjectArrayElement(lArray, i, lString);
+      env->DeleteLocalRef(lString);
+    }
+    if (env->ExceptionCheck())
+    {
+      env->DeleteLocalRef(lArray);
+      return 0;
+    }
+  }
+  return lArray;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
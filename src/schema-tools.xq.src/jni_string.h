@@ -0,0 +1,74 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_JNI_STRING_H
+#define ZORBA_SCHEMATOOLS_JNI_STRING_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include <jni.h>
+
+namespace zorba
+{
+namespace schematools
+{
+
+/*
+ * Strings crossing the JNI boundary.
+ *
+ * NewStringUTF and GetStringUTFChars take JNI's modified UTF-8, in which a
+ * supplementary character is two encoded surrogates of three bytes each:
+ * the standard four-byte sequences of Zorba's strings are rejected or
+ * garbled, and the JVM transcodes byte by byte. These functions convert
+ * standard UTF-8 to and from UTF-16 on this side and copy the code units
+ * with NewString and GetStringRegion. Runs of ASCII, most of the markup of
+ * any document, are converted 16 bytes at a time with SSE2 where it is
+ * available and 8 at a time otherwise.
+ *
+ * Ill-formed input, e.g. overlong or truncated UTF-8 sequences or unpaired
+ * surrogates, becomes U+FFFD rather than failing the call.
+ */
+
+// appends the UTF-16 code units of the aSize bytes of UTF-8 at aData
+void utf8ToUtf16(const char* aData, size_t aSize, std::vector<jchar>& aOut);
+
+// appends the UTF-8 bytes of the aSize UTF-16 code units at aData
+void utf16ToUtf8(const jchar* aData, size_t aSize, std::string& aOut);
+
+// a new local reference to the Java string of the UTF-8 aData; null with
+// a pending exception if the JVM could not create it
+jstring newJavaString(JNIEnv* env, const char* aData, size_t aSize);
+
+inline jstring newJavaString(JNIEnv* env, const std::string& aString)
+{
+  return newJavaString(env, aString.data(), aString.size());
+}
+
+// aString as UTF-8 in aOut; false with a pending exception if it could
+// not be read
+bool getJavaString(JNIEnv* env, jstring aString, std::string& aOut);
+
+// a new String[] of the UTF-8 aStrings; null with a pending exception if
+// the JVM could not create it
+jobjectArray newJavaStringArray(JNIEnv* env, jclass aStringClass,
+    const std::vector<std::string>& aStrings);
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_JNI_STRING_H
+/* vim:set et sw=2 ts=2: */
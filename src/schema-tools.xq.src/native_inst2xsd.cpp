@@ -0,0 +1,1541 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <zorba/iterator.h>
+#include <zorba/store_consts.h>
+
+#include "native_inst2xsd.h"
+#include "schema_model.h"
+
+#define XML_SCHEMA_NAMESPACE "http://www.w3.org/2001/XMLSchema"
+#define XML_SCHEMA_INSTANCE_NAMESPACE "http://www.w3.org/2001/XMLSchema-instance"
+#define XML_NAMESPACE "http://www.w3.org/XML/1998/namespace"
+
+namespace zorba
+{
+namespace schematools
+{
+
+namespace
+{
+
+bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// an ASCII NCName character, or a byte of a non-ASCII one
+bool isNameChar(char c, bool aFirst)
+{
+  return isalpha((unsigned char)c) || c == '_' || (unsigned char)c >= 0x80 ||
+         (!aFirst && (isDigit(c) || c == '-' || c == '.'));
+}
+
+bool isNCName(const std::string& aValue, size_t aBegin, size_t aEnd)
+{
+  if (aBegin >= aEnd || !isNameChar(aValue[aBegin], true))
+    return false;
+  for (size_t i = aBegin + 1; i < aEnd; ++i)
+  {
+    if (!isNameChar(aValue[i], false))
+      return false;
+  }
+  return true;
+}
+
+// prefix:local with the prefix bound in the scope of aElement; like
+// XMLBeans, only values with a prefix are taken for QNames
+bool isQName(const std::string& aValue, const Item& aElement)
+{
+  std::string::size_type lColon = aValue.find(':');
+  if (lColon == std::string::npos || lColon != aValue.rfind(':') ||
+      !isNCName(aValue, 0, lColon) ||
+      !isNCName(aValue, lColon + 1, aValue.size()))
+    return false;
+
+  std::string lPrefix = aValue.substr(0, lColon);
+  if (lPrefix == "xml")
+    return true;
+  NsBindings lBindings;
+  aElement.getNamespaceBindings(lBindings);
+  for (size_t i = 0; i < lBindings.size(); ++i)
+  {
+    if (lBindings[i].first.str() == lPrefix)
+      return !lBindings[i].second.empty();
+  }
+  return false;
+}
+
+std::string trim(const std::string& aValue)
+{
+  std::string::size_type lBegin = 0;
+  std::string::size_type lEnd = aValue.size();
+  while (lBegin < lEnd && isSpace(aValue[lBegin]))
+    ++lBegin;
+  while (lEnd > lBegin && isSpace(aValue[lEnd - 1]))
+    --lEnd;
+  return aValue.substr(lBegin, lEnd - lBegin);
+}
+
+// number of digits at aPos
+size_t digits(const std::string& s, size_t aPos)
+{
+  size_t n = 0;
+  while (aPos + n < s.size() && isDigit(s[aPos + n]))
+    ++n;
+  return n;
+}
+
+// exactly aCount digits at aPos, moves aPos past them
+bool fixedDigits(const std::string& s, size_t& aPos, size_t aCount)
+{
+  if (digits(s, aPos) < aCount)
+    return false;
+  aPos += aCount;
+  return true;
+}
+
+bool literal(const std::string& s, size_t& aPos, char c)
+{
+  if (aPos >= s.size() || s[aPos] != c)
+    return false;
+  ++aPos;
+  return true;
+}
+
+// optional time zone, then end of value
+bool timeZoneAndEnd(const std::string& s, size_t aPos)
+{
+  if (aPos == s.size())
+    return true;
+  if (s[aPos] == 'Z')
+    return aPos + 1 == s.size();
+  if (s[aPos] != '+' && s[aPos] != '-')
+    return false;
+  ++aPos;
+  return fixedDigits(s, aPos, 2) && literal(s, aPos, ':') &&
+         fixedDigits(s, aPos, 2) && aPos == s.size();
+}
+
+// [-]yyyy with at least four digits
+bool year(const std::string& s, size_t& aPos)
+{
+  if (aPos < s.size() && s[aPos] == '-')
+    ++aPos;
+  size_t n = digits(s, aPos);
+  if (n < 4)
+    return false;
+  aPos += n;
+  return true;
+}
+
+bool timeOfDay(const std::string& s, size_t& aPos)
+{
+  if (!(fixedDigits(s, aPos, 2) && literal(s, aPos, ':') &&
+        fixedDigits(s, aPos, 2) && literal(s, aPos, ':') &&
+        fixedDigits(s, aPos, 2)))
+    return false;
+  if (aPos < s.size() && s[aPos] == '.')
+  {
+    ++aPos;
+    size_t n = digits(s, aPos);
+    if (n == 0)
+      return false;
+    aPos += n;
+  }
+  return true;
+}
+
+bool isDateTimeKind(const std::string& s, int& aKind)
+{
+  size_t p = 0;
+  if (s.compare(0, 3, "---") == 0)
+  {
+    p = 3;
+    aKind = SimpleContent::G_DAY_TYPE;
+    return fixedDigits(s, p, 2) && timeZoneAndEnd(s, p);
+  }
+  if (s.compare(0, 2, "--") == 0)
+  {
+    p = 2;
+    if (!fixedDigits(s, p, 2))
+      return false;
+    size_t q = p;
+    if (literal(s, q, '-') && fixedDigits(s, q, 2) && timeZoneAndEnd(s, q))
+    {
+      aKind = SimpleContent::G_MONTH_DAY_TYPE;
+      return true;
+    }
+    aKind = SimpleContent::G_MONTH_TYPE;
+    return timeZoneAndEnd(s, p);
+  }
+
+  p = 0;
+  if (timeOfDay(s, p) && timeZoneAndEnd(s, p))
+  {
+    aKind = SimpleContent::TIME_TYPE;
+    return true;
+  }
+
+  p = 0;
+  if (!year(s, p))
+    return false;
+  if (timeZoneAndEnd(s, p))
+  {
+    aKind = SimpleContent::G_YEAR_TYPE;
+    return true;
+  }
+  if (!(literal(s, p, '-') && fixedDigits(s, p, 2)))
+    return false;
+  if (timeZoneAndEnd(s, p))
+  {
+    aKind = SimpleContent::G_YEAR_MONTH_TYPE;
+    return true;
+  }
+  if (!(literal(s, p, '-') && fixedDigits(s, p, 2)))
+    return false;
+  if (timeZoneAndEnd(s, p))
+  {
+    aKind = SimpleContent::DATE_TYPE;
+    return true;
+  }
+  aKind = SimpleContent::DATE_TIME_TYPE;
+  return literal(s, p, 'T') && timeOfDay(s, p) && timeZoneAndEnd(s, p);
+}
+
+bool isDuration(const std::string& s)
+{
+  size_t p = 0;
+  if (p < s.size() && s[p] == '-')
+    ++p;
+  if (!literal(s, p, 'P'))
+    return false;
+
+  static const char lDateParts[] = "YMD";
+  static const char lTimeParts[] = "HMS";
+  bool lAny = false;
+  const char* lParts = lDateParts;
+  for (size_t i = 0; p < s.size(); )
+  {
+    if (s[p] == 'T')
+    {
+      if (lParts == lTimeParts)
+        return false;
+      lParts = lTimeParts;
+      i = 0;
+      ++p;
+      if (p == s.size())
+        return false;
+      continue;
+    }
+    size_t n = digits(s, p);
+    if (n == 0)
+      return false;
+    p += n;
+    if (lParts == lTimeParts && p < s.size() && s[p] == '.')
+    {
+      ++p;
+      n = digits(s, p);
+      if (n == 0 || p + n >= s.size() || s[p + n] != 'S')
+        return false;
+      p += n;
+    }
+    while (i < 3 && (p >= s.size() || s[p] != lParts[i]))
+      ++i;
+    if (i == 3)
+      return false;
+    ++i;
+    ++p;
+    lAny = true;
+  }
+  return lAny;
+}
+
+bool isFloat(const std::string& s)
+{
+  if (s == "INF" || s == "-INF" || s == "NaN")
+    return true;
+  size_t p = 0;
+  if (p < s.size() && (s[p] == '+' || s[p] == '-'))
+    ++p;
+  size_t lInt = digits(s, p);
+  p += lInt;
+  size_t lFrac = 0;
+  if (p < s.size() && s[p] == '.')
+  {
+    ++p;
+    lFrac = digits(s, p);
+    p += lFrac;
+  }
+  if (lInt + lFrac == 0)
+    return false;
+  if (p < s.size() && (s[p] == 'e' || s[p] == 'E'))
+  {
+    ++p;
+    if (p < s.size() && (s[p] == '+' || s[p] == '-'))
+      ++p;
+    size_t lExp = digits(s, p);
+    if (lExp == 0)
+      return false;
+    p += lExp;
+  }
+  return p == s.size();
+}
+
+// compares the unsigned decimal aDigits with aLimit
+bool withinLimit(const std::string& aDigits, const char* aLimit)
+{
+  size_t lLen = strlen(aLimit);
+  if (aDigits.size() != lLen)
+    return aDigits.size() < lLen;
+  return aDigits.compare(aLimit) <= 0;
+}
+
+int integerKind(const std::string& s)
+{
+  size_t p = 0;
+  bool lNegative = false;
+  if (p < s.size() && (s[p] == '+' || s[p] == '-'))
+  {
+    lNegative = (s[p] == '-');
+    ++p;
+  }
+  if (p == s.size() || digits(s, p) != s.size() - p)
+    return SimpleContent::NO_VALUE;
+
+  while (p + 1 < s.size() && s[p] == '0')
+    ++p;
+  std::string lDigits = s.substr(p);
+
+  if (withinLimit(lDigits, lNegative ? "128" : "127"))
+    return SimpleContent::BYTE_TYPE;
+  if (withinLimit(lDigits, lNegative ? "32768" : "32767"))
+    return SimpleContent::SHORT_TYPE;
+  if (withinLimit(lDigits, lNegative ? "2147483648" : "2147483647"))
+    return SimpleContent::INT_TYPE;
+  if (withinLimit(lDigits, lNegative ? "9223372036854775808" : "9223372036854775807"))
+    return SimpleContent::LONG_TYPE;
+  return SimpleContent::INTEGER_TYPE;
+}
+
+template <class T>
+size_t indexOf(std::vector<T>& aVector, std::map<QNameKey, size_t>& aIndex,
+    const QNameKey& aName, bool& aNew)
+{
+  std::map<QNameKey, size_t>::iterator lIt = aIndex.find(aName);
+  aNew = (lIt == aIndex.end());
+  if (!aNew)
+    return lIt->second;
+  size_t lPos = aVector.size();
+  aVector.push_back(T());
+  aVector.back().theName = aName;
+  aIndex[aName] = lPos;
+  return lPos;
+}
+
+QNameKey nodeName(const Item& aNode)
+{
+  Item lName;
+  aNode.getNodeName(lName);
+  return QNameKey(lName.getNamespace().str(), lName.getLocalName().str());
+}
+
+} // anonymous namespace
+
+
+/*******************************************************************************
+  SimpleContent
+*******************************************************************************/
+
+const char* SimpleContent::typeName(int aKind)
+{
+  switch (aKind)
+  {
+  case BYTE_TYPE: return "byte";
+  case SHORT_TYPE: return "short";
+  case INT_TYPE: return "int";
+  case LONG_TYPE: return "long";
+  case INTEGER_TYPE: return "integer";
+  case FLOAT_TYPE: return "float";
+  case DATE_TIME_TYPE: return "dateTime";
+  case TIME_TYPE: return "time";
+  case DATE_TYPE: return "date";
+  case G_YEAR_MONTH_TYPE: return "gYearMonth";
+  case G_YEAR_TYPE: return "gYear";
+  case G_MONTH_DAY_TYPE: return "gMonthDay";
+  case G_DAY_TYPE: return "gDay";
+  case G_MONTH_TYPE: return "gMonth";
+  case DURATION_TYPE: return "duration";
+  case ANY_URI_TYPE: return "anyURI";
+  case QNAME_TYPE: return "QName";
+  default: return "string";
+  }
+}
+
+
+int SimpleContent::detect(const std::string& aValue, const Item& aElement)
+{
+  // same order of attempts as XMLBeans' RussianDollStrategy
+  int lKind = integerKind(aValue);
+  if (lKind != NO_VALUE)
+    return lKind;
+  if (isFloat(aValue))
+    return FLOAT_TYPE;
+  if (isDateTimeKind(aValue, lKind))
+    return lKind;
+  if (isDuration(aValue))
+    return DURATION_TYPE;
+  if ((aValue.compare(0, 7, "http://") == 0 || aValue.compare(0, 4, "www.") == 0) &&
+      aValue.find_first_of(" \t\r\n") == std::string::npos)
+    return ANY_URI_TYPE;
+  if (isQName(aValue, aElement))
+    return QNAME_TYPE;
+  return STRING_TYPE;
+}
+
+
+int SimpleContent::join(int aKind1, int aKind2)
+{
+  if (aKind1 == NO_VALUE)
+    return aKind2;
+  if (aKind2 == NO_VALUE || aKind1 == aKind2)
+    return aKind1;
+  // byte < short < int < long < integer < float
+  if (aKind1 <= FLOAT_TYPE && aKind2 <= FLOAT_TYPE)
+    return std::max(aKind1, aKind2);
+  return STRING_TYPE;
+}
+
+
+void SimpleContent::addKind(int aKind)
+{
+  theKind = join(theKind, aKind);
+}
+
+
+void SimpleContent::addValue(const std::string& aValue, const Item& aElement,
+    const STOptions& aOptions)
+{
+  if (aOptions.getSimpleContentType() == STOptions::ALWAYS_STRING_TYPES)
+    addKind(STRING_TYPE);
+  else
+    addKind(detect(aValue, aElement));
+
+  if (theTooManyValues)
+    return;
+  if (std::find(theValues.begin(), theValues.end(), aValue) != theValues.end())
+    return;
+  if ((int)theValues.size() + 1 >= aOptions.getUseEnumeration())
+  {
+    theTooManyValues = true;
+    theValues.clear();
+    return;
+  }
+  theValues.push_back(aValue);
+}
+
+
+void SimpleContent::merge(const SimpleContent& aOther, const STOptions& aOptions)
+{
+  addKind(aOther.theKind);
+  if (aOther.theTooManyValues)
+  {
+    theTooManyValues = true;
+    theValues.clear();
+    return;
+  }
+  for (size_t i = 0; i < aOther.theValues.size() && !theTooManyValues; ++i)
+  {
+    const std::string& lValue = aOther.theValues[i];
+    if (std::find(theValues.begin(), theValues.end(), lValue) != theValues.end())
+      continue;
+    if ((int)theValues.size() + 1 >= aOptions.getUseEnumeration())
+    {
+      theTooManyValues = true;
+      theValues.clear();
+    }
+    else
+      theValues.push_back(lValue);
+  }
+}
+
+
+/*******************************************************************************
+  TypeInfo
+*******************************************************************************/
+
+size_t TypeInfo::childIndex(const QNameKey& aName, bool aLocal)
+{
+  bool lNew;
+  size_t lPos = indexOf(theChildren, theChildIndex, aName, lNew);
+  if (lNew && aLocal)
+  {
+    theChildren[lPos].theLocal.reset(new ElementDecl());
+    theChildren[lPos].theLocal->theName = aName;
+  }
+  return lPos;
+}
+
+
+size_t TypeInfo::attributeIndex(const QNameKey& aName)
+{
+  bool lNew;
+  return indexOf(theAttributes, theAttributeIndex, aName, lNew);
+}
+
+
+void TypeInfo::merge(const TypeInfo& aOther, const STOptions& aOptions)
+{
+  theCount += aOther.theCount;
+  theHasChildren = theHasChildren || aOther.theHasChildren;
+  theHasText = theHasText || aOther.theHasText;
+  theContent.merge(aOther.theContent, aOptions);
+
+  // positions of the children of aOther in this
+  std::vector<size_t> lPositions(aOther.theChildren.size());
+  for (size_t i = 0; i < aOther.theChildren.size(); ++i)
+  {
+    const ChildParticle& lOther = aOther.theChildren[i];
+    lPositions[i] = childIndex(lOther.theName, lOther.theLocal.get() != 0);
+
+    ChildParticle& lParticle = theChildren[lPositions[i]];
+    lParticle.theParents += lOther.theParents;
+    lParticle.theMaxPerParent =
+        std::max(lParticle.theMaxPerParent, lOther.theMaxPerParent);
+    if (lOther.theLocal)
+      lParticle.theLocal->theType.merge(lOther.theLocal->theType, aOptions);
+  }
+
+  std::set<std::pair<size_t, size_t> >::const_iterator lIt;
+  for (lIt = aOther.theFollows.begin(); lIt != aOther.theFollows.end(); ++lIt)
+    theFollows.insert(std::make_pair(lPositions[lIt->first], lPositions[lIt->second]));
+
+  for (size_t i = 0; i < aOther.theAttributes.size(); ++i)
+  {
+    const AttributeUse& lOther = aOther.theAttributes[i];
+    AttributeUse& lUse = theAttributes[attributeIndex(lOther.theName)];
+    lUse.theCount += lOther.theCount;
+    lUse.theContent.merge(lOther.theContent, aOptions);
+  }
+}
+
+
+/*******************************************************************************
+  NativeInst2Xsd
+*******************************************************************************/
+
+NativeInst2Xsd::NativeInst2Xsd(const STOptions& aOptions) :
+  theOptions(aOptions),
+  theInstanceCount(0)
+{
+}
+
+
+ElementDecl* NativeInst2Xsd::globalElement(const QNameKey& aName)
+{
+  std::map<QNameKey, size_t>::iterator lIt = theElementIndex.find(aName);
+  if (lIt != theElementIndex.end())
+    return theElements[lIt->second].get();
+
+  theElementIndex[aName] = theElements.size();
+  theElements.push_back(std::unique_ptr<ElementDecl>(new ElementDecl()));
+  theElements.back()->theName = aName;
+  return theElements.back().get();
+}
+
+
+void NativeInst2Xsd::completeGlobalElement(const QNameKey& aName)
+{
+  size_t lPos = theElementIndex[aName];
+  if (std::find(theElementOrder.begin(), theElementOrder.end(), lPos) ==
+      theElementOrder.end())
+    theElementOrder.push_back(lPos);
+}
+
+
+AttributeDecl& NativeInst2Xsd::globalAttribute(const QNameKey& aName)
+{
+  bool lNew;
+  return theAttributes[indexOf(theAttributes, theAttributeIndex, aName, lNew)];
+}
+
+
+bool NativeInst2Xsd::isGlobal(const QNameKey& aName,
+    const std::string& aTargetNamespace) const
+{
+  // elements of another namespace can only be referenced
+  return theOptions.getDesign() == STOptions::SALAMI_SLICE_DESIGN ||
+         aName.first != aTargetNamespace;
+}
+
+
+void NativeInst2Xsd::add(const Item& aInstance)
+{
+  Item lRoot = aInstance;
+  if (lRoot.getNodeKind() == store::StoreConsts::documentNode)
+  {
+    Iterator_t lChildren = aInstance.getChildren();
+    lChildren->open();
+    while (lChildren->next(lRoot) &&
+           lRoot.getNodeKind() != store::StoreConsts::elementNode)
+      ;
+    lChildren->close();
+    if (lRoot.isNull() || lRoot.getNodeKind() != store::StoreConsts::elementNode)
+      return;
+  }
+
+  QNameKey lName = nodeName(lRoot);
+  ElementDecl* lDecl = globalElement(lName);
+  processElement(lRoot, lDecl->theType, lName.first);
+  completeGlobalElement(lName);
+  ++theInstanceCount;
+}
+
+
+void NativeInst2Xsd::merge(const NativeInst2Xsd& aOther)
+{
+  // new declarations are appended in the order aOther created them, which
+  // is the order adding its instances here would have created them in
+  for (size_t i = 0; i < aOther.theElements.size(); ++i)
+  {
+    const ElementDecl& lOther = *aOther.theElements[i];
+    globalElement(lOther.theName)->theType.merge(lOther.theType, theOptions);
+  }
+
+  for (size_t i = 0; i < aOther.theElementOrder.size(); ++i)
+    completeGlobalElement(aOther.theElements[aOther.theElementOrder[i]]->theName);
+
+  for (size_t i = 0; i < aOther.theAttributes.size(); ++i)
+  {
+    const AttributeDecl& lOther = aOther.theAttributes[i];
+    globalAttribute(lOther.theName).theContent.merge(lOther.theContent, theOptions);
+  }
+
+  theInstanceCount += aOther.theInstanceCount;
+}
+
+
+void NativeInst2Xsd::processElement(const Item& aElement, TypeInfo& aType,
+    const std::string& aTargetNamespace)
+{
+  ++aType.theCount;
+
+  bool lHasAttributes = false;
+  Iterator_t lAttributes = aElement.getAttributes();
+  lAttributes->open();
+  Item lAttr;
+  while (lAttributes->next(lAttr))
+  {
+    QNameKey lName = nodeName(lAttr);
+    if (lName.first == XML_SCHEMA_INSTANCE_NAMESPACE)
+      continue;
+    lHasAttributes = true;
+
+    AttributeUse& lUse = aType.theAttributes[aType.attributeIndex(lName)];
+    ++lUse.theCount;
+    std::string lValue = trim(lAttr.getStringValue().str());
+    if (lName.first.empty())
+      lUse.theContent.addValue(lValue, aElement, theOptions);
+    else
+      globalAttribute(lName).theContent.addValue(lValue, aElement, theOptions);
+  }
+  lAttributes->close();
+
+  // per child: occurrences within this element
+  std::vector<std::pair<size_t, unsigned long> > lCounts;
+  std::string lText;
+  bool lHasChildren = false;
+  size_t lPrevious = (size_t)-1;
+
+  Iterator_t lChildren = aElement.getChildren();
+  lChildren->open();
+  Item lChild;
+  while (lChildren->next(lChild))
+  {
+    int lKind = lChild.getNodeKind();
+    if (lKind == store::StoreConsts::textNode)
+    {
+      lText += lChild.getStringValue().str();
+      continue;
+    }
+    if (lKind != store::StoreConsts::elementNode)
+      continue;
+
+    lHasChildren = true;
+    QNameKey lName = nodeName(lChild);
+    bool lGlobal = isGlobal(lName, aTargetNamespace);
+    size_t lPos = aType.childIndex(lName, !lGlobal);
+
+    if (lPrevious != (size_t)-1 && lPrevious != lPos)
+      aType.theFollows.insert(std::make_pair(lPrevious, lPos));
+    lPrevious = lPos;
+
+    size_t i = 0;
+    while (i < lCounts.size() && lCounts[i].first != lPos)
+      ++i;
+    if (i == lCounts.size())
+      lCounts.push_back(std::make_pair(lPos, 0UL));
+    ++lCounts[i].second;
+
+    // no reference into aType is held across the recursion: with
+    // recursive global elements aType itself may grow
+    if (lGlobal)
+    {
+      processElement(lChild, globalElement(lName)->theType, lName.first);
+      completeGlobalElement(lName);
+    }
+    else
+    {
+      ElementDecl* lDecl = aType.theChildren[lPos].theLocal.get();
+      processElement(lChild, lDecl->theType, aTargetNamespace);
+    }
+  }
+  lChildren->close();
+
+  for (size_t i = 0; i < lCounts.size(); ++i)
+  {
+    ChildParticle& lParticle = aType.theChildren[lCounts[i].first];
+    ++lParticle.theParents;
+    lParticle.theMaxPerParent = std::max(lParticle.theMaxPerParent, lCounts[i].second);
+  }
+
+  std::string lValue = trim(lText);
+  if (lHasChildren)
+  {
+    aType.theHasChildren = true;
+    if (!lValue.empty())
+      aType.theHasText = true;
+  }
+  else if (!lValue.empty())
+  {
+    aType.theHasText = true;
+    aType.theContent.addValue(lValue, aElement, theOptions);
+  }
+  else if (!lHasAttributes)
+  {
+    // an empty element is an empty string
+    aType.theContent.addValue(lValue, aElement, theOptions);
+  }
+}
+
+
+/*******************************************************************************
+  SchemaReader
+*******************************************************************************/
+
+/**
+ * Seeds a NativeInst2Xsd from schema documents, the inverse of SchemaWriter:
+ * a type counts as one occurrence, a particle without minOccurs="0" and an
+ * attribute without use="optional" as present in it, maxOccurs > 1 as
+ * repeated, a sequence as its children following each other and a choice
+ * as a cycle of them. Whether a child is local or a reference is decided
+ * by the design of the options, as when instances are added, so schemas
+ * of another design are read into this one.
+ */
+class SchemaReader
+{
+  private:
+    NativeInst2Xsd& theInference;
+    const SchemaSet& theSchemas;
+    const STOptions& theOptions;
+    // global attributes read so far
+    std::set<QNameKey> theAttributesRead;
+    // global elements being read into local declarations, which stop the
+    // recursion of a recursive element
+    std::set<QNameKey> theOpen;
+
+  public:
+    SchemaReader(NativeInst2Xsd& aInference, const SchemaSet& aSchemas) :
+      theInference(aInference),
+      theSchemas(aSchemas),
+      theOptions(aInference.theOptions)
+    {}
+
+    void read();
+
+  private:
+    // aNode is an xs:element with a type attribute or an anonymous type
+    void element(const Item& aNode, TypeInfo& aType,
+        const std::string& aTargetNamespace);
+
+    void typeReference(const Item& aNode, const QNameKey& aType,
+        TypeInfo& aInfo, const std::string& aTargetNamespace);
+
+    void complexType(const Item& aNode, TypeInfo& aType,
+        const std::string& aTargetNamespace);
+
+    void particles(const Item& aNode, TypeInfo& aType, bool aChoice,
+        const std::string& aTargetNamespace, std::vector<size_t>& aPositions);
+
+    void particle(const Item& aNode, TypeInfo& aType, bool aChoice,
+        const std::string& aTargetNamespace, std::vector<size_t>& aPositions);
+
+    void attribute(const Item& aNode, TypeInfo& aType,
+        const std::string& aTargetNamespace);
+
+    // the content of the type attribute or xs:simpleType child of aNode
+    void simpleContent(const Item& aNode, SimpleContent& aContent);
+
+    void simpleTypeReference(const QNameKey& aType, SimpleContent& aContent);
+
+    void simpleType(const Item& aNode, SimpleContent& aContent);
+
+    // the SimpleContent kind of the built-in type aLocalName
+    static int builtinKind(const std::string& aLocalName);
+
+    // content of aKind written without an enumeration, i.e. of more values
+    // than the options enumerate
+    static void anyValue(SimpleContent& aContent, int aKind);
+};
+
+
+int SchemaReader::builtinKind(const std::string& aLocalName)
+{
+  for (int lKind = SimpleContent::BYTE_TYPE; lKind < SimpleContent::STRING_TYPE;
+       ++lKind)
+  {
+    if (aLocalName == SimpleContent::typeName(lKind))
+      return lKind;
+  }
+  // the built-in types the inference does not write, by their nearest kind
+  if (aLocalName == "decimal" || aLocalName == "double")
+    return SimpleContent::FLOAT_TYPE;
+  if (aLocalName.find("nteger") != std::string::npos ||
+      aLocalName.compare(0, 8, "unsigned") == 0)
+    return SimpleContent::INTEGER_TYPE;
+  return SimpleContent::STRING_TYPE;
+}
+
+
+void SchemaReader::anyValue(SimpleContent& aContent, int aKind)
+{
+  aContent.addKind(aKind);
+  aContent.theTooManyValues = true;
+  aContent.theValues.clear();
+}
+
+
+void SchemaReader::read()
+{
+  // the order of the global elements is the one they are written in
+  const std::vector<QNameKey>& lElements = theSchemas.getGlobalElements();
+  for (size_t i = 0; i < lElements.size(); ++i)
+  {
+    const SchemaComponent& lComponent =
+        theSchemas.resolve(SchemaSet::ELEMENT_COMPONENT, lElements[i]);
+    element(lComponent.theNode, theInference.globalElement(lElements[i])->theType,
+        lElements[i].first);
+    theInference.completeGlobalElement(lElements[i]);
+  }
+}
+
+
+void SchemaReader::element(const Item& aNode, TypeInfo& aType,
+    const std::string& aTargetNamespace)
+{
+  ++aType.theCount;
+
+  std::string lType;
+  if (SchemaSet::getAttribute(aNode, "type", lType))
+  {
+    typeReference(aNode, SchemaSet::expandQName(aNode, lType), aType,
+        aTargetNamespace);
+    return;
+  }
+
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aNode, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    std::string lName = SchemaSet::xsName(lChildren[i]);
+    if (lName == "complexType")
+    {
+      complexType(lChildren[i], aType, aTargetNamespace);
+      return;
+    }
+    if (lName == "simpleType")
+    {
+      aType.theHasText = true;
+      simpleType(lChildren[i], aType.theContent);
+      return;
+    }
+  }
+
+  // no type is any content, taken as text
+  aType.theHasText = true;
+  anyValue(aType.theContent, SimpleContent::STRING_TYPE);
+}
+
+
+void SchemaReader::typeReference(const Item& aNode, const QNameKey& aType,
+    TypeInfo& aInfo, const std::string& aTargetNamespace)
+{
+  if (aType.first != XML_SCHEMA_NAMESPACE)
+  {
+    const SchemaComponent* lComplex =
+        theSchemas.find(SchemaSet::COMPLEX_TYPE_COMPONENT, aType);
+    if (lComplex)
+    {
+      complexType(lComplex->theNode, aInfo, aTargetNamespace);
+      return;
+    }
+  }
+  aInfo.theHasText = true;
+  simpleTypeReference(aType, aInfo.theContent);
+}
+
+
+void SchemaReader::complexType(const Item& aNode, TypeInfo& aType,
+    const std::string& aTargetNamespace)
+{
+  std::string lMixed;
+  if (SchemaSet::getAttribute(aNode, "mixed", lMixed) &&
+      (lMixed == "true" || lMixed == "1"))
+    aType.theHasText = true;
+
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aNode, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    std::string lName = SchemaSet::xsName(lChildren[i]);
+    if (lName == "sequence" || lName == "choice" || lName == "all")
+    {
+      aType.theHasChildren = true;
+      std::vector<size_t> lPositions;
+      particles(lChildren[i], aType, lName != "sequence", aTargetNamespace,
+          lPositions);
+    }
+    else if (lName == "attribute")
+    {
+      attribute(lChildren[i], aType, aTargetNamespace);
+    }
+    else if (lName == "simpleContent")
+    {
+      std::vector<Item> lDerivations;
+      SchemaSet::xsChildren(lChildren[i], lDerivations);
+      for (size_t j = 0; j < lDerivations.size(); ++j)
+      {
+        std::string lBase;
+        if (SchemaSet::getAttribute(lDerivations[j], "base", lBase))
+        {
+          aType.theHasText = true;
+          simpleTypeReference(SchemaSet::expandQName(lDerivations[j], lBase),
+              aType.theContent);
+        }
+        std::vector<Item> lAttributes;
+        SchemaSet::xsChildren(lDerivations[j], lAttributes);
+        for (size_t k = 0; k < lAttributes.size(); ++k)
+        {
+          if (SchemaSet::xsName(lAttributes[k]) == "attribute")
+            attribute(lAttributes[k], aType, aTargetNamespace);
+        }
+      }
+    }
+  }
+}
+
+
+void SchemaReader::particles(const Item& aNode, TypeInfo& aType, bool aChoice,
+    const std::string& aTargetNamespace, std::vector<size_t>& aPositions)
+{
+  size_t lFirst = aPositions.size();
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aNode, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    std::string lName = SchemaSet::xsName(lChildren[i]);
+    if (lName == "element")
+      particle(lChildren[i], aType, aChoice, aTargetNamespace, aPositions);
+    else if (lName == "sequence")
+      particles(lChildren[i], aType, aChoice, aTargetNamespace, aPositions);
+    else if (lName == "choice" || lName == "all")
+      particles(lChildren[i], aType, true, aTargetNamespace, aPositions);
+  }
+
+  // a sequence is its children following each other, a choice a cycle
+  for (size_t i = lFirst + 1; i < aPositions.size(); ++i)
+  {
+    if (aPositions[i - 1] != aPositions[i])
+      aType.theFollows.insert(std::make_pair(aPositions[i - 1], aPositions[i]));
+  }
+  if (aChoice && aPositions.size() > lFirst + 1 &&
+      aPositions.back() != aPositions[lFirst])
+    aType.theFollows.insert(std::make_pair(aPositions.back(), aPositions[lFirst]));
+}
+
+
+void SchemaReader::particle(const Item& aNode, TypeInfo& aType, bool aChoice,
+    const std::string& aTargetNamespace, std::vector<size_t>& aPositions)
+{
+  std::string lValue;
+  bool lReference = SchemaSet::getAttribute(aNode, "ref", lValue);
+  QNameKey lName;
+  if (lReference)
+    lName = SchemaSet::expandQName(aNode, lValue);
+  else if (SchemaSet::getAttribute(aNode, "name", lValue))
+    // local elements are qualified, as SchemaWriter writes them
+    lName = QNameKey(aTargetNamespace, lValue);
+  else
+    return;
+
+  bool lGlobal = theInference.isGlobal(lName, aTargetNamespace);
+  size_t lPos = aType.childIndex(lName, !lGlobal);
+  aPositions.push_back(lPos);
+
+  ChildParticle& lParticle = aType.theChildren[lPos];
+  std::string lMinOccurs, lMaxOccurs;
+  bool lOptional = aChoice ||
+      (SchemaSet::getAttribute(aNode, "minOccurs", lMinOccurs) && lMinOccurs == "0");
+  bool lRepeated = SchemaSet::getAttribute(aNode, "maxOccurs", lMaxOccurs) &&
+      lMaxOccurs != "0" && lMaxOccurs != "1";
+  if (!lOptional)
+    ++lParticle.theParents;
+  lParticle.theMaxPerParent =
+      std::max(lParticle.theMaxPerParent, lRepeated || aChoice ? 2UL : 1UL);
+  if (!lParticle.theLocal && !lGlobal)
+  {
+    lParticle.theLocal.reset(new ElementDecl());
+    lParticle.theLocal->theName = lName;
+  }
+
+  // no reference into aType is held across the recursion, as in
+  // NativeInst2Xsd::processElement
+  ElementDecl* lLocal = lParticle.theLocal.get();
+  if (!lGlobal && lReference)
+  {
+    // a global element of the schemas, local in the design of the options
+    if (theOpen.count(lName) != 0)
+      return;
+    const SchemaComponent& lComponent =
+        theSchemas.resolve(SchemaSet::ELEMENT_COMPONENT, lName);
+    theOpen.insert(lName);
+    element(lComponent.theNode, lLocal->theType, aTargetNamespace);
+    theOpen.erase(lName);
+  }
+  else if (!lGlobal)
+  {
+    element(aNode, lLocal->theType, aTargetNamespace);
+  }
+  else if (!lReference)
+  {
+    // a local element of the schemas, global in the design of the options
+    element(aNode, theInference.globalElement(lName)->theType, lName.first);
+    theInference.completeGlobalElement(lName);
+  }
+}
+
+
+void SchemaReader::attribute(const Item& aNode, TypeInfo& aType,
+    const std::string& aTargetNamespace)
+{
+  std::string lValue;
+  QNameKey lName;
+  bool lReference = SchemaSet::getAttribute(aNode, "ref", lValue);
+  if (lReference)
+    lName = SchemaSet::expandQName(aNode, lValue);
+  else if (SchemaSet::getAttribute(aNode, "name", lValue))
+    lName = QNameKey("", lValue);
+  else
+    return;
+
+  AttributeUse& lUse = aType.theAttributes[aType.attributeIndex(lName)];
+  if (!SchemaSet::getAttribute(aNode, "use", lValue) ||
+      (lValue != "optional" && lValue != "prohibited"))
+    ++lUse.theCount;
+
+  if (!lReference)
+  {
+    simpleContent(aNode, lUse.theContent);
+    return;
+  }
+
+  // qualified attributes are typed globally, once
+  if (lName.first == XML_NAMESPACE || !theAttributesRead.insert(lName).second)
+    return;
+  const SchemaComponent& lComponent =
+      theSchemas.resolve(SchemaSet::ATTRIBUTE_COMPONENT, lName);
+  simpleContent(lComponent.theNode,
+      theInference.globalAttribute(lName).theContent);
+}
+
+
+void SchemaReader::simpleContent(const Item& aNode, SimpleContent& aContent)
+{
+  std::string lType;
+  if (SchemaSet::getAttribute(aNode, "type", lType))
+  {
+    simpleTypeReference(SchemaSet::expandQName(aNode, lType), aContent);
+    return;
+  }
+
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aNode, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    if (SchemaSet::xsName(lChildren[i]) == "simpleType")
+    {
+      simpleType(lChildren[i], aContent);
+      return;
+    }
+  }
+  anyValue(aContent, SimpleContent::STRING_TYPE);
+}
+
+
+void SchemaReader::simpleTypeReference(const QNameKey& aType,
+    SimpleContent& aContent)
+{
+  if (aType.first == XML_SCHEMA_NAMESPACE)
+  {
+    anyValue(aContent, builtinKind(aType.second));
+    return;
+  }
+  simpleType(theSchemas.resolve(SchemaSet::SIMPLE_TYPE_COMPONENT, aType).theNode,
+      aContent);
+}
+
+
+void SchemaReader::simpleType(const Item& aNode, SimpleContent& aContent)
+{
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aNode, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    if (SchemaSet::xsName(lChildren[i]) != "restriction")
+      continue;
+
+    std::vector<Item> lFacets;
+    SchemaSet::xsChildren(lChildren[i], lFacets);
+    SimpleContent lEnumeration;
+    for (size_t j = 0; j < lFacets.size(); ++j)
+    {
+      std::string lValue;
+      if (SchemaSet::xsName(lFacets[j]) == "enumeration" &&
+          SchemaSet::getAttribute(lFacets[j], "value", lValue))
+        lEnumeration.theValues.push_back(lValue);
+    }
+    if (lEnumeration.theValues.empty())
+      lEnumeration.theTooManyValues = true;
+
+    std::string lBase;
+    if (!SchemaSet::getAttribute(lChildren[i], "base", lBase))
+    {
+      simpleContent(lChildren[i], aContent);
+      return;
+    }
+    QNameKey lBaseName = SchemaSet::expandQName(lChildren[i], lBase);
+    if (lBaseName.first == XML_SCHEMA_NAMESPACE)
+      lEnumeration.addKind(builtinKind(lBaseName.second));
+    else
+      simpleTypeReference(lBaseName, aContent);
+
+    // the enumeration values, within the limit of the options
+    aContent.merge(lEnumeration, theOptions);
+    return;
+  }
+
+  // lists and unions are strings to the inference
+  anyValue(aContent, SimpleContent::STRING_TYPE);
+}
+
+
+void NativeInst2Xsd::seed(const SchemaSet& aSchemas)
+{
+  SchemaReader lReader(*this, aSchemas);
+  lReader.read();
+}
+
+
+
+/*******************************************************************************
+  SchemaWriter
+*******************************************************************************/
+
+/**
+ * Writes the schema documents of a NativeInst2Xsd.
+ */
+class SchemaWriter
+{
+  private:
+    class SchemaDoc
+    {
+      public:
+        std::string theTargetNamespace;
+        std::vector<XmlNode> theElements;
+        std::vector<XmlNode> theAttributes;
+        std::vector<XmlNode> theTypes;
+        // type name -> canonical form of its definition
+        std::map<std::string, std::string> theTypeNames;
+    };
+
+    const NativeInst2Xsd& theInference;
+    const STOptions& theOptions;
+    std::vector<SchemaDoc> theDocs;
+    std::map<std::string, size_t> theDocIndex;
+
+  public:
+    SchemaWriter(const NativeInst2Xsd& aInference) :
+      theInference(aInference),
+      theOptions(aInference.theOptions)
+    {}
+
+    std::vector<XmlNode> write();
+
+  private:
+    SchemaDoc& doc(const std::string& aNamespace);
+
+    // lexical QName of aName, declaring its prefix on aOwner if needed
+    static std::string qname(const QNameKey& aName, XmlNode& aOwner);
+
+
+    static XmlNode xs(const char* aLocalName)
+    {
+      return XmlNode(XML_SCHEMA_NAMESPACE, "xs", aLocalName);
+    }
+
+    XmlNode globalElement(const ElementDecl& aDecl);
+
+    void localElement(SchemaDoc& aDoc, const TypeInfo& aParent,
+        const ChildParticle& aParticle, bool aInChoice, XmlNode& aParticleNode);
+
+    void elementType(SchemaDoc& aDoc, const ElementDecl& aDecl, XmlNode& aElement,
+        bool aTypeFirst);
+
+    XmlNode complexType(SchemaDoc& aDoc, const TypeInfo& aType);
+
+    XmlNode enumeration(const SimpleContent& aContent);
+
+    void simpleType(SchemaDoc& aDoc, const std::string& aName,
+        const SimpleContent& aContent, XmlNode& aOwner, bool aTypeFirst);
+
+    std::string namedType(SchemaDoc& aDoc, const std::string& aName,
+        XmlNode aDefinition, XmlNode& aOwner);
+
+    XmlNode attribute(SchemaDoc& aDoc, const TypeInfo& aType, const AttributeUse& aUse);
+};
+
+
+SchemaWriter::SchemaDoc& SchemaWriter::doc(const std::string& aNamespace)
+{
+  std::map<std::string, size_t>::iterator lIt = theDocIndex.find(aNamespace);
+  if (lIt != theDocIndex.end())
+    return theDocs[lIt->second];
+  theDocIndex[aNamespace] = theDocs.size();
+  theDocs.push_back(SchemaDoc());
+  theDocs.back().theTargetNamespace = aNamespace;
+  return theDocs.back();
+}
+
+
+std::string SchemaWriter::qname(const QNameKey& aName, XmlNode& aOwner)
+{
+  if (aName.first == XML_SCHEMA_NAMESPACE)
+    return "xs:" + aName.second;
+  if (aName.first == XML_NAMESPACE)
+    return "xml:" + aName.second;
+  if (aName.first.empty())
+    return aName.second;
+
+  // like XMLBeans, the prefix is declared on the element that uses it
+  std::string lPrefix = suggestPrefix(aName.first);
+  aOwner.theBindings.push_back(XmlNode::Binding(lPrefix, aName.first));
+  return lPrefix + ":" + aName.second;
+}
+
+
+std::string SchemaWriter::namedType(SchemaDoc& aDoc, const std::string& aName,
+    XmlNode aDefinition, XmlNode& aOwner)
+{
+  std::string lCanonical;
+  aDefinition.toString(lCanonical);
+
+  // same name for identical definitions, numbered names otherwise
+  std::string lName = aName;
+  for (int i = 2; ; ++i)
+  {
+    std::map<std::string, std::string>::iterator lIt = aDoc.theTypeNames.find(lName);
+    if (lIt == aDoc.theTypeNames.end())
+      break;
+    if (lIt->second == lCanonical)
+      return qname(QNameKey(aDoc.theTargetNamespace, lName), aOwner);
+    std::ostringstream lNumbered;
+    lNumbered << aName << i;
+    lName = lNumbered.str();
+  }
+
+  aDoc.theTypeNames[lName] = lCanonical;
+  aDefinition.theAttributes.insert(aDefinition.theAttributes.begin(),
+      std::make_pair(std::string("name"), lName));
+  aDoc.theTypes.push_back(aDefinition);
+  return qname(QNameKey(aDoc.theTargetNamespace, lName), aOwner);
+}
+
+
+XmlNode SchemaWriter::enumeration(const SimpleContent& aContent)
+{
+  XmlNode lSimpleType = xs("simpleType");
+  XmlNode& lRestriction = lSimpleType.append(xs("restriction"));
+  lRestriction.attr("base", std::string("xs:") + SimpleContent::typeName(aContent.theKind));
+  for (size_t i = 0; i < aContent.theValues.size(); ++i)
+    lRestriction.append(xs("enumeration")).attr("value", aContent.theValues[i]);
+  return lSimpleType;
+}
+
+
+void SchemaWriter::simpleType(SchemaDoc& aDoc, const std::string& aName,
+    const SimpleContent& aContent, XmlNode& aOwner, bool aTypeFirst)
+{
+  std::string lType;
+  if (aContent.useEnumeration())
+  {
+    if (theOptions.getDesign() != STOptions::VENETIAN_BLIND_DESIGN)
+    {
+      aOwner.append(enumeration(aContent));
+      return;
+    }
+    lType = namedType(aDoc, aName + "Type", enumeration(aContent), aOwner);
+  }
+  else
+  {
+    lType = std::string("xs:") + SimpleContent::typeName(aContent.theKind);
+  }
+
+  if (aTypeFirst)
+    aOwner.theAttributes.insert(aOwner.theAttributes.begin(),
+        std::make_pair(std::string("type"), lType));
+  else
+    aOwner.attr("type", lType);
+}
+
+
+XmlNode SchemaWriter::attribute(SchemaDoc& aDoc, const TypeInfo& aType,
+    const AttributeUse& aUse)
+{
+  XmlNode lAttr = xs("attribute");
+  if (aUse.theName.first.empty())
+  {
+    lAttr.attr("name", aUse.theName.second);
+    simpleType(aDoc, aUse.theName.second, aUse.theContent, lAttr, true);
+  }
+  else
+  {
+    lAttr.attr("ref", qname(aUse.theName, lAttr));
+  }
+  if (aUse.theCount < aType.theCount)
+    lAttr.attr("use", "optional");
+  return lAttr;
+}
+
+
+XmlNode SchemaWriter::complexType(SchemaDoc& aDoc, const TypeInfo& aType)
+{
+  XmlNode lComplexType = xs("complexType");
+
+  if (aType.theHasChildren)
+  {
+    if (aType.theHasText)
+      lComplexType.attr("mixed", "true");
+
+    // order the children by their "followed by" pairs, first seen first
+    size_t lCount = aType.theChildren.size();
+    std::vector<size_t> lIncoming(lCount, 0);
+    std::set<std::pair<size_t, size_t> >::const_iterator lIt;
+    for (lIt = aType.theFollows.begin(); lIt != aType.theFollows.end(); ++lIt)
+      ++lIncoming[lIt->second];
+
+    std::vector<size_t> lOrder;
+    std::vector<bool> lDone(lCount, false);
+    while (lOrder.size() < lCount)
+    {
+      size_t lNext = 0;
+      while (lNext < lCount && (lDone[lNext] || lIncoming[lNext] != 0))
+        ++lNext;
+      if (lNext == lCount)
+        break;
+      lDone[lNext] = true;
+      lOrder.push_back(lNext);
+      for (lIt = aType.theFollows.begin(); lIt != aType.theFollows.end(); ++lIt)
+        if (lIt->first == lNext)
+          --lIncoming[lIt->second];
+    }
+
+    bool lChoice = (lOrder.size() < lCount);
+    XmlNode& lParticle = lComplexType.append(xs(lChoice ? "choice" : "sequence"));
+    if (lChoice)
+    {
+      // the children repeat in no fixed order
+      lParticle.attr("maxOccurs", "unbounded").attr("minOccurs", "0");
+      lOrder.clear();
+      for (size_t i = 0; i < lCount; ++i)
+        lOrder.push_back(i);
+    }
+    for (size_t i = 0; i < lOrder.size(); ++i)
+      localElement(aDoc, aType, aType.theChildren[lOrder[i]], lChoice, lParticle);
+
+    for (size_t i = 0; i < aType.theAttributes.size(); ++i)
+      lComplexType.append(attribute(aDoc, aType, aType.theAttributes[i]));
+  }
+  else if (aType.theHasText)
+  {
+    XmlNode& lExtension =
+        lComplexType.append(xs("simpleContent")).append(xs("extension"));
+    lExtension.attr("base",
+        std::string("xs:") + SimpleContent::typeName(aType.theContent.theKind));
+    for (size_t i = 0; i < aType.theAttributes.size(); ++i)
+      lExtension.append(attribute(aDoc, aType, aType.theAttributes[i]));
+  }
+  else
+  {
+    for (size_t i = 0; i < aType.theAttributes.size(); ++i)
+      lComplexType.append(attribute(aDoc, aType, aType.theAttributes[i]));
+  }
+  return lComplexType;
+}
+
+
+void SchemaWriter::elementType(SchemaDoc& aDoc, const ElementDecl& aDecl,
+    XmlNode& aElement, bool aTypeFirst)
+{
+  const TypeInfo& lType = aDecl.theType;
+  if (!lType.isComplex())
+  {
+    simpleType(aDoc, aDecl.theName.second, lType.theContent, aElement, aTypeFirst);
+    return;
+  }
+
+  XmlNode lDefinition = complexType(aDoc, lType);
+  if (theOptions.getDesign() != STOptions::VENETIAN_BLIND_DESIGN)
+  {
+    aElement.append(lDefinition);
+    return;
+  }
+
+  std::string lName = namedType(aDoc, aDecl.theName.second + "Type", lDefinition,
+      aElement);
+  if (aTypeFirst)
+    aElement.theAttributes.insert(aElement.theAttributes.begin(),
+        std::make_pair(std::string("type"), lName));
+  else
+    aElement.attr("type", lName);
+}
+
+
+void SchemaWriter::localElement(SchemaDoc& aDoc, const TypeInfo& aParent,
+    const ChildParticle& aParticle, bool aInChoice, XmlNode& aParticleNode)
+{
+  XmlNode lElement = xs("element");
+  if (aParticle.theLocal)
+  {
+    lElement.attr("name", aParticle.theName.second);
+    // XMLBeans writes the type of local elements before their name
+    elementType(aDoc, *aParticle.theLocal, lElement, true);
+  }
+  else
+  {
+    lElement.attr("ref", qname(aParticle.theName, lElement));
+  }
+
+  if (!aInChoice)
+  {
+    if (aParticle.theMaxPerParent > 1)
+      lElement.attr("maxOccurs", "unbounded").attr("minOccurs", "0");
+    else if (aParticle.theParents < aParent.theCount)
+      lElement.attr("minOccurs", "0");
+  }
+  aParticleNode.append(lElement);
+}
+
+
+XmlNode SchemaWriter::globalElement(const ElementDecl& aDecl)
+{
+  SchemaDoc& lDoc = doc(aDecl.theName.first);
+  XmlNode lElement = xs("element");
+  lElement.attr("name", aDecl.theName.second);
+  elementType(lDoc, aDecl, lElement, false);
+  return lElement;
+}
+
+
+std::vector<XmlNode> SchemaWriter::write()
+{
+  for (size_t i = 0; i < theInference.theElementOrder.size(); ++i)
+  {
+    const ElementDecl& lDecl = *theInference.theElements[theInference.theElementOrder[i]];
+    XmlNode lElement = globalElement(lDecl);
+    doc(lDecl.theName.first).theElements.push_back(lElement);
+  }
+
+  for (size_t i = 0; i < theInference.theAttributes.size(); ++i)
+  {
+    const AttributeDecl& lDecl = theInference.theAttributes[i];
+    if (lDecl.theName.first == XML_NAMESPACE)
+      continue;
+    SchemaDoc& lDoc = doc(lDecl.theName.first);
+    XmlNode lAttr = xs("attribute");
+    lAttr.attr("name", lDecl.theName.second);
+    simpleType(lDoc, lDecl.theName.second, lDecl.theContent, lAttr, false);
+    lDoc.theAttributes.push_back(lAttr);
+  }
+
+  std::vector<XmlNode> lResult;
+  for (size_t i = 0; i < theDocs.size(); ++i)
+  {
+    SchemaDoc& lDoc = theDocs[i];
+    XmlNode lSchema = xs("schema");
+    lSchema.theBindings.push_back(XmlNode::Binding("xs", XML_SCHEMA_NAMESPACE));
+    lSchema.attr("attributeFormDefault", "unqualified");
+    lSchema.attr("elementFormDefault", "qualified");
+    if (!lDoc.theTargetNamespace.empty())
+    {
+      lSchema.attr("targetNamespace", lDoc.theTargetNamespace);
+    }
+
+    for (size_t j = 0; j < lDoc.theElements.size(); ++j)
+      lSchema.append(lDoc.theElements[j]);
+    for (size_t j = 0; j < lDoc.theAttributes.size(); ++j)
+      lSchema.append(lDoc.theAttributes[j]);
+    for (size_t j = 0; j < lDoc.theTypes.size(); ++j)
+      lSchema.append(lDoc.theTypes[j]);
+
+    lResult.push_back(lSchema);
+  }
+  return lResult;
+}
+
+
+std::vector<XmlNode> NativeInst2Xsd::schemas() const
+{
+  if (theOptions.isVerbose())
+    std::cout << "native inst2xsd: " << theInstanceCount << " instances, "
+              << theElements.size() << " global elements" << std::endl;
+
+  SchemaWriter lWriter(*this);
+  return lWriter.write();
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
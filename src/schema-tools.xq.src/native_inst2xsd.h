@@ -0,0 +1,271 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_NATIVE_INST2XSD_H
+#define ZORBA_SCHEMATOOLS_NATIVE_INST2XSD_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zorba/item.h>
+
+#include "node_builder.h"
+#include "st_options.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * What is known about the text values of an element or attribute: the
+ * narrowest built-in type all of them belong to and, while there are fewer
+ * than the use-enumeration limit, the distinct values themselves.
+ */
+class SimpleContent
+{
+  public:
+    typedef enum
+    {
+      NO_VALUE = 0,
+      BYTE_TYPE,
+      SHORT_TYPE,
+      INT_TYPE,
+      LONG_TYPE,
+      INTEGER_TYPE,
+      FLOAT_TYPE,
+      DATE_TIME_TYPE,
+      TIME_TYPE,
+      DATE_TYPE,
+      G_YEAR_MONTH_TYPE,
+      G_YEAR_TYPE,
+      G_MONTH_DAY_TYPE,
+      G_DAY_TYPE,
+      G_MONTH_TYPE,
+      DURATION_TYPE,
+      ANY_URI_TYPE,
+      QNAME_TYPE,
+      STRING_TYPE,
+    } kind_t;
+
+  public:
+    int theKind;
+    std::vector<std::string> theValues;
+    bool theTooManyValues;
+
+  public:
+    SimpleContent() : theKind(NO_VALUE), theTooManyValues(false)
+    {}
+
+    // aValue of an element or attribute of aElement, whose namespace
+    // bindings a QName value is resolved with
+    void addValue(const std::string& aValue, const Item& aElement,
+        const STOptions& aOptions);
+
+    void addKind(int aKind);
+
+    void merge(const SimpleContent& aOther, const STOptions& aOptions);
+
+    // QName values are never enumerated: their prefixes are the ones of
+    // the instances, which the schema does not declare
+    bool useEnumeration() const
+    {
+      return !theTooManyValues && !theValues.empty() && theKind != QNAME_TYPE;
+    }
+
+    // local name of the XML Schema built-in type for aKind
+    static const char* typeName(int aKind);
+
+    // the narrowest kind aValue, a value in aElement, is a lexical
+    // representation of
+    static int detect(const std::string& aValue, const Item& aElement);
+
+    // the narrowest kind covering both
+    static int join(int aKind1, int aKind2);
+};
+
+
+class ElementDecl;
+class SchemaSet;
+
+/**
+ * A child element as seen inside the occurrences of its parent.
+ */
+class ChildParticle
+{
+  public:
+    QNameKey theName;
+    // number of parent occurrences containing this child
+    unsigned long theParents;
+    // largest number of occurrences within a single parent
+    unsigned long theMaxPerParent;
+    // declaration of a local element, null for a reference to a global one
+    std::unique_ptr<ElementDecl> theLocal;
+
+  public:
+    ChildParticle() : theParents(0), theMaxPerParent(0)
+    {}
+};
+
+
+class AttributeUse
+{
+  public:
+    QNameKey theName;
+    unsigned long theCount;
+    // values of unqualified attributes; qualified ones are typed globally
+    SimpleContent theContent;
+
+  public:
+    AttributeUse() : theCount(0)
+    {}
+};
+
+
+/**
+ * Inferred content of all occurrences of one element declaration.
+ *
+ * Merging two TypeInfo is associative and gives the same state as adding
+ * the occurrences of both one after the other. The order of the children
+ * is not decided while adding: it is kept as the set of "directly
+ * followed by" pairs and resolved to a sequence, or to a repeated choice if
+ * the pairs form a cycle, when the schema is written.
+ */
+class TypeInfo
+{
+  public:
+    unsigned long theCount;
+    bool theHasChildren;
+    bool theHasText;
+    SimpleContent theContent;
+
+    std::vector<ChildParticle> theChildren;
+    std::map<QNameKey, size_t> theChildIndex;
+    std::set<std::pair<size_t, size_t> > theFollows;
+
+    std::vector<AttributeUse> theAttributes;
+    std::map<QNameKey, size_t> theAttributeIndex;
+
+  public:
+    TypeInfo() : theCount(0), theHasChildren(false), theHasText(false)
+    {}
+
+    size_t childIndex(const QNameKey& aName, bool aLocal);
+
+    size_t attributeIndex(const QNameKey& aName);
+
+    // folds aOther, inferred from later occurrences, into this
+    void merge(const TypeInfo& aOther, const STOptions& aOptions);
+
+    bool isComplex() const
+    {
+      return theHasChildren || !theAttributes.empty();
+    }
+};
+
+
+class ElementDecl
+{
+  public:
+    QNameKey theName;
+    TypeInfo theType;
+};
+
+
+class AttributeDecl
+{
+  public:
+    QNameKey theName;
+    SimpleContent theContent;
+};
+
+
+/**
+ * Schema inference over Zorba items, without a JVM.
+ *
+ * Instances are walked with getChildren/getAttributes/getNodeName and
+ * folded into one ElementDecl per global element. The schemas are written
+ * in the Russian doll, salami slice or Venetian blind design of the
+ * options, following the conventions of XMLBeans' inst2xsd.
+ */
+class NativeInst2Xsd
+{
+  private:
+    STOptions theOptions;
+    unsigned long theInstanceCount;
+
+    // global elements, in the order their first occurrence was completed
+    std::vector<std::unique_ptr<ElementDecl> > theElements;
+    std::map<QNameKey, size_t> theElementIndex;
+    std::vector<size_t> theElementOrder;
+
+    std::vector<AttributeDecl> theAttributes;
+    std::map<QNameKey, size_t> theAttributeIndex;
+
+  public:
+    NativeInst2Xsd(const STOptions& aOptions);
+
+    void add(const Item& aInstance);
+
+    // folds aOther, inferred from the instances that follow the ones added
+    // so far, into this; the result is the same as adding them here
+    void merge(const NativeInst2Xsd& aOther);
+
+    unsigned long getInstanceCount() const
+    {
+      return theInstanceCount;
+    }
+
+    const STOptions& getOptions() const
+    {
+      return theOptions;
+    }
+
+    // sets the state to the one the schemas aSchemas were written from,
+    // as far as they tell: instances added afterwards widen them instead
+    // of starting over. Every type counts as seen once. Throws a
+    // SchemaException for a reference aSchemas do not resolve.
+    void seed(const SchemaSet& aSchemas);
+
+    // one schema document per target namespace
+    std::vector<XmlNode> schemas() const;
+
+  private:
+    NativeInst2Xsd(const NativeInst2Xsd&);
+    NativeInst2Xsd& operator=(const NativeInst2Xsd&);
+
+    ElementDecl* globalElement(const QNameKey& aName);
+
+    void completeGlobalElement(const QNameKey& aName);
+
+    AttributeDecl& globalAttribute(const QNameKey& aName);
+
+    bool isGlobal(const QNameKey& aName, const std::string& aTargetNamespace) const;
+
+    void processElement(const Item& aElement, TypeInfo& aType,
+        const std::string& aTargetNamespace);
+
+    friend class SchemaReader;
+    friend class SchemaWriter;
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_NATIVE_INST2XSD_H
+/* vim:set et sw=2 ts=2: */
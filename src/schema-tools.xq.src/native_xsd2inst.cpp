@@ -0,0 +1,882 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "native_xsd2inst.h"
+
+#define XML_SCHEMA_NAMESPACE "http://www.w3.org/2001/XMLSchema"
+#define XML_SCHEMA_INSTANCE_NAMESPACE "http://www.w3.org/2001/XMLSchema-instance"
+
+// occurrences a varied particle may have beyond its minOccurs
+#define VARIED_EXTRA_OCCURRENCES 4
+
+namespace zorba
+{
+namespace schematools
+{
+
+namespace
+{
+
+std::string toString(long long aValue)
+{
+  std::ostringstream lOut;
+  lOut << aValue;
+  return lOut.str();
+}
+
+bool parseLong(const std::string& aValue, long long& aResult)
+{
+  if (aValue.empty())
+    return false;
+  char* lEnd;
+  errno = 0;
+  aResult = strtoll(aValue.c_str(), &lEnd, 10);
+  return errno == 0 && *lEnd == 0;
+}
+
+// minOccurs or maxOccurs of aParticle, -1 for unbounded
+long occurs(const Item& aParticle, const char* aName)
+{
+  std::string lValue;
+  if (!SchemaSet::getAttribute(aParticle, aName, lValue))
+    return 1;
+  if (lValue == "unbounded")
+    return -1;
+  return atol(lValue.c_str());
+}
+
+// the comment XMLBeans writes before a particle
+std::string occurrenceComment(long aMin, long aMax)
+{
+  if (aMin == 1 && aMax == 1)
+    return "";
+  if (aMin == 0 && aMax == 1)
+    return "Optional:";
+  if (aMin == 0 && aMax < 0)
+    return "Zero or more repetitions:";
+  if (aMax < 0)
+    return toString(aMin) + " or more repetitions:";
+  if (aMin == aMax)
+    return toString(aMin) + " repetitions:";
+  return toString(aMin) + " to " + toString(aMax) + " repetitions:";
+}
+
+void setText(XmlNode& aElement, const std::string& aValue)
+{
+  std::vector<XmlNode>& lChildren = aElement.theChildren;
+  for (size_t i = lChildren.size(); i > 0; --i)
+    if (lChildren[i - 1].theKind == XmlNode::TEXT_NODE)
+      lChildren.erase(lChildren.begin() + (i - 1));
+  if (!aValue.empty())
+    lChildren.push_back(XmlNode::text(aValue));
+}
+
+bool hasElementChildren(const XmlNode& aElement)
+{
+  for (size_t i = 0; i < aElement.theChildren.size(); ++i)
+    if (aElement.theChildren[i].theKind == XmlNode::ELEMENT_NODE)
+      return true;
+  return false;
+}
+
+// aValue with at least aWidth digits
+std::string padded(long long aValue, int aWidth)
+{
+  char lBuffer[32];
+  snprintf(lBuffer, sizeof(lBuffer), "%0*lld", aWidth, aValue);
+  return lBuffer;
+}
+
+// the range the range facets of aRestriction allow, false if it has none
+bool integerBounds(const Item& aRestriction, long long& aLow, long long& aHigh)
+{
+  bool lHasLow = false;
+  bool lHasHigh = false;
+  std::vector<Item> lFacets;
+  SchemaSet::xsChildren(aRestriction, lFacets);
+  for (size_t i = 0; i < lFacets.size(); ++i)
+  {
+    std::string lName = SchemaSet::xsName(lFacets[i]);
+    std::string lFacet;
+    long long lBound;
+    if (!SchemaSet::getAttribute(lFacets[i], "value", lFacet) ||
+        !parseLong(lFacet, lBound))
+      continue;
+    if (lName == "minInclusive" || lName == "minExclusive")
+    {
+      aLow = (lName == "minInclusive") ? lBound : lBound + 1;
+      lHasLow = true;
+    }
+    else if (lName == "maxInclusive" || lName == "maxExclusive")
+    {
+      aHigh = (lName == "maxInclusive") ? lBound : lBound - 1;
+      lHasHigh = true;
+    }
+  }
+  if (!lHasLow && !lHasHigh)
+    return false;
+  if (!lHasLow)
+    aLow = aHigh - 1000;
+  if (!lHasHigh)
+    aHigh = aLow + 1000;
+  return aLow <= aHigh;
+}
+
+// adjusts aValue to the length and range facets of aRestriction
+std::string applyFacets(const std::string& aValue, const Item& aRestriction)
+{
+  std::string lResult = aValue;
+  std::vector<Item> lFacets;
+  SchemaSet::xsChildren(aRestriction, lFacets);
+
+  long lMinLength = -1;
+  long lMaxLength = -1;
+  for (size_t i = 0; i < lFacets.size(); ++i)
+  {
+    std::string lName = SchemaSet::xsName(lFacets[i]);
+    std::string lFacet;
+    if (!SchemaSet::getAttribute(lFacets[i], "value", lFacet))
+      continue;
+
+    if (lName == "length")
+      lMinLength = lMaxLength = atol(lFacet.c_str());
+    else if (lName == "minLength")
+      lMinLength = atol(lFacet.c_str());
+    else if (lName == "maxLength")
+      lMaxLength = atol(lFacet.c_str());
+    else
+    {
+      long long lValue;
+      long long lBound;
+      if (!parseLong(lResult, lValue) || !parseLong(lFacet, lBound))
+        continue;
+      if (lName == "minInclusive")
+        lValue = std::max(lValue, lBound);
+      else if (lName == "minExclusive")
+        lValue = std::max(lValue, lBound + 1);
+      else if (lName == "maxInclusive")
+        lValue = std::min(lValue, lBound);
+      else if (lName == "maxExclusive")
+        lValue = std::min(lValue, lBound - 1);
+      std::ostringstream lOut;
+      lOut << lValue;
+      lResult = lOut.str();
+    }
+  }
+
+  // as XMLBeans' formatToLength
+  if (lMinLength > 0 && lResult.empty())
+    lResult = "x";
+  while (lMinLength > 0 && (long)lResult.size() < lMinLength)
+    lResult += lResult;
+  if (lMaxLength >= 0 && (long)lResult.size() > lMaxLength)
+    lResult.resize(lMaxLength);
+  return lResult;
+}
+
+} // anonymous namespace
+
+
+SampleGenerator::SampleGenerator(const SchemaSet& aSchemas,
+                                 std::mt19937_64* aRandom) :
+  theSchemas(aSchemas),
+  theRandom(aRandom),
+  theIds(0)
+{
+}
+
+
+std::string SampleGenerator::builtinValue(const std::string& aLocalName)
+{
+  // the values of XMLBeans' SampleXmlUtil.sampleDataForSimpleType
+  static const char* lValues[][2] = {
+    { "anySimpleType", "anything" },
+    { "anyAtomicType", "anything" },
+    { "boolean", "true" },
+    { "base64Binary", "c3RyaW5n" },
+    { "hexBinary", "737472696E67" },
+    { "anyURI", "http://www.example.com/string" },
+    { "QName", "qname" },
+    { "NOTATION", "notation" },
+    { "float", "1.5E2" },
+    { "double", "1.051732E7" },
+    { "decimal", "1000.00" },
+    { "integer", "100" },
+    { "nonPositiveInteger", "-200" },
+    { "negativeInteger", "-201" },
+    { "nonNegativeInteger", "200" },
+    { "positiveInteger", "201" },
+    { "long", "10" },
+    { "unsignedLong", "11" },
+    { "int", "3" },
+    { "unsignedInt", "7" },
+    { "short", "1" },
+    { "unsignedShort", "5" },
+    { "byte", "2" },
+    { "unsignedByte", "6" },
+    { "token", "token" },
+    { "duration", "P1D" },
+    { "dateTime", "2013-01-01T12:00:00" },
+    { "time", "12:00:00" },
+    { "date", "2013-01-01" },
+    { "gYearMonth", "2013-01" },
+    { "gYear", "2013" },
+    { "gMonthDay", "--01-01" },
+    { "gDay", "---01" },
+    { "gMonth", "--01" },
+  };
+
+  for (size_t i = 0; i < sizeof(lValues) / sizeof(lValues[0]); ++i)
+    if (aLocalName == lValues[i][0])
+      return lValues[i][1];
+  // string and the other types derived from it
+  return "string";
+}
+
+
+std::string SampleGenerator::sampleValue(const std::string& aLocalName)
+{
+  return theRandom ? randomValue(aLocalName) : builtinValue(aLocalName);
+}
+
+
+std::string SampleGenerator::randomValue(const std::string& aLocalName)
+{
+  // the integer types, over a range that suits them
+  static const struct { const char* theName; long long theMin; long long theMax; }
+  lIntegers[] = {
+    { "integer", -100000, 100000 },
+    { "nonPositiveInteger", -100000, 0 },
+    { "negativeInteger", -100000, -1 },
+    { "nonNegativeInteger", 0, 100000 },
+    { "positiveInteger", 1, 100000 },
+    { "long", -100000, 100000 },
+    { "unsignedLong", 0, 100000 },
+    { "int", -100000, 100000 },
+    { "unsignedInt", 0, 100000 },
+    { "short", -32768, 32767 },
+    { "unsignedShort", 0, 65535 },
+    { "byte", -128, 127 },
+    { "unsignedByte", 0, 255 },
+  };
+  for (size_t i = 0; i < sizeof(lIntegers) / sizeof(lIntegers[0]); ++i)
+    if (aLocalName == lIntegers[i].theName)
+      return toString(randomIn(lIntegers[i].theMin, lIntegers[i].theMax));
+
+  if (aLocalName == "boolean")
+    return randomIn(0, 1) ? "true" : "false";
+  if (aLocalName == "decimal")
+    return toString(randomIn(-100000, 100000)) + "." + padded(randomIn(0, 99), 2);
+  if (aLocalName == "float" || aLocalName == "double")
+    return toString(randomIn(-100000, 100000)) + "." + padded(randomIn(0, 999), 3);
+
+  std::string lDate = padded(randomIn(1970, 2037), 4) + "-" +
+      padded(randomIn(1, 12), 2) + "-" + padded(randomIn(1, 28), 2);
+  std::string lTime = padded(randomIn(0, 23), 2) + ":" +
+      padded(randomIn(0, 59), 2) + ":" + padded(randomIn(0, 59), 2);
+  if (aLocalName == "date")
+    return lDate;
+  if (aLocalName == "time")
+    return lTime;
+  if (aLocalName == "dateTime")
+    return lDate + "T" + lTime;
+  if (aLocalName == "duration")
+    return "P" + toString(randomIn(0, 365)) + "DT" + toString(randomIn(0, 23)) + "H";
+  if (aLocalName == "gYearMonth")
+    return lDate.substr(0, 7);
+  if (aLocalName == "gYear")
+    return lDate.substr(0, 4);
+  if (aLocalName == "gMonthDay")
+    return "-" + lDate.substr(4);
+  if (aLocalName == "gDay")
+    return "---" + lDate.substr(8);
+  if (aLocalName == "gMonth")
+    return "-" + lDate.substr(4, 3);
+
+  if (aLocalName == "hexBinary")
+  {
+    static const char lHex[] = "0123456789ABCDEF";
+    std::string lValue;
+    for (long long i = randomIn(1, 8); i > 0; --i)
+    {
+      lValue += lHex[randomIn(0, 15)];
+      lValue += lHex[randomIn(0, 15)];
+    }
+    return lValue;
+  }
+  if (aLocalName == "base64Binary")
+  {
+    // whole groups of three bytes, so there is no padding
+    static const char lBase64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string lValue;
+    for (long long i = 4 * randomIn(1, 4); i > 0; --i)
+      lValue += lBase64[randomIn(0, 63)];
+    return lValue;
+  }
+  if (aLocalName == "language")
+  {
+    static const char* lLanguages[] = { "en", "de", "fr", "es", "it", "ja" };
+    return lLanguages[randomIn(0, 5)];
+  }
+  if (aLocalName == "anyURI")
+    return "http://www.example.com/" + randomWord();
+  if (aLocalName == "ID")
+    return "id" + toString(++theIds);
+  // only IDs the instance has so far are referenced; before the first
+  // one, the value is the one of the XMLBeans samples
+  if ((aLocalName == "IDREF" || aLocalName == "IDREFS") && theIds == 0)
+    return builtinValue(aLocalName);
+  if (aLocalName == "IDREF")
+    return "id" + toString(randomIn(1, theIds));
+  if (aLocalName == "IDREFS")
+  {
+    std::string lValue;
+    for (long long i = randomIn(1, 3); i > 0; --i)
+      lValue += (lValue.empty() ? "id" : " id") + toString(randomIn(1, theIds));
+    return lValue;
+  }
+
+  // string and the name and token types
+  return randomWord();
+}
+
+
+bool SampleGenerator::enumeration(const Item& aRestriction, std::string& aValue)
+{
+  std::vector<Item> lFacets;
+  SchemaSet::xsChildren(aRestriction, lFacets);
+  std::vector<Item> lEnumerations;
+  for (size_t i = 0; i < lFacets.size(); ++i)
+    if (SchemaSet::xsName(lFacets[i]) == "enumeration")
+      lEnumerations.push_back(lFacets[i]);
+  if (lEnumerations.empty())
+    return false;
+
+  size_t lIndex = theRandom ? randomIn(0, lEnumerations.size() - 1) : 0;
+  return SchemaSet::getAttribute(lEnumerations[lIndex], "value", aValue);
+}
+
+
+long long SampleGenerator::randomIn(long long aMin, long long aMax)
+{
+  std::uniform_int_distribution<long long> lDistribution(aMin, aMax);
+  return lDistribution(*theRandom);
+}
+
+
+std::string SampleGenerator::randomWord()
+{
+  std::string lWord;
+  for (long long i = randomIn(3, 10); i > 0; --i)
+    lWord += (char)('a' + randomIn(0, 25));
+  return lWord;
+}
+
+
+long SampleGenerator::occurrences(long aMin, long aMax)
+{
+  long lMax = aMin + VARIED_EXTRA_OCCURRENCES;
+  if (aMax >= 0 && aMax < lMax)
+    lMax = aMax;
+  return (long)randomIn(aMin, std::max(aMin, lMax));
+}
+
+
+XmlNode SampleGenerator::sample(const std::string& aRootName)
+{
+  return sample(theSchemas.findGlobalElement(aRootName));
+}
+
+
+XmlNode SampleGenerator::sample(const QNameKey& aName)
+{
+  const SchemaComponent& lDecl =
+      theSchemas.resolve(SchemaSet::ELEMENT_COMPONENT, aName);
+
+  XmlNode lHolder;
+  theStack.clear();
+  theScope.clear();
+  theIds = 0;
+  element(lDecl.theNode, *lDecl.theDoc, true, lHolder);
+  return lHolder.theChildren[0];
+}
+
+
+bool SampleGenerator::push(const std::string& aKey)
+{
+  if (std::find(theStack.begin(), theStack.end(), aKey) != theStack.end())
+    return false;
+  theStack.push_back(aKey);
+  return true;
+}
+
+
+std::string SampleGenerator::prefixFor(const std::string& aNamespace, XmlNode& aOwner)
+{
+  for (size_t i = theScope.size(); i > 0; --i)
+    if (theScope[i - 1].second == aNamespace)
+      return theScope[i - 1].first;
+
+  std::string lBase = suggestPrefix(aNamespace);
+  std::string lPrefix = lBase;
+  for (int n = 1; ; ++n)
+  {
+    bool lTaken = false;
+    for (size_t i = 0; i < theScope.size() && !lTaken; ++i)
+      lTaken = (theScope[i].first == lPrefix);
+    if (!lTaken)
+      break;
+    lPrefix = lBase + toString(n);
+  }
+
+  XmlNode::Binding lBinding(lPrefix, aNamespace);
+  aOwner.theBindings.push_back(lBinding);
+  theScope.push_back(lBinding);
+  return lPrefix;
+}
+
+
+void SampleGenerator::element(const Item& aDecl, const SchemaDocInfo& aDoc,
+    bool aGlobal, XmlNode& aParent)
+{
+  std::string lValue;
+  if (SchemaSet::getAttribute(aDecl, "ref", lValue))
+  {
+    const SchemaComponent& lGlobal = theSchemas.resolve(
+        SchemaSet::ELEMENT_COMPONENT, SchemaSet::expandQName(aDecl, lValue));
+    element(lGlobal.theNode, *lGlobal.theDoc, true, aParent);
+    return;
+  }
+
+  std::string lName;
+  SchemaSet::getAttribute(aDecl, "name", lName);
+  std::string lNamespace;
+  if (aGlobal)
+    lNamespace = aDoc.theTargetNamespace;
+  else if (SchemaSet::getAttribute(aDecl, "form", lValue) ?
+           lValue == "qualified" : aDoc.theElementsQualified)
+    lNamespace = aDoc.theTargetNamespace;
+
+  size_t lScope = theScope.size();
+  XmlNode lElement(lNamespace, "", lName);
+  if (!lNamespace.empty())
+    lElement.thePrefix = prefixFor(lNamespace, lElement);
+
+  // a recursive global element is written empty
+  std::string lKey = "element {" + lNamespace + "}" + lName;
+  if (!aGlobal || push(lKey))
+  {
+    std::vector<Item> lChildren;
+    SchemaSet::xsChildren(aDecl, lChildren);
+
+    if (SchemaSet::getAttribute(aDecl, "type", lValue))
+    {
+      typedContent(SchemaSet::expandQName(aDecl, lValue), lElement);
+    }
+    else
+    {
+      for (size_t i = 0; i < lChildren.size(); ++i)
+      {
+        std::string lKind = SchemaSet::xsName(lChildren[i]);
+        if (lKind == "complexType")
+          complexContent(lChildren[i], aDoc, lElement);
+        else if (lKind == "simpleType")
+          setText(lElement, simpleValue(lChildren[i]));
+      }
+    }
+
+    // a varied instance has its own values instead of the defaults
+    if ((SchemaSet::getAttribute(aDecl, "fixed", lValue) ||
+         (!theRandom && SchemaSet::getAttribute(aDecl, "default", lValue))) &&
+        !hasElementChildren(lElement))
+      setText(lElement, lValue);
+
+    if (aGlobal)
+      theStack.pop_back();
+  }
+
+  theScope.resize(lScope);
+  aParent.append(lElement);
+}
+
+
+void SampleGenerator::typedContent(const QNameKey& aType, XmlNode& aElement)
+{
+  if (aType.first == XML_SCHEMA_NAMESPACE)
+  {
+    if (aType.second != "anyType")
+      setText(aElement, sampleValue(aType.second));
+    return;
+  }
+
+  const SchemaComponent* lComplex =
+      theSchemas.find(SchemaSet::COMPLEX_TYPE_COMPONENT, aType);
+  if (lComplex)
+  {
+    // a type that contains itself is left empty the second time
+    if (push("type {" + aType.first + "}" + aType.second))
+    {
+      complexContent(lComplex->theNode, *lComplex->theDoc, aElement);
+      theStack.pop_back();
+    }
+    return;
+  }
+
+  setText(aElement, typeValue(aType));
+}
+
+
+void SampleGenerator::complexContent(const Item& aType, const SchemaDocInfo& aDoc,
+    XmlNode& aElement)
+{
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aType, lChildren);
+
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    const Item& lChild = lChildren[i];
+    std::string lKind = SchemaSet::xsName(lChild);
+
+    if (lKind == "sequence" || lKind == "choice" || lKind == "all" ||
+        lKind == "group")
+    {
+      particle(lChild, aDoc, aElement);
+    }
+    else if (lKind == "attribute")
+    {
+      attribute(lChild, aDoc, aElement);
+    }
+    else if (lKind == "attributeGroup")
+    {
+      attributeGroup(lChild, aDoc, aElement);
+    }
+    else if (lKind == "simpleContent" || lKind == "complexContent")
+    {
+      std::vector<Item> lDerivations;
+      SchemaSet::xsChildren(lChild, lDerivations);
+      for (size_t j = 0; j < lDerivations.size(); ++j)
+      {
+        const Item& lDerivation = lDerivations[j];
+        bool lExtension = (SchemaSet::xsName(lDerivation) == "extension");
+        std::string lBase;
+
+        // an extension starts with the content of its base
+        if (SchemaSet::getAttribute(lDerivation, "base", lBase) &&
+            (lExtension || lKind == "simpleContent"))
+          typedContent(SchemaSet::expandQName(lDerivation, lBase), aElement);
+
+        std::string lValue;
+        if (lKind == "simpleContent" && !lExtension)
+        {
+          if (enumeration(lDerivation, lValue))
+            setText(aElement, lValue);
+        }
+        complexContent(lDerivation, aDoc, aElement);
+      }
+    }
+  }
+}
+
+
+void SampleGenerator::particle(const Item& aParticle, const SchemaDocInfo& aDoc,
+    XmlNode& aElement)
+{
+  long lMax = occurs(aParticle, "maxOccurs");
+  if (lMax == 0)
+    return;
+
+  long lTimes = 1;
+  if (theRandom)
+  {
+    lTimes = occurrences(occurs(aParticle, "minOccurs"), lMax);
+  }
+  else
+  {
+    std::string lComment = occurrenceComment(occurs(aParticle, "minOccurs"), lMax);
+    if (!lComment.empty())
+      aElement.append(XmlNode::comment(lComment));
+  }
+
+  std::string lKind = SchemaSet::xsName(aParticle);
+  for (long n = 0; n < lTimes; ++n)
+  {
+    if (lKind == "element")
+    {
+      element(aParticle, aDoc, false, aElement);
+    }
+    else if (lKind == "any")
+    {
+      if (!theRandom)
+        aElement.append(XmlNode::comment("You may enter ANY elements at this point"));
+    }
+    else if (lKind == "group")
+    {
+      std::string lRef;
+      if (!SchemaSet::getAttribute(aParticle, "ref", lRef))
+        return;
+      QNameKey lName = SchemaSet::expandQName(aParticle, lRef);
+      const SchemaComponent& lGroup =
+          theSchemas.resolve(SchemaSet::GROUP_COMPONENT, lName);
+      if (!push("group {" + lName.first + "}" + lName.second))
+        return;
+      std::vector<Item> lModelGroup;
+      SchemaSet::xsChildren(lGroup.theNode, lModelGroup);
+      if (!lModelGroup.empty())
+        particle(lModelGroup[0], *lGroup.theDoc, aElement);
+      theStack.pop_back();
+    }
+    else if (lKind == "choice" && theRandom)
+    {
+      // one branch per occurrence
+      std::vector<Item> lChildren;
+      SchemaSet::xsChildren(aParticle, lChildren);
+      if (!lChildren.empty())
+        particle(lChildren[randomIn(0, lChildren.size() - 1)], aDoc, aElement);
+    }
+    else
+    {
+      std::vector<Item> lChildren;
+      SchemaSet::xsChildren(aParticle, lChildren);
+      if (!theRandom && lKind == "choice")
+        aElement.append(XmlNode::comment("You have a CHOICE of the next " +
+            toString(lChildren.size()) + " items at this level"));
+      else if (!theRandom && lKind == "all")
+        aElement.append(XmlNode::comment("You may enter the following " +
+            toString(lChildren.size()) + " items in any order"));
+
+      for (size_t i = 0; i < lChildren.size(); ++i)
+        particle(lChildren[i], aDoc, aElement);
+    }
+  }
+}
+
+
+void SampleGenerator::attribute(const Item& aDecl, const SchemaDocInfo& aDoc,
+    XmlNode& aElement)
+{
+  std::string lUse;
+  SchemaSet::getAttribute(aDecl, "use", lUse);
+  if (lUse == "prohibited")
+    return;
+  // a varied instance has each optional attribute or not
+  if (theRandom && lUse != "required" && randomIn(0, 1) == 0)
+    return;
+
+  std::string lValue;
+
+  Item lDecl = aDecl;
+  QNameKey lName;
+  if (SchemaSet::getAttribute(aDecl, "ref", lValue))
+  {
+    lName = SchemaSet::expandQName(aDecl, lValue);
+    lDecl = theSchemas.resolve(SchemaSet::ATTRIBUTE_COMPONENT, lName).theNode;
+  }
+  else
+  {
+    SchemaSet::getAttribute(aDecl, "name", lName.second);
+    if (SchemaSet::getAttribute(aDecl, "form", lValue) ?
+        lValue == "qualified" : aDoc.theAttributesQualified)
+      lName.first = aDoc.theTargetNamespace;
+  }
+  if (lName.first == XML_SCHEMA_INSTANCE_NAMESPACE)
+    return;
+
+  // attributes of a base type may be restated by a derived one
+  for (size_t i = 0; i < aElement.theAttributes.size(); ++i)
+    if (lName.first.empty() && aElement.theAttributes[i].first == lName.second)
+      return;
+  for (size_t i = 0; i < aElement.theQAttributes.size(); ++i)
+    if (aElement.theQAttributes[i][0] == lName.first &&
+        aElement.theQAttributes[i][2] == lName.second)
+      return;
+
+  std::string lSample;
+  bool lConstrained = SchemaSet::getAttribute(aDecl, "fixed", lSample) ||
+                      SchemaSet::getAttribute(lDecl, "fixed", lSample) ||
+                      (!theRandom &&
+                       (SchemaSet::getAttribute(aDecl, "default", lSample) ||
+                        SchemaSet::getAttribute(lDecl, "default", lSample)));
+  if (!lConstrained)
+  {
+    if (SchemaSet::getAttribute(lDecl, "type", lValue))
+    {
+      lSample = typeValue(SchemaSet::expandQName(lDecl, lValue));
+    }
+    else
+    {
+      std::vector<Item> lChildren;
+      SchemaSet::xsChildren(lDecl, lChildren);
+      lSample = lChildren.empty() ? sampleValue("anySimpleType")
+                                  : simpleValue(lChildren[0]);
+    }
+  }
+
+  if (lName.first.empty())
+  {
+    aElement.attr(lName.second, lSample);
+    return;
+  }
+
+  std::vector<std::string> lQAttr(4);
+  lQAttr[0] = lName.first;
+  lQAttr[1] = prefixFor(lName.first, aElement);
+  lQAttr[2] = lName.second;
+  lQAttr[3] = lSample;
+  aElement.theQAttributes.push_back(lQAttr);
+}
+
+
+void SampleGenerator::attributeGroup(const Item& aGroup, const SchemaDocInfo& aDoc,
+    XmlNode& aElement)
+{
+  std::string lRef;
+  if (SchemaSet::getAttribute(aGroup, "ref", lRef))
+  {
+    QNameKey lName = SchemaSet::expandQName(aGroup, lRef);
+    const SchemaComponent& lDefinition =
+        theSchemas.resolve(SchemaSet::ATTRIBUTE_GROUP_COMPONENT, lName);
+    if (push("attributeGroup {" + lName.first + "}" + lName.second))
+    {
+      attributeGroup(lDefinition.theNode, *lDefinition.theDoc, aElement);
+      theStack.pop_back();
+    }
+    return;
+  }
+
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aGroup, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    std::string lKind = SchemaSet::xsName(lChildren[i]);
+    if (lKind == "attribute")
+      attribute(lChildren[i], aDoc, aElement);
+    else if (lKind == "attributeGroup")
+      attributeGroup(lChildren[i], aDoc, aElement);
+  }
+}
+
+
+std::string SampleGenerator::simpleValue(const Item& aSimpleType)
+{
+  std::vector<Item> lChildren;
+  SchemaSet::xsChildren(aSimpleType, lChildren);
+  std::string lValue;
+
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    const Item& lChild = lChildren[i];
+    std::string lKind = SchemaSet::xsName(lChild);
+    std::vector<Item> lInline;
+    SchemaSet::xsChildren(lChild, lInline);
+    Item lInlineType;
+    for (size_t j = 0; j < lInline.size() && lInlineType.isNull(); ++j)
+      if (SchemaSet::xsName(lInline[j]) == "simpleType")
+        lInlineType = lInline[j];
+
+    if (lKind == "restriction")
+    {
+      if (enumeration(lChild, lValue))
+        return lValue;
+      if (SchemaSet::getAttribute(lChild, "base", lValue))
+        lValue = typeValue(SchemaSet::expandQName(lChild, lValue));
+      else if (!lInlineType.isNull())
+        lValue = simpleValue(lInlineType);
+
+      // a random integer is drawn from the range of the facets
+      long long lLow;
+      long long lHigh;
+      if (theRandom && parseLong(lValue, lLow) &&
+          integerBounds(lChild, lLow, lHigh))
+        lValue = toString(randomIn(lLow, lHigh));
+      return applyFacets(lValue, lChild);
+    }
+    if (lKind == "list")
+    {
+      // a list of one item, or of one to three if varied
+      std::string lItemType;
+      bool lHasItemType = SchemaSet::getAttribute(lChild, "itemType", lItemType);
+      long lItems = theRandom ? (long)randomIn(1, 3) : 1;
+      for (long n = 0; n < lItems; ++n)
+      {
+        std::string lItem;
+        if (lHasItemType)
+          lItem = typeValue(SchemaSet::expandQName(lChild, lItemType));
+        else if (!lInlineType.isNull())
+          lItem = simpleValue(lInlineType);
+        lValue = n ? lValue + " " + lItem : lItem;
+      }
+      return lValue;
+    }
+    if (lKind == "union")
+    {
+      // the first member type, or a random one if varied
+      std::vector<std::string> lMembers;
+      if (SchemaSet::getAttribute(lChild, "memberTypes", lValue))
+      {
+        std::istringstream lNames(lValue);
+        std::string lName;
+        while (lNames >> lName)
+          lMembers.push_back(lName);
+      }
+      std::vector<Item> lInlineMembers;
+      for (size_t j = 0; j < lInline.size(); ++j)
+        if (SchemaSet::xsName(lInline[j]) == "simpleType")
+          lInlineMembers.push_back(lInline[j]);
+
+      size_t lCount = lMembers.size() + lInlineMembers.size();
+      if (lCount == 0)
+        return "";
+      size_t lIndex = theRandom ? randomIn(0, lCount - 1) : 0;
+      if (lIndex < lMembers.size())
+        return typeValue(SchemaSet::expandQName(lChild, lMembers[lIndex]));
+      return simpleValue(lInlineMembers[lIndex - lMembers.size()]);
+    }
+  }
+  return "";
+}
+
+
+std::string SampleGenerator::typeValue(const QNameKey& aType)
+{
+  if (aType.first == XML_SCHEMA_NAMESPACE)
+    return sampleValue(aType.second);
+
+  const SchemaComponent* lSimple =
+      theSchemas.find(SchemaSet::SIMPLE_TYPE_COMPONENT, aType);
+  if (lSimple)
+    return simpleValue(lSimple->theNode);
+
+  // the text of a complex type with simple content
+  theSchemas.resolve(SchemaSet::COMPLEX_TYPE_COMPONENT, aType);
+  size_t lScope = theScope.size();
+  XmlNode lElement;
+  typedContent(aType, lElement);
+  theScope.resize(lScope);
+  for (size_t i = 0; i < lElement.theChildren.size(); ++i)
+    if (lElement.theChildren[i].theKind == XmlNode::TEXT_NODE)
+      return lElement.theChildren[i].theLocalName;
+  return "";
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_NATIVE_XSD2INST_H
+#define ZORBA_SCHEMATOOLS_NATIVE_XSD2INST_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <zorba/item.h>
+
+#include "node_builder.h"
+#include "schema_model.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Sample instances for the global elements of a SchemaSet, without a JVM.
+ *
+ * Follows XMLBeans' SampleXmlUtil: one occurrence of every particle, a
+ * comment before optional, repeated, choice and all particles, every
+ * attribute, and the same sample values for the built-in types. Values
+ * that XMLBeans picks at random or from the clock (booleans, dates,
+ * enumerations) are fixed here, so the samples are reproducible.
+ *
+ * Given a random number generator, it generates varied instances instead,
+ * as xsd2inst-generate does: optional and repeated particles occur a random
+ * number of times within their bounds, a choice takes one random branch,
+ * optional attributes are left out at random, and simple values are random
+ * values of their types and enumerations. There are no comments then.
+ */
+class SampleGenerator
+{
+  private:
+    const SchemaSet& theSchemas;
+    // null for the XMLBeans samples
+    std::mt19937_64* theRandom;
+    // ID values given out in the current instance
+    unsigned long theIds;
+    // named types and global elements being expanded, against recursion
+    std::vector<std::string> theStack;
+    // namespace bindings in scope
+    std::vector<XmlNode::Binding> theScope;
+
+  public:
+    SampleGenerator(const SchemaSet& aSchemas, std::mt19937_64* aRandom = 0);
+
+    // sample for the first global element with local name aRootName,
+    // throws a SchemaException if there is none
+    XmlNode sample(const std::string& aRootName);
+
+    // sample for the global element aName
+    XmlNode sample(const QNameKey& aName);
+
+    // sample value of the XML Schema built-in type aLocalName
+    static std::string builtinValue(const std::string& aLocalName);
+
+  private:
+    void element(const Item& aDecl, const SchemaDocInfo& aDoc, bool aGlobal,
+        XmlNode& aParent);
+
+    void typedContent(const QNameKey& aType, XmlNode& aElement);
+
+    void complexContent(const Item& aType, const SchemaDocInfo& aDoc,
+        XmlNode& aElement);
+
+    void particle(const Item& aParticle, const SchemaDocInfo& aDoc,
+        XmlNode& aElement);
+
+    void attribute(const Item& aDecl, const SchemaDocInfo& aDoc, XmlNode& aElement);
+
+    void attributeGroup(const Item& aGroup, const SchemaDocInfo& aDoc,
+        XmlNode& aElement);
+
+    std::string simpleValue(const Item& aSimpleType);
+
+    std::string typeValue(const QNameKey& aType);
+
+    // builtinValue, or a random value of the type if varied
+    std::string sampleValue(const std::string& aLocalName);
+
+    // a random value of the XML Schema built-in type aLocalName
+    std::string randomValue(const std::string& aLocalName);
+
+    // value of an enumeration facet of aRestriction, the first one or a
+    // random one if varied
+    bool enumeration(const Item& aRestriction, std::string& aValue);
+
+    // uniform in [aMin, aMax]
+    long long randomIn(long long aMin, long long aMax);
+
+    std::string randomWord();
+
+    // times a particle with these bounds occurs, aMax -1 for unbounded
+    long occurrences(long aMin, long aMax);
+
+    std::string prefixFor(const std::string& aNamespace, XmlNode& aOwner);
+
+    bool push(const std::string& aKey);
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_NATIVE_XSD2INST_H
+/* vim:set et sw=2 ts=2: */
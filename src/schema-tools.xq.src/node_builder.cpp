@@ -0,0 +1,195 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+#include <cstring>
+
+#include "node_builder.h"
+
+#define XML_SCHEMA_NAMESPACE "http://www.w3.org/2001/XMLSchema"
+
+namespace zorba
+{
+namespace schematools
+{
+
+std::string suggestPrefix(const std::string& aNamespace)
+{
+  // last segment of the URI, leading alphanumerics, three or four letters
+  size_t lEnd = aNamespace.size();
+  size_t lBegin = aNamespace.rfind('/');
+  if (lBegin != std::string::npos && lBegin > 0 && lBegin == lEnd - 1)
+  {
+    lEnd = lBegin;
+    lBegin = aNamespace.rfind('/', lBegin - 1);
+  }
+  lBegin = (lBegin == std::string::npos ? 0 : lBegin + 1);
+  if (aNamespace.compare(lBegin, 4, "www.") == 0)
+    lBegin += 4;
+  while (lBegin < lEnd && !isalpha((unsigned char)aNamespace[lBegin]) &&
+         aNamespace[lBegin] != '_')
+    ++lBegin;
+  for (size_t i = lBegin + 1; i < lEnd; ++i)
+  {
+    if (!isalnum((unsigned char)aNamespace[i]))
+    {
+      lEnd = i;
+      break;
+    }
+  }
+  if (lEnd - lBegin > 4)
+  {
+    const char* lVowels = "aeiouAEIOU";
+    if (strchr(lVowels, aNamespace[lBegin + 2]) &&
+        !strchr(lVowels, aNamespace[lBegin + 3]))
+      lEnd = lBegin + 4;
+    else
+      lEnd = lBegin + 3;
+  }
+
+  std::string lPrefix;
+  for (size_t i = lBegin; i < lEnd; ++i)
+    lPrefix += (char)tolower((unsigned char)aNamespace[i]);
+  if (lPrefix.empty() || lPrefix == "xs" || lPrefix.compare(0, 3, "xml") == 0)
+    return "ns";
+  return lPrefix;
+}
+
+
+void XmlNode::toString(std::string& aOut) const
+{
+  switch (theKind)
+  {
+  case TEXT_NODE:
+    aOut += theLocalName;
+    return;
+  case COMMENT_NODE:
+    aOut += "<!--";
+    aOut += theLocalName;
+    aOut += "-->";
+    return;
+  }
+
+  aOut += "<{";
+  aOut += theNamespace;
+  aOut += "}";
+  aOut += theLocalName;
+  for (size_t i = 0; i < theAttributes.size(); ++i)
+  {
+    aOut += " ";
+    aOut += theAttributes[i].first;
+    aOut += "=\"";
+    aOut += theAttributes[i].second;
+    aOut += "\"";
+  }
+  for (size_t i = 0; i < theQAttributes.size(); ++i)
+  {
+    aOut += " {";
+    aOut += theQAttributes[i][0];
+    aOut += "}";
+    aOut += theQAttributes[i][2];
+    aOut += "=\"";
+    aOut += theQAttributes[i][3];
+    aOut += "\"";
+  }
+  aOut += ">";
+  for (size_t i = 0; i < theChildren.size(); ++i)
+    theChildren[i].toString(aOut);
+  aOut += "</>";
+}
+
+
+
+NodeBuilder::NodeBuilder(ItemFactory* aFactory, bool aIndent) :
+  theFactory(aFactory),
+  theIndent(aIndent)
+{
+  theUntypedType = theFactory->createQName(XML_SCHEMA_NAMESPACE, "untyped");
+  theUntypedAtomicType = theFactory->createQName(XML_SCHEMA_NAMESPACE, "untypedAtomic");
+}
+
+
+Item NodeBuilder::buildDocument(const XmlNode& aRoot)
+{
+  Item lDoc = theFactory->createDocumentNode("", "");
+  build(lDoc, aRoot, 0);
+  return lDoc;
+}
+
+
+void NodeBuilder::build(Item& aParent, const XmlNode& aNode, int aDepth)
+{
+  if (aNode.theKind == XmlNode::TEXT_NODE)
+  {
+    theFactory->createTextNode(aParent, aNode.theLocalName);
+    return;
+  }
+  if (aNode.theKind == XmlNode::COMMENT_NODE)
+  {
+    String lContent(aNode.theLocalName);
+    theFactory->createCommentNode(aParent, lContent);
+    return;
+  }
+
+  NsBindings lBindings;
+  for (size_t i = 0; i < aNode.theBindings.size(); ++i)
+    lBindings.push_back(std::make_pair(String(aNode.theBindings[i].first),
+                                       String(aNode.theBindings[i].second)));
+
+  Item lName = theFactory->createQName(aNode.theNamespace, aNode.thePrefix,
+      aNode.theLocalName);
+  Item lElem = theFactory->createElementNode(aParent, lName, theUntypedType,
+      false, false, lBindings);
+
+  for (size_t i = 0; i < aNode.theAttributes.size(); ++i)
+  {
+    theFactory->createAttributeNode(lElem,
+        theFactory->createQName("", aNode.theAttributes[i].first),
+        theUntypedAtomicType,
+        theFactory->createUntypedAtomic(aNode.theAttributes[i].second));
+  }
+  for (size_t i = 0; i < aNode.theQAttributes.size(); ++i)
+  {
+    const std::vector<std::string>& lAttr = aNode.theQAttributes[i];
+    theFactory->createAttributeNode(lElem,
+        theFactory->createQName(lAttr[0], lAttr[1], lAttr[2]),
+        theUntypedAtomicType,
+        theFactory->createUntypedAtomic(lAttr[3]));
+  }
+
+  // indent element-only content only, text is significant in mixed content
+  bool lIndent = theIndent && !aNode.theChildren.empty();
+  for (size_t i = 0; lIndent && i < aNode.theChildren.size(); ++i)
+    if (aNode.theChildren[i].theKind == XmlNode::TEXT_NODE)
+      lIndent = false;
+
+  std::string lChildIndent;
+  if (lIndent)
+    lChildIndent = "\n" + std::string(2 * (aDepth + 1), ' ');
+
+  for (size_t i = 0; i < aNode.theChildren.size(); ++i)
+  {
+    if (lIndent)
+      theFactory->createTextNode(lElem, lChildIndent);
+    build(lElem, aNode.theChildren[i], aDepth + 1);
+  }
+
+  if (lIndent)
+    theFactory->createTextNode(lElem, "\n" + std::string(2 * aDepth, ' '));
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
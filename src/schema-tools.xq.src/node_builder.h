@@ -0,0 +1,142 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_NODE_BUILDER_H
+#define ZORBA_SCHEMATOOLS_NODE_BUILDER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zorba/item.h>
+#include <zorba/item_factory.h>
+
+namespace zorba
+{
+namespace schematools
+{
+
+// namespace URI and local name
+typedef std::pair<std::string, std::string> QNameKey;
+
+// the prefix XMLBeans derives from a namespace URI, e.g. "sch" for
+// ".../modules/schema-tools"
+std::string suggestPrefix(const std::string& aNamespace);
+
+/**
+ * Minimal XML tree the native engines produce before it is turned into
+ * store nodes.
+ */
+class XmlNode
+{
+  public:
+    typedef enum
+    {
+      ELEMENT_NODE = 1,
+      TEXT_NODE = 2,
+      COMMENT_NODE = 3,
+    } kind_t;
+
+    typedef std::pair<std::string, std::string> Binding;
+
+  public:
+    int theKind;
+    std::string theNamespace;
+    std::string thePrefix;
+    // local name of an element, content of a text or comment node
+    std::string theLocalName;
+
+    // unqualified attributes, in order
+    std::vector<std::pair<std::string, std::string> > theAttributes;
+    // qualified attributes: namespace, prefix, local name and value
+    std::vector<std::vector<std::string> > theQAttributes;
+    // namespace declarations (prefix, uri) of this element
+    std::vector<Binding> theBindings;
+
+    std::vector<XmlNode> theChildren;
+
+  public:
+    XmlNode() : theKind(ELEMENT_NODE)
+    {}
+
+    XmlNode(const std::string& aNamespace, const std::string& aPrefix,
+        const std::string& aLocalName) :
+      theKind(ELEMENT_NODE),
+      theNamespace(aNamespace),
+      thePrefix(aPrefix),
+      theLocalName(aLocalName)
+    {}
+
+    static XmlNode text(const std::string& aContent)
+    {
+      XmlNode lNode;
+      lNode.theKind = TEXT_NODE;
+      lNode.theLocalName = aContent;
+      return lNode;
+    }
+
+    static XmlNode comment(const std::string& aContent)
+    {
+      XmlNode lNode;
+      lNode.theKind = COMMENT_NODE;
+      lNode.theLocalName = aContent;
+      return lNode;
+    }
+
+    XmlNode& attr(const std::string& aName, const std::string& aValue)
+    {
+      theAttributes.push_back(std::make_pair(aName, aValue));
+      return *this;
+    }
+
+    XmlNode& append(const XmlNode& aChild)
+    {
+      theChildren.push_back(aChild);
+      return theChildren.back();
+    }
+
+    // appends the canonical form of this node, used to compare definitions
+    void toString(std::string& aOut) const;
+};
+
+
+/**
+ * Creates document nodes from XmlNode trees through the ItemFactory.
+ *
+ * With indentation on, elements with element-only content get the same
+ * whitespace text nodes XMLBeans' pretty printer writes, so the result
+ * serializes like the text the JVM path parses.
+ */
+class NodeBuilder
+{
+  private:
+    ItemFactory* theFactory;
+    bool theIndent;
+    Item theUntypedType;
+    Item theUntypedAtomicType;
+
+  public:
+    NodeBuilder(ItemFactory* aFactory, bool aIndent);
+
+    Item buildDocument(const XmlNode& aRoot);
+
+  private:
+    void build(Item& aParent, const XmlNode& aNode, int aDepth);
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_NODE_BUILDER_H
+/* vim:set et sw=2 ts=2: */
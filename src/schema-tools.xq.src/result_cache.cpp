@@ -0,0 +1,322 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "result_cache.h"
+
+// the suffix of the result files in the directory
+#define RESULT_FILE_SUFFIX ".schemas"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+namespace zorba
+{
+namespace schematools
+{
+
+HashStreamBuf::HashStreamBuf() :
+  theHash(FNV_OFFSET_BASIS),
+  theSize(0)
+{
+  setp(theBuffer, theBuffer + sizeof(theBuffer));
+}
+
+
+uint64_t HashStreamBuf::getHash()
+{
+  sync();
+  return theHash;
+}
+
+
+uint64_t HashStreamBuf::getSize()
+{
+  sync();
+  return theSize;
+}
+
+
+void HashStreamBuf::update(const char* aData, size_t aSize)
+{
+  sync();
+  hash(aData, aSize);
+}
+
+
+void HashStreamBuf::hash(const char* aData, size_t aSize)
+{
+  uint64_t lHash = theHash;
+  for (size_t i = 0; i < aSize; ++i)
+  {
+    lHash ^= (unsigned char)aData[i];
+    lHash *= FNV_PRIME;
+  }
+  theHash = lHash;
+  theSize += aSize;
+}
+
+
+HashStreamBuf::int_type HashStreamBuf::overflow(int_type aChar)
+{
+  sync();
+  if (!traits_type::eq_int_type(aChar, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(aChar);
+    pbump(1);
+  }
+  return traits_type::not_eof(aChar);
+}
+
+
+int HashStreamBuf::sync()
+{
+  hash(pbase(), pptr() - pbase());
+  setp(theBuffer, theBuffer + sizeof(theBuffer));
+  return 0;
+}
+
+
+
+ResultCache::ResultCache() :
+  theCapacity(DEFAULT_RESULT_CACHE_SIZE),
+  theDirectoryBytes(DEFAULT_RESULT_CACHE_DIR_SIZE_MB * 1024ULL * 1024)
+{
+  const char* lSize = getenv(SCHEMATOOLS_RESULT_CACHE_SIZE_ENV);
+  if (lSize && *lSize)
+    theCapacity = strtoul(lSize, NULL, 10);
+
+  const char* lDirectory = getenv(SCHEMATOOLS_RESULT_CACHE_DIR_ENV);
+  if (lDirectory)
+    theDirectory = lDirectory;
+
+  const char* lDirectorySize = getenv(SCHEMATOOLS_RESULT_CACHE_DIR_SIZE_ENV);
+  if (lDirectorySize && *lDirectorySize)
+    theDirectoryBytes = strtoull(lDirectorySize, NULL, 10) * 1024 * 1024;
+}
+
+
+ResultCache& ResultCache::getInstance()
+{
+  static ResultCache lInstance;
+  return lInstance;
+}
+
+
+ResultCache::Schemas_t ResultCache::find(const std::string& aKey)
+{
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    std::unordered_map<std::string, Entries::iterator>::iterator lEntry =
+        theIndex.find(aKey);
+    if (lEntry != theIndex.end())
+    {
+      theEntries.splice(theEntries.begin(), theEntries, lEntry->second);
+      return lEntry->second->second;
+    }
+  }
+
+  // the file is read without the lock, calls for other keys go on
+  Schemas_t lSchemas = load(aKey);
+  if (lSchemas)
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    remember(aKey, lSchemas);
+  }
+  return lSchemas;
+}
+
+
+void ResultCache::put(const std::string& aKey, const Schemas_t& aSchemas)
+{
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    remember(aKey, aSchemas);
+  }
+  store(aKey, aSchemas);
+}
+
+
+void ResultCache::remember(const std::string& aKey, const Schemas_t& aSchemas)
+{
+  if (theCapacity == 0)
+    return;
+
+  std::unordered_map<std::string, Entries::iterator>::iterator lEntry =
+      theIndex.find(aKey);
+  if (lEntry != theIndex.end())
+  {
+    lEntry->second->second = aSchemas;
+    theEntries.splice(theEntries.begin(), theEntries, lEntry->second);
+    return;
+  }
+
+  theEntries.push_front(std::make_pair(aKey, aSchemas));
+  theIndex[aKey] = theEntries.begin();
+  if (theEntries.size() > theCapacity)
+  {
+    theIndex.erase(theEntries.back().first);
+    theEntries.pop_back();
+  }
+}
+
+
+std::string ResultCache::pathFor(const std::string& aKey) const
+{
+  return theDirectory + "/" + aKey + RESULT_FILE_SUFFIX;
+}
+
+
+ResultCache::Schemas_t ResultCache::load(const std::string& aKey) const
+{
+  if (theDirectory.empty())
+    return Schemas_t();
+
+  // the number of schemas, then each one as its length in bytes, a
+  // newline and the text
+  std::string lPath = pathFor(aKey);
+  std::ifstream lIn(lPath.c_str(), std::ios::in | std::ios::binary);
+  if (!lIn.seekg(0, std::ios::end))
+    return Schemas_t();
+  uint64_t lFileSize = lIn.tellg();
+  lIn.seekg(0, std::ios::beg);
+
+  // a corrupt file can not ask for more than it holds: every schema takes
+  // at least its length and a newline
+  size_t lCount;
+  if (!(lIn >> lCount) || lCount > lFileSize / 2)
+    return Schemas_t();
+
+  std::shared_ptr<std::vector<std::string> > lSchemas(
+      new std::vector<std::string>(lCount));
+  for (size_t i = 0; i < lCount; ++i)
+  {
+    size_t lSize;
+    if (!(lIn >> lSize) || lIn.get() != '\n' || lSize > lFileSize)
+      return Schemas_t();
+    std::string& lSchema = (*lSchemas)[i];
+    lSchema.resize(lSize);
+    if (lSize > 0 && !lIn.read(&lSchema[0], lSize))
+      return Schemas_t();
+  }
+
+#ifndef WIN32
+  // the most recently used files are kept
+  utime(lPath.c_str(), NULL);
+#endif
+  return lSchemas;
+}
+
+
+void ResultCache::store(const std::string& aKey, const Schemas_t& aSchemas) const
+{
+  if (theDirectory.empty())
+    return;
+
+  // written to a file of its own and renamed, so a reader never sees a
+  // partial result
+  // processes sharing the directory, and threads of one, never write to
+  // the same file
+  static std::atomic<unsigned long> lTemporaries(0);
+  std::ostringstream lTemporary;
+  lTemporary << pathFor(aKey) << ".tmp" << getpid() << "-"
+             << std::hash<std::thread::id>()(std::this_thread::get_id()) << "-"
+             << lTemporaries++;
+
+  {
+    std::ofstream lOut(lTemporary.str().c_str(),
+        std::ios::out | std::ios::binary | std::ios::trunc);
+    lOut << aSchemas->size() << "\n";
+    for (size_t i = 0; i < aSchemas->size(); ++i)
+      lOut << (*aSchemas)[i].size() << "\n" << (*aSchemas)[i];
+    if (!lOut.flush())
+    {
+      lOut.close();
+      std::remove(lTemporary.str().c_str());
+      return;
+    }
+  }
+
+  if (std::rename(lTemporary.str().c_str(), pathFor(aKey).c_str()) != 0)
+  {
+    std::remove(lTemporary.str().c_str());
+    return;
+  }
+  evict(pathFor(aKey));
+}
+
+
+void ResultCache::evict(const std::string& aKeep) const
+{
+#ifndef WIN32
+  DIR* lDir = opendir(theDirectory.c_str());
+  if (!lDir)
+    return;
+
+  // the result files by last use, with their sizes
+  std::vector<std::pair<time_t, std::pair<std::string, uint64_t> > > lFiles;
+  uint64_t lTotal = 0;
+  std::string lSuffix(RESULT_FILE_SUFFIX);
+  while (struct dirent* lEntry = readdir(lDir))
+  {
+    std::string lName(lEntry->d_name);
+    if (lName.size() <= lSuffix.size() ||
+        lName.compare(lName.size() - lSuffix.size(), lSuffix.size(), lSuffix) != 0)
+      continue;
+    std::string lPath = theDirectory + "/" + lName;
+    struct stat lStat;
+    if (stat(lPath.c_str(), &lStat) != 0 || !S_ISREG(lStat.st_mode))
+      continue;
+    lFiles.push_back(std::make_pair(lStat.st_mtime,
+        std::make_pair(lPath, (uint64_t)lStat.st_size)));
+    lTotal += lStat.st_size;
+  }
+  closedir(lDir);
+  if (lTotal <= theDirectoryBytes)
+    return;
+
+  std::sort(lFiles.begin(), lFiles.end());
+  for (size_t i = 0; i < lFiles.size() && lTotal > theDirectoryBytes; ++i)
+  {
+    if (lFiles[i].second.first == aKeep)
+      continue;
+    // another process may have deleted it already
+    if (std::remove(lFiles[i].second.first.c_str()) == 0)
+      lTotal -= lFiles[i].second.second;
+  }
+#endif
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
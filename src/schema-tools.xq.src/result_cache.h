@@ -0,0 +1,136 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_RESULT_CACHE_H
+#define ZORBA_SCHEMATOOLS_RESULT_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+// environment variable with the number of results kept in memory
+#define SCHEMATOOLS_RESULT_CACHE_SIZE_ENV "ZORBA_SCHEMATOOLS_RESULT_CACHE_SIZE"
+
+// environment variable with the directory results are persisted in
+#define SCHEMATOOLS_RESULT_CACHE_DIR_ENV "ZORBA_SCHEMATOOLS_RESULT_CACHE_DIR"
+
+// environment variable with the megabytes the results in the directory
+// may take; the least recently used ones are deleted beyond
+#define SCHEMATOOLS_RESULT_CACHE_DIR_SIZE_ENV "ZORBA_SCHEMATOOLS_RESULT_CACHE_DIR_SIZE"
+
+#define DEFAULT_RESULT_CACHE_SIZE 16
+
+#define DEFAULT_RESULT_CACHE_DIR_SIZE_MB 256
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * 64-bit FNV-1a hash of the bytes written to it.
+ */
+class HashStreamBuf : public std::streambuf
+{
+  private:
+    uint64_t theHash;
+    uint64_t theSize;
+    char theBuffer[4096];
+
+  public:
+    HashStreamBuf();
+
+    // the hash of all bytes written so far
+    uint64_t getHash();
+
+    uint64_t getSize();
+
+    // hashes aSize bytes that are not part of the stream, e.g. a separator
+    void update(const char* aData, size_t aSize);
+
+  protected:
+    virtual int_type overflow(int_type aChar);
+
+    virtual int sync();
+
+  private:
+    void hash(const char* aData, size_t aSize);
+};
+
+
+/**
+ * Schemas inferred by inst2xsd, keyed by a hash of the serialized
+ * instances and the options, so that a call for the same instances does
+ * not infer them again.
+ *
+ * The SCHEMATOOLS_RESULT_CACHE_SIZE_ENV most recently used results are kept
+ * in memory. If SCHEMATOOLS_RESULT_CACHE_DIR_ENV names a directory, every
+ * result is also written there, one file per key, and read from there when
+ * it is not in memory. The files are bounded by the total size
+ * SCHEMATOOLS_RESULT_CACHE_DIR_SIZE_ENV gives: reading a file marks it as
+ * used, and writing one deletes the least recently used files beyond that
+ * size (not on Windows, where the directory is not bounded).
+ */
+class ResultCache
+{
+  public:
+    typedef std::shared_ptr<const std::vector<std::string> > Schemas_t;
+
+  private:
+    typedef std::list<std::pair<std::string, Schemas_t> > Entries;
+
+    std::mutex theMutex;
+    size_t theCapacity;
+    std::string theDirectory;
+    uint64_t theDirectoryBytes;
+    // most recently used first
+    Entries theEntries;
+    std::unordered_map<std::string, Entries::iterator> theIndex;
+
+    ResultCache();
+
+  public:
+    static ResultCache& getInstance();
+
+    // null if there is no result for aKey
+    Schemas_t find(const std::string& aKey);
+
+    void put(const std::string& aKey, const Schemas_t& aSchemas);
+
+  private:
+    // keeps aSchemas in memory, dropping the least recently used
+    void remember(const std::string& aKey, const Schemas_t& aSchemas);
+
+    std::string pathFor(const std::string& aKey) const;
+
+    Schemas_t load(const std::string& aKey) const;
+
+    void store(const std::string& aKey, const Schemas_t& aSchemas) const;
+
+    // deletes the least recently used files other than aKeep while they
+    // take more than theDirectoryBytes
+    void evict(const std::string& aKeep) const;
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_RESULT_CACHE_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zorba/user_exception.h>
+
+#include "event_stream.h"
+#include "native_xsd2inst.h"
+#include "sample_sequence.h"
+#include "schema-tools.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+JavaSampleSequence::JavaSampleSequence(zorba::jvm::JavaVMSingleton* aJvm,
+                                       const JniCache& aCache,
+                                       jobject aBatch,
+                                       ItemFactory* aFactory,
+                                       const CallStats_t& aStats) :
+  theJvm(aJvm),
+  theCache(aCache),
+  theFactory(aFactory),
+  theStats(aStats)
+{
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+  theBatch = env->NewGlobalRef(aBatch);
+  env->DeleteLocalRef(aBatch);
+}
+
+
+JavaSampleSequence::~JavaSampleSequence()
+{
+  try
+  {
+    currentThreadEnv(theJvm->getVM())->DeleteGlobalRef(theBatch);
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    // this thread can not be attached, the batch is left to the VM
+  }
+}
+
+
+void JavaSampleSequence::JavaSampleIterator::open()
+{
+  JNIEnv* env = currentThreadEnv(theSequence->theJvm->getVM());
+  jthrowable lException = 0;
+  LocalFrame lFrame;
+  try
+  {
+    lFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+    env->CallVoidMethod(theSequence->theBatch,
+        theSequence->theCache.theSampleBatchReset);
+    CHECK_EXCEPTION(env);
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theSequence->theFactory);
+  }
+  theIsOpen = true;
+}
+
+
+bool JavaSampleSequence::JavaSampleIterator::next(Item& aItem)
+{
+  JNIEnv* env = currentThreadEnv(theSequence->theJvm->getVM());
+  const JniCache& lCache = theSequence->theCache;
+  CallStats* lStats = theSequence->theStats.get();
+  jthrowable lException = 0;
+  LocalFrame lFrame;
+  try
+  {
+    lFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+    jboolean lHasNext = env->CallBooleanMethod(theSequence->theBatch,
+        lCache.theSampleBatchHasNext);
+    CHECK_EXCEPTION(env);
+    if (!lHasNext)
+      return false;
+
+    // the sample is generated by this call
+    jbyteArray lEvents = (jbyteArray)env->CallObjectMethod(theSequence->theBatch,
+        lCache.theSampleBatchNextEvents);
+    CHECK_EXCEPTION(env);
+    lStats->takeJavaTimes(env, lCache, lException);
+
+    aItem = buildEventDocument(env, lEvents, theSequence->theFactory, lStats,
+        lException);
+    return true;
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theSequence->theFactory);
+  }
+  return false;
+}
+
+
+bool NativeSampleSequence::NativeSampleIterator::next(Item& aItem)
+{
+  if (theNext >= theSequence->theRoots.size())
+    return false;
+
+  try
+  {
+    CallStats* lStats = theSequence->theStats.get();
+    PhaseTimer lGenerate(lStats, GENERATE_PHASE);
+    SampleGenerator lGenerator(*theSequence->theSchemas);
+    XmlNode lSample = lGenerator.sample(theSequence->theRoots[theNext++]);
+    lGenerate.stop();
+
+    PhaseTimer lResult(lStats, RESULT_PHASE);
+    NodeBuilder lBuilder(theSequence->theFactory, true);
+    aItem = lBuilder.buildDocument(lSample);
+    lStats->count(DOCUMENTS_COUNTER);
+    return true;
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theSequence->theFactory->createQName(
+        SCHEMATOOLS_MODULE_NAMESPACE, "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
+
+
+
+bool GeneratedSampleSequence::GeneratedSampleIterator::next(Item& aItem)
+{
+  if (theNext >= theSequence->theCount)
+    return false;
+  ++theNext;
+
+  try
+  {
+    CallStats* lStats = theSequence->theStats.get();
+    PhaseTimer lGenerate(lStats, GENERATE_PHASE);
+    SampleGenerator lGenerator(*theSequence->theSchemas, &theRandom);
+    XmlNode lSample = lGenerator.sample(theSequence->theRoot);
+    lGenerate.stop();
+
+    PhaseTimer lResult(lStats, RESULT_PHASE);
+    NodeBuilder lBuilder(theSequence->theFactory, false);
+    aItem = lBuilder.buildDocument(lSample);
+    lStats->count(DOCUMENTS_COUNTER);
+    return true;
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theSequence->theFactory->createQName(
+        SCHEMATOOLS_MODULE_NAMESPACE, "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
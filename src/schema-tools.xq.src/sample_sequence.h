@@ -0,0 +1,212 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_SAMPLE_SEQUENCE_H
+#define ZORBA_SCHEMATOOLS_SAMPLE_SEQUENCE_H
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <zorba/item_factory.h>
+#include <zorba/item_sequence.h>
+#include <zorba/iterator.h>
+
+#include "JavaVMSingleton.h"
+
+#include "jni_cache.h"
+#include "schema_model.h"
+#include "stats.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * The samples of an Xsd2InstHelper.SampleBatch. The schemas are compiled
+ * once by xsd2instAll; each sample is only generated and parsed when the
+ * iterator gets to it.
+ */
+class JavaSampleSequence : public ItemSequence
+{
+  private:
+    class JavaSampleIterator : public Iterator
+    {
+      private:
+        JavaSampleSequence* theSequence;
+        bool theIsOpen;
+
+      public:
+        JavaSampleIterator(JavaSampleSequence* aSequence) :
+          theSequence(aSequence),
+          theIsOpen(false)
+        {}
+
+        virtual void open();
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    zorba::jvm::JavaVMSingleton* theJvm;
+    const JniCache& theCache;
+    // global reference to the SampleBatch
+    jobject theBatch;
+    ItemFactory* theFactory;
+    CallStats_t theStats;
+
+  public:
+    // aBatch is a local reference, the sequence keeps a global one
+    JavaSampleSequence(zorba::jvm::JavaVMSingleton* aJvm, const JniCache& aCache,
+        jobject aBatch, ItemFactory* aFactory, const CallStats_t& aStats);
+
+    virtual ~JavaSampleSequence();
+
+    virtual Iterator_t getIterator()
+    { return new JavaSampleIterator(this); }
+};
+
+
+/**
+ * Samples of the native engine, one per root element, generated when the
+ * iterator gets to them.
+ */
+class NativeSampleSequence : public ItemSequence
+{
+  private:
+    class NativeSampleIterator : public Iterator
+    {
+      private:
+        NativeSampleSequence* theSequence;
+        size_t theNext;
+        bool theIsOpen;
+
+      public:
+        NativeSampleIterator(NativeSampleSequence* aSequence) :
+          theSequence(aSequence),
+          theNext(0),
+          theIsOpen(false)
+        {}
+
+        virtual void open()
+        {
+          theNext = 0;
+          theIsOpen = true;
+        }
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    std::unique_ptr<SchemaSet> theSchemas;
+    std::vector<QNameKey> theRoots;
+    ItemFactory* theFactory;
+    CallStats_t theStats;
+
+  public:
+    NativeSampleSequence(std::unique_ptr<SchemaSet> aSchemas,
+        const std::vector<QNameKey>& aRoots, ItemFactory* aFactory,
+        const CallStats_t& aStats) :
+      theSchemas(std::move(aSchemas)),
+      theRoots(aRoots),
+      theFactory(aFactory),
+      theStats(aStats)
+    {}
+
+    virtual Iterator_t getIterator()
+    { return new NativeSampleIterator(this); }
+};
+
+
+/**
+ * Varied instances of one root element, as many as asked for, generated
+ * when the iterator gets to them. Every iteration starts over from the
+ * seed, so it returns the same instances.
+ */
+class GeneratedSampleSequence : public ItemSequence
+{
+  private:
+    class GeneratedSampleIterator : public Iterator
+    {
+      private:
+        GeneratedSampleSequence* theSequence;
+        std::mt19937_64 theRandom;
+        uint64_t theNext;
+        bool theIsOpen;
+
+      public:
+        GeneratedSampleIterator(GeneratedSampleSequence* aSequence) :
+          theSequence(aSequence),
+          theNext(0),
+          theIsOpen(false)
+        {}
+
+        virtual void open()
+        {
+          theRandom.seed(theSequence->theSeed);
+          theNext = 0;
+          theIsOpen = true;
+        }
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    std::unique_ptr<SchemaSet> theSchemas;
+    QNameKey theRoot;
+    uint64_t theCount;
+    uint64_t theSeed;
+    ItemFactory* theFactory;
+    CallStats_t theStats;
+
+  public:
+    GeneratedSampleSequence(std::unique_ptr<SchemaSet> aSchemas,
+        const QNameKey& aRoot, uint64_t aCount, uint64_t aSeed,
+        ItemFactory* aFactory, const CallStats_t& aStats) :
+      theSchemas(std::move(aSchemas)),
+      theRoot(aRoot),
+      theCount(aCount),
+      theSeed(aSeed),
+      theFactory(aFactory),
+      theStats(aStats)
+    {}
+
+    virtual Iterator_t getIterator()
+    { return new GeneratedSampleIterator(this); }
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_SAMPLE_SEQUENCE_H
+/* vim:set et sw=2 ts=2: */
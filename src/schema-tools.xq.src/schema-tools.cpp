@@ -15,9 +15,12 @@
  */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <sstream>
+#include <thread>
 
 #include <zorba/diagnostic_list.h>
 #include <zorba/empty_sequence.h>
@@ -26,6 +29,7 @@
 #include <zorba/item_factory.h>
 #include <zorba/serializer.h>
 #include <zorba/singleton_item_sequence.h>
+#include <zorba/static_context.h>
 #include <zorba/user_exception.h>
 #include <zorba/util/base64_util.h>
 #include <zorba/vector_item_sequence.h>
@@ -33,199 +37,461 @@
 
 #include "JavaVMSingleton.h"
 
-#define SCHEMATOOLS_MODULE_NAMESPACE "http://www.zorba-xquery.com/modules/schema-tools"
-#define SCHEMATOOLS_OPTIONS_NAMESPACE "http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options"
+#include "event_stream.h"
+#include "inst2xsd_session.h"
+#include "instance_files.h"
+#include "jni_string.h"
+#include "native_xsd2inst.h"
+#include "result_cache.h"
+#include "sample_sequence.h"
+#include "schema-tools.h"
+#include "schema_sequence.h"
+#include "worker_pool.h"
 
-class JavaException {
-};
-
-#define CHECK_EXCEPTION(env)  if ((lException = env->ExceptionOccurred())) throw JavaException()
+// inferences and samples the warm-up runs, see WarmUp.java
+#define WARMUP_ROUNDS 5
 
 namespace zorba
 {
 namespace schematools
 {
 
-class SchemaToolsModule;
-class Inst2xsdFunction;
-class Xsd2instFunction;
-class STOptions;
+void throwJavaException(JNIEnv* env, jthrowable aException, ItemFactory* aFactory)
+{
+  // the calls below need a clear exception state
+  env->ExceptionClear();
+
+  jclass stringWriterClass = env->FindClass("java/io/StringWriter");
+  jclass printWriterClass = env->FindClass("java/io/PrintWriter");
+  jclass throwableClass = env->FindClass("java/lang/Throwable");
+  jobject stringWriter = env->NewObject(
+      stringWriterClass,
+      env->GetMethodID(stringWriterClass, "<init>", "()V"));
+
+  jobject printWriter = env->NewObject(
+      printWriterClass,
+      env->GetMethodID(printWriterClass, "<init>", "(Ljava/io/Writer;)V"),
+      stringWriter);
+
+  env->CallObjectMethod(aException,
+      env->GetMethodID(throwableClass, "printStackTrace",
+          "(Ljava/io/PrintWriter;)V"),
+      printWriter);
+
+  jmethodID toStringMethod =
+    env->GetMethodID(stringWriterClass, "toString", "()Ljava/lang/String;");
+  jobject errorMessageObj = env->CallObjectMethod(
+      stringWriter, toStringMethod);
+  jstring errorMessage = (jstring) errorMessageObj;
+  std::string errMsg;
+  getJavaString(env, errorMessage, errMsg);
+  env->ExceptionClear();
+  std::stringstream s;
+  s << "A Java Exception was thrown:" << std::endl << errMsg;
+  std::string err("");
+  err += s.str();
+  env->ExceptionClear();
+  Item lQName = aFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+      "JAVA-EXCEPTION");
+  throw USER_EXCEPTION(lQName, err);
+}
 
 
-class Inst2xsdFunction : public ContextualExternalFunction
+// raises the schema-tools error of a failed worker request
+static void throwWorkerException(const WorkerException& e, ItemFactory* aFactory)
 {
-  private:
-    const ExternalModule* theModule;
-    ItemFactory* theFactory;
+  Item lQName = aFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE, e.theCode);
+  throw USER_EXCEPTION(lQName, e.theMessage);
+}
 
-  public:
-    Inst2xsdFunction(const ExternalModule* aModule) :
-      theModule(aModule),
-      theFactory(Zorba::getInstance(0)->getItemFactory())
-    {}
 
-    ~Inst2xsdFunction()
-    {}
+String CompileOptionsFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-  public:
-    virtual String getURI() const
-    { return theModule->getURI(); }
 
-    virtual String getLocalName() const
-    { return "inst2xsd-internal"; }
+String Inst2xsdFunction::getURI() const
+{
+  return theModule->getURI();
+}
+
 
-    virtual ItemSequence_t 
-    evaluate(const ExternalFunction::Arguments_t& args,
-             const zorba::StaticContext*,
-             const zorba::DynamicContext*) const;
-};
+String Inst2xsdFilesFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
 
-class Xsd2instFunction : public ContextualExternalFunction
+String Inst2xsdRefineFunction::getURI() const
 {
-  private:
-    const ExternalModule* theModule;
-    ItemFactory* theFactory;
+  return theModule->getURI();
+}
 
-  public:
-    Xsd2instFunction(const ExternalModule* aModule) :
-      theModule(aModule),
-      theFactory(Zorba::getInstance(0)->getItemFactory())
-    {}
 
-    ~Xsd2instFunction()
-    {}
+String Inst2xsdOpenFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-  public:
-    virtual String getURI() const
-    { return theModule->getURI(); }
 
-    virtual String getLocalName() const
-    { return "xsd2inst-internal"; }
+String Inst2xsdAddFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-    virtual ItemSequence_t
-      evaluate(const ExternalFunction::Arguments_t& args,
-               const zorba::StaticContext*,
-               const zorba::DynamicContext*) const;
-};
 
+String Inst2xsdCloseFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-class SchemaToolsModule : public ExternalModule {
-  private:
-    ExternalFunction* inst2xsd;
-    ExternalFunction* xsd2inst;
 
-  public:
-    SchemaToolsModule() :
-      inst2xsd(new Inst2xsdFunction(this)),
-      xsd2inst(new Xsd2instFunction(this))
-    {}
+String Xsd2instFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-    ~SchemaToolsModule()
-    {
-      delete inst2xsd;
-      delete xsd2inst;
-    }
 
-    virtual String getURI() const
-    { return SCHEMATOOLS_MODULE_NAMESPACE; }
+String Xsd2instAllFunction::getURI() const
+{
+  return theModule->getURI();
+}
 
-    virtual ExternalFunction* getExternalFunction(const String& localName);
 
-    virtual void destroy()
+String Xsd2instGenerateFunction::getURI() const
+{
+  return theModule->getURI();
+}
+
+
+String StatsFunction::getURI() const
+{
+  return theModule->getURI();
+}
+
+
+// the lock of the VM start, which JavaVMSingleton does not guard against
+// concurrent callers; the VM is one per process, and so is the lock,
+// whatever module instance or warm-up starts it
+static std::mutex& jvmMutex()
+{
+  static std::mutex lMutex;
+  return lMutex;
+}
+
+
+// whether SCHEMATOOLS_WARMUP_ENV asks for the warm-up and it did not start
+// yet in this process; it is then taken to start. Called with jvmMutex().
+static bool claimWarmUp()
+{
+  static bool lClaimed = false;
+  const char* lValue = getenv(SCHEMATOOLS_WARMUP_ENV);
+  if (lClaimed || !lValue || strcmp(lValue, "1") != 0)
+    return false;
+  lClaimed = true;
+  return true;
+}
+
+
+// runs the Java WarmUp in aVM
+static void warmUp(JavaVM* aVM)
+{
+  try
+  {
+    JNIEnv* env = currentThreadEnv(aVM);
+    jclass lClass = env->FindClass("org/zorbaxquery/modules/schemaTools/WarmUp");
+    jmethodID lRun = lClass ?
+        env->GetStaticMethodID(lClass, "run", "(I)V") : 0;
+    if (lRun)
+      env->CallStaticVoidMethod(lClass, lRun, (jint)WARMUP_ROUNDS);
+    if (env->ExceptionCheck())
     {
-      delete this;
+      std::cerr << "schema-tools: the warm-up failed:" << std::endl;
+      env->ExceptionDescribe();
     }
-};
+    if (lClass)
+      env->DeleteLocalRef(lClass);
+  }
+  catch (...)
+  {
+    std::cerr << "schema-tools: the warm-up could not attach to the Java VM"
+              << std::endl;
+  }
+}
 
 
-class STOptions
+// starts the workers, or else the VM with aClassPath, unless a call
+// started it meanwhile, and runs the Java WarmUp in it
+static void warmUpModule(const std::string& aClassPath)
 {
-public:
-  typedef enum
+  if (WorkerPool::getInstance().isEnabled())
   {
-    RUSSIAN_DOLL_DESIGN = 1,
-    SALAMI_SLICE_DESIGN = 2,
-    VENETIAN_BLIND_DESIGN = 3,
-  } design_t;
+    try
+    {
+      WorkerPool::getInstance().startWorkers();
+    }
+    catch (WorkerException& e)
+    {
+      std::cerr << "schema-tools: the warm-up could not start the workers: "
+                << e.theMessage << std::endl;
+    }
+    return;
+  }
 
-  typedef enum
+  zorba::jvm::JavaVMSingleton* lJvm = 0;
+  try
   {
-    SMART_TYPES = 1,
-    ALWAYS_STRING_TYPES = 2,
-  } simple_content_types_t;
+    std::lock_guard<std::mutex> lLock(jvmMutex());
+    lJvm = zorba::jvm::JavaVMSingleton::getInstance(aClassPath.c_str(), "");
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    std::cerr << "schema-tools: the warm-up could not start the Java VM "
+              << "with the classpath " << aClassPath << std::endl;
+    return;
+  }
+  warmUp(lJvm->getVM());
+}
+
 
+void SchemaToolsModule::startWarmUp()
+{
+  std::string lClassPath;
+  const char* lValue = getenv(SCHEMATOOLS_WARMUP_CLASSPATH_ENV);
+  if (!lValue || !*lValue)
+    lValue = getenv("CLASSPATH");
+  if (lValue)
+    lClassPath = lValue;
+
+  // without workers or a classpath, the VM can not start before a call
+  // gives its static context: getJvm warms it up then
+  if (!WorkerPool::getInstance().isEnabled() && lClassPath.empty())
+    return;
 
-private:
-  int theDesign;
-  int theSimpleContentType;
-  // useEnumeration NEVER = 1
-  int theUseEnumeration;
-  bool theVerbose;
+  std::lock_guard<std::mutex> lLock(jvmMutex());
+  if (claimWarmUp())
+    theWarmUp = std::thread(warmUpModule, lClassPath);
+}
 
-  bool theNetworkDownloads;
-  bool theNoPVR;
-  bool theNoUPA;
 
-public:
-  STOptions() : theDesign(STOptions::VENETIAN_BLIND_DESIGN),
-    theSimpleContentType(STOptions::SMART_TYPES),
-    theUseEnumeration(10), theVerbose(false),
-    theNetworkDownloads(false), theNoPVR(false), theNoUPA(false)
-  {}
+zorba::jvm::JavaVMSingleton*
+SchemaToolsModule::getJvm(const zorba::StaticContext* aStaticContext) const
+{
+  // waits for a warm-up that is starting the VM
+  std::lock_guard<std::mutex> lLock(jvmMutex());
+  zorba::jvm::JavaVMSingleton* lJvm =
+      zorba::jvm::JavaVMSingleton::getInstance(aStaticContext);
+
+  if (claimWarmUp())
+    theWarmUp = std::thread(warmUp, lJvm->getVM());
+  return lJvm;
+}
 
-  void parseI(Item optionsNode, ItemFactory *itemFactory);
-  void parseX(Item optionsNode, ItemFactory *itemFactory);
 
-  int getDesign()
+ExternalFunction* SchemaToolsModule::getExternalFunction(const String& localName)
+{
+  if (localName == "inst2xsd-internal")
   {
-    return theDesign;
+    return inst2xsd;
   }
-
-  int getSimpleContentType()
+  else if (localName == "inst2xsd-files-internal")
   {
-    return theSimpleContentType;
+    return inst2xsdFiles;
   }
-
-  int getUseEnumeration()
+  else if (localName == "inst2xsd-refine-internal")
   {
-    return theUseEnumeration;
+    return inst2xsdRefine;
   }
-
-  bool isVerbose()
+  else if (localName == "inst2xsd-open-internal")
   {
-    return theVerbose;
+    return inst2xsdOpen;
   }
-
-  bool isNetworkDownloads()
+  else if (localName == "inst2xsd-add")
   {
-    return theNetworkDownloads;
+    return inst2xsdAdd;
+  }
+  else if (localName == "inst2xsd-close")
+  {
+    return inst2xsdClose;
+  }
+  else if (localName == "xsd2inst-internal")
+  {
+    return xsd2inst;
+  }
+  else if (localName == "xsd2inst-all-internal")
+  {
+    return xsd2instAll;
+  }
+  else if (localName == "xsd2inst-generate-internal")
+  {
+    return xsd2instGenerate;
+  }
+  else if (localName == "stats")
+  {
+    return stats;
+  }
+  else if (localName == "compile-options-internal")
+  {
+    return compileOptions;
   }
 
-  bool isNoPVR()
+  return 0;
+}
+
+
+// the options of the optional argument aArg: an options element, parsed as
+// inst2xsd-options if aInst2xsd and as xsd2inst-options otherwise, or a
+// handle of compile-options, whose options aCompiled is set to. Throws
+// OPTIONS001 if the handle is not one of compiled options of that kind.
+static STOptions
+readOptions(ItemSequence* aArg, bool aInst2xsd,
+            const SchemaToolsModule* aModule, ItemFactory* aFactory,
+            std::shared_ptr<CompiledOptions>& aCompiled)
+{
+  STOptions lOptions;
+  Item lItem;
+  Iterator_t lIter = aArg->getIterator();
+  lIter->open();
+  bool lHasOptions = lIter->next(lItem);
+  lIter->close();
+  if (!lHasOptions)
+    return lOptions;
+
+  if (!lItem.isNode())
   {
-    return theNoPVR;
+    std::string lHandle = lItem.getStringValue().str();
+    aCompiled = CompiledOptionsRegistry::getInstance().find(lHandle);
+    if (!aCompiled || aCompiled->isInst2xsd() != aInst2xsd)
+    {
+      Item lQName = aFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+          "OPTIONS001");
+      throw USER_EXCEPTION(lQName, "\"" + lHandle +
+          "\" is not a handle of compiled " +
+          (aInst2xsd ? "inst2xsd" : "xsd2inst") + " options");
+    }
+    return aCompiled->getOptions();
   }
 
-  bool isNoUPA()
+  if (aInst2xsd)
+    lOptions.parseI(lItem, aFactory);
+  else
+    lOptions.parseX(lItem, aFactory);
+  return lOptions;
+}
+
+
+ItemSequence_t
+CompileOptionsFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                                 const zorba::StaticContext* aStaticContext,
+                                 const zorba::DynamicContext* aDynamicContext) const
+{
+  Item lOptionsItem;
+  Iterator_t lIter = args[0]->getIterator();
+  lIter->open();
+  lIter->next(lOptionsItem);
+  lIter->close();
+
+  // parseI and parseX report any other element
+  Item lName;
+  lOptionsItem.getNodeName(lName);
+  bool lInst2xsd = lName.getLocalName() != "xsd2inst-options";
+
+  STOptions lOptions;
+  if (lInst2xsd)
+    lOptions.parseI(lOptionsItem, theFactory);
+  else
+    lOptions.parseX(lOptionsItem, theFactory);
+
+  std::string lHandle =
+      CompiledOptionsRegistry::getInstance().add(lOptions, lInst2xsd);
+  return ItemSequence_t(new SingletonItemSequence(
+      theFactory->createAnyURI(lHandle)));
+}
+
+
+// the ResultCache key of aInstances inferred with aOptions; aItems gets the
+// instances, since the argument can only be iterated once
+static std::string
+resultCacheKey(ItemSequence* aInstances, const STOptions& aOptions,
+               std::vector<Item>& aItems, CallStats* aStats)
+{
+  PhaseTimer lTimer(aStats, SERIALIZE_PHASE);
+  Zorba_SerializerOptions_t lOptions;
+  lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
+  Serializer_t lSerializer = Serializer::createSerializer(lOptions);
+
+  HashStreamBuf lHash;
+  std::ostream lOut(&lHash);
+  std::string lOptionsKey = aOptions.inst2xsdKey();
+  lHash.update(lOptionsKey.c_str(), lOptionsKey.size() + 1);
+
+  Iterator_t lIter = aInstances->getIterator();
+  Item item;
+  lIter->open();
+  while( lIter->next(item) )
   {
-    return theNoUPA;
+    SingletonItemSequence lSequence(item);
+    lSerializer->serialize(&lSequence, lOut);
+    // a NUL byte, which no XML text has, ends each instance
+    lHash.update("", 1);
+    aItems.push_back(item);
   }
-};
+  lIter->close();
 
+  std::ostringstream lKey;
+  lKey << std::hex << lHash.getHash() << "-" << lHash.getSize()
+       << "-" << aItems.size();
+  return lKey.str();
+}
 
-ExternalFunction* SchemaToolsModule::getExternalFunction(const String& localName)
+
+// enters the JVM of this process for a call: env is the JNIEnv of the
+// thread, aFrame holds the local references of the call, and the JniCache
+// of aModule is resolved
+static zorba::jvm::JavaVMSingleton*
+enterJvm(const SchemaToolsModule* aModule,
+         const zorba::StaticContext* aStaticContext,
+         JNIEnv*& env, LocalFrame& aFrame, jthrowable& lException)
 {
-  if (localName == "inst2xsd-internal")
+  zorba::jvm::JavaVMSingleton* lJvm = aModule->getJvm(aStaticContext);
+  env = currentThreadEnv(lJvm->getVM());
+  aFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+  aModule->getJniCache().resolve(env, lJvm->getVM(), lException);
+  return lJvm;
+}
+
+
+// a session on the engine aOptions select: the native engine, which works
+// on the items, a worker process, or the JVM of this process, entered
+// through env and aFrame
+static std::unique_ptr<InferenceSession>
+newSession(const STOptions& aOptions,
+           const std::shared_ptr<CompiledOptions>& aCompiled,
+           const SchemaToolsModule* aModule,
+           const zorba::StaticContext* aStaticContext, CallStats* aStats,
+           JNIEnv*& env, LocalFrame& aFrame, jthrowable& lException)
+{
+  if (aOptions.getEngine() == STOptions::NATIVE_ENGINE)
   {
-    return inst2xsd;
+    aStats->setEngine("native");
+    return std::unique_ptr<InferenceSession>(new InferenceSession(aOptions));
   }
-  else if (localName == "xsd2inst-internal")
+
+  if (WorkerPool::getInstance().isEnabled())
   {
-    return xsd2inst;
+    aStats->setEngine("worker");
+    return std::unique_ptr<InferenceSession>(
+        new InferenceSession(aOptions, aStaticContext));
   }
 
-  return 0;
+  zorba::jvm::JavaVMSingleton* lJvm =
+      enterJvm(aModule, aStaticContext, env, aFrame, lException);
+  JniCache& lCache = aModule->getJniCache();
+  jobject lJavaOptions = aCompiled ?
+      aCompiled->getJavaOptions(env, lCache, lException) : 0;
+  return std::unique_ptr<InferenceSession>(new InferenceSession(aOptions,
+      lJvm, lCache, lJavaOptions, lException));
 }
 
 
@@ -234,130 +500,214 @@ Inst2xsdFunction::evaluate(const ExternalFunction::Arguments_t& args,
                            const zorba::StaticContext* aStaticContext,
                            const zorba::DynamicContext* aDynamincContext) const
 {
+  CallStats_t lStats = theModule->newCall(INST2XSD_FUNCTION);
   jthrowable lException = 0;
-  static JNIEnv* env;
+  JNIEnv* env = 0;
+  LocalFrame lFrame;
 
   try
   {
-    env = zorba::jvm::JavaVMSingleton::getInstance(aStaticContext)->getEnv();
+    // read input parm 1: $options
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[1], true, theModule, theFactory,
+        lCompiled);
+
+    // a cached result is returned without starting an engine
+    ItemSequence* lInstances = args[0];
+    std::unique_ptr<VectorItemSequence> lHashedInstances;
+    std::string lCacheKey;
+    if (options.useCache())
+    {
+      std::vector<Item> lItems;
+      lCacheKey = resultCacheKey(args[0], options, lItems, lStats.get());
+      ResultCache::Schemas_t lCached = ResultCache::getInstance().find(lCacheKey);
+      if (lCached)
+      {
+        lStats->setEngine("cache");
+        lStats->count(CACHE_HITS_COUNTER);
+        return ItemSequence_t(new CachedSchemaSequence(lCached, lStats));
+      }
+      lStats->count(CACHE_MISSES_COUNTER);
+      lHashedInstances.reset(new VectorItemSequence(lItems));
+      lInstances = lHashedInstances.get();
+    }
 
-    // Local variables
-    Zorba_SerializerOptions_t lOptions;
-    lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
-    Serializer_t lSerializer = Serializer::createSerializer(lOptions);
-    jclass myClass;
-    jmethodID myMethod;
+    // a session that lives for this call only
+    std::unique_ptr<InferenceSession> lSession = newSession(options,
+        lCompiled, theModule, aStaticContext, lStats.get(), env, lFrame,
+        lException);
 
-    // read input param 0
-    Iterator_t lIter = args[0]->getIterator();
-    lIter->open();
+    lSession->add(lInstances, lStats.get(), lException);
 
-    Item item;
-    std::vector<jstring> xmlUtfVec;
+    ItemSequence_t lResult = lSession->finish(theFactory, lStats, lException);
+    if (!lCacheKey.empty())
+      return ItemSequence_t(new CachingSchemaSequence(lResult, lCacheKey));
+    return lResult;
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "VM001");
+    throw USER_EXCEPTION(lQName, "Could not start the Java VM (is the classpath set?)");
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
+  }
 
-    while( lIter->next(item) )
-    {
-      // Searialize Item
-      std::ostringstream os;
-      SingletonItemSequence lSequence(item);
-      lSerializer->serialize(&lSequence, os);
-      std::string xmlString = os.str();
-      const char* xml = xmlString.c_str();
-      //std::cout << "  xmlString: '" << xml << "'" << std::endl; std::cout.flush();
-      xmlUtfVec.push_back( env->NewStringUTF(xml) );
-      CHECK_EXCEPTION(env);
-    }
+  return ItemSequence_t(new EmptySequence());
+}
 
-    lIter->close();
+
+ItemSequence_t
+Inst2xsdFilesFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                                const zorba::StaticContext* aStaticContext,
+                                const zorba::DynamicContext* aDynamincContext) const
+{
+  CallStats_t lStats = theModule->newCall(INST2XSD_FILES_FUNCTION);
+  jthrowable lException = 0;
+  JNIEnv* env = 0;
+  LocalFrame lFrame;
+
+  try
+  {
+    // read input parm 0: $paths
+    std::vector<std::string> lPatterns;
+    Item lPathItem;
+    Iterator_t arg0Iter = args[0]->getIterator();
+    arg0Iter->open();
+    while (arg0Iter->next(lPathItem))
+      lPatterns.push_back(lPathItem.getStringValue().str());
+    arg0Iter->close();
 
     // read input parm 1: $options
-    Item optionsItem;
-    Iterator_t arg1Iter = args[1]->getIterator();
-    arg1Iter->open();
-    bool hasOptions = arg1Iter->next(optionsItem);
-    arg1Iter->close();
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[1], true, theModule, theFactory,
+        lCompiled);
 
-    STOptions options;
-    if (hasOptions)
-      options.parseI(optionsItem, theFactory);
+    std::unique_ptr<InferenceSession> lSession = newSession(options,
+        lCompiled, theModule, aStaticContext, lStats.get(), env, lFrame,
+        lException);
 
+    lSession->addFiles(expandPaths(lPatterns), lStats.get(), lException);
 
-    // make options object
-    jclass optClass = env->FindClass("org/apache/xmlbeans/impl/inst2xsd/Inst2XsdOptions");
-    CHECK_EXCEPTION(env);
-    jmethodID optConstrId = env->GetMethodID(optClass, "<init>", "()V" );
-    CHECK_EXCEPTION(env);
-    jobject optObj = env->NewObject(optClass, optConstrId);
-    CHECK_EXCEPTION(env);
-    jmethodID optSetDegignId = env->GetMethodID(optClass, "setDesign", "(I)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetDegignId, options.getDesign());
-    CHECK_EXCEPTION(env);
-    jmethodID optSetEnumId = env->GetMethodID(optClass, "setUseEnumerations", "(I)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetEnumId, options.getUseEnumeration());
-    CHECK_EXCEPTION(env);
-    jmethodID optSetSCId = env->GetMethodID(optClass, "setSimpleContentTypes", "(I)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetSCId, options.getSimpleContentType());
-    CHECK_EXCEPTION(env);
-    jmethodID optSetVerboseId = env->GetMethodID(optClass, "setVerbose", "(Z)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetVerboseId, options.isVerbose());
-    CHECK_EXCEPTION(env);
+    return lSession->finish(theFactory, lStats, lException);
+  }
+  catch (FileException& e)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "FILE001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "VM001");
+    throw USER_EXCEPTION(lQName, "Could not start the Java VM (is the classpath set?)");
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
+  }
 
-    // Create String[]
-    jclass strCls = env->FindClass("Ljava/lang/String;");
-    CHECK_EXCEPTION(env);
-    jobjectArray jXmlStrArray = env->NewObjectArray(xmlUtfVec.size(), strCls, NULL);
-    //std::cout << "  NewObjectArray: '" << jXmlStrArray << "'" << std::endl; std::cout.flush();
-    CHECK_EXCEPTION(env);
+  return ItemSequence_t(new EmptySequence());
+}
 
-    for ( jsize i = 0; i<(jsize)xmlUtfVec.size(); i++)
-    {
-      env->SetObjectArrayElement(jXmlStrArray, i, xmlUtfVec[i]);
-      CHECK_EXCEPTION(env);
-      env->DeleteLocalRef((jstring)xmlUtfVec[i]);
-      CHECK_EXCEPTION(env);
-    }
 
-    // Create a Inst2XsdHelper class
-    myClass = env->FindClass("org/zorbaxquery/modules/schemaTools/Inst2XsdHelper");
-    CHECK_EXCEPTION(env);
-    myMethod = env->GetStaticMethodID(myClass, "inst2xsd",
-        "([Ljava/lang/String;Lorg/apache/xmlbeans/impl/inst2xsd/Inst2XsdOptions;)[Ljava/lang/String;");
-    CHECK_EXCEPTION(env);
-    jobjectArray resStrArray = (jobjectArray) env->CallStaticObjectMethod(myClass,
-        myMethod, jXmlStrArray, optObj);
-    CHECK_EXCEPTION(env);
-    //std::cout << "  CallStaticObjectMethod: '" << jXmlStrArray << "'" << std::endl; std::cout.flush();
+ItemSequence_t
+Inst2xsdRefineFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                                 const zorba::StaticContext* aStaticContext,
+                                 const zorba::DynamicContext* aDynamincContext) const
+{
+  CallStats_t lStats = theModule->newCall(INST2XSD_REFINE_FUNCTION);
+  jthrowable lException = 0;
 
-    jsize resStrArraySize = env->GetArrayLength(resStrArray);
-    CHECK_EXCEPTION(env);
-    //std::cout << "  GetArrayLength: '" << resStrArraySize << "'" << std::endl; std::cout.flush();
-    std::vector<Item> vec;
+  try
+  {
+    // read input parm 2: $options
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[2], true, theModule, theFactory,
+        lCompiled);
 
+    // only the native engine can start from schemas, whatever the options
+    lStats->setEngine("native");
+    InferenceSession lSession(options);
 
-    for( jsize i=0; i<resStrArraySize; i++)
-    {
-      jobject resStr = env->GetObjectArrayElement(resStrArray, i);
+    // read input parm 0: $schemas
+    lSession.seed(args[0], lStats.get());
 
-      const char *str;
-      str = env->GetStringUTFChars( (jstring)resStr, NULL);
-      if ( str == NULL ) return NULL;
+    // read input parm 1: $newInstances
+    lSession.add(args[1], lStats.get(), lException);
 
-      std::string lBinaryString(str);
+    return lSession.finish(theFactory, lStats, lException);
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
 
-      env->ReleaseStringUTFChars( (jstring)resStr, str);
-      //std::cout << "  lBinaryString '" << lBinaryString << "'" << std::endl; std::cout.flush();
 
-      std::stringstream lStream(lBinaryString);
-      Item lRes = Zorba::getInstance(0)->getXmlDataManager()->parseXML(lStream);
+// the session aHandle of the query, throws SESSION001 if it is not open
+static std::shared_ptr<InferenceSession>
+findSession(const DynamicContext* aContext, ItemSequence* aHandle,
+            bool aClose, ItemFactory* aFactory)
+{
+  Item lHandle;
+  Iterator_t lIter = aHandle->getIterator();
+  lIter->open();
+  lIter->next(lHandle);
+  lIter->close();
+
+  std::string lName = lHandle.getStringValue().str();
+  InferenceSessions* lSessions = InferenceSessions::get(aContext);
+  std::shared_ptr<InferenceSession> lSession =
+      aClose ? lSessions->close(lName) : lSessions->find(lName);
+  if (!lSession)
+  {
+    Item lQName = aFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "SESSION001");
+    throw USER_EXCEPTION(lQName, "No open inst2xsd session \"" + lName + "\"");
+  }
+  return lSession;
+}
 
-      vec.push_back(lRes);
-    }
 
-    return ItemSequence_t(new VectorItemSequence(vec));
+ItemSequence_t
+Inst2xsdOpenFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                               const zorba::StaticContext* aStaticContext,
+                               const zorba::DynamicContext* aDynamicContext) const
+{
+  CallStats_t lStats = theModule->newCall(INST2XSD_OPEN_FUNCTION);
+  jthrowable lException = 0;
+  JNIEnv* env = 0;
+  LocalFrame lFrame;
+
+  try
+  {
+    // read input parm 0: $options
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[0], true, theModule, theFactory,
+        lCompiled);
+
+    std::shared_ptr<InferenceSession> lSession = newSession(options,
+        lCompiled, theModule, aStaticContext, lStats.get(), env, lFrame,
+        lException);
+
+    std::string lHandle =
+        InferenceSessions::get(aDynamicContext)->open(lSession);
+    return ItemSequence_t(new SingletonItemSequence(
+        theFactory->createAnyURI(lHandle)));
   }
   catch (zorba::jvm::VMOpenException&)
   {
@@ -367,39 +717,79 @@ Inst2xsdFunction::evaluate(const ExternalFunction::Arguments_t& args,
   }
   catch (JavaException&)
   {
-    jclass stringWriterClass = env->FindClass("java/io/StringWriter");
-    jclass printWriterClass = env->FindClass("java/io/PrintWriter");
-    jclass throwableClass = env->FindClass("java/lang/Throwable");
-    jobject stringWriter = env->NewObject(
-        stringWriterClass,
-        env->GetMethodID(stringWriterClass, "<init>", "()V"));
-
-    jobject printWriter = env->NewObject(
-        printWriterClass,
-        env->GetMethodID(printWriterClass, "<init>", "(Ljava/io/Writer;)V"),
-        stringWriter);
-
-    env->CallObjectMethod(lException,
-        env->GetMethodID(throwableClass, "printStackTrace",
-            "(Ljava/io/PrintWriter;)V"),
-        printWriter);
-
-    //env->CallObjectMethod(printWriter, env->GetMethodID(printWriterClass, "flush", "()V"));
-    jmethodID toStringMethod =
-      env->GetMethodID(stringWriterClass, "toString", "()Ljava/lang/String;");
-    jobject errorMessageObj = env->CallObjectMethod(
-        stringWriter, toStringMethod);
-    jstring errorMessage = (jstring) errorMessageObj;
-    const char *errMsg = env->GetStringUTFChars(errorMessage, 0);
-    std::stringstream s;
-    s << "A Java Exception was thrown:" << std::endl << errMsg;
-    env->ReleaseStringUTFChars(errorMessage, errMsg);
-    std::string err("");
-    err += s.str();
-    env->ExceptionClear();
-    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
-        "JAVA-EXCEPTION");
-    throw USER_EXCEPTION(lQName, err);
+    throwJavaException(env, lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
+  }
+
+  return ItemSequence_t(new EmptySequence());
+}
+
+
+ItemSequence_t
+Inst2xsdAddFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                              const zorba::StaticContext* aStaticContext,
+                              const zorba::DynamicContext* aDynamicContext) const
+{
+  CallStats_t lStats = theModule->newCall(INST2XSD_ADD_FUNCTION);
+  std::shared_ptr<InferenceSession> lSession =
+      findSession(aDynamicContext, args[0], false, theFactory);
+  if (lSession->getOptions().getEngine() == STOptions::NATIVE_ENGINE)
+    lStats->setEngine("native");
+  else if (lSession->isWorker())
+    lStats->setEngine("worker");
+
+  jthrowable lException = 0;
+  LocalFrame lFrame;
+  try
+  {
+    if (JNIEnv* env = lSession->getEnv())
+      lFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+    lSession->add(args[1], lStats.get(), lException);
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(lSession->getEnv(), lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
+  }
+
+  return ItemSequence_t(new EmptySequence());
+}
+
+
+ItemSequence_t
+Inst2xsdCloseFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                                const zorba::StaticContext* aStaticContext,
+                                const zorba::DynamicContext* aDynamicContext) const
+{
+  CallStats_t lStats = theModule->newCall(INST2XSD_CLOSE_FUNCTION);
+  std::shared_ptr<InferenceSession> lSession =
+      findSession(aDynamicContext, args[0], true, theFactory);
+  if (lSession->getOptions().getEngine() == STOptions::NATIVE_ENGINE)
+    lStats->setEngine("native");
+  else if (lSession->isWorker())
+    lStats->setEngine("worker");
+
+  jthrowable lException = 0;
+  LocalFrame lFrame;
+  try
+  {
+    if (JNIEnv* env = lSession->getEnv())
+      lFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+    return lSession->finish(theFactory, lStats, lException);
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(lSession->getEnv(), lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
   }
 
   return ItemSequence_t(new EmptySequence());
@@ -407,137 +797,324 @@ Inst2xsdFunction::evaluate(const ExternalFunction::Arguments_t& args,
 
 
 
+// the text of every schema of aSchemas
+static std::vector<std::string>
+serializeSchemas(ItemSequence* aSchemas, CallStats* aStats)
+{
+  PhaseTimer lSerialize(aStats, SERIALIZE_PHASE);
+  Zorba_SerializerOptions_t lOptions;
+  lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
+  Serializer_t lSerializer = Serializer::createSerializer(lOptions);
+
+  std::vector<std::string> lXmls;
+  Iterator_t lIter = aSchemas->getIterator();
+  lIter->open();
+  Item item;
+  while( lIter->next(item) )
+  {
+    std::ostringstream os;
+    SingletonItemSequence lSequence(item);
+    lSerializer->serialize(&lSequence, os);
+    lXmls.push_back(os.str());
+    aStats->count(SCHEMAS_COUNTER);
+    aStats->count(BYTES_TO_JVM_COUNTER, lXmls.back().size());
+  }
+  lIter->close();
+  return lXmls;
+}
+
+
+// serializes every schema of aSchemas into a Java String[]
+static jobjectArray
+newSchemaArray(JNIEnv* env, const JniCache& aCache, ItemSequence* aSchemas,
+               CallStats* aStats, jthrowable& lException)
+{
+  std::vector<std::string> lXmls = serializeSchemas(aSchemas, aStats);
+
+  PhaseTimer lMarshal(aStats, MARSHAL_PHASE);
+  jobjectArray lArray = newJavaStringArray(env, aCache.theStringClass, lXmls);
+  CHECK_EXCEPTION(env);
+  return lArray;
+}
+
+
+// the Java Xsd2InstOptions of a call: compiled options have an object of
+// their own, the others reuse this thread's
+static jobject
+xsd2instJavaOptions(JNIEnv* env, const JniCache& aCache,
+                    const STOptions& aOptions,
+                    const std::shared_ptr<CompiledOptions>& aCompiled,
+                    jthrowable& lException)
+{
+  return aCompiled ?
+      aCompiled->getJavaOptions(env, aCache, lException) :
+      JavaOptionsCache::forCurrentThread().getXsd2InstOptions(
+          env, aCache, aOptions, lException);
+}
+
+
+ItemSequence_t
+Xsd2instFunction::nativeXsd2inst(ItemSequence* aSchemas,
+                                 ItemSequence* aRootName,
+                                 CallStats* aStats) const
+{
+  try
+  {
+    PhaseTimer lCompile(aStats, COMPILE_PHASE);
+    SchemaSet lSchemas;
+    Iterator_t lIter = aSchemas->getIterator();
+    lIter->open();
+    Item item;
+    while( lIter->next(item) )
+    {
+      lSchemas.add(item);
+      aStats->count(SCHEMAS_COUNTER);
+    }
+    lIter->close();
+    lCompile.stop();
+
+    lIter = aRootName->getIterator();
+    lIter->open();
+    lIter->next(item);
+    lIter->close();
+
+    PhaseTimer lGenerate(aStats, GENERATE_PHASE);
+    SampleGenerator lGenerator(lSchemas);
+    XmlNode lSample = lGenerator.sample(item.getStringValue().str());
+    lGenerate.stop();
+
+    PhaseTimer lResult(aStats, RESULT_PHASE);
+    NodeBuilder lBuilder(theFactory, true);
+    Item lRes = lBuilder.buildDocument(lSample);
+    aStats->count(DOCUMENTS_COUNTER);
+    return ItemSequence_t(new SingletonItemSequence(lRes));
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
+
+
 ItemSequence_t
 Xsd2instFunction::evaluate(const ExternalFunction::Arguments_t& args,
                            const zorba::StaticContext* aStaticContext,
                            const zorba::DynamicContext* aDynamicContext) const
 {
+  CallStats_t lStats = theModule->newCall(XSD2INST_FUNCTION);
   Iterator_t lIter;
 
   jthrowable lException = 0;
-  static JNIEnv* env;
+  JNIEnv* env = 0;
+  LocalFrame lFrame;
 
   try
   {
-    env = zorba::jvm::JavaVMSingleton::getInstance(aStaticContext)->getEnv();
+    // read input param 2: $options
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[2], false, theModule, theFactory,
+        lCompiled);
 
-    // Local variables
-    std::ostringstream os;
-    Zorba_SerializerOptions_t lOptions;
-    lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
-    Serializer_t lSerializer = Serializer::createSerializer(lOptions);
+    // the native engine reads the schema nodes, no JVM needed
+    if (options.getEngine() == STOptions::NATIVE_ENGINE)
+    {
+      lStats->setEngine("native");
+      return nativeXsd2inst(args[0], args[1], lStats.get());
+    }
 
-    const char* xml;
-    std::string xmlString;
+    if (WorkerPool::getInstance().isEnabled())
+    {
+      lStats->setEngine("worker");
+      Item lRootName;
+      lIter = args[1]->getIterator();
+      lIter->open();
+      lIter->next(lRootName);
+      lIter->close();
 
-    // read input param 0: schemas
-    lIter = args[0]->getIterator();
-    lIter->open();
+      std::vector<Item> lSamples = WorkerPool::getInstance().xsd2inst(
+          serializeSchemas(args[0], lStats.get()),
+          std::vector<std::string>(1, lRootName.getStringValue().str()),
+          options, aStaticContext, theFactory, lStats.get());
+      if (lSamples.size() != 1)
+        throw WorkerException("WORKER001",
+            "The schema-tools worker returned no sample");
+      return ItemSequence_t(new SingletonItemSequence(lSamples[0]));
+    }
+
+    zorba::jvm::JavaVMSingleton* lJvm =
+        enterJvm(theModule, aStaticContext, env, lFrame, lException);
+    JniCache& lCache = theModule->getJniCache();
+
+    // param 0: schemas
+    jobjectArray jXmlStrArray = newSchemaArray(env, lCache, args[0],
+        lStats.get(), lException);
 
+    // param 1: rootName
     Item item;
-    std::vector<jstring> xmlUtfVec;
+    lIter = args[1]->getIterator();
+    lIter->open();
+    lIter->next(item);
+    lIter->close();
+    jstring jStrParam2 = newJavaString(env, item.getStringValue().str());
+    CHECK_EXCEPTION(env);
+
+    jobject optObj = xsd2instJavaOptions(env, lCache, options, lCompiled,
+        lException);
+
+    // Call Xsd2InstHelper.xsd2instEvents
+    jbyteArray lEvents = (jbyteArray)env->CallStaticObjectMethod(
+        lCache.theXsd2InstHelperClass, lCache.theXsd2InstHelperXsd2instEvents,
+        jXmlStrArray, jStrParam2, optObj);
+    CHECK_EXCEPTION(env);
+    env->DeleteLocalRef(jXmlStrArray);
+    env->DeleteLocalRef(jStrParam2);
+    lStats->takeJavaTimes(env, lCache, lException);
+
+    // the nodes are built from the events, no text is printed or parsed
+    Item lRes = buildEventDocument(env, lEvents, theFactory, lStats.get(),
+        lException);
+
+    return ItemSequence_t(new SingletonItemSequence(lRes));
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+                                          "VM001");
+    throw USER_EXCEPTION(lQName, "Could not start the Java VM (is the classpath set?)");
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
+  }
 
+  return ItemSequence_t(new EmptySequence());
+}
+
+
+
+
+ItemSequence_t
+Xsd2instAllFunction::nativeXsd2instAll(ItemSequence* aSchemas,
+                                       ItemSequence* aRootNames,
+                                       const CallStats_t& aStats) const
+{
+  try
+  {
+    PhaseTimer lCompile(aStats.get(), COMPILE_PHASE);
+    std::unique_ptr<SchemaSet> lSchemas(new SchemaSet());
+    Iterator_t lIter = aSchemas->getIterator();
+    lIter->open();
+    Item item;
     while( lIter->next(item) )
     {
-      // Searialize Item
-      std::ostringstream os;
-      SingletonItemSequence lSequence(item);
-      lSerializer->serialize(&lSequence, os);
-      std::string xmlString = os.str();
-      const char* xml = xmlString.c_str();
-      //std::cout << "  xmlString: '" << xml << "'" << std::endl; std::cout.flush();
-      xmlUtfVec.push_back( env->NewStringUTF(xml) );
-      CHECK_EXCEPTION(env);
+      lSchemas->add(item);
+      aStats->count(SCHEMAS_COUNTER);
     }
+    lIter->close();
 
+    // all names are looked up before the first sample is generated
+    std::vector<QNameKey> lRoots;
+    lIter = aRootNames->getIterator();
+    lIter->open();
+    while( lIter->next(item) )
+      lRoots.push_back(lSchemas->findGlobalElement(item.getStringValue().str()));
     lIter->close();
 
+    if (lRoots.empty())
+      lRoots = lSchemas->getGlobalElements();
 
-    // Create String[]
-    jclass strCls = env->FindClass("Ljava/lang/String;");
-    CHECK_EXCEPTION(env);
-    jobjectArray jXmlStrArray = env->NewObjectArray(xmlUtfVec.size(), strCls, NULL);
-    //std::cout << "  NewObjectArray: '" << jXmlStrArray << "'" << std::endl; std::cout.flush();
-    CHECK_EXCEPTION(env);
+    lCompile.stop();
+
+    return ItemSequence_t(new NativeSampleSequence(std::move(lSchemas),
+        lRoots, theFactory, aStats));
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
+
+
+ItemSequence_t
+Xsd2instAllFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                              const zorba::StaticContext* aStaticContext,
+                              const zorba::DynamicContext* aDynamicContext) const
+{
+  CallStats_t lStats = theModule->newCall(XSD2INST_ALL_FUNCTION);
+  jthrowable lException = 0;
+  JNIEnv* env = 0;
+  LocalFrame lFrame;
+
+  try
+  {
+    // read input param 2: $options
+    std::shared_ptr<CompiledOptions> lCompiled;
+    STOptions options = readOptions(args[2], false, theModule, theFactory,
+        lCompiled);
+    Iterator_t lIter;
 
-    for ( jsize i = 0; i<(jsize)xmlUtfVec.size(); i++)
+    if (options.getEngine() == STOptions::NATIVE_ENGINE)
     {
-      env->SetObjectArrayElement(jXmlStrArray, i, xmlUtfVec[i]);
-      CHECK_EXCEPTION(env);
-      env->DeleteLocalRef((jstring)xmlUtfVec[i]);
-      CHECK_EXCEPTION(env);
+      lStats->setEngine("native");
+      return nativeXsd2instAll(args[0], args[1], lStats);
     }
 
-    // Get and create param 1: rootName string in jStrParam2
+    // param 1: root element names, none means all global elements
+    std::vector<std::string> lNames;
+    Item item;
     lIter = args[1]->getIterator();
     lIter->open();
-    lIter->next(item);
+    while( lIter->next(item) )
+      lNames.push_back(item.getStringValue().str());
     lIter->close();
-    //   Searialize Item
-    SingletonItemSequence lSequence(item);
-    lSerializer->serialize(&lSequence, os);
-    xmlString = os.str();
-    xml = xmlString.c_str();
-    jstring jStrParam2 = env->NewStringUTF(xml);
 
-    // read input param 2: $options
-    Item optionsItem;
-    STOptions options;
-    lIter = args[2]->getIterator();
-    lIter->open();
-    bool isOpen = lIter->isOpen();
-    if ( isOpen )
+    if (WorkerPool::getInstance().isEnabled())
     {
-      bool hasOptions = lIter->next(optionsItem);
-      lIter->close();
-
-      if (hasOptions)
-        options.parseX(optionsItem, theFactory);
+      // a worker answers with all samples at once
+      lStats->setEngine("worker");
+      std::vector<Item> lSamples = WorkerPool::getInstance().xsd2inst(
+          serializeSchemas(args[0], lStats.get()), lNames, options,
+          aStaticContext, theFactory, lStats.get());
+      if (!lNames.empty() && lSamples.size() != lNames.size())
+        throw WorkerException("WORKER001",
+            "The schema-tools worker returned too few samples");
+      return ItemSequence_t(new VectorItemSequence(lSamples));
     }
 
-    // make options object
-    jclass optClass = env->FindClass("org/zorbaxquery/modules/schemaTools/Xsd2InstHelper$Xsd2InstOptions");
-    CHECK_EXCEPTION(env);
-    jmethodID optConstrId = env->GetMethodID(optClass, "<init>", "()V" );
-    CHECK_EXCEPTION(env);
-    jobject optObj = env->NewObject(optClass, optConstrId);
-    CHECK_EXCEPTION(env);
-    jmethodID optSetNetId = env->GetMethodID(optClass, "setNetworkDownloads", "(Z)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetNetId, options.isNetworkDownloads());
-    CHECK_EXCEPTION(env);
-    jmethodID optSetNoPVRId = env->GetMethodID(optClass, "setNopvr", "(Z)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetNoPVRId, options.isNoPVR());
-    CHECK_EXCEPTION(env);
-    jmethodID optSetNoUPAId = env->GetMethodID(optClass, "setNoupa", "(Z)V" );
-    CHECK_EXCEPTION(env);
-    env->CallVoidMethod(optObj, optSetNoUPAId, options.isNoUPA());
-    CHECK_EXCEPTION(env);
+    zorba::jvm::JavaVMSingleton* lJvm =
+        enterJvm(theModule, aStaticContext, env, lFrame, lException);
+    JniCache& lCache = theModule->getJniCache();
 
-    // Create a Inst2XsdHelper class
-    jclass myClass = env->FindClass("org/zorbaxquery/modules/schemaTools/Xsd2InstHelper");
-    CHECK_EXCEPTION(env);
-    jmethodID myMethod = env->GetStaticMethodID(myClass, "xsd2inst",
-        "([Ljava/lang/String;Ljava/lang/String;Lorg/zorbaxquery/modules/schemaTools/Xsd2InstHelper$Xsd2InstOptions;)Ljava/lang/String;");
-    CHECK_EXCEPTION(env);
-    jobject resStr = (jobjectArray) env->CallStaticObjectMethod(myClass, myMethod, jXmlStrArray, jStrParam2, optObj);
-    CHECK_EXCEPTION(env);
-    //std::cout << "  CallStaticObjectMethod: '" << resStr << "'" << std::endl; std::cout.flush();
+    // param 0: schemas
+    jobjectArray jXmlStrArray = newSchemaArray(env, lCache, args[0],
+        lStats.get(), lException);
 
-    const char *str;
-    str = env->GetStringUTFChars( (jstring)resStr, NULL);
+    jobjectArray jNameArray = newJavaStringArray(env, lCache.theStringClass,
+        lNames);
     CHECK_EXCEPTION(env);
 
-    std::string lBinaryString(str);
+    jobject optObj = xsd2instJavaOptions(env, lCache, options, lCompiled,
+        lException);
 
-    env->ReleaseStringUTFChars( (jstring)resStr, str);
-    //std::cout << "  lBinaryString '" << lBinaryString << "'" << std::endl; std::cout.flush();
-
-    std::stringstream lStream(lBinaryString);
-    Item lRes = Zorba::getInstance(0)->getXmlDataManager()->parseXML(lStream);
+    // compiles the schemas and checks the names, the samples are generated
+    // one at a time by the returned sequence
+    jobject lBatch = env->CallStaticObjectMethod(lCache.theXsd2InstHelperClass,
+        lCache.theXsd2InstHelperXsd2instAll, jXmlStrArray, jNameArray, optObj);
+    CHECK_EXCEPTION(env);
+    env->DeleteLocalRef(jXmlStrArray);
+    env->DeleteLocalRef(jNameArray);
+    lStats->takeJavaTimes(env, lCache, lException);
 
-    return ItemSequence_t(new SingletonItemSequence(lRes));
+    return ItemSequence_t(
+        new JavaSampleSequence(lJvm, lCache, lBatch, theFactory, lStats));
   }
   catch (zorba::jvm::VMOpenException&)
   {
@@ -547,45 +1124,89 @@ Xsd2instFunction::evaluate(const ExternalFunction::Arguments_t& args,
   }
   catch (JavaException&)
   {
-    jclass stringWriterClass = env->FindClass("java/io/StringWriter");
-    jclass printWriterClass = env->FindClass("java/io/PrintWriter");
-    jclass throwableClass = env->FindClass("java/lang/Throwable");
-    jobject stringWriter = env->NewObject(
-          stringWriterClass,
-          env->GetMethodID(stringWriterClass, "<init>", "()V"));
-
-    jobject printWriter = env->NewObject(
-          printWriterClass,
-          env->GetMethodID(printWriterClass, "<init>", "(Ljava/io/Writer;)V"),
-          stringWriter);
-
-    env->CallObjectMethod(lException,
-                          env->GetMethodID(throwableClass, "printStackTrace",
-                                           "(Ljava/io/PrintWriter;)V"),
-                          printWriter);
-
-    //env->CallObjectMethod(printWriter, env->GetMethodID(printWriterClass, "flush", "()V"));
-    jmethodID toStringMethod =
-        env->GetMethodID(stringWriterClass, "toString", "()Ljava/lang/String;");
-    jobject errorMessageObj = env->CallObjectMethod(
-        stringWriter, toStringMethod);
-    jstring errorMessage = (jstring) errorMessageObj;
-    const char *errMsg = env->GetStringUTFChars(errorMessage, 0);
-    std::stringstream s;
-    s << "A Java Exception was thrown:" << std::endl << errMsg;
-    env->ReleaseStringUTFChars(errorMessage, errMsg);
-    std::string err("");
-    err += s.str();
-    env->ExceptionClear();
-    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
-                                          "JAVA-EXCEPTION");
-    throw USER_EXCEPTION(lQName, err);
+    throwJavaException(env, lException, theFactory);
+  }
+  catch (WorkerException& e)
+  {
+    throwWorkerException(e, theFactory);
   }
 
   return ItemSequence_t(new EmptySequence());
 }
 
 
+ItemSequence_t
+Xsd2instGenerateFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                                   const zorba::StaticContext* aStaticContext,
+                                   const zorba::DynamicContext* aDynamicContext) const
+{
+  // the native generator varies the instances, whatever the engine option
+  CallStats_t lStats = theModule->newCall(XSD2INST_GENERATE_FUNCTION);
+  lStats->setEngine("native");
+
+  // read input param 3: $options
+  std::shared_ptr<CompiledOptions> lCompiled;
+  STOptions options = readOptions(args[3], false, theModule, theFactory,
+      lCompiled);
+  Iterator_t lIter;
+
+  // read input param 2: $count
+  Item countItem;
+  lIter = args[2]->getIterator();
+  lIter->open();
+  lIter->next(countItem);
+  lIter->close();
+  uint64_t lCount = strtoull(countItem.getStringValue().c_str(), NULL, 10);
+
+  try
+  {
+    PhaseTimer lCompile(lStats.get(), COMPILE_PHASE);
+    std::unique_ptr<SchemaSet> lSchemas(new SchemaSet());
+    Item item;
+    lIter = args[0]->getIterator();
+    lIter->open();
+    while( lIter->next(item) )
+    {
+      lSchemas->add(item);
+      lStats->count(SCHEMAS_COUNTER);
+    }
+    lIter->close();
+
+    // param 1: the root element, looked up before the first instance
+    lIter = args[1]->getIterator();
+    lIter->open();
+    lIter->next(item);
+    lIter->close();
+    QNameKey lRoot = lSchemas->findGlobalElement(item.getStringValue().str());
+    lCompile.stop();
+
+    return ItemSequence_t(new GeneratedSampleSequence(std::move(lSchemas),
+        lRoot, lCount, options.getSeed(), theFactory, lStats));
+  }
+  catch (SchemaException& e)
+  {
+    Item lQName = theFactory->createQName(SCHEMATOOLS_MODULE_NAMESPACE,
+        "XSD001");
+    throw USER_EXCEPTION(lQName, e.theMessage);
+  }
+}
+
+
+ItemSequence_t
+StatsFunction::evaluate(const ExternalFunction::Arguments_t& args,
+                        const zorba::StaticContext* aStaticContext,
+                        const zorba::DynamicContext* aDynamicContext) const
+{
+  NodeBuilder lBuilder(theFactory, false);
+  Item lDoc = lBuilder.buildDocument(theModule->getStats().toXml());
+
+  Item lStats;
+  Iterator_t lChildren = lDoc.getChildren();
+  lChildren->open();
+  lChildren->next(lStats);
+  lChildren->close();
+  return ItemSequence_t(new SingletonItemSequence(lStats));
+}
 
 bool compareItemQName(Item item, const char *localname, const char *ns)
 {
@@ -608,44 +1229,6 @@ bool compareItemQName(Item item, const char *localname, const char *ns)
 }
 
 
-bool getChild(zorba::Iterator_t children, const char *localname, const char *ns,
-                           zorba::Item &child_item);
-bool getChild(zorba::Item &lItem, const char *localname, const char *ns,
-                           zorba::Item &child_item)
-{
-  Iterator_t    children;
-  children = lItem.getChildren();
-  children->open();
-  bool retval = getChild(children, localname, ns, child_item);
-  children->close();
-  return retval;
-}
-
-
-bool getChild(zorba::Iterator_t children, const char *localname, const char *ns,
-              zorba::Item &child_item)
-{
-  while(children->next(child_item))
-  {
-    if(child_item.getNodeKind() != store::StoreConsts::elementNode)
-      continue;
-    Item    child_name;
-    child_item.getNodeName(child_name);
-    String  item_namespace = child_name.getNamespace();
-    if(item_namespace != ns)
-    {
-      continue;//next child
-    }
-    String  item_name = child_name.getLocalName();
-    if(item_name != localname)
-    {
-      continue;//next child
-    }
-    return true;
-  }
-  return false;
-}
-
 void STOptions::parseI(Item optionsNode, ItemFactory *itemFactory)
 {
   if(optionsNode.isNull())
@@ -666,46 +1249,82 @@ void STOptions::parseI(Item optionsNode, ItemFactory *itemFactory)
     throw USER_EXCEPTION(errWrongParamQName, errDescription);
   }
 
+  // one pass over the children, whatever their number and order
+  Iterator_t children = optionsNode.getChildren();
+  children->open();
   zorba::Item child_item;
-
-  if(getChild(optionsNode, "design", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
-  {
-    String design_text = child_item.getStringValue();
-    if ( design_text == "rdd" )
-      theDesign = RUSSIAN_DOLL_DESIGN;
-    else if ( design_text == "ssd" )
-      theDesign = SALAMI_SLICE_DESIGN;
-    else if ( design_text == "vbd" )
-      theDesign = VENETIAN_BLIND_DESIGN;
-  }
-
-  if(getChild(optionsNode, "simple-content-types", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
-  {
-    String sct_text = child_item.getStringValue();
-    if ( sct_text == "always-string" )
-      theSimpleContentType = ALWAYS_STRING_TYPES;
-    else if ( sct_text == "smart" )
-      theSimpleContentType = SMART_TYPES;
-  }
-
-  if(getChild(optionsNode, "verbose", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
+  while(children->next(child_item))
   {
-    String sct_text = child_item.getStringValue();
-    if ( sct_text == "true" || sct_text == "1" )
-      theVerbose = true;
-    else
-      theVerbose = false;
-  }
+    if(child_item.getNodeKind() != store::StoreConsts::elementNode)
+      continue;
+    Item child_name;
+    child_item.getNodeName(child_name);
+    if(child_name.getNamespace() != SCHEMATOOLS_OPTIONS_NAMESPACE)
+      continue;
+    String name = child_name.getLocalName();
+    String text = child_item.getStringValue();
 
-  if(getChild(optionsNode, "use-enumeration", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
-  {
-    String sct_text = child_item.getStringValue();
-    int ival = atoi(sct_text.c_str());
-    if (ival>1)
-      theUseEnumeration = ival;
-    else
-      theUseEnumeration = 1;
+    if(name == "design")
+    {
+      if ( text == "rdd" )
+        theDesign = RUSSIAN_DOLL_DESIGN;
+      else if ( text == "ssd" )
+        theDesign = SALAMI_SLICE_DESIGN;
+      else if ( text == "vbd" )
+        theDesign = VENETIAN_BLIND_DESIGN;
+    }
+    else if(name == "simple-content-types")
+    {
+      if ( text == "always-string" )
+        theSimpleContentType = ALWAYS_STRING_TYPES;
+      else if ( text == "smart" )
+        theSimpleContentType = SMART_TYPES;
+    }
+    else if(name == "verbose")
+    {
+      theVerbose = ( text == "true" || text == "1" );
+    }
+    else if(name == "use-enumeration")
+    {
+      int ival = atoi(text.c_str());
+      if (ival>1)
+        theUseEnumeration = ival;
+      else
+        theUseEnumeration = 1;
+    }
+    else if(name == "engine")
+    {
+      if ( text == "native" )
+        theEngine = NATIVE_ENGINE;
+      else if ( text == "xmlbeans" )
+        theEngine = XMLBEANS_ENGINE;
+    }
+    else if(name == "parallelism")
+    {
+      int ival = atoi(text.c_str());
+      theParallelism = ival > 0 ? ival : 0;
+    }
+    else if(name == "sample-size")
+    {
+      theSampleSize = strtoull(text.c_str(), NULL, 10);
+    }
+    else if(name == "seed")
+    {
+      theSeed = strtoull(text.c_str(), NULL, 10);
+    }
+    else if(name == "cache")
+    {
+      theCache = ( text == "true" || text == "1" );
+    }
+    else if(name == "transfer")
+    {
+      if ( text == "events" )
+        theTransfer = EVENTS_TRANSFER;
+      else if ( text == "xml" )
+        theTransfer = XML_TRANSFER;
+    }
   }
+  children->close();
 }
 
 void STOptions::parseX(Item optionsNode, ItemFactory *itemFactory)
@@ -727,37 +1346,46 @@ void STOptions::parseX(Item optionsNode, ItemFactory *itemFactory)
     throw USER_EXCEPTION(errWrongParamQName, errDescription);
   }
 
+  // one pass over the children, as in parseI
+  Iterator_t children = optionsNode.getChildren();
+  children->open();
   zorba::Item child_item;
-
-  if(getChild(optionsNode, "network-downloads", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
-  {
-    //theNetworkDownloads = child_item.getBooleanValue();
-    String sct_text = child_item.getStringValue();
-    if ( sct_text == "true" || sct_text == "1" )
-      theNetworkDownloads = true;
-    else
-      theNetworkDownloads = false;
-  }
-
-  if(getChild(optionsNode, "no-pvr", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
+  while(children->next(child_item))
   {
-    //theNoPVR = child_item.getBooleanValue();
-    String sct_text = child_item.getStringValue();
-    if ( sct_text == "true" || sct_text == "1" )
-      theNetworkDownloads = true;
-    else
-      theNetworkDownloads = false;
-  }
+    if(child_item.getNodeKind() != store::StoreConsts::elementNode)
+      continue;
+    Item child_name;
+    child_item.getNodeName(child_name);
+    if(child_name.getNamespace() != SCHEMATOOLS_OPTIONS_NAMESPACE)
+      continue;
+    String name = child_name.getLocalName();
+    String text = child_item.getStringValue();
 
-  if(getChild(optionsNode, "no-pvr", SCHEMATOOLS_OPTIONS_NAMESPACE, child_item))
-  {
-    //theNoUPA = child_item.getBooleanValue();
-    String sct_text = child_item.getStringValue();
-    if ( sct_text == "true" || sct_text == "1" )
-      theNetworkDownloads = true;
-    else
-      theNetworkDownloads = false;
+    if(name == "network-downloads")
+    {
+      theNetworkDownloads = ( text == "true" || text == "1" );
+    }
+    else if(name == "no-pvr")
+    {
+      theNoPVR = ( text == "true" || text == "1" );
+    }
+    else if(name == "no-upa")
+    {
+      theNoUPA = ( text == "true" || text == "1" );
+    }
+    else if(name == "engine")
+    {
+      if ( text == "native" )
+        theEngine = NATIVE_ENGINE;
+      else if ( text == "xmlbeans" )
+        theEngine = XMLBEANS_ENGINE;
+    }
+    else if(name == "seed")
+    {
+      theSeed = strtoull(text.c_str(), NULL, 10);
+    }
   }
+  children->close();
 }
 
 }}; // namespace zorba, schematools
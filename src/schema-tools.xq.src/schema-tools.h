@@ -0,0 +1,476 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_SCHEMA_TOOLS_H
+#define ZORBA_SCHEMATOOLS_SCHEMA_TOOLS_H
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <zorba/external_module.h>
+#include <zorba/function.h>
+#include <zorba/item_factory.h>
+#include <zorba/zorba.h>
+
+#include "JavaVMSingleton.h"
+
+#include "compiled_options.h"
+#include "jni_cache.h"
+#include "st_options.h"
+#include "stats.h"
+
+#define SCHEMATOOLS_MODULE_NAMESPACE "http://www.zorba-xquery.com/modules/schema-tools"
+#define SCHEMATOOLS_OPTIONS_NAMESPACE "http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options"
+
+// environment variable that turns the warm-up on when it is "1", see
+// SchemaToolsModule::startWarmUp
+#define SCHEMATOOLS_WARMUP_ENV "ZORBA_SCHEMATOOLS_WARMUP"
+
+// environment variable with the classpath of the module's jars the
+// warm-up starts the JVM with, before any call; CLASSPATH if not set
+#define SCHEMATOOLS_WARMUP_CLASSPATH_ENV "ZORBA_SCHEMATOOLS_WARMUP_CLASSPATH"
+
+namespace zorba
+{
+namespace schematools
+{
+
+class SchemaToolsModule;
+
+/**
+ * Throws the JAVA-EXCEPTION user exception for aException, with its stack
+ * trace as the message, and clears it in env.
+ */
+void throwJavaException(JNIEnv* env, jthrowable aException, ItemFactory* aFactory);
+
+
+class Inst2xsdFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-internal"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Inst2xsdFilesFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdFilesFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdFilesFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-files-internal"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Inst2xsdRefineFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdRefineFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdRefineFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-refine-internal"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Inst2xsdOpenFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdOpenFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdOpenFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-open-internal"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Inst2xsdAddFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdAddFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdAddFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-add"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Inst2xsdCloseFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Inst2xsdCloseFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Inst2xsdCloseFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "inst2xsd-close"; }
+
+    virtual ItemSequence_t
+    evaluate(const ExternalFunction::Arguments_t& args,
+             const zorba::StaticContext*,
+             const zorba::DynamicContext*) const;
+};
+
+
+class Xsd2instFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Xsd2instFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Xsd2instFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "xsd2inst-internal"; }
+
+    virtual ItemSequence_t
+      evaluate(const ExternalFunction::Arguments_t& args,
+               const zorba::StaticContext*,
+               const zorba::DynamicContext*) const;
+
+  private:
+    ItemSequence_t
+    nativeXsd2inst(ItemSequence* aSchemas, ItemSequence* aRootName,
+        CallStats* aStats) const;
+};
+
+
+class Xsd2instAllFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Xsd2instAllFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Xsd2instAllFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "xsd2inst-all-internal"; }
+
+    virtual ItemSequence_t
+      evaluate(const ExternalFunction::Arguments_t& args,
+               const zorba::StaticContext*,
+               const zorba::DynamicContext*) const;
+
+  private:
+    ItemSequence_t
+    nativeXsd2instAll(ItemSequence* aSchemas, ItemSequence* aRootNames,
+        const CallStats_t& aStats) const;
+};
+
+
+class Xsd2instGenerateFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    Xsd2instGenerateFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~Xsd2instGenerateFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "xsd2inst-generate-internal"; }
+
+    virtual ItemSequence_t
+      evaluate(const ExternalFunction::Arguments_t& args,
+               const zorba::StaticContext*,
+               const zorba::DynamicContext*) const;
+};
+
+
+class StatsFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    StatsFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~StatsFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "stats"; }
+
+    virtual ItemSequence_t
+      evaluate(const ExternalFunction::Arguments_t& args,
+               const zorba::StaticContext*,
+               const zorba::DynamicContext*) const;
+};
+
+
+class CompileOptionsFunction : public ContextualExternalFunction
+{
+  private:
+    const SchemaToolsModule* theModule;
+    ItemFactory* theFactory;
+
+  public:
+    CompileOptionsFunction(const SchemaToolsModule* aModule) :
+      theModule(aModule),
+      theFactory(Zorba::getInstance(0)->getItemFactory())
+    {}
+
+    ~CompileOptionsFunction()
+    {}
+
+  public:
+    virtual String getURI() const;
+
+    virtual String getLocalName() const
+    { return "compile-options-internal"; }
+
+    virtual ItemSequence_t
+      evaluate(const ExternalFunction::Arguments_t& args,
+               const zorba::StaticContext*,
+               const zorba::DynamicContext*) const;
+};
+
+
+class SchemaToolsModule : public ExternalModule {
+  private:
+    ExternalFunction* inst2xsd;
+    ExternalFunction* inst2xsdFiles;
+    ExternalFunction* inst2xsdRefine;
+    ExternalFunction* inst2xsdOpen;
+    ExternalFunction* inst2xsdAdd;
+    ExternalFunction* inst2xsdClose;
+    ExternalFunction* xsd2inst;
+    ExternalFunction* xsd2instAll;
+    ExternalFunction* xsd2instGenerate;
+    ExternalFunction* stats;
+    ExternalFunction* compileOptions;
+
+    // classes and method ids shared by all functions of this module
+    mutable JniCache theJniCache;
+
+    // timings and counters of all calls, see schema-tools:stats()
+    mutable ModuleStats theStats;
+
+    // the warm-up this module started, joined when it goes
+    mutable std::thread theWarmUp;
+
+    // with SCHEMATOOLS_WARMUP_ENV set to 1, once per process, starts on
+    // theWarmUp the workers, which warm themselves up, or the JVM of this
+    // process with the warm-up classpath and the Java WarmUp in it, so
+    // that the first calls find the classes loaded and compiled
+    void startWarmUp();
+
+  public:
+    SchemaToolsModule() :
+      inst2xsd(new Inst2xsdFunction(this)),
+      inst2xsdFiles(new Inst2xsdFilesFunction(this)),
+      inst2xsdRefine(new Inst2xsdRefineFunction(this)),
+      inst2xsdOpen(new Inst2xsdOpenFunction(this)),
+      inst2xsdAdd(new Inst2xsdAddFunction(this)),
+      inst2xsdClose(new Inst2xsdCloseFunction(this)),
+      xsd2inst(new Xsd2instFunction(this)),
+      xsd2instAll(new Xsd2instAllFunction(this)),
+      xsd2instGenerate(new Xsd2instGenerateFunction(this)),
+      stats(new StatsFunction(this)),
+      compileOptions(new CompileOptionsFunction(this))
+    {
+      startWarmUp();
+    }
+
+    ~SchemaToolsModule()
+    {
+      if (theWarmUp.joinable())
+        theWarmUp.join();
+      delete inst2xsd;
+      delete inst2xsdFiles;
+      delete inst2xsdRefine;
+      delete inst2xsdOpen;
+      delete inst2xsdAdd;
+      delete inst2xsdClose;
+      delete xsd2inst;
+      delete xsd2instAll;
+      delete xsd2instGenerate;
+      delete stats;
+      delete compileOptions;
+    }
+
+    virtual String getURI() const
+    { return SCHEMATOOLS_MODULE_NAMESPACE; }
+
+    virtual ExternalFunction* getExternalFunction(const String& localName);
+
+    JniCache& getJniCache() const
+    { return theJniCache; }
+
+    ModuleStats& getStats() const
+    { return theStats; }
+
+
+    // the stats of a new call of aFunction
+    CallStats_t newCall(function_t aFunction) const
+    { return CallStats_t(new CallStats(theStats, aFunction)); }
+
+    /**
+     * The Java VM, started on first use with the jars aStaticContext finds,
+     * unless the warm-up is starting it; the call waits for that start.
+     * With SCHEMATOOLS_WARMUP_ENV set to 1 and no classpath for the
+     * warm-up, the first start runs the Java WarmUp on a background thread
+     * instead, see startWarmUp.
+     */
+    zorba::jvm::JavaVMSingleton* getJvm(const zorba::StaticContext* aStaticContext) const;
+
+    virtual void destroy()
+    {
+      delete this;
+    }
+};
+
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_SCHEMA_TOOLS_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zorba/iterator.h>
+#include <zorba/store_consts.h>
+
+#include "schema_model.h"
+
+#define XML_SCHEMA_NAMESPACE "http://www.w3.org/2001/XMLSchema"
+#define XML_NAMESPACE "http://www.w3.org/XML/1998/namespace"
+
+namespace zorba
+{
+namespace schematools
+{
+
+void SchemaSet::add(const Item& aSchema)
+{
+  Item lSchema = aSchema;
+  if (lSchema.getNodeKind() == store::StoreConsts::documentNode)
+  {
+    Iterator_t lChildren = aSchema.getChildren();
+    lChildren->open();
+    Item lChild;
+    while (lChildren->next(lChild))
+    {
+      if (lChild.getNodeKind() == store::StoreConsts::elementNode)
+      {
+        lSchema = lChild;
+        break;
+      }
+    }
+    lChildren->close();
+  }
+  if (lSchema.getNodeKind() != store::StoreConsts::elementNode ||
+      xsName(lSchema) != "schema")
+    throw SchemaException("schemas must be xs:schema elements");
+
+  theDocs.push_back(std::unique_ptr<SchemaDocInfo>(new SchemaDocInfo()));
+  SchemaDocInfo* lDoc = theDocs.back().get();
+  std::string lValue;
+  getAttribute(lSchema, "targetNamespace", lDoc->theTargetNamespace);
+  lDoc->theElementsQualified =
+      getAttribute(lSchema, "elementFormDefault", lValue) && lValue == "qualified";
+  lDoc->theAttributesQualified =
+      getAttribute(lSchema, "attributeFormDefault", lValue) && lValue == "qualified";
+
+  std::vector<Item> lChildren;
+  xsChildren(lSchema, lChildren);
+  for (size_t i = 0; i < lChildren.size(); ++i)
+  {
+    std::string lKindName = xsName(lChildren[i]);
+    int lKind;
+    if (lKindName == "element")
+      lKind = ELEMENT_COMPONENT;
+    else if (lKindName == "attribute")
+      lKind = ATTRIBUTE_COMPONENT;
+    else if (lKindName == "complexType")
+      lKind = COMPLEX_TYPE_COMPONENT;
+    else if (lKindName == "simpleType")
+      lKind = SIMPLE_TYPE_COMPONENT;
+    else if (lKindName == "group")
+      lKind = GROUP_COMPONENT;
+    else if (lKindName == "attributeGroup")
+      lKind = ATTRIBUTE_GROUP_COMPONENT;
+    else
+      continue;
+
+    std::string lName;
+    if (!getAttribute(lChildren[i], "name", lName))
+      continue;
+    QNameKey lKey(lDoc->theTargetNamespace, lName);
+
+    // the first declaration wins, as in the order of the schemas
+    std::pair<int, QNameKey> lIndex(lKind, lKey);
+    if (theComponents.find(lIndex) != theComponents.end())
+      continue;
+    SchemaComponent& lComponent = theComponents[lIndex];
+    lComponent.theNode = lChildren[i];
+    lComponent.theDoc = lDoc;
+    if (lKind == ELEMENT_COMPONENT)
+      theGlobalElements.push_back(lKey);
+  }
+}
+
+
+const SchemaComponent* SchemaSet::find(int aKind, const QNameKey& aName) const
+{
+  std::map<std::pair<int, QNameKey>, SchemaComponent>::const_iterator lIt =
+      theComponents.find(std::make_pair(aKind, aName));
+  return lIt == theComponents.end() ? 0 : &lIt->second;
+}
+
+
+const QNameKey& SchemaSet::findGlobalElement(const std::string& aLocalName) const
+{
+  for (size_t i = 0; i < theGlobalElements.size(); ++i)
+    if (theGlobalElements[i].second == aLocalName)
+      return theGlobalElements[i];
+
+  throw SchemaException("Could not find a global element with name \"" +
+      aLocalName + "\"");
+}
+
+
+const SchemaComponent& SchemaSet::resolve(int aKind, const QNameKey& aName) const
+{
+  const SchemaComponent* lComponent = find(aKind, aName);
+  if (!lComponent)
+  {
+    static const char* lKinds[] = { "", "element", "attribute", "complex type",
+                                    "simple type", "group", "attribute group" };
+    std::string lMessage = "Could not find the ";
+    lMessage += lKinds[aKind];
+    lMessage += " {" + aName.first + "}" + aName.second;
+    throw SchemaException(lMessage);
+  }
+  return *lComponent;
+}
+
+
+QNameKey SchemaSet::expandQName(const Item& aNode, const std::string& aLexical)
+{
+  std::string::size_type lColon = aLexical.find(':');
+  std::string lPrefix;
+  std::string lLocal = aLexical;
+  if (lColon != std::string::npos)
+  {
+    lPrefix = aLexical.substr(0, lColon);
+    lLocal = aLexical.substr(lColon + 1);
+  }
+  if (lPrefix == "xml")
+    return QNameKey(XML_NAMESPACE, lLocal);
+
+  NsBindings lBindings;
+  aNode.getNamespaceBindings(lBindings);
+  for (size_t i = 0; i < lBindings.size(); ++i)
+  {
+    if (lBindings[i].first.str() == lPrefix)
+      return QNameKey(lBindings[i].second.str(), lLocal);
+  }
+  if (!lPrefix.empty())
+    throw SchemaException("Undeclared prefix in " + aLexical);
+  return QNameKey("", lLocal);
+}
+
+
+bool SchemaSet::getAttribute(const Item& aNode, const char* aName, std::string& aValue)
+{
+  Iterator_t lAttributes = aNode.getAttributes();
+  lAttributes->open();
+  Item lAttr;
+  bool lFound = false;
+  while (lAttributes->next(lAttr))
+  {
+    Item lName;
+    lAttr.getNodeName(lName);
+    if (lName.getNamespace().str().empty() && lName.getLocalName().str() == aName)
+    {
+      aValue = lAttr.getStringValue().str();
+      lFound = true;
+      break;
+    }
+  }
+  lAttributes->close();
+  return lFound;
+}
+
+
+std::string SchemaSet::xsName(const Item& aNode)
+{
+  Item lName;
+  aNode.getNodeName(lName);
+  if (lName.getNamespace().str() != XML_SCHEMA_NAMESPACE)
+    return "";
+  return lName.getLocalName().str();
+}
+
+
+void SchemaSet::xsChildren(const Item& aNode, std::vector<Item>& aChildren)
+{
+  Iterator_t lChildren = aNode.getChildren();
+  lChildren->open();
+  Item lChild;
+  while (lChildren->next(lChild))
+  {
+    if (lChild.getNodeKind() != store::StoreConsts::elementNode)
+      continue;
+    std::string lName = xsName(lChild);
+    if (lName.empty() || lName == "annotation")
+      continue;
+    aChildren.push_back(lChild);
+  }
+  lChildren->close();
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_SCHEMA_MODEL_H
+#define ZORBA_SCHEMATOOLS_SCHEMA_MODEL_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zorba/item.h>
+
+#include "node_builder.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * Thrown for schemas the native engines can not use, e.g. an unresolved
+ * reference or a missing root element.
+ */
+class SchemaException
+{
+  public:
+    std::string theMessage;
+
+  public:
+    SchemaException(const std::string& aMessage) : theMessage(aMessage)
+    {}
+};
+
+
+/**
+ * Settings of one xs:schema element that apply to its components.
+ */
+class SchemaDocInfo
+{
+  public:
+    std::string theTargetNamespace;
+    bool theElementsQualified;
+    bool theAttributesQualified;
+
+  public:
+    SchemaDocInfo() : theElementsQualified(false), theAttributesQualified(false)
+    {}
+};
+
+
+class SchemaComponent
+{
+  public:
+    // the xs:element, xs:complexType, ... node of the declaration
+    Item theNode;
+    const SchemaDocInfo* theDoc;
+
+  public:
+    SchemaComponent() : theDoc(0)
+    {}
+};
+
+
+/**
+ * The global components of a set of schema documents, indexed by kind and
+ * name. The components stay the xs:* nodes of the schemas; the native
+ * engines read their properties from there.
+ */
+class SchemaSet
+{
+  public:
+    typedef enum
+    {
+      ELEMENT_COMPONENT = 1,
+      ATTRIBUTE_COMPONENT,
+      COMPLEX_TYPE_COMPONENT,
+      SIMPLE_TYPE_COMPONENT,
+      GROUP_COMPONENT,
+      ATTRIBUTE_GROUP_COMPONENT,
+    } component_kind_t;
+
+  private:
+    std::vector<std::unique_ptr<SchemaDocInfo> > theDocs;
+    std::map<std::pair<int, QNameKey>, SchemaComponent> theComponents;
+    std::vector<QNameKey> theGlobalElements;
+
+  public:
+    // aSchema is an xs:schema element or a document node containing one
+    void add(const Item& aSchema);
+
+    // null if there is no such component
+    const SchemaComponent* find(int aKind, const QNameKey& aName) const;
+
+    // same, throws a SchemaException if there is no such component
+    const SchemaComponent& resolve(int aKind, const QNameKey& aName) const;
+
+    // first global element with local name aLocalName, throws a
+    // SchemaException if there is none
+    const QNameKey& findGlobalElement(const std::string& aLocalName) const;
+
+    // names of the global elements, in the order of the schemas
+    const std::vector<QNameKey>& getGlobalElements() const
+    {
+      return theGlobalElements;
+    }
+
+    // expands aLexical with the namespaces in scope at aNode
+    static QNameKey expandQName(const Item& aNode, const std::string& aLexical);
+
+    // value of the unqualified attribute aName of aNode
+    static bool getAttribute(const Item& aNode, const char* aName, std::string& aValue);
+
+    // local name of aNode if it is in the XML Schema namespace, "" otherwise
+    static std::string xsName(const Item& aNode);
+
+    // the element children of aNode in the XML Schema namespace, without
+    // annotations
+    static void xsChildren(const Item& aNode, std::vector<Item>& aChildren);
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_SCHEMA_MODEL_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <string>
+
+#include <zorba/singleton_item_sequence.h>
+#include <zorba/zorba.h>
+
+#include "event_stream.h"
+#include "jni_cache.h"
+#include "schema-tools.h"
+#include "schema_sequence.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+JavaSchemaSequence::JavaSchemaSequence(zorba::jvm::JavaVMSingleton* aJvm,
+                                       jobjectArray aSchemas,
+                                       ItemFactory* aFactory,
+                                       const CallStats_t& aStats) :
+  theJvm(aJvm),
+  theFactory(aFactory),
+  theStats(aStats)
+{
+  JNIEnv* env = currentThreadEnv(theJvm->getVM());
+  theSchemas = (jobjectArray)env->NewGlobalRef(aSchemas);
+  theSize = env->GetArrayLength(aSchemas);
+  env->DeleteLocalRef(aSchemas);
+}
+
+
+JavaSchemaSequence::~JavaSchemaSequence()
+{
+  try
+  {
+    currentThreadEnv(theJvm->getVM())->DeleteGlobalRef(theSchemas);
+  }
+  catch (zorba::jvm::VMOpenException&)
+  {
+    // this thread can not be attached, the array is left to the VM
+  }
+}
+
+
+bool JavaSchemaSequence::JavaSchemaIterator::next(Item& aItem)
+{
+  if (theNext >= theSequence->theSize)
+    return false;
+
+  JNIEnv* env = currentThreadEnv(theSequence->theJvm->getVM());
+  CallStats* lStats = theSequence->theStats.get();
+  jthrowable lException = 0;
+  LocalFrame lFrame;
+  try
+  {
+    lFrame.push(env, LOCAL_FRAME_CAPACITY, lException);
+    jbyteArray lEvents = (jbyteArray)env->GetObjectArrayElement(
+        theSequence->theSchemas, theNext++);
+    CHECK_EXCEPTION(env);
+
+    aItem = buildEventDocument(env, lEvents, theSequence->theFactory, lStats,
+        lException);
+    return true;
+  }
+  catch (JavaException&)
+  {
+    throwJavaException(env, lException, theSequence->theFactory);
+  }
+  return false;
+}
+
+
+bool NativeSchemaSequence::NativeSchemaIterator::next(Item& aItem)
+{
+  if (theNext >= theSequence->theSchemas.size())
+    return false;
+
+  PhaseTimer lTimer(theSequence->theStats.get(), RESULT_PHASE);
+  NodeBuilder lBuilder(theSequence->theFactory, true);
+  aItem = lBuilder.buildDocument(theSequence->theSchemas[theNext++]);
+  theSequence->theStats->count(DOCUMENTS_COUNTER);
+  return true;
+}
+
+
+
+bool CachedSchemaSequence::CachedSchemaIterator::next(Item& aItem)
+{
+  if (theNext >= theSequence->theSchemas->size())
+    return false;
+
+  PhaseTimer lTimer(theSequence->theStats.get(), RESULT_PHASE);
+  std::istringstream lStream((*theSequence->theSchemas)[theNext++]);
+  aItem = Zorba::getInstance(0)->getXmlDataManager()->parseXML(lStream);
+  theSequence->theStats->count(DOCUMENTS_COUNTER);
+  return true;
+}
+
+
+CachingSchemaSequence::CachingSchemaIterator::CachingSchemaIterator(
+    CachingSchemaSequence* aSequence) :
+  theSequence(aSequence),
+  theIsOpen(false)
+{
+  Zorba_SerializerOptions_t lOptions;
+  lOptions.omit_xml_declaration = ZORBA_OMIT_XML_DECLARATION_YES;
+  theSerializer = Serializer::createSerializer(lOptions);
+}
+
+
+void CachingSchemaSequence::CachingSchemaIterator::open()
+{
+  theResult = theSequence->theResult->getIterator();
+  theResult->open();
+  theSchemas.reset(new std::vector<std::string>());
+  theIsOpen = true;
+}
+
+
+bool CachingSchemaSequence::CachingSchemaIterator::next(Item& aItem)
+{
+  if (!theResult->next(aItem))
+  {
+    if (theSchemas)
+      ResultCache::getInstance().put(theSequence->theKey, theSchemas);
+    theSchemas.reset();
+    return false;
+  }
+
+  if (theSchemas)
+  {
+    std::ostringstream lOut;
+    SingletonItemSequence lSequence(aItem);
+    theSerializer->serialize(&lSequence, lOut);
+    theSchemas->push_back(lOut.str());
+  }
+  return true;
+}
+
+
+void CachingSchemaSequence::CachingSchemaIterator::close()
+{
+  theResult->close();
+  theIsOpen = false;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_SCHEMA_SEQUENCE_H
+#define ZORBA_SCHEMATOOLS_SCHEMA_SEQUENCE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zorba/item_factory.h>
+#include <zorba/item_sequence.h>
+#include <zorba/iterator.h>
+#include <zorba/serializer.h>
+
+#include "JavaVMSingleton.h"
+
+#include "node_builder.h"
+#include "result_cache.h"
+#include "stats.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * The schema documents of a Java byte[][], as returned by
+ * Inst2XsdSession.finishEvents. A schema is only copied out of the JVM and
+ * built when the iterator gets to it, so a query using the first schema
+ * does not pay for the others.
+ */
+class JavaSchemaSequence : public ItemSequence
+{
+  private:
+    class JavaSchemaIterator : public Iterator
+    {
+      private:
+        JavaSchemaSequence* theSequence;
+        jsize theNext;
+        bool theIsOpen;
+
+      public:
+        JavaSchemaIterator(JavaSchemaSequence* aSequence) :
+          theSequence(aSequence),
+          theNext(0),
+          theIsOpen(false)
+        {}
+
+        virtual void open()
+        {
+          theNext = 0;
+          theIsOpen = true;
+        }
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    zorba::jvm::JavaVMSingleton* theJvm;
+    // global reference to the byte[][]
+    jobjectArray theSchemas;
+    jsize theSize;
+    ItemFactory* theFactory;
+    CallStats_t theStats;
+
+  public:
+    // aSchemas is a local reference, the sequence keeps a global one
+    JavaSchemaSequence(zorba::jvm::JavaVMSingleton* aJvm,
+        jobjectArray aSchemas, ItemFactory* aFactory,
+        const CallStats_t& aStats);
+
+    virtual ~JavaSchemaSequence();
+
+    virtual Iterator_t getIterator()
+    { return new JavaSchemaIterator(this); }
+};
+
+
+/**
+ * The schema documents of the native engine, built into items when the
+ * iterator gets to them.
+ */
+class NativeSchemaSequence : public ItemSequence
+{
+  private:
+    class NativeSchemaIterator : public Iterator
+    {
+      private:
+        NativeSchemaSequence* theSequence;
+        size_t theNext;
+        bool theIsOpen;
+
+      public:
+        NativeSchemaIterator(NativeSchemaSequence* aSequence) :
+          theSequence(aSequence),
+          theNext(0),
+          theIsOpen(false)
+        {}
+
+        virtual void open()
+        {
+          theNext = 0;
+          theIsOpen = true;
+        }
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    std::vector<XmlNode> theSchemas;
+    ItemFactory* theFactory;
+    CallStats_t theStats;
+
+  public:
+    NativeSchemaSequence(const std::vector<XmlNode>& aSchemas,
+        ItemFactory* aFactory, const CallStats_t& aStats) :
+      theSchemas(aSchemas),
+      theFactory(aFactory),
+      theStats(aStats)
+    {}
+
+    virtual Iterator_t getIterator()
+    { return new NativeSchemaIterator(this); }
+};
+
+
+/**
+ * The schema documents of a ResultCache hit, parsed when the iterator gets
+ * to them.
+ */
+class CachedSchemaSequence : public ItemSequence
+{
+  private:
+    class CachedSchemaIterator : public Iterator
+    {
+      private:
+        CachedSchemaSequence* theSequence;
+        size_t theNext;
+        bool theIsOpen;
+
+      public:
+        CachedSchemaIterator(CachedSchemaSequence* aSequence) :
+          theSequence(aSequence),
+          theNext(0),
+          theIsOpen(false)
+        {}
+
+        virtual void open()
+        {
+          theNext = 0;
+          theIsOpen = true;
+        }
+
+        virtual bool next(Item& aItem);
+
+        virtual void close()
+        { theIsOpen = false; }
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    ResultCache::Schemas_t theSchemas;
+    CallStats_t theStats;
+
+  public:
+    CachedSchemaSequence(const ResultCache::Schemas_t& aSchemas,
+        const CallStats_t& aStats) :
+      theSchemas(aSchemas),
+      theStats(aStats)
+    {}
+
+    virtual Iterator_t getIterator()
+    { return new CachedSchemaIterator(this); }
+};
+
+
+/**
+ * The schema documents of an inferred result, put into the ResultCache
+ * under its key once the iterator has returned the last of them. Each
+ * schema is serialized for the cache when the iterator gets to it, so the
+ * result is never held twice; a result that is not iterated to its end
+ * is not cached.
+ */
+class CachingSchemaSequence : public ItemSequence
+{
+  private:
+    class CachingSchemaIterator : public Iterator
+    {
+      private:
+        CachingSchemaSequence* theSequence;
+        Iterator_t theResult;
+        Serializer_t theSerializer;
+        // the schemas so far, null once they are cached
+        std::shared_ptr<std::vector<std::string> > theSchemas;
+        bool theIsOpen;
+
+      public:
+        CachingSchemaIterator(CachingSchemaSequence* aSequence);
+
+        virtual void open();
+
+        virtual bool next(Item& aItem);
+
+        virtual void close();
+
+        virtual bool isOpen() const
+        { return theIsOpen; }
+    };
+
+  private:
+    ItemSequence_t theResult;
+    std::string theKey;
+
+  public:
+    CachingSchemaSequence(const ItemSequence_t& aResult,
+        const std::string& aKey) :
+      theResult(aResult),
+      theKey(aKey)
+    {}
+
+    virtual Iterator_t getIterator()
+    { return new CachingSchemaIterator(this); }
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_SCHEMA_SEQUENCE_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_ST_OPTIONS_H
+#define ZORBA_SCHEMATOOLS_ST_OPTIONS_H
+
+#include <stdint.h>
+
+#include <sstream>
+#include <string>
+
+#include <zorba/item.h>
+#include <zorba/item_factory.h>
+
+namespace zorba
+{
+namespace schematools
+{
+
+class STOptions
+{
+public:
+  typedef enum
+  {
+    RUSSIAN_DOLL_DESIGN = 1,
+    SALAMI_SLICE_DESIGN = 2,
+    VENETIAN_BLIND_DESIGN = 3,
+  } design_t;
+
+  typedef enum
+  {
+    SMART_TYPES = 1,
+    ALWAYS_STRING_TYPES = 2,
+  } simple_content_types_t;
+
+  typedef enum
+  {
+    XMLBEANS_ENGINE = 1,
+    NATIVE_ENGINE = 2,
+  } engine_t;
+
+  typedef enum
+  {
+    XML_TRANSFER = 1,
+    EVENTS_TRANSFER = 2,
+  } transfer_t;
+
+private:
+  int theDesign;
+  int theSimpleContentType;
+  // useEnumeration NEVER = 1
+  int theUseEnumeration;
+  bool theVerbose;
+  int theEngine;
+  // worker threads of the native inference, 0 for one per hardware thread
+  unsigned int theParallelism;
+  // instances inferred from, drawn uniformly from the input; 0 for all
+  uint64_t theSampleSize;
+  // seed of the inst2xsd sample and of the xsd2inst-generate instances
+  uint64_t theSeed;
+  // inst2xsd results are looked up in and added to the ResultCache
+  bool theCache;
+  // how instances are sent to the JVM: serialized, or as EventStreamWriter
+  // events
+  int theTransfer;
+
+  bool theNetworkDownloads;
+  bool theNoPVR;
+  bool theNoUPA;
+
+public:
+  STOptions() : theDesign(STOptions::VENETIAN_BLIND_DESIGN),
+    theSimpleContentType(STOptions::SMART_TYPES),
+    theUseEnumeration(10), theVerbose(false),
+    theEngine(STOptions::XMLBEANS_ENGINE), theParallelism(1),
+    theSampleSize(0), theSeed(0), theCache(false),
+    theTransfer(STOptions::XML_TRANSFER),
+    theNetworkDownloads(false), theNoPVR(false), theNoUPA(false)
+  {}
+
+  void parseI(Item optionsNode, ItemFactory *itemFactory);
+  void parseX(Item optionsNode, ItemFactory *itemFactory);
+
+  // true if both carry the same values for the Inst2XsdOptions fields
+  bool sameInst2xsdOptions(const STOptions& other) const
+  {
+    return theDesign == other.theDesign &&
+           theSimpleContentType == other.theSimpleContentType &&
+           theUseEnumeration == other.theUseEnumeration &&
+           theVerbose == other.theVerbose;
+  }
+
+  // the options that make a difference to the inst2xsd schemas, as part of
+  // the ResultCache key; parallelism and transfer do not
+  std::string inst2xsdKey() const
+  {
+    std::ostringstream lKey;
+    lKey << "inst2xsd design=" << theDesign
+         << " simple-content-types=" << theSimpleContentType
+         << " use-enumeration=" << theUseEnumeration
+         << " verbose=" << theVerbose
+         << " engine=" << theEngine
+         << " sample-size=" << theSampleSize
+         << " seed=" << theSeed;
+    return lKey.str();
+  }
+
+  // all the options, the same for equal options
+  std::string key() const
+  {
+    std::ostringstream lKey;
+    lKey << inst2xsdKey()
+         << " parallelism=" << theParallelism
+         << " cache=" << theCache
+         << " transfer=" << theTransfer
+         << " network-downloads=" << theNetworkDownloads
+         << " no-pvr=" << theNoPVR
+         << " no-upa=" << theNoUPA;
+    return lKey.str();
+  }
+
+  // true if both carry the same values for the Xsd2InstOptions fields
+  bool sameXsd2instOptions(const STOptions& other) const
+  {
+    return theNetworkDownloads == other.theNetworkDownloads &&
+           theNoPVR == other.theNoPVR &&
+           theNoUPA == other.theNoUPA;
+  }
+
+  int getDesign() const
+  {
+    return theDesign;
+  }
+
+  int getSimpleContentType() const
+  {
+    return theSimpleContentType;
+  }
+
+  int getUseEnumeration() const
+  {
+    return theUseEnumeration;
+  }
+
+  bool isVerbose() const
+  {
+    return theVerbose;
+  }
+
+  int getEngine() const
+  {
+    return theEngine;
+  }
+
+  unsigned int getParallelism() const
+  {
+    return theParallelism;
+  }
+
+  uint64_t getSampleSize() const
+  {
+    return theSampleSize;
+  }
+
+  uint64_t getSeed() const
+  {
+    return theSeed;
+  }
+
+  // the cache hashes and keeps every instance before the engine sees the
+  // first, which the native engine and a sample, both of which take the
+  // instances one at a time, must not pay for: it is off with them
+  bool useCache() const
+  {
+    return theCache && theEngine != NATIVE_ENGINE && theSampleSize == 0;
+  }
+
+  int getTransfer() const
+  {
+    return theTransfer;
+  }
+
+  bool isNetworkDownloads() const
+  {
+    return theNetworkDownloads;
+  }
+
+  bool isNoPVR() const
+  {
+    return theNoPVR;
+  }
+
+  bool isNoUPA() const
+  {
+    return theNoUPA;
+  }
+};
+
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_ST_OPTIONS_H
+/* vim:set et sw=2 ts=2: */
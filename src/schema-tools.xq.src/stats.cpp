@@ -0,0 +1,326 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "schema-tools.h"
+#include "stats.h"
+
+namespace zorba
+{
+namespace schematools
+{
+
+static const char* FUNCTION_NAMES[FUNCTION_COUNT] =
+{
+  "inst2xsd", "inst2xsd-open", "inst2xsd-add", "inst2xsd-close",
+  "inst2xsd-files", "inst2xsd-refine",
+  "xsd2inst", "xsd2inst-all", "xsd2inst-generate"
+};
+
+static const char* PHASE_NAMES[PHASE_COUNT] =
+{
+  "serialize", "marshal", "java-parse", "infer", "compile", "generate",
+  "print", "result"
+};
+
+static const char* COUNTER_NAMES[COUNTER_COUNT] =
+{
+  "instances", "sampled", "schemas", "documents", "bytes-to-jvm", "bytes-from-jvm",
+  "cache-hits", "cache-misses", "schema-cache-hits", "schema-cache-misses",
+  "schema-cache-evictions", "schema-store-loads"
+};
+
+// the phases of PhaseTimes.take(), by index
+static const phase_t JAVA_PHASES[] =
+{
+  JAVA_PARSE_PHASE, INFER_PHASE, COMPILE_PHASE, GENERATE_PHASE, PRINT_PHASE
+};
+
+// the counters of PhaseTimes.take(), by index following the phases
+static const counter_t JAVA_COUNTERS[] =
+{
+  SCHEMA_CACHE_HITS_COUNTER, SCHEMA_CACHE_MISSES_COUNTER,
+  SCHEMA_CACHE_EVICTIONS_COUNTER, SCHEMA_STORE_LOADS_COUNTER
+};
+
+#define JAVA_PHASE_COUNT (sizeof(JAVA_PHASES) / sizeof(JAVA_PHASES[0]))
+
+static_assert(JAVA_PHASE_COUNT + sizeof(JAVA_COUNTERS) / sizeof(JAVA_COUNTERS[0])
+              == JAVA_TIMES_COUNT, "JAVA_TIMES_COUNT mirrors PhaseTimes.COUNT");
+
+
+/**
+ * Where trace lines go, configured once from SCHEMATOOLS_TRACE_ENV.
+ */
+class TraceSink
+{
+  private:
+    std::mutex theMutex;
+    std::ofstream theFile;
+    std::ostream* theOut;
+
+    TraceSink() : theOut(0)
+    {
+      const char* lValue = getenv(SCHEMATOOLS_TRACE_ENV);
+      if (!lValue || !*lValue || strcmp(lValue, "0") == 0)
+        return;
+
+      if (strcmp(lValue, "1") == 0 || strcmp(lValue, "stderr") == 0)
+      {
+        theOut = &std::cerr;
+        return;
+      }
+
+      theFile.open(lValue, std::ios::out | std::ios::app);
+      if (theFile)
+        theOut = &theFile;
+    }
+
+  public:
+    static TraceSink& getInstance()
+    {
+      static TraceSink lInstance;
+      return lInstance;
+    }
+
+    bool isOn() const
+    { return theOut != 0; }
+
+    void write(const std::string& aLine)
+    {
+      std::lock_guard<std::mutex> lLock(theMutex);
+      *theOut << aLine << std::endl;
+    }
+};
+
+
+static std::string toString(uint64_t aValue)
+{
+  std::ostringstream lOut;
+  lOut << aValue;
+  return lOut.str();
+}
+
+
+
+PhaseHistogram::PhaseHistogram() :
+  theCount(0),
+  theTotalNs(0),
+  theMaxNs(0)
+{
+  for (int i = 0; i < STATS_BUCKETS; ++i)
+    theBuckets[i] = 0;
+}
+
+
+void PhaseHistogram::record(uint64_t aNs)
+{
+  theCount.fetch_add(1, std::memory_order_relaxed);
+  theTotalNs.fetch_add(aNs, std::memory_order_relaxed);
+
+  uint64_t lMax = theMaxNs.load(std::memory_order_relaxed);
+  while (aNs > lMax &&
+         !theMaxNs.compare_exchange_weak(lMax, aNs, std::memory_order_relaxed))
+    ;
+
+  int lBucket = 0;
+  for (uint64_t lUs = aNs / 1000; lUs > 0 && lBucket < STATS_BUCKETS - 1; lUs >>= 1)
+    ++lBucket;
+  theBuckets[lBucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+
+ModuleStats::ModuleStats()
+{
+  for (int i = 0; i < FUNCTION_COUNT; ++i)
+    theCalls[i] = 0;
+  for (int i = 0; i < COUNTER_COUNT; ++i)
+    theCounters[i] = 0;
+}
+
+
+XmlNode ModuleStats::toXml() const
+{
+  XmlNode lStats(SCHEMATOOLS_MODULE_NAMESPACE, "st", "stats");
+  lStats.theBindings.push_back(
+      XmlNode::Binding("st", SCHEMATOOLS_MODULE_NAMESPACE));
+
+  for (int i = 0; i < FUNCTION_COUNT; ++i)
+  {
+    XmlNode lCalls(SCHEMATOOLS_MODULE_NAMESPACE, "st", "calls");
+    lCalls.attr("function", FUNCTION_NAMES[i]);
+    lCalls.append(XmlNode::text(toString(theCalls[i].load())));
+    lStats.append(lCalls);
+  }
+
+  for (int i = 0; i < COUNTER_COUNT; ++i)
+  {
+    XmlNode lCounter(SCHEMATOOLS_MODULE_NAMESPACE, "st", "counter");
+    lCounter.attr("name", COUNTER_NAMES[i]);
+    lCounter.append(XmlNode::text(toString(theCounters[i].load())));
+    lStats.append(lCounter);
+  }
+
+  for (int i = 0; i < PHASE_COUNT; ++i)
+  {
+    const PhaseHistogram& lHistogram = thePhases[i];
+    XmlNode lPhase(SCHEMATOOLS_MODULE_NAMESPACE, "st", "phase");
+    lPhase.attr("name", PHASE_NAMES[i])
+          .attr("count", toString(lHistogram.theCount.load()))
+          .attr("total-us", toString(lHistogram.theTotalNs.load() / 1000))
+          .attr("max-us", toString(lHistogram.theMaxNs.load() / 1000));
+
+    // only the buckets calls fell into
+    for (int b = 0; b < STATS_BUCKETS; ++b)
+    {
+      uint64_t lCount = lHistogram.theBuckets[b].load();
+      if (lCount == 0)
+        continue;
+      XmlNode lBucket(SCHEMATOOLS_MODULE_NAMESPACE, "st", "bucket");
+      if (b < STATS_BUCKETS - 1)
+        lBucket.attr("below-us", toString(uint64_t(1) << b));
+      lBucket.append(XmlNode::text(toString(lCount)));
+      lPhase.append(lBucket);
+    }
+    lStats.append(lPhase);
+  }
+
+  return lStats;
+}
+
+
+
+CallStats::CallStats(ModuleStats& aModule, function_t aFunction) :
+  theModule(aModule),
+  theFunction(aFunction),
+  theEngine("xmlbeans"),
+  theStart(std::chrono::steady_clock::now())
+{
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    thePhases[i] = 0;
+  for (int i = 0; i < COUNTER_COUNT; ++i)
+    theCounters[i] = 0;
+
+  theModule.call(theFunction);
+}
+
+
+CallStats::~CallStats()
+{
+  // the histograms hold the time of each phase per call
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    if (thePhases[i] > 0)
+      theModule.record((phase_t)i, thePhases[i]);
+
+  TraceSink& lSink = TraceSink::getInstance();
+  if (!lSink.isOn())
+    return;
+
+  uint64_t lElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - theStart).count();
+
+  std::ostringstream lLine;
+  lLine << "schema-tools: function=" << FUNCTION_NAMES[theFunction]
+        << " engine=" << theEngine
+        << " elapsed-us=" << lElapsed;
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    lLine << " " << PHASE_NAMES[i] << "-us=" << thePhases[i] / 1000;
+  for (int i = 0; i < COUNTER_COUNT; ++i)
+    lLine << " " << COUNTER_NAMES[i] << "=" << theCounters[i];
+  lSink.write(lLine.str());
+}
+
+
+void CallStats::count(counter_t aCounter, uint64_t aN)
+{
+  theCounters[aCounter] += aN;
+  theModule.count(aCounter, aN);
+}
+
+
+void CallStats::record(phase_t aPhase, uint64_t aNs)
+{
+  thePhases[aPhase] += aNs;
+}
+
+
+void CallStats::recordJavaTimes(const uint64_t* aValues, size_t aCount)
+{
+  aCount = std::min(aCount, (size_t)JAVA_TIMES_COUNT);
+  for (size_t i = 0; i < aCount; ++i)
+  {
+    if (i < JAVA_PHASE_COUNT)
+      record(JAVA_PHASES[i], aValues[i]);
+    else if (aValues[i])
+      count(JAVA_COUNTERS[i - JAVA_PHASE_COUNT], aValues[i]);
+  }
+}
+
+
+void CallStats::takeJavaTimes(JNIEnv* env, const JniCache& aCache,
+                              jobject aTimes, jthrowable& lException)
+{
+  jlongArray lTimes = (jlongArray)env->CallObjectMethod(aTimes,
+      aCache.thePhaseTimesTake);
+  CHECK_EXCEPTION(env);
+
+  jlong lValues[JAVA_TIMES_COUNT];
+  jsize lCount = std::min(env->GetArrayLength(lTimes),
+      (jsize)JAVA_TIMES_COUNT);
+  env->GetLongArrayRegion(lTimes, 0, lCount, lValues);
+  env->DeleteLocalRef(lTimes);
+  CHECK_EXCEPTION(env);
+
+  uint64_t lTimes64[JAVA_TIMES_COUNT];
+  for (jsize i = 0; i < lCount; ++i)
+    lTimes64[i] = lValues[i];
+  recordJavaTimes(lTimes64, lCount);
+}
+
+
+void CallStats::takeJavaTimes(JNIEnv* env, const JniCache& aCache,
+                              jthrowable& lException)
+{
+  jobject lTimes = env->CallStaticObjectMethod(aCache.thePhaseTimesClass,
+      aCache.thePhaseTimesCurrent);
+  CHECK_EXCEPTION(env);
+  takeJavaTimes(env, aCache, lTimes, lException);
+  env->DeleteLocalRef(lTimes);
+}
+
+
+
+void PhaseTimer::stop()
+{
+  if (!theStats)
+    return;
+
+  theStats->record(thePhase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - theStart).count());
+  theStats = 0;
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_STATS_H
+#define ZORBA_SCHEMATOOLS_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <jni.h>
+
+#include "jni_cache.h"
+#include "node_builder.h"
+
+// environment variable that turns the per call trace on: "1" or "stderr"
+// writes it to stderr, any other value is the file it is appended to
+#define SCHEMATOOLS_TRACE_ENV "ZORBA_SCHEMATOOLS_TRACE"
+
+// histogram buckets, bucket i counts durations below 2^i microseconds
+#define STATS_BUCKETS 32
+
+// values PhaseTimes.take() returns, the times of the Java phases and then
+// the counts of the schema type system cache and store
+#define JAVA_TIMES_COUNT 9
+
+namespace zorba
+{
+namespace schematools
+{
+
+typedef enum
+{
+  INST2XSD_FUNCTION = 0,
+  INST2XSD_OPEN_FUNCTION,
+  INST2XSD_ADD_FUNCTION,
+  INST2XSD_CLOSE_FUNCTION,
+  INST2XSD_FILES_FUNCTION,
+  INST2XSD_REFINE_FUNCTION,
+  XSD2INST_FUNCTION,
+  XSD2INST_ALL_FUNCTION,
+  XSD2INST_GENERATE_FUNCTION,
+  FUNCTION_COUNT
+} function_t;
+
+typedef enum
+{
+  SERIALIZE_PHASE = 0,  // Zorba serializing instances or schemas
+  MARSHAL_PHASE,        // copying text into and out of the JVM
+  JAVA_PARSE_PHASE,     // XMLBeans parsing the instances
+  INFER_PHASE,          // schema inference, by either engine
+  COMPILE_PHASE,        // reading and compiling the schemas of xsd2inst
+  GENERATE_PHASE,       // sample generation, by either engine
+  PRINT_PHASE,          // XMLBeans printing the inferred schemas
+  RESULT_PHASE,         // Zorba parsing or building the result documents
+  PHASE_COUNT
+} phase_t;
+
+typedef enum
+{
+  INSTANCES_COUNTER = 0,  // instances given to inst2xsd
+  SAMPLED_COUNTER,        // instances of inst2xsd reservoir samples
+  SCHEMAS_COUNTER,        // schema documents given to xsd2inst
+  DOCUMENTS_COUNTER,      // result documents, schemas or samples
+  BYTES_TO_JVM_COUNTER,   // serialized bytes sent to the JVM
+  BYTES_FROM_JVM_COUNTER, // result bytes copied out of the JVM
+  CACHE_HITS_COUNTER,     // inst2xsd results found in the ResultCache
+  CACHE_MISSES_COUNTER,   // inst2xsd results not found there
+  SCHEMA_CACHE_HITS_COUNTER,      // xsd2inst schema sets found compiled in
+                                  // the SchemaTypeSystemCache of the JVM
+  SCHEMA_CACHE_MISSES_COUNTER,    // xsd2inst schema sets not found there
+  SCHEMA_CACHE_EVICTIONS_COUNTER, // schema sets evicted from there
+  SCHEMA_STORE_LOADS_COUNTER,     // schema sets loaded from the
+                                  // SchemaTypeSystemStore on disk
+  COUNTER_COUNT
+} counter_t;
+
+
+/**
+ * Count, total, maximum and log2 histogram of the durations of one phase.
+ */
+class PhaseHistogram
+{
+  public:
+    std::atomic<uint64_t> theCount;
+    std::atomic<uint64_t> theTotalNs;
+    std::atomic<uint64_t> theMaxNs;
+    std::atomic<uint64_t> theBuckets[STATS_BUCKETS];
+
+  public:
+    PhaseHistogram();
+
+    void record(uint64_t aNs);
+};
+
+
+/**
+ * Timings and counters of all calls of a module, as returned by
+ * schema-tools:stats(). Updated with relaxed atomics, so concurrent queries
+ * do not wait for each other to record.
+ */
+class ModuleStats
+{
+  private:
+    std::atomic<uint64_t> theCalls[FUNCTION_COUNT];
+    std::atomic<uint64_t> theCounters[COUNTER_COUNT];
+    PhaseHistogram thePhases[PHASE_COUNT];
+
+  public:
+    ModuleStats();
+
+    void call(function_t aFunction)
+    { theCalls[aFunction].fetch_add(1, std::memory_order_relaxed); }
+
+    void count(counter_t aCounter, uint64_t aN)
+    { theCounters[aCounter].fetch_add(aN, std::memory_order_relaxed); }
+
+    void record(phase_t aPhase, uint64_t aNs)
+    { thePhases[aPhase].record(aNs); }
+
+    // the schema-tools:stats element
+    XmlNode toXml() const;
+};
+
+
+/**
+ * The phases and counters of one call.
+ *
+ * Everything is recorded in the ModuleStats as well. The result of a call
+ * may be built lazily, so the sequences it returns share the CallStats;
+ * the trace line, if the trace is on, is written when the last of them is
+ * gone.
+ */
+class CallStats
+{
+  private:
+    ModuleStats& theModule;
+    function_t theFunction;
+    const char* theEngine;
+    std::chrono::steady_clock::time_point theStart;
+    uint64_t thePhases[PHASE_COUNT];
+    uint64_t theCounters[COUNTER_COUNT];
+
+  public:
+    CallStats(ModuleStats& aModule, function_t aFunction);
+
+    ~CallStats();
+
+    void setEngine(const char* aEngine)
+    { theEngine = aEngine; }
+
+    void count(counter_t aCounter, uint64_t aN = 1);
+
+    void record(phase_t aPhase, uint64_t aNs);
+
+    // records aValues, the aCount times and counts PhaseTimes.take()
+    // returns
+    void recordJavaTimes(const uint64_t* aValues, size_t aCount);
+
+    /**
+     * Records the times and counts of the Java PhaseTimes aTimes collected
+     * since they were taken last. Throws JavaException like CHECK_EXCEPTION.
+     */
+    void takeJavaTimes(JNIEnv* env, const JniCache& aCache, jobject aTimes,
+        jthrowable& lException);
+
+    // takeJavaTimes for PhaseTimes.current() of the calling thread
+    void takeJavaTimes(JNIEnv* env, const JniCache& aCache,
+        jthrowable& lException);
+};
+
+typedef std::shared_ptr<CallStats> CallStats_t;
+
+
+/**
+ * Records the time until stop() or the end of the scope as aPhase.
+ */
+class PhaseTimer
+{
+  private:
+    CallStats* theStats;
+    phase_t thePhase;
+    std::chrono::steady_clock::time_point theStart;
+
+  public:
+    PhaseTimer(CallStats* aStats, phase_t aPhase) :
+      theStats(aStats),
+      thePhase(aPhase),
+      theStart(std::chrono::steady_clock::now())
+    {}
+
+    ~PhaseTimer()
+    { stop(); }
+
+    void stop();
+};
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_STATS_H
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,602 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "JavaVMSingleton.h"
+
+#include "event_stream.h"
+#include "worker_pool.h"
+
+// queued frames are written once they are this large
+#define WORKER_SEND_BUFFER_SIZE (64 * 1024)
+
+// how long a call waits for a worker it started to listen
+#define WORKER_START_TIMEOUT_MS 30000
+
+#define WORKER_CLASS "org.zorbaxquery.modules.schemaTools.Worker"
+
+namespace zorba
+{
+namespace schematools
+{
+
+void appendInt(std::string& aPayload, uint32_t aValue)
+{
+  aPayload += (char)(aValue >> 24);
+  aPayload += (char)(aValue >> 16);
+  aPayload += (char)(aValue >> 8);
+  aPayload += (char)aValue;
+}
+
+
+void appendString(std::string& aPayload, const std::string& aValue)
+{
+  appendInt(aPayload, aValue.size());
+  aPayload += aValue;
+}
+
+
+static uint32_t decodeInt(const char* aData)
+{
+  const unsigned char* lData = (const unsigned char*)aData;
+  return (uint32_t)lData[0] << 24 | (uint32_t)lData[1] << 16 |
+         (uint32_t)lData[2] << 8 | (uint32_t)lData[3];
+}
+
+
+/**
+ * Reads the fields of a payload the worker wrote.
+ */
+class PayloadReader
+{
+  private:
+    const std::string& thePayload;
+    size_t thePos;
+
+  public:
+    PayloadReader(const std::string& aPayload) :
+      thePayload(aPayload),
+      thePos(0)
+    {}
+
+    const char* read(size_t aSize)
+    {
+      if (aSize > thePayload.size() - thePos)
+        throw WorkerException("WORKER001",
+            "Truncated answer from the schema-tools worker");
+      const char* lData = thePayload.data() + thePos;
+      thePos += aSize;
+      return lData;
+    }
+
+    uint32_t readInt()
+    { return decodeInt(read(4)); }
+
+    uint64_t readLong()
+    {
+      uint64_t lHigh = readInt();
+      return lHigh << 32 | readInt();
+    }
+
+    std::string readString()
+    {
+      uint32_t lSize = readInt();
+      return std::string(read(lSize), lSize);
+    }
+};
+
+
+
+WorkerConnection::WorkerConnection(int aSocket, size_t aWorker) :
+  theSocket(aSocket),
+  theWorker(aWorker),
+  theOpen(0),
+  theInSession(false),
+  theBroken(false),
+  theLoad(0)
+{
+}
+
+
+WorkerConnection::~WorkerConnection()
+{
+#ifndef WIN32
+  close(theSocket);
+#endif
+}
+
+
+bool WorkerConnection::isStale() const
+{
+#ifndef WIN32
+  // an idle connection has nothing to read: anything there is the end of
+  // the stream, or an error
+  struct pollfd lPoll;
+  lPoll.fd = theSocket;
+  lPoll.events = POLLIN;
+  lPoll.revents = 0;
+  return poll(&lPoll, 1, 0) != 0;
+#else
+  return true;
+#endif
+}
+
+
+void WorkerConnection::send(int aType, const std::string& aPayload,
+                            bool aRequest)
+{
+  theOut += (char)aType;
+  appendInt(theOut, aPayload.size());
+  theOut += aPayload;
+  if (aRequest)
+    ++theOpen;
+  // the answer to FINISH ends the session in the worker, whatever it is
+  if (aType == WORKER_INST2XSD_OPEN)
+    theInSession = true;
+  else if (aType == WORKER_INST2XSD_FINISH)
+    theInSession = false;
+
+  if (theOut.size() >= WORKER_SEND_BUFFER_SIZE)
+    flush();
+}
+
+
+void WorkerConnection::flush()
+{
+#ifndef WIN32
+  // MSG_NOSIGNAL: a worker that went away is an error, not SIGPIPE
+  int lFlags = 0;
+#ifdef MSG_NOSIGNAL
+  lFlags = MSG_NOSIGNAL;
+#endif
+  size_t lPos = 0;
+  while (lPos < theOut.size())
+  {
+    ssize_t lWritten = ::send(theSocket, theOut.data() + lPos,
+        theOut.size() - lPos, lFlags);
+    if (lWritten < 0 && errno == EINTR)
+      continue;
+    if (lWritten <= 0)
+    {
+      theBroken = true;
+      throw WorkerException("WORKER001",
+          std::string("Lost the connection to the schema-tools worker: ") +
+          strerror(errno));
+    }
+    lPos += lWritten;
+  }
+#endif
+  theOut.clear();
+}
+
+
+void WorkerConnection::readFully(char* aData, size_t aSize)
+{
+#ifndef WIN32
+  while (aSize > 0)
+  {
+    ssize_t lRead = recv(theSocket, aData, aSize, 0);
+    if (lRead < 0 && errno == EINTR)
+      continue;
+    if (lRead <= 0)
+    {
+      theBroken = true;
+      throw WorkerException("WORKER001",
+          "The schema-tools worker closed the connection (did it crash?)");
+    }
+    aData += lRead;
+    aSize -= lRead;
+  }
+#endif
+}
+
+
+std::vector<Item> WorkerConnection::receiveResult(ItemFactory* aFactory,
+                                                  CallStats* aStats)
+{
+  flush();
+
+  char lHeader[5];
+  readFully(lHeader, sizeof(lHeader));
+  std::string lPayload(decodeInt(lHeader + 1), '\0');
+  readFully(&lPayload[0], lPayload.size());
+  --theOpen;
+
+  PayloadReader lReader(lPayload);
+  theLoad = lReader.readInt();
+  switch (lHeader[0])
+  {
+  case WORKER_RESULT:
+    break;
+  case WORKER_ERROR:
+    throw WorkerException("JAVA-EXCEPTION",
+        "A Java Exception was thrown:\n" + lReader.readString());
+  default:
+    theBroken = true;
+    throw WorkerException("WORKER001",
+        "Unexpected answer from the schema-tools worker");
+  }
+
+  // times and counts, as PhaseTimes.take() returns them
+  uint64_t lTimes[JAVA_TIMES_COUNT];
+  for (int i = 0; i < JAVA_TIMES_COUNT; ++i)
+    lTimes[i] = lReader.readLong();
+  aStats->recordJavaTimes(lTimes, JAVA_TIMES_COUNT);
+
+  std::vector<Item> lDocs;
+  for (uint32_t i = lReader.readInt(); i > 0; --i)
+  {
+    uint32_t lSize = lReader.readInt();
+    lDocs.push_back(
+        buildEventDocument(lReader.read(lSize), lSize, aFactory, aStats));
+  }
+  return lDocs;
+}
+
+
+
+WorkerPool::WorkerPool()
+{
+#ifndef WIN32
+  const char* lCount = getenv(SCHEMATOOLS_WORKERS_ENV);
+  if (!lCount || atoi(lCount) <= 0)
+    return;
+
+  theWorkers.resize(atoi(lCount));
+  for (size_t i = 0; i < theWorkers.size(); ++i)
+  {
+    theWorkers[i].theInFlight = 0;
+    theWorkers[i].theLoad = 0;
+  }
+
+  // one directory per user, the workers run as the processes using them
+  const char* lDir = getenv(SCHEMATOOLS_WORKER_DIR_ENV);
+  if (lDir && *lDir)
+    theDir = lDir;
+  else if ((lDir = getenv("XDG_RUNTIME_DIR")) && *lDir)
+    theDir = std::string(lDir) + "/zorba-schema-tools";
+  else
+  {
+    std::ostringstream lDefault;
+    lDefault << "/tmp/zorba-schema-tools-" << getuid();
+    theDir = lDefault.str();
+  }
+
+  // whoever can put a socket in the directory gets the schemas and
+  // instances and answers for the workers: it must be the user's own, and
+  // not one another user made first under the same name
+  struct stat lStat;
+  if (mkdir(theDir.c_str(), 0700) != 0 && errno != EEXIST)
+    theDirError = std::string("Could not create ") + theDir + ": " +
+        strerror(errno);
+  else if (lstat(theDir.c_str(), &lStat) != 0)
+    theDirError = std::string("Could not read ") + theDir + ": " +
+        strerror(errno);
+  else if (!S_ISDIR(lStat.st_mode))
+    theDirError = theDir + " is not a directory";
+  else if (lStat.st_uid != getuid())
+    theDirError = theDir + " is not owned by the user";
+  else if ((lStat.st_mode & 0777) != 0700)
+    theDirError = theDir + " is accessible to other users (mode must be 0700)";
+
+  const char* lClassPath = getenv(SCHEMATOOLS_WORKER_CLASSPATH_ENV);
+  if (lClassPath)
+    theClassPath = lClassPath;
+#endif
+}
+
+
+WorkerPool& WorkerPool::getInstance()
+{
+  static WorkerPool lInstance;
+  return lInstance;
+}
+
+
+std::string WorkerPool::socketPath(size_t aWorker) const
+{
+  std::ostringstream lPath;
+  lPath << theDir << "/worker-" << aWorker << ".sock";
+  return lPath.str();
+}
+
+
+std::unique_ptr<WorkerConnection>
+WorkerPool::acquire(const StaticContext* aContext)
+{
+  if (!theDirError.empty())
+    throw WorkerException("WORKER001",
+        "Schema-tools worker directory rejected: " + theDirError);
+
+  size_t lWorker = 0;
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    for (size_t i = 1; i < theWorkers.size(); ++i)
+      if (theWorkers[i].theInFlight + theWorkers[i].theLoad <
+          theWorkers[lWorker].theInFlight + theWorkers[lWorker].theLoad)
+        lWorker = i;
+
+    Worker& lChosen = theWorkers[lWorker];
+    ++lChosen.theInFlight;
+    while (!lChosen.theIdle.empty())
+    {
+      std::unique_ptr<WorkerConnection> lConnection =
+          std::move(lChosen.theIdle.back());
+      lChosen.theIdle.pop_back();
+      // a worker that was restarted closed the connections to the old one
+      if (!lConnection->isStale())
+        return lConnection;
+    }
+  }
+
+  try
+  {
+    return std::unique_ptr<WorkerConnection>(
+        new WorkerConnection(connect(lWorker, aContext), lWorker));
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    --theWorkers[lWorker].theInFlight;
+    throw;
+  }
+}
+
+
+void WorkerPool::release(std::unique_ptr<WorkerConnection> aConnection)
+{
+  if (!aConnection)
+    return;
+
+  std::lock_guard<std::mutex> lLock(theMutex);
+  Worker& lWorker = theWorkers[aConnection->getWorker()];
+  --lWorker.theInFlight;
+  lWorker.theLoad = aConnection->getLoad();
+  // a connection with an unanswered request would get its answer next, and
+  // one with an unfinished session would add the next user's instances to
+  // it; both are closed
+  if (aConnection->isReusable())
+    lWorker.theIdle.push_back(std::move(aConnection));
+}
+
+
+bool WorkerPool::startWorkers()
+{
+  if (!theDirError.empty())
+    throw WorkerException("WORKER001",
+        "Schema-tools worker directory rejected: " + theDirError);
+
+  {
+    std::lock_guard<std::mutex> lLock(theMutex);
+    if (theClassPath.empty())
+      return false;
+  }
+
+  for (size_t i = 0; i < theWorkers.size(); ++i)
+  {
+    std::unique_ptr<WorkerConnection> lConnection(
+        new WorkerConnection(connect(i, 0), i));
+    std::lock_guard<std::mutex> lLock(theMutex);
+    theWorkers[i].theIdle.push_back(std::move(lConnection));
+  }
+  return true;
+}
+
+
+#ifndef WIN32
+// a connected socket, or -1 if nothing listens at aPath
+static int connectSocket(const std::string& aPath)
+{
+  struct sockaddr_un lAddress;
+  memset(&lAddress, 0, sizeof(lAddress));
+  if (aPath.size() >= sizeof(lAddress.sun_path))
+    throw WorkerException("WORKER001",
+        "Schema-tools worker socket path too long: " + aPath);
+  lAddress.sun_family = AF_UNIX;
+  strcpy(lAddress.sun_path, aPath.c_str());
+
+  int lSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (lSocket < 0)
+    throw WorkerException("WORKER001",
+        std::string("Could not create a socket: ") + strerror(errno));
+  // not inherited by the workers this process starts
+  fcntl(lSocket, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+  int lOn = 1;
+  setsockopt(lSocket, SOL_SOCKET, SO_NOSIGPIPE, &lOn, sizeof(lOn));
+#endif
+
+  if (::connect(lSocket, (struct sockaddr*)&lAddress, sizeof(lAddress)) != 0)
+  {
+    close(lSocket);
+    return -1;
+  }
+  return lSocket;
+}
+#endif
+
+
+int WorkerPool::connect(size_t aWorker, const StaticContext* aContext)
+{
+#ifndef WIN32
+  std::string lPath = socketPath(aWorker);
+  int lSocket = connectSocket(lPath);
+  if (lSocket >= 0)
+    return lSocket;
+
+  start(aWorker, aContext);
+
+  // the worker, ours or another process's, listens once its JVM is up
+  std::chrono::steady_clock::time_point lDeadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(WORKER_START_TIMEOUT_MS);
+  for (unsigned lWait = 10; ; lWait = std::min(2 * lWait, 200U))
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(lWait));
+    lSocket = connectSocket(lPath);
+    if (lSocket >= 0)
+      return lSocket;
+    if (std::chrono::steady_clock::now() > lDeadline)
+    {
+      std::ostringstream lLog;
+      lLog << theDir << "/worker-" << aWorker << ".log";
+      throw WorkerException("WORKER001",
+          "Could not connect to the schema-tools worker at " + lPath +
+          " (see " + lLog.str() + ")");
+    }
+  }
+#else
+  throw WorkerException("WORKER001",
+      "Schema-tools workers are not supported on this platform");
+#endif
+}
+
+
+void WorkerPool::start(size_t aWorker, const StaticContext* aContext)
+{
+#ifndef WIN32
+  std::ostringstream lBase;
+  lBase << theDir << "/worker-" << aWorker;
+  std::string lLock = lBase.str() + ".lock";
+  std::string lLog = lBase.str() + ".log";
+
+  // the worker holds a write lock on the lock file while it runs; one that
+  // starts while another holds it exits, so a race only costs a JVM start
+  int lFd = open(lLock.c_str(), O_RDWR | O_CREAT, 0600);
+  if (lFd >= 0)
+  {
+    struct flock lTest;
+    memset(&lTest, 0, sizeof(lTest));
+    lTest.l_type = F_WRLCK;
+    lTest.l_whence = SEEK_SET;
+    bool lHeld = fcntl(lFd, F_GETLK, &lTest) == 0 && lTest.l_type != F_UNLCK;
+    close(lFd);
+    if (lHeld)
+      return;
+  }
+
+  std::string lClassPath;
+  {
+    std::lock_guard<std::mutex> lGuard(theMutex);
+    if (theClassPath.empty())
+      theClassPath =
+          zorba::jvm::JavaVMSingleton::computeClassPath(aContext).str();
+    lClassPath = theClassPath;
+  }
+
+  std::string lJava = "java";
+  const char* lValue = getenv(SCHEMATOOLS_WORKER_JAVA_ENV);
+  if (lValue && *lValue)
+    lJava = lValue;
+  else if ((lValue = getenv("JAVA_HOME")) && *lValue)
+    lJava = std::string(lValue) + "/bin/java";
+
+  std::vector<std::string> lArgs;
+  lArgs.push_back(lJava);
+  lValue = getenv(SCHEMATOOLS_WORKER_OPTIONS_ENV);
+  if (lValue)
+  {
+    std::istringstream lOptions(lValue);
+    std::string lOption;
+    while (lOptions >> lOption)
+      lArgs.push_back(lOption);
+  }
+  lArgs.push_back("-cp");
+  lArgs.push_back(lClassPath);
+  lArgs.push_back(WORKER_CLASS);
+  lArgs.push_back(socketPath(aWorker));
+  lArgs.push_back(lLock);
+
+  // everything the child needs is prepared before fork()
+  std::vector<char*> lArgv;
+  for (size_t i = 0; i < lArgs.size(); ++i)
+    lArgv.push_back(&lArgs[i][0]);
+  lArgv.push_back(0);
+  int lOut = open(lLog.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600);
+  int lIn = open("/dev/null", O_RDONLY);
+  long lMaxFd = sysconf(_SC_OPEN_MAX);
+
+  // forked twice, the worker belongs to no process using it and outlives
+  // them all
+  pid_t lChild = fork();
+  if (lChild == 0)
+  {
+    setsid();
+    if (fork() != 0)
+      _exit(0);
+    dup2(lIn, 0);
+    dup2(lOut, 1);
+    dup2(lOut, 2);
+    for (long i = 3; i < lMaxFd; ++i)
+      close(i);
+    signal(SIGPIPE, SIG_DFL);
+    execvp(lArgv[0], lArgv.data());
+    _exit(127);
+  }
+  if (lOut >= 0)
+    close(lOut);
+  if (lIn >= 0)
+    close(lIn);
+  if (lChild > 0)
+    waitpid(lChild, 0, 0);
+#endif
+}
+
+
+std::vector<Item> WorkerPool::xsd2inst(const std::vector<std::string>& aSchemas,
+                                       const std::vector<std::string>& aRootNames,
+                                       const STOptions& aOptions,
+                                       const StaticContext* aContext,
+                                       ItemFactory* aFactory,
+                                       CallStats* aStats)
+{
+  std::string lPayload;
+  appendInt(lPayload, aOptions.isNetworkDownloads());
+  appendInt(lPayload, aOptions.isNoPVR());
+  appendInt(lPayload, aOptions.isNoUPA());
+  appendInt(lPayload, aSchemas.size());
+  for (size_t i = 0; i < aSchemas.size(); ++i)
+    appendString(lPayload, aSchemas[i]);
+  appendInt(lPayload, aRootNames.size());
+  for (size_t i = 0; i < aRootNames.size(); ++i)
+    appendString(lPayload, aRootNames[i]);
+  aStats->count(BYTES_TO_JVM_COUNTER, lPayload.size());
+
+  WorkerLease lWorker(aContext);
+  lWorker->send(WORKER_XSD2INST, lPayload, true);
+  return lWorker->receiveResult(aFactory, aStats);
+}
+
+}}; // namespace zorba, schematools
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ZORBA_SCHEMATOOLS_WORKER_POOL_H
+#define ZORBA_SCHEMATOOLS_WORKER_POOL_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <zorba/item.h>
+#include <zorba/item_factory.h>
+#include <zorba/static_context.h>
+
+#include "st_options.h"
+#include "stats.h"
+
+// environment variable with the number of worker processes the XMLBeans
+// engine runs in instead of the JVM of the process; unset or 0 for none
+#define SCHEMATOOLS_WORKERS_ENV "ZORBA_SCHEMATOOLS_WORKERS"
+
+// environment variable naming the directory of the worker sockets, locks
+// and logs; processes using the same directory share the workers. It
+// defaults to zorba-schema-tools in $XDG_RUNTIME_DIR, or else to
+// /tmp/zorba-schema-tools-<uid>, and must be a directory of the user with
+// mode 0700, or no worker is used.
+#define SCHEMATOOLS_WORKER_DIR_ENV "ZORBA_SCHEMATOOLS_WORKER_DIR"
+
+// environment variables with the java launcher of the workers, its options
+// (separated by spaces) and the classpath of the module's jars, which
+// defaults to the one the module's JVM would use
+#define SCHEMATOOLS_WORKER_JAVA_ENV "ZORBA_SCHEMATOOLS_WORKER_JAVA"
+#define SCHEMATOOLS_WORKER_OPTIONS_ENV "ZORBA_SCHEMATOOLS_WORKER_OPTIONS"
+#define SCHEMATOOLS_WORKER_CLASSPATH_ENV "ZORBA_SCHEMATOOLS_WORKER_CLASSPATH"
+
+// frame types, mirrored in Worker.java
+#define WORKER_INST2XSD_OPEN 1
+#define WORKER_INST2XSD_ADD 2
+#define WORKER_INST2XSD_FINISH 3
+#define WORKER_XSD2INST 4
+#define WORKER_RESULT 16
+#define WORKER_ERROR 17
+
+namespace zorba
+{
+namespace schematools
+{
+
+/**
+ * A failed worker request. theCode is the schema-tools error the calling
+ * function raises: WORKER001 if the worker could not be reached or went
+ * away, JAVA-EXCEPTION if the request itself failed in the worker.
+ */
+class WorkerException
+{
+  public:
+    std::string theCode;
+    std::string theMessage;
+
+  public:
+    WorkerException(const std::string& aCode, const std::string& aMessage) :
+      theCode(aCode),
+      theMessage(aMessage)
+    {}
+};
+
+
+/**
+ * A connection to a worker process. Every frame is a type byte, the
+ * big-endian 32-bit length of the payload, and the payload.
+ *
+ * Frames are queued and written together, so the instances of a session
+ * are pipelined: the worker only answers INST2XSD_FINISH and XSD2INST,
+ * with WORKER_RESULT or WORKER_ERROR. A connection goes back to the pool
+ * only once every request it sent is answered and its inst2xsd session,
+ * if it opened one, is finished; any other is closed, which ends the
+ * session in the worker.
+ */
+class WorkerConnection
+{
+  private:
+    int theSocket;
+    size_t theWorker;
+    std::string theOut;
+    // requests sent and not answered yet
+    unsigned theOpen;
+    // whether an inst2xsd session was opened and not finished
+    bool theInSession;
+    bool theBroken;
+    // active requests of the worker, from its last answer
+    uint32_t theLoad;
+
+  public:
+    WorkerConnection(int aSocket, size_t aWorker);
+
+    ~WorkerConnection();
+
+    size_t getWorker() const
+    { return theWorker; }
+
+    uint32_t getLoad() const
+    { return theLoad; }
+
+    // whether the connection can take another request: the worker
+    // answered all of them, and no session or frame of the last user is
+    // left to precede it
+    bool isReusable() const
+    { return !theBroken && theOpen == 0 && !theInSession && theOut.empty(); }
+
+    // whether the worker closed the idle connection, or wrote to it
+    bool isStale() const;
+
+    // queues a frame, aRequest if the worker answers it; the queue is
+    // written when it is large; throws WorkerException
+    void send(int aType, const std::string& aPayload, bool aRequest = false);
+
+    // writes the queued frames; throws WorkerException
+    void flush();
+
+    // the documents of the answer to the oldest open request, built
+    // through aFactory, and the Java times recorded in aStats; throws
+    // WorkerException
+    std::vector<Item> receiveResult(ItemFactory* aFactory, CallStats* aStats);
+
+  private:
+    void readFully(char* aData, size_t aSize);
+
+    WorkerConnection(const WorkerConnection&);
+    WorkerConnection& operator=(const WorkerConnection&);
+};
+
+
+/**
+ * The workers of the module, each a long-lived Java process listening on
+ * a Unix domain socket worker-<n>.sock of the worker directory.
+ *
+ * A worker holds the lock file worker-<n>.lock for as long as it runs, so
+ * of all processes sharing the directory only one starts it, and a worker
+ * that crashed is started again by the next call that can not connect.
+ * Idle connections are kept per worker; a call goes to the worker with
+ * the fewest active requests, counting the ones of this process not
+ * answered yet and what the worker reported last for all processes.
+ */
+class WorkerPool
+{
+  private:
+    struct Worker
+    {
+      std::vector<std::unique_ptr<WorkerConnection> > theIdle;
+      unsigned theInFlight;
+      uint32_t theLoad;
+    };
+
+    std::mutex theMutex;
+    std::vector<Worker> theWorkers;
+    std::string theDir;
+    // why theDir can not be used, empty if it can
+    std::string theDirError;
+    std::string theClassPath;
+
+    WorkerPool();
+
+  public:
+    static WorkerPool& getInstance();
+
+    // whether SCHEMATOOLS_WORKERS_ENV asks for workers
+    bool isEnabled() const
+    { return !theWorkers.empty(); }
+
+    // a connection to the least loaded worker, which is started if it does
+    // not run; aContext finds the jars to start it with. Throws
+    // WorkerException.
+    std::unique_ptr<WorkerConnection> acquire(const StaticContext* aContext);
+
+    // takes aConnection back, and keeps it if it can be reused
+    void release(std::unique_ptr<WorkerConnection> aConnection);
+
+    // starts the workers that do not run, which warm themselves up, and
+    // keeps a connection to each for the first calls; false if that needs
+    // the classpath of a static context, as SCHEMATOOLS_WORKER_CLASSPATH_ENV
+    // is not set. Throws WorkerException.
+    bool startWorkers();
+
+    // the samples of aSchemas for aRootNames, or for all global elements
+    // if there are none
+    std::vector<Item> xsd2inst(const std::vector<std::string>& aSchemas,
+        const std::vector<std::string>& aRootNames, const STOptions& aOptions,
+        const StaticContext* aContext, ItemFactory* aFactory,
+        CallStats* aStats);
+
+  private:
+    std::string socketPath(size_t aWorker) const;
+
+    // connects to aWorker, starting it if need be
+    int connect(size_t aWorker, const StaticContext* aContext);
+
+    // starts aWorker unless a process holds its lock
+    void start(size_t aWorker, const StaticContext* aContext);
+
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+};
+
+
+/**
+ * A connection of the pool, given back when the lease goes.
+ */
+class WorkerLease
+{
+  private:
+    std::unique_ptr<WorkerConnection> theConnection;
+
+  public:
+    WorkerLease(const StaticContext* aContext) :
+      theConnection(WorkerPool::getInstance().acquire(aContext))
+    {}
+
+    ~WorkerLease()
+    { WorkerPool::getInstance().release(std::move(theConnection)); }
+
+    WorkerConnection* operator->() const
+    { return theConnection.get(); }
+};
+
+
+// appends the big-endian aValue to aPayload
+void appendInt(std::string& aPayload, uint32_t aValue);
+
+// appends the length and bytes of aValue to aPayload
+void appendString(std::string& aPayload, const std::string& aValue);
+
+}}; // namespace zorba, schematools
+
+#endif // ZORBA_SCHEMATOOLS_WORKER_POOL_H
+/* vim:set et sw=2 ts=2: */
@@ -1,59 +1,231 @@
 package org.zorbaxquery.modules.schemaTools;
 
-import java.io.ByteArrayInputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.InterruptedIOException;
 import java.nio.ByteBuffer;
-import java.util.ArrayList;
-import java.util.Arrays;
-import java.util.List;
+import java.util.ArrayDeque;
 
+/**
+ * Fixed size ring buffer filled by native code and read as a sequence of
+ * documents.
+ *
+ * The producer (C++) writes directly into the direct ByteBuffer returned by
+ * getBuffer(): it asks for free space with reserve(), copies bytes to the
+ * position following the bytes it wrote so far (modulo the capacity) and
+ * publishes them with commit(). endDocument() marks the end of a document
+ * and endOfData() the end of the whole stream.
+ *
+ * The consumer calls nextDocument() before each document and then reads
+ * it like any InputStream until -1.
+ */
 public class CppInputStream
     extends InputStream
 {
-    List<Byte> data = new ArrayList<Byte>();
-    int off = 0;
-    private boolean endflag = false;
+    public static final int DEFAULT_CAPACITY = 256 * 1024;
 
-    public void push(byte[] d)
+    private final ByteBuffer _ring;
+    private final ByteBuffer _readView;
+    private final int _capacity;
+
+    // total number of bytes committed and consumed so far
+    private long _written = 0;
+    private long _read = 0;
+    // end offsets of the documents committed but not yet fully consumed
+    private final ArrayDeque<Long> _boundaries = new ArrayDeque<Long>();
+
+    private boolean _inDocument = false;
+    private boolean _endOfData = false;
+    private Throwable _abortCause = null;
+    private boolean _aborted = false;
+
+    public CppInputStream()
+    {
+        this(DEFAULT_CAPACITY);
+    }
+
+    public CppInputStream(int capacity)
+    {
+        _capacity = capacity;
+        _ring = ByteBuffer.allocateDirect(capacity);
+        _readView = _ring.duplicate();
+    }
+
+    // ---- producer side, called from native code ----
+
+    /**
+     * @return the direct buffer native code writes into
+     */
+    public ByteBuffer getBuffer()
     {
-        synchronized(data)
+        return _ring;
+    }
+
+    public int getCapacity()
+    {
+        return _capacity;
+    }
+
+    /**
+     * Blocks until at least one byte is free.
+     * @return the number of free bytes
+     */
+    public synchronized int reserve() throws IOException
+    {
+        while (_written - _read == _capacity && !_aborted)
         {
-            if(d == null)
+            waitForChange();
+        }
+        checkAborted();
+        return (int)(_capacity - (_written - _read));
+    }
+
+    /**
+     * Publishes len bytes written after the previously committed ones.
+     */
+    public synchronized void commit(int len) throws IOException
+    {
+        checkAborted();
+        _written += len;
+        notifyAll();
+    }
+
+    public synchronized void endDocument() throws IOException
+    {
+        checkAborted();
+        _boundaries.addLast(Long.valueOf(_written));
+        notifyAll();
+    }
+
+    public synchronized void endOfData()
+    {
+        _endOfData = true;
+        notifyAll();
+    }
+
+    // ---- consumer side ----
+
+    /**
+     * Skips what is left of the current document and waits for the next one.
+     * @return false if the producer will not send any further document
+     */
+    public synchronized boolean nextDocument() throws IOException
+    {
+        if (_inDocument)
+        {
+            while (_boundaries.isEmpty() && !_aborted)
+                waitForChange();
+            checkAborted();
+            _read = _boundaries.removeFirst().longValue();
+            _inDocument = false;
+            notifyAll();
+        }
+
+        while (_written == _read && _boundaries.isEmpty() && !_endOfData && !_aborted)
+            waitForChange();
+        checkAborted();
+
+        if (_written == _read && _boundaries.isEmpty())
+            return false;
+
+        _inDocument = true;
+        return true;
+    }
+
+    /**
+     * Makes the producer fail with cause on its next call.
+     */
+    public synchronized void abort(Throwable cause)
+    {
+        _aborted = true;
+        _abortCause = cause;
+        notifyAll();
+    }
+
+    @Override
+    public int read() throws IOException
+    {
+        byte[] b = new byte[1];
+        int n = read(b, 0, 1);
+        return n < 0 ? -1 : (b[0] & 0xff);
+    }
+
+    @Override
+    public synchronized int read(byte[] b, int off, int len) throws IOException
+    {
+        if (len == 0)
+            return 0;
+        if (!_inDocument)
+            return -1;
+
+        long limit;
+        while (true)
+        {
+            checkAborted();
+            limit = _boundaries.isEmpty() ? _written : _boundaries.peekFirst().longValue();
+            if (limit > _read)
+                break;
+            if (!_boundaries.isEmpty())
             {
-                this.endflag = true;
+                // end of the current document, nextDocument() moves on
+                _boundaries.removeFirst();
+                _inDocument = false;
+                return -1;
             }
-            else
+            if (_endOfData)
             {
-                for(int i = 0; i < d.length;++i)
-                {
-                    data.add(d[i]);
-                }
+                _inDocument = false;
+                return -1;
             }
+            waitForChange();
         }
+
+        int pos = (int)(_read % _capacity);
+        int n = (int)Math.min(Math.min(limit - _read, (long)len), (long)(_capacity - pos));
+        _readView.limit(pos + n);
+        _readView.position(pos);
+        _readView.get(b, off, n);
+        _read += n;
+        notifyAll();
+        return n;
     }
 
     @Override
-    public int read() throws IOException
+    public synchronized int available()
     {
-        synchronized(data)
+        long limit = _boundaries.isEmpty() ? _written : _boundaries.peekFirst().longValue();
+        return _inDocument ? (int)(limit - _read) : 0;
+    }
+
+    /**
+     * Parsers close the stream after each document; the stream stays usable
+     * for the following documents.
+     */
+    @Override
+    public void close()
+    {
+    }
+
+    private void waitForChange() throws IOException
+    {
+        try
         {
-            while(data.isEmpty()&&!endflag)
-            {
-                try
-                {
-                    data.wait();
-                }
-                catch (InterruptedException e)
-                {
-                    throw new InterruptedIOException();
-                }
-            }
+            wait();
+        }
+        catch (InterruptedException e)
+        {
+            throw new InterruptedIOException();
+        }
+    }
+
+    private void checkAborted() throws IOException
+    {
+        if (_aborted)
+        {
+            IOException e = new IOException("Instance stream aborted by the reader");
+            if (_abortCause != null)
+                e.initCause(_abortCause);
+            throw e;
         }
-        if(endflag)
-            return -1;
-        else
-            return data.remove(0);
     }
 }
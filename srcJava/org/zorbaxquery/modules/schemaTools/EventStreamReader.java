@@ -0,0 +1,227 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.XmlException;
+import org.apache.xmlbeans.XmlObject;
+import org.apache.xmlbeans.XmlOptions;
+import org.apache.xmlbeans.XmlSaxHandler;
+import org.xml.sax.ContentHandler;
+import org.xml.sax.SAXException;
+import org.xml.sax.helpers.AttributesImpl;
+
+import java.io.EOFException;
+import java.io.IOException;
+import java.io.InputStream;
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Reads the instances native code writes with EventStreamWriter
+ * (event_stream.h) and feeds their events to XMLBeans as SAX events.
+ *
+ * Nothing is tokenized: names and namespace URIs arrive as numbers of
+ * strings interned earlier in the stream, so one reader is used for all
+ * documents of a stream.
+ */
+public class EventStreamReader
+{
+    // event codes, mirrored in event_stream.h
+    private static final int END_DOCUMENT = 0;
+    private static final int START_ELEMENT = 1;
+    private static final int END_ELEMENT = 2;
+    private static final int TEXT = 3;
+
+    private static final Charset UTF8 = Charset.forName("UTF-8");
+
+    private final InputStream _in;
+    private final XmlOptions _options;
+
+    private final byte[] _buf = new byte[8192];
+    private int _pos = 0;
+    private int _end = 0;
+    private byte[] _text = new byte[256];
+    private char[] _chars = new char[256];
+
+    // interned strings and names, numbered from 1
+    private final List<String> _strings = new ArrayList<String>();
+    private final List<String[]> _dictionary = new ArrayList<String[]>();
+
+    // names of the open elements and the prefixes they declared
+    private final List<String[]> _open = new ArrayList<String[]>();
+    private final List<String[]> _prefixes = new ArrayList<String[]>();
+
+    private final AttributesImpl _attributes = new AttributesImpl();
+
+    public EventStreamReader(InputStream in, XmlOptions options)
+    {
+        _in = in;
+        _options = options;
+        _strings.add(null);
+        _dictionary.add(null);
+    }
+
+    /**
+     * Reads the current document of the stream.
+     */
+    public XmlObject parse()
+        throws IOException, SAXException, XmlException
+    {
+        // the stream returns -1 at the end of each document, nothing is
+        // buffered across documents
+        _pos = _end = 0;
+
+        XmlSaxHandler handler = XmlObject.Factory.newXmlSaxHandler(_options);
+        ContentHandler out = handler.getContentHandler();
+        out.startDocument();
+
+        int event;
+        while ((event = readByte()) != END_DOCUMENT)
+        {
+            switch (event)
+            {
+            case START_ELEMENT:
+                startElement(out);
+                break;
+            case END_ELEMENT:
+                endElement(out);
+                break;
+            case TEXT:
+                int len = readText();
+                if (_chars.length < len)
+                    _chars = new char[len];
+                String s = new String(_text, 0, len, UTF8);
+                s.getChars(0, s.length(), _chars, 0);
+                out.characters(_chars, 0, s.length());
+                break;
+            default:
+                throw new IOException("Unknown event " + event + " in instance stream");
+            }
+        }
+
+        out.endDocument();
+        return handler.getObject();
+    }
+
+    private void startElement(ContentHandler out)
+        throws IOException, SAXException
+    {
+        String[] name = readName();
+
+        int bindings = (int)readNumber();
+        String[] prefixes = new String[bindings];
+        for (int i = 0; i < bindings; i++)
+        {
+            prefixes[i] = readString();
+            out.startPrefixMapping(prefixes[i], readString());
+        }
+        _prefixes.add(prefixes);
+
+        _attributes.clear();
+        int count = (int)readNumber();
+        for (int i = 0; i < count; i++)
+        {
+            String[] attr = readName();
+            int len = readText();
+            _attributes.addAttribute(attr[0], attr[2], attr[3], "CDATA",
+                new String(_text, 0, len, UTF8));
+        }
+
+        out.startElement(name[0], name[2], name[3], _attributes);
+        _open.add(name);
+    }
+
+    private void endElement(ContentHandler out)
+        throws IOException, SAXException
+    {
+        String[] name = _open.remove(_open.size() - 1);
+        out.endElement(name[0], name[2], name[3]);
+
+        String[] prefixes = _prefixes.remove(_prefixes.size() - 1);
+        for (int i = 0; i < prefixes.length; i++)
+            out.endPrefixMapping(prefixes[i]);
+    }
+
+    // uri, prefix, local name and qualified name
+    private String[] readName()
+        throws IOException
+    {
+        int id = (int)readNumber();
+        if (id != 0)
+            return _dictionary.get(id);
+
+        String uri = readString();
+        String prefix = readString();
+        String local = readString();
+        String[] name = new String[] { uri, prefix, local,
+            prefix.length() == 0 ? local : prefix + ":" + local };
+        _dictionary.add(name);
+        return name;
+    }
+
+    private String readString()
+        throws IOException
+    {
+        int id = (int)readNumber();
+        if (id != 0)
+            return _strings.get(id);
+
+        int len = readText();
+        String s = new String(_text, 0, len, UTF8);
+        _strings.add(s);
+        return s;
+    }
+
+    // reads a text into _text, returns its length in bytes
+    private int readText()
+        throws IOException
+    {
+        int len = (int)readNumber();
+        if (_text.length < len)
+            _text = new byte[Math.max(len, 2 * _text.length)];
+
+        int off = 0;
+        while (off < len)
+        {
+            if (_pos == _end)
+                fill();
+            int n = Math.min(len - off, _end - _pos);
+            System.arraycopy(_buf, _pos, _text, off, n);
+            _pos += n;
+            off += n;
+        }
+        return len;
+    }
+
+    private long readNumber()
+        throws IOException
+    {
+        long res = 0;
+        int shift = 0;
+        int b;
+        do
+        {
+            b = readByte();
+            res |= (long)(b & 0x7f) << shift;
+            shift += 7;
+        } while ((b & 0x80) != 0);
+        return res;
+    }
+
+    private int readByte()
+        throws IOException
+    {
+        if (_pos == _end)
+            fill();
+        return _buf[_pos++] & 0xff;
+    }
+
+    private void fill()
+        throws IOException
+    {
+        int n = _in.read(_buf, 0, _buf.length);
+        if (n <= 0)
+            throw new EOFException("Instance stream ended within a document");
+        _pos = 0;
+        _end = n;
+    }
+}
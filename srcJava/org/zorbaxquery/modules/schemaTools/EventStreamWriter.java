@@ -0,0 +1,262 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.XmlObject;
+import org.apache.xmlbeans.XmlOptions;
+import org.xml.sax.Attributes;
+import org.xml.sax.ContentHandler;
+import org.xml.sax.Locator;
+import org.xml.sax.SAXException;
+import org.xml.sax.ext.LexicalHandler;
+
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+
+/**
+ * Writes a result document in the event format of event_stream.h, which
+ * native code builds the result nodes from directly.
+ *
+ * XMLBeans saves the document as SAX events, with the namespace
+ * declarations and prefixes it would write as text, but without printing
+ * it: native code adds the whitespace of the pretty printer itself. Every
+ * document has strings and names of its own, so it can be read alone.
+ */
+public class EventStreamWriter
+    implements ContentHandler, LexicalHandler
+{
+    // event codes, mirrored in event_stream.h
+    private static final int END_DOCUMENT = 0;
+    private static final int START_ELEMENT = 1;
+    private static final int END_ELEMENT = 2;
+    private static final int TEXT = 3;
+    private static final int COMMENT = 4;
+
+    private static final Charset UTF8 = Charset.forName("UTF-8");
+
+    private byte[] _buf = new byte[4096];
+    private int _size = 0;
+
+    // interned strings and names, numbered from 1
+    private final Map<String, Integer> _strings = new HashMap<String, Integer>();
+    private final Map<String, Integer> _names = new HashMap<String, Integer>();
+
+    // declarations for the next element, prefix and uri
+    private final List<String> _bindings = new ArrayList<String>();
+    // adjacent characters() calls make one text event
+    private final StringBuilder _text = new StringBuilder();
+
+    /**
+     * @return the events of doc, saved with options
+     */
+    public static byte[] save(XmlObject doc, XmlOptions options)
+        throws SAXException
+    {
+        EventStreamWriter out = new EventStreamWriter();
+        doc.save(out, out, options);
+        return out.toByteArray();
+    }
+
+    public byte[] toByteArray()
+    {
+        byte[] res = new byte[_size];
+        System.arraycopy(_buf, 0, res, 0, _size);
+        return res;
+    }
+
+    // ---- ContentHandler ----
+
+    public void setDocumentLocator(Locator locator)
+    {
+    }
+
+    public void startDocument()
+    {
+    }
+
+    public void endDocument()
+    {
+        flushText();
+        writeByte(END_DOCUMENT);
+    }
+
+    public void startPrefixMapping(String prefix, String uri)
+    {
+        _bindings.add(prefix);
+        _bindings.add(uri);
+    }
+
+    public void endPrefixMapping(String prefix)
+    {
+    }
+
+    public void startElement(String uri, String localName, String qName,
+        Attributes atts)
+    {
+        flushText();
+        writeByte(START_ELEMENT);
+        writeName(uri, localName, qName);
+
+        writeNumber(_bindings.size() / 2);
+        for (int i = 0; i < _bindings.size(); i++)
+            writeString(_bindings.get(i));
+        _bindings.clear();
+
+        int count = 0;
+        for (int i = 0; i < atts.getLength(); i++)
+            if (!isDeclaration(atts.getQName(i)))
+                count++;
+        writeNumber(count);
+        for (int i = 0; i < atts.getLength(); i++)
+        {
+            if (isDeclaration(atts.getQName(i)))
+                continue;
+            writeName(atts.getURI(i), atts.getLocalName(i), atts.getQName(i));
+            writeText(atts.getValue(i));
+        }
+    }
+
+    public void endElement(String uri, String localName, String qName)
+    {
+        flushText();
+        writeByte(END_ELEMENT);
+    }
+
+    public void characters(char[] ch, int start, int length)
+    {
+        _text.append(ch, start, length);
+    }
+
+    public void ignorableWhitespace(char[] ch, int start, int length)
+    {
+        _text.append(ch, start, length);
+    }
+
+    public void processingInstruction(String target, String data)
+    {
+    }
+
+    public void skippedEntity(String name)
+    {
+    }
+
+    // ---- LexicalHandler ----
+
+    public void comment(char[] ch, int start, int length)
+    {
+        flushText();
+        writeByte(COMMENT);
+        writeText(new String(ch, start, length));
+    }
+
+    public void startDTD(String name, String publicId, String systemId)
+    {
+    }
+
+    public void endDTD()
+    {
+    }
+
+    public void startEntity(String name)
+    {
+    }
+
+    public void endEntity(String name)
+    {
+    }
+
+    public void startCDATA()
+    {
+    }
+
+    public void endCDATA()
+    {
+    }
+
+    // ---- encoding ----
+
+    private static boolean isDeclaration(String qName)
+    {
+        return qName.equals("xmlns") || qName.startsWith("xmlns:");
+    }
+
+    private void flushText()
+    {
+        if (_text.length() == 0)
+            return;
+        writeByte(TEXT);
+        writeText(_text.toString());
+        _text.setLength(0);
+    }
+
+    private void writeName(String uri, String localName, String qName)
+    {
+        int colon = qName.indexOf(':');
+        String prefix = colon < 0 ? "" : qName.substring(0, colon);
+        if (localName.length() == 0)
+            localName = colon < 0 ? qName : qName.substring(colon + 1);
+
+        String key = uri + '\0' + prefix + '\0' + localName;
+        Integer id = _names.get(key);
+        if (id != null)
+        {
+            writeNumber(id.intValue());
+            return;
+        }
+
+        _names.put(key, Integer.valueOf(_names.size() + 1));
+        writeNumber(0);
+        writeString(uri);
+        writeString(prefix);
+        writeString(localName);
+    }
+
+    private void writeString(String s)
+    {
+        Integer id = _strings.get(s);
+        if (id != null)
+        {
+            writeNumber(id.intValue());
+            return;
+        }
+
+        _strings.put(s, Integer.valueOf(_strings.size() + 1));
+        writeNumber(0);
+        writeText(s);
+    }
+
+    private void writeText(String s)
+    {
+        byte[] bytes = s.getBytes(UTF8);
+        writeNumber(bytes.length);
+        ensure(bytes.length);
+        System.arraycopy(bytes, 0, _buf, _size, bytes.length);
+        _size += bytes.length;
+    }
+
+    private void writeNumber(long value)
+    {
+        while (value >= 0x80)
+        {
+            writeByte((int)(value | 0x80) & 0xff);
+            value >>>= 7;
+        }
+        writeByte((int)value);
+    }
+
+    private void writeByte(int b)
+    {
+        ensure(1);
+        _buf[_size++] = (byte)b;
+    }
+
+    private void ensure(int len)
+    {
+        if (_size + len <= _buf.length)
+            return;
+        byte[] buf = new byte[Math.max(_size + len, 2 * _buf.length)];
+        System.arraycopy(_buf, 0, buf, 0, _size);
+        _buf = buf;
+    }
+}
@@ -0,0 +1,306 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.XmlObject;
+import org.apache.xmlbeans.XmlOptions;
+import org.apache.xmlbeans.impl.inst2xsd.Inst2XsdOptions;
+import org.apache.xmlbeans.impl.inst2xsd.RussianDollStrategy;
+import org.apache.xmlbeans.impl.inst2xsd.SalamiSliceStrategy;
+import org.apache.xmlbeans.impl.inst2xsd.VenetianBlindStrategy;
+import org.apache.xmlbeans.impl.inst2xsd.XsdGenStrategy;
+import org.apache.xmlbeans.impl.inst2xsd.util.TypeSystemHolder;
+import org.apache.xmlbeans.impl.xb.xsdschema.SchemaDocument;
+
+import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.concurrent.ThreadFactory;
+
+/**
+ * Schema inference state that instances are added to one at a time.
+ *
+ * This does what Inst2Xsd.inst2xsd does for an array of instances, but
+ * each instance is dropped as soon as the strategy has processed it. With
+ * startStream() the instances are parsed on a reader thread while native
+ * code is still serializing the following ones.
+ */
+public class Inst2XsdSession
+{
+    private static final ExecutorService _readers =
+        Executors.newCachedThreadPool(new ThreadFactory()
+        {
+            public Thread newThread(Runnable r)
+            {
+                Thread t = new Thread(r, "schema-tools-reader");
+                t.setDaemon(true);
+                return t;
+            }
+        });
+
+    private final Inst2XsdOptions _options;
+    private final XsdGenStrategy _strategy;
+    private final TypeSystemHolder _holder = new TypeSystemHolder();
+    private final PhaseTimes _times = new PhaseTimes();
+
+    private Future<Object> _reader = null;
+
+    public Inst2XsdSession(Inst2XsdOptions options)
+    {
+        _options = options == null ? new Inst2XsdOptions() : options;
+        switch (_options.getDesign())
+        {
+        case Inst2XsdOptions.DESIGN_RUSSIAN_DOLL:
+            _strategy = new RussianDollStrategy();
+            break;
+        case Inst2XsdOptions.DESIGN_SALAMI_SLICE:
+            _strategy = new SalamiSliceStrategy();
+            break;
+        case Inst2XsdOptions.DESIGN_VENETIAN_BLIND:
+            _strategy = new VenetianBlindStrategy();
+            break;
+        default:
+            throw new IllegalArgumentException("Unknown design: " + _options.getDesign());
+        }
+    }
+
+    public void add(XmlObject instance)
+    {
+        long start = System.nanoTime();
+        _strategy.processDoc(new XmlObject[] { instance }, _options, _holder);
+        _times.add(PhaseTimes.INFER, start);
+    }
+
+    /**
+     * @return the times of this session, recorded by the reader thread too
+     */
+    public PhaseTimes times()
+    {
+        return _times;
+    }
+
+    /**
+     * Parses docs, with up to parallelism threads, and adds them in order.
+     * The buffers are only read during the call.
+     */
+    public void addDocuments(ByteBuffer[] docs, int parallelism)
+        throws Exception
+    {
+        if (parallelism <= 1 || docs.length < 2)
+        {
+            for (int i = 0; i < docs.length; i++)
+                add(parse(docs[i]));
+            return;
+        }
+
+        ExecutorService parsers = Executors.newFixedThreadPool(
+            Math.min(parallelism, docs.length), new ThreadFactory()
+            {
+                public Thread newThread(Runnable r)
+                {
+                    Thread t = new Thread(r, "schema-tools-parser");
+                    t.setDaemon(true);
+                    return t;
+                }
+            });
+        try
+        {
+            List<Future<XmlObject>> parsed = new ArrayList<Future<XmlObject>>();
+            for (int i = 0; i < docs.length; i++)
+            {
+                final ByteBuffer doc = docs[i];
+                parsed.add(parsers.submit(new Callable<XmlObject>()
+                {
+                    public XmlObject call() throws Exception
+                    {
+                        return parse(doc);
+                    }
+                }));
+            }
+
+            // the strategy sees the documents in the order of docs
+            for (int i = 0; i < docs.length; i++)
+            {
+                try
+                {
+                    add(parsed.get(i).get());
+                }
+                catch (ExecutionException e)
+                {
+                    if (e.getCause() instanceof Exception)
+                        throw (Exception)e.getCause();
+                    throw e;
+                }
+            }
+        }
+        finally
+        {
+            parsers.shutdownNow();
+        }
+    }
+
+    private XmlObject parse(ByteBuffer doc)
+        throws Exception
+    {
+        final ByteBuffer in = doc.duplicate();
+        long start = System.nanoTime();
+        XmlObject res = XmlObject.Factory.parse(new InputStream()
+        {
+            public int read()
+            {
+                return in.hasRemaining() ? in.get() & 0xff : -1;
+            }
+
+            public int read(byte[] b, int off, int len)
+            {
+                if (!in.hasRemaining())
+                    return -1;
+                len = Math.min(len, in.remaining());
+                in.get(b, off, len);
+                return len;
+            }
+        }, new XmlOptions());
+        _times.add(PhaseTimes.PARSE, start);
+        return res;
+    }
+
+    /**
+     * Starts a reader thread that parses and adds every document of the
+     * returned stream.
+     */
+    public CppInputStream startStream(int capacity)
+    {
+        return startReader(new CppInputStream(capacity), false);
+    }
+
+    /**
+     * Same as startStream(), for documents written as EventStreamWriter
+     * events instead of XML text.
+     */
+    public CppInputStream startEventStream(int capacity)
+    {
+        return startReader(new CppInputStream(capacity), true);
+    }
+
+    private CppInputStream startReader(final CppInputStream in, final boolean events)
+    {
+        _reader = _readers.submit(new Callable<Object>()
+        {
+            public Object call() throws Exception
+            {
+                try
+                {
+                    XmlOptions loadOptions = new XmlOptions();
+                    EventStreamReader reader = events ?
+                        new EventStreamReader(in, loadOptions) : null;
+                    while (in.nextDocument())
+                    {
+                        // includes waiting for native code to write
+                        long start = System.nanoTime();
+                        XmlObject instance = events ? reader.parse() :
+                            XmlObject.Factory.parse(in, loadOptions);
+                        _times.add(PhaseTimes.PARSE, start);
+                        add(instance);
+                    }
+                    return null;
+                }
+                catch (Exception e)
+                {
+                    in.abort(e);
+                    throw e;
+                }
+            }
+        });
+        return in;
+    }
+
+    /**
+     * Waits for the reader thread, if any, to add the last document of its
+     * stream. More streams can be started afterwards.
+     */
+    public void await()
+        throws Exception
+    {
+        if (_reader != null)
+        {
+            Future<Object> reader = _reader;
+            _reader = null;
+            try
+            {
+                reader.get();
+            }
+            catch (ExecutionException e)
+            {
+                if (e.getCause() instanceof Exception)
+                    throw (Exception)e.getCause();
+                throw e;
+            }
+        }
+    }
+
+    /**
+     * Waits for the reader thread, if any, and returns the inferred schemas.
+     */
+    public String[] finish()
+        throws Exception
+    {
+        SchemaDocument[] xsds = schemas();
+
+        XmlOptions options = new XmlOptions();
+        options.put( XmlOptions.SAVE_INNER );
+        options.put( XmlOptions.SAVE_PRETTY_PRINT );
+        options.put( XmlOptions.SAVE_AGGRESSIVE_NAMESPACES );
+        //options.put( XmlOptions.SAVE_USE_DEFAULT_NAMESPACE ); don't use this can generate buggy schema
+        options.setSaveNamespacesFirst();
+
+        long start = System.nanoTime();
+        String[] res = new String[xsds.length];
+        for (int i = 0; i < xsds.length; i++)
+        {
+            res[i] = xsds[i].xmlText(options);
+        }
+        _times.add(PhaseTimes.PRINT, start);
+
+        return res;
+    }
+
+    /**
+     * Same as finish(), with the schemas as EventStreamWriter events
+     * instead of printed text.
+     */
+    public byte[][] finishEvents()
+        throws Exception
+    {
+        SchemaDocument[] xsds = schemas();
+
+        // the namespaces finish() prints, the indentation is native code's
+        XmlOptions options = new XmlOptions();
+        options.put( XmlOptions.SAVE_AGGRESSIVE_NAMESPACES );
+        options.setSaveNamespacesFirst();
+
+        long start = System.nanoTime();
+        byte[][] res = new byte[xsds.length][];
+        for (int i = 0; i < xsds.length; i++)
+        {
+            res[i] = EventStreamWriter.save(xsds[i], options);
+        }
+        _times.add(PhaseTimes.PRINT, start);
+
+        return res;
+    }
+
+    private SchemaDocument[] schemas()
+        throws Exception
+    {
+        await();
+
+        if (_options.isVerbose())
+            System.out.println("typeSystemHolder.toString(): " + _holder);
+
+        return _holder.getSchemaDocuments();
+    }
+}
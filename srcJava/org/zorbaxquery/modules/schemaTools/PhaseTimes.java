@@ -0,0 +1,74 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import java.util.Arrays;
+
+/**
+ * Nanoseconds spent in the phases of a call that run in the JVM, and the
+ * counts of the SchemaTypeSystemCache the call hit, missed and evicted and
+ * of the type systems it loaded from the SchemaTypeSystemStore.
+ *
+ * Native code takes the times and counts after each call into Java and
+ * adds them to the statistics of the module. The helpers called on the native thread
+ * record into current(); an Inst2XsdSession has its own PhaseTimes since
+ * its reader thread records concurrently with the native caller.
+ */
+public class PhaseTimes
+{
+    // indices of take(), mirrored in stats.cpp
+    public static final int PARSE = 0;
+    public static final int INFER = 1;
+    public static final int COMPILE = 2;
+    public static final int GENERATE = 3;
+    public static final int PRINT = 4;
+    // counts, following the times
+    public static final int SCHEMA_CACHE_HITS = 5;
+    public static final int SCHEMA_CACHE_MISSES = 6;
+    public static final int SCHEMA_CACHE_EVICTIONS = 7;
+    public static final int SCHEMA_STORE_LOADS = 8;
+    public static final int COUNT = 9;
+
+    private static final ThreadLocal<PhaseTimes> _current =
+        new ThreadLocal<PhaseTimes>()
+        {
+            protected PhaseTimes initialValue()
+            {
+                return new PhaseTimes();
+            }
+        };
+
+    private final long[] _values = new long[COUNT];
+
+    /**
+     * @return the times of the calling thread
+     */
+    public static PhaseTimes current()
+    {
+        return _current.get();
+    }
+
+    /**
+     * Adds the time since start, a System.nanoTime() value, to phase.
+     */
+    public synchronized void add(int phase, long start)
+    {
+        _values[phase] += System.nanoTime() - start;
+    }
+
+    /**
+     * Adds n to counter.
+     */
+    public synchronized void count(int counter, long n)
+    {
+        _values[counter] += n;
+    }
+
+    /**
+     * @return the times and counts added since the last call, by index
+     */
+    public synchronized long[] take()
+    {
+        long[] res = _values.clone();
+        Arrays.fill(_values, 0);
+        return res;
+    }
+}
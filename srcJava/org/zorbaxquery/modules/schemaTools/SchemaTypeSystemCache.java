@@ -0,0 +1,181 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.SchemaTypeSystem;
+
+import java.nio.charset.Charset;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.util.Iterator;
+import java.util.LinkedHashMap;
+import java.util.Map;
+
+/**
+ * Bounded LRU cache of compiled schema type systems.
+ *
+ * Entries are keyed by a digest of the schema documents and of the options
+ * that influence compilation, so calls with the same schema set reuse the
+ * compiled type system whatever root element they ask for.
+ *
+ * The capacity is read from the system property
+ * "org.zorbaxquery.modules.schemaTools.schemaCacheSize" or, if not set, from
+ * the environment variable ZORBA_SCHEMATOOLS_SCHEMA_CACHE_SIZE. Default is
+ * 16, 0 disables caching.
+ */
+public class SchemaTypeSystemCache
+{
+    public static final String CAPACITY_PROPERTY =
+        "org.zorbaxquery.modules.schemaTools.schemaCacheSize";
+    public static final String CAPACITY_ENV = "ZORBA_SCHEMATOOLS_SCHEMA_CACHE_SIZE";
+    public static final int DEFAULT_CAPACITY = 16;
+
+    private static final Charset UTF8 = Charset.forName("UTF-8");
+    private static final SchemaTypeSystemCache _instance =
+        new SchemaTypeSystemCache(configuredCapacity());
+
+    private final LinkedHashMap<String, SchemaTypeSystem> _entries =
+        new LinkedHashMap<String, SchemaTypeSystem>(16, 0.75f, true);
+    private int _capacity;
+    private long _hits = 0;
+    private long _misses = 0;
+    private long _evictions = 0;
+
+    public SchemaTypeSystemCache(int capacity)
+    {
+        _capacity = Math.max(0, capacity);
+    }
+
+    public static SchemaTypeSystemCache getInstance()
+    {
+        return _instance;
+    }
+
+    private static int configuredCapacity()
+    {
+        String value = System.getProperty(CAPACITY_PROPERTY);
+        if (value == null)
+            value = System.getenv(CAPACITY_ENV);
+        if (value == null)
+            return DEFAULT_CAPACITY;
+        try
+        {
+            return Integer.parseInt(value.trim());
+        }
+        catch (NumberFormatException e)
+        {
+            return DEFAULT_CAPACITY;
+        }
+    }
+
+    /**
+     * @return the key for the given schema documents compiled with options
+     */
+    public static String key(String[] xsds, Xsd2InstHelper.Xsd2InstOptions options)
+    {
+        MessageDigest md;
+        try
+        {
+            md = MessageDigest.getInstance("SHA-256");
+        }
+        catch (NoSuchAlgorithmException e)
+        {
+            throw new RuntimeException(e);
+        }
+
+        for (int i = 0; i < xsds.length; i++)
+        {
+            byte[] bytes = xsds[i].getBytes(UTF8);
+            // length prefix keeps ("ab","c") and ("a","bc") apart
+            md.update(new byte[] {
+                (byte)(bytes.length >>> 24), (byte)(bytes.length >>> 16),
+                (byte)(bytes.length >>> 8), (byte)bytes.length });
+            md.update(bytes);
+        }
+        md.update((byte)((options.isNetworkDownloads() ? 1 : 0) |
+                         (options.isNopvr() ? 2 : 0) |
+                         (options.isNoupa() ? 4 : 0)));
+
+        byte[] digest = md.digest();
+        StringBuilder sb = new StringBuilder(digest.length * 2);
+        for (int i = 0; i < digest.length; i++)
+        {
+            sb.append(Character.forDigit((digest[i] >> 4) & 0xf, 16));
+            sb.append(Character.forDigit(digest[i] & 0xf, 16));
+        }
+        return sb.toString();
+    }
+
+    /**
+     * @return the cached type system for key or null, counting a hit or miss
+     */
+    public synchronized SchemaTypeSystem get(String key)
+    {
+        SchemaTypeSystem sts = _entries.get(key);
+        if (sts != null)
+            _hits++;
+        else
+            _misses++;
+        return sts;
+    }
+
+    /**
+     * @return the number of entries evicted to make room for sts
+     */
+    public synchronized int put(String key, SchemaTypeSystem sts)
+    {
+        if (_capacity == 0)
+            return 0;
+        _entries.put(key, sts);
+        return evict();
+    }
+
+    public synchronized void setCapacity(int capacity)
+    {
+        _capacity = Math.max(0, capacity);
+        evict();
+    }
+
+    public synchronized int getCapacity()
+    {
+        return _capacity;
+    }
+
+    public synchronized int size()
+    {
+        return _entries.size();
+    }
+
+    public synchronized long getHits()
+    {
+        return _hits;
+    }
+
+    public synchronized long getMisses()
+    {
+        return _misses;
+    }
+
+    public synchronized long getEvictions()
+    {
+        return _evictions;
+    }
+
+    public synchronized void clear()
+    {
+        _entries.clear();
+    }
+
+    private int evict()
+    {
+        int evicted = 0;
+        Iterator<Map.Entry<String, SchemaTypeSystem>> it = _entries.entrySet().iterator();
+        while (_entries.size() > _capacity && it.hasNext())
+        {
+            // iteration order is least recently used first
+            it.next();
+            it.remove();
+            evicted++;
+        }
+        _evictions += evicted;
+        return evicted;
+    }
+}
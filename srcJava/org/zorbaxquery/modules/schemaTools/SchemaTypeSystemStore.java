@@ -0,0 +1,382 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.Filer;
+import org.apache.xmlbeans.ResourceLoader;
+import org.apache.xmlbeans.SchemaTypeLoaderException;
+import org.apache.xmlbeans.SchemaTypeSystem;
+import org.apache.xmlbeans.XmlBeans;
+import org.apache.xmlbeans.impl.schema.SchemaTypeSystemImpl;
+
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.OutputStream;
+import java.io.Writer;
+import java.nio.charset.Charset;
+import java.nio.file.Files;
+import java.nio.file.LinkOption;
+import java.nio.file.Path;
+import java.nio.file.attribute.PosixFilePermission;
+import java.nio.file.attribute.PosixFilePermissions;
+import java.util.Arrays;
+import java.util.Comparator;
+import java.util.Map;
+import java.util.Set;
+import java.util.TreeMap;
+import java.util.zip.ZipEntry;
+import java.util.zip.ZipException;
+import java.util.zip.ZipOutputStream;
+
+/**
+ * On-disk store of compiled schema type systems, shared by all processes
+ * using the same directory, so a process that starts loads the type
+ * systems compiled before instead of compiling the schemas again.
+ *
+ * Every entry is the .xsb files XMLBeans saves for a type system, in a
+ * jar named after the SchemaTypeSystemCache key of the schemas and
+ * options. The type system is read from the .xsb resources of the jar
+ * alone: the TypeSystemHolder class XMLBeans saves with them is left out,
+ * and no class is ever loaded from the store, so its files are data only.
+ * Entries are written to a file of their own and renamed into
+ * place, so a process never reads a partial entry, and an entry two
+ * processes compile at once is stored by the last one. A process that
+ * loaded an entry keeps the jar open, so it may be evicted by another
+ * process meanwhile. An entry that is not a valid type system, e.g. saved
+ * by another version of XMLBeans, is deleted and compiled again; one that
+ * can not be read for another reason, e.g. an I/O error or a lack of
+ * memory, is compiled again without deleting it.
+ *
+ * The directory is read from the system property
+ * "org.zorbaxquery.modules.schemaTools.schemaStoreDir" or, if not set, from
+ * the environment variable ZORBA_SCHEMATOOLS_SCHEMA_STORE_DIR; without
+ * either there is no store. The entries are bounded by a total size in
+ * megabytes, read from "org.zorbaxquery.modules.schemaTools.schemaStoreSize"
+ * or ZORBA_SCHEMATOOLS_SCHEMA_STORE_SIZE, default 256; the least recently
+ * used ones are evicted when an entry is stored. Like the directory of the
+ * workers, the directory is created with mode 0700 and must be a directory
+ * of the user that no group or other user can write to, or there is no
+ * store.
+ */
+public class SchemaTypeSystemStore
+{
+    public static final String DIRECTORY_PROPERTY =
+        "org.zorbaxquery.modules.schemaTools.schemaStoreDir";
+    public static final String DIRECTORY_ENV = "ZORBA_SCHEMATOOLS_SCHEMA_STORE_DIR";
+    public static final String SIZE_PROPERTY =
+        "org.zorbaxquery.modules.schemaTools.schemaStoreSize";
+    public static final String SIZE_ENV = "ZORBA_SCHEMATOOLS_SCHEMA_STORE_SIZE";
+    public static final long DEFAULT_SIZE_MB = 256;
+
+    private static final String SUFFIX = ".jar";
+    // the entry with the name of the type system
+    private static final String NAME_ENTRY = "META-INF/schema-tools-type-system";
+
+    private static final Charset UTF8 = Charset.forName("UTF-8");
+    private static final SchemaTypeSystemStore _instance = configured();
+
+    private final File _directory;
+    private final long _maxBytes;
+
+    // an entry that is not a valid type system
+    private static class FormatException extends Exception
+    {
+        FormatException(String message)
+        {
+            super(message);
+        }
+    }
+
+    public SchemaTypeSystemStore(File directory, long maxBytes)
+    {
+        _directory = directory;
+        _maxBytes = Math.max(0, maxBytes);
+    }
+
+    /**
+     * @return the configured store, or null if there is none
+     */
+    public static SchemaTypeSystemStore getInstance()
+    {
+        return _instance;
+    }
+
+    private static SchemaTypeSystemStore configured()
+    {
+        String dir = setting(DIRECTORY_PROPERTY, DIRECTORY_ENV);
+        if (dir == null || dir.trim().length() == 0)
+            return null;
+
+        long sizeMb = DEFAULT_SIZE_MB;
+        String size = setting(SIZE_PROPERTY, SIZE_ENV);
+        if (size != null)
+        {
+            try
+            {
+                sizeMb = Long.parseLong(size.trim());
+            }
+            catch (NumberFormatException e)
+            {
+                sizeMb = DEFAULT_SIZE_MB;
+            }
+        }
+
+        File directory = new File(dir.trim());
+        String error = secureDirectory(directory.toPath());
+        if (error != null)
+        {
+            System.err.println("Not using the schema store " + directory + ": " + error);
+            return null;
+        }
+        return new SchemaTypeSystemStore(directory, sizeMb * 1024 * 1024);
+    }
+
+    /**
+     * Creates directory with mode 0700 if it does not exist.
+     *
+     * @return why directory can not be trusted with the entries of the
+     * store, or null if it can: it must be a directory, not a link, of the
+     * user the process runs as, and no group or other user may write to it
+     */
+    private static String secureDirectory(Path directory)
+    {
+        try
+        {
+            if (!Files.exists(directory, LinkOption.NOFOLLOW_LINKS))
+            {
+                try
+                {
+                    Files.createDirectories(directory,
+                        PosixFilePermissions.asFileAttribute(
+                            PosixFilePermissions.fromString("rwx------")));
+                }
+                catch (UnsupportedOperationException e)
+                {
+                    // no POSIX permissions on this file system
+                    Files.createDirectories(directory);
+                }
+            }
+            if (!Files.isDirectory(directory, LinkOption.NOFOLLOW_LINKS))
+                return "not a directory";
+
+            String owner = Files.getOwner(directory, LinkOption.NOFOLLOW_LINKS).getName();
+            if (!owner.equals(System.getProperty("user.name")))
+                return "owned by " + owner;
+
+            Set<PosixFilePermission> permissions;
+            try
+            {
+                permissions = Files.getPosixFilePermissions(directory,
+                    LinkOption.NOFOLLOW_LINKS);
+            }
+            catch (UnsupportedOperationException e)
+            {
+                // the owner is all there is to check
+                return null;
+            }
+            if (permissions.contains(PosixFilePermission.GROUP_WRITE) ||
+                permissions.contains(PosixFilePermission.OTHERS_WRITE))
+                return "writable by others (mode " +
+                    PosixFilePermissions.toString(permissions) + ")";
+            return null;
+        }
+        catch (IOException e)
+        {
+            return e.toString();
+        }
+    }
+
+    private static String setting(String property, String env)
+    {
+        String value = System.getProperty(property);
+        return value != null ? value : System.getenv(env);
+    }
+
+    /**
+     * @return the type system stored for key, or null if there is none or
+     * it can not be loaded
+     */
+    public SchemaTypeSystem load(String key)
+    {
+        File file = fileFor(key);
+        if (!file.isFile())
+            return null;
+
+        ResourceLoader resources = null;
+        boolean loaded = false;
+        Exception invalid = null;
+        try
+        {
+            // reads the jar as data: resources only, no class loader
+            resources = XmlBeans.resourceLoaderForPath(new File[] { file });
+            InputStream in = resources.getResourceAsStream(NAME_ENTRY);
+            if (in == null)
+                throw new FormatException("No type system name");
+            ByteArrayOutputStream name = new ByteArrayOutputStream();
+            try
+            {
+                byte[] buffer = new byte[256];
+                for (int n; (n = in.read(buffer)) > 0; )
+                    name.write(buffer, 0, n);
+            }
+            finally
+            {
+                in.close();
+            }
+
+            // the type system of the .xsb files, whose types are read from
+            // resources as they are used
+            SchemaTypeSystem sts = new SchemaTypeSystemImpl(resources,
+                new String(name.toByteArray(), UTF8),
+                XmlBeans.typeLoaderForResource(resources));
+            // the most recently used entries are kept
+            file.setLastModified(System.currentTimeMillis());
+            loaded = true;
+            return sts;
+        }
+        catch (FormatException e)
+        {
+            invalid = e;
+        }
+        catch (ZipException e)
+        {
+            invalid = e;
+        }
+        catch (SchemaTypeLoaderException e)
+        {
+            invalid = e;
+        }
+        catch (Exception e)
+        {
+            // maybe transient, so the entry is kept
+            System.err.println("Can not load stored schemas " + file + ": " + e);
+        }
+        finally
+        {
+            if (!loaded && resources != null)
+                resources.close();
+        }
+
+        // deleted once the resources are closed, where open files can not be
+        if (invalid != null)
+        {
+            System.err.println("Dropping stored schemas " + file + ": " + invalid);
+            file.delete();
+        }
+        return null;
+    }
+
+    /**
+     * Stores sts for key, and evicts the least recently used entries beyond
+     * the size of the store. A failure only leaves sts out of the store.
+     */
+    public void store(String key, SchemaTypeSystem sts)
+    {
+        if (_maxBytes == 0)
+            return;
+
+        File file = fileFor(key);
+        File temporary = new File(_directory, key + ".tmp" +
+            Long.toHexString(Thread.currentThread().getId()) +
+            Long.toHexString(System.nanoTime()));
+        try
+        {
+            // the saved files, by their path in the jar; the holder class is
+            // dropped, since the type system is loaded without it
+            final Map<String, ByteArrayOutputStream> files =
+                new TreeMap<String, ByteArrayOutputStream>();
+            sts.save(new Filer()
+            {
+                public OutputStream createBinaryFile(String typename)
+                {
+                    ByteArrayOutputStream out = new ByteArrayOutputStream();
+                    String path = typename.replace('\\', '/');
+                    if (!path.endsWith(".class"))
+                        files.put(path, out);
+                    return out;
+                }
+
+                public Writer createSourceFile(String typename)
+                    throws IOException
+                {
+                    throw new IOException("No sources are stored: " + typename);
+                }
+            });
+
+            ZipOutputStream zip = new ZipOutputStream(new FileOutputStream(temporary));
+            try
+            {
+                zip.putNextEntry(new ZipEntry(NAME_ENTRY));
+                zip.write(sts.getName().getBytes(UTF8));
+                zip.closeEntry();
+                for (Map.Entry<String, ByteArrayOutputStream> entry : files.entrySet())
+                {
+                    zip.putNextEntry(new ZipEntry(entry.getKey()));
+                    entry.getValue().writeTo(zip);
+                    zip.closeEntry();
+                }
+            }
+            finally
+            {
+                zip.close();
+            }
+
+            // an entry another process stored meanwhile is replaced; where
+            // renaming does not replace files, it is deleted first
+            if (!temporary.renameTo(file) &&
+                !(file.delete() && temporary.renameTo(file)))
+                throw new IOException("Can not rename " + temporary);
+        }
+        catch (Exception e)
+        {
+            System.err.println("Can not store schemas " + file + ": " + e);
+            temporary.delete();
+            return;
+        }
+
+        evict(file);
+    }
+
+    private File fileFor(String key)
+    {
+        return new File(_directory, key + SUFFIX);
+    }
+
+    // deletes the least recently used entries other than keep while they
+    // take more than the size of the store
+    private void evict(File keep)
+    {
+        File[] entries = _directory.listFiles();
+        if (entries == null)
+            return;
+
+        long total = 0;
+        for (int i = 0; i < entries.length; i++)
+        {
+            if (entries[i].getName().endsWith(SUFFIX))
+                total += entries[i].length();
+        }
+        if (total <= _maxBytes)
+            return;
+
+        Arrays.sort(entries, new Comparator<File>()
+        {
+            public int compare(File a, File b)
+            {
+                long am = a.lastModified();
+                long bm = b.lastModified();
+                return am < bm ? -1 : (am > bm ? 1 : 0);
+            }
+        });
+        for (int i = 0; i < entries.length && total > _maxBytes; i++)
+        {
+            if (!entries[i].getName().endsWith(SUFFIX) || entries[i].equals(keep))
+                continue;
+            long size = entries[i].length();
+            // another process may have evicted it already
+            if (entries[i].delete())
+                total -= size;
+        }
+    }
+}
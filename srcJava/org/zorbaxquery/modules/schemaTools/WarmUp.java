@@ -0,0 +1,61 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.XmlObject;
+import org.apache.xmlbeans.impl.inst2xsd.Inst2XsdOptions;
+
+/**
+ * Loads and runs the code paths of inst2xsd and xsd2inst on a tiny input,
+ * so that the first real call finds the classes loaded and the hot methods
+ * compiled.
+ *
+ * With ZORBA_SCHEMATOOLS_WARMUP set to 1, native code runs it on a
+ * background thread when the module is loaded, in a JVM it starts with
+ * the classpath of ZORBA_SCHEMATOOLS_WARMUP_CLASSPATH or CLASSPATH, or
+ * once the first call has started the JVM if neither is set. Worker
+ * processes run it when they start.
+ *
+ * A JVM started with -Xshare:auto -XX:SharedArchiveFile=<archive>, which
+ * operators add to its options (the module sets none), maps the classes
+ * from that class data sharing archive instead of loading them. Java 19
+ * and later record the archive on their own with
+ * -XX:+AutoCreateSharedArchive; for older versions (13 and later) it can
+ * be recorded with this class, using the jars the module's JVM uses, in
+ * the same order:
+ *
+ *   java -XX:ArchiveClassesAtExit=schema-tools.jsa -cp &lt;module jars&gt;
+ *       org.zorbaxquery.modules.schemaTools.WarmUp
+ */
+public class WarmUp
+{
+    public static final int DEFAULT_ROUNDS = 5;
+
+    private static final String INSTANCE =
+        "<order id=\"1\" xmlns=\"http://example.com/warm-up\">" +
+        "<line qty=\"2\">x</line><line qty=\"3\">y</line><note/></order>";
+
+    public static void run(int rounds)
+        throws Exception
+    {
+        for (int i = 0; i < rounds; i++)
+        {
+            // one design per round, they load different strategies
+            Inst2XsdOptions options = new Inst2XsdOptions();
+            options.setDesign(i % 3 + 1);
+            Inst2XsdSession session = new Inst2XsdSession(options);
+            session.add(XmlObject.Factory.parse(INSTANCE));
+            String[] xsds = session.finish();
+
+            Xsd2InstHelper.xsd2instAll(xsds, new String[0],
+                new Xsd2InstHelper.Xsd2InstOptions()).nextEvents();
+        }
+
+        // the time spent here is not the one of the calling thread's next call
+        PhaseTimes.current().take();
+    }
+
+    public static void main(String[] args)
+        throws Exception
+    {
+        run(args.length > 0 ? Integer.parseInt(args[0]) : DEFAULT_ROUNDS);
+    }
+}
@@ -0,0 +1,337 @@
+package org.zorbaxquery.modules.schemaTools;
+
+import org.apache.xmlbeans.impl.inst2xsd.Inst2XsdOptions;
+
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.File;
+import java.io.IOException;
+import java.io.PrintWriter;
+import java.io.RandomAccessFile;
+import java.io.StringWriter;
+import java.net.StandardProtocolFamily;
+import java.net.UnixDomainSocketAddress;
+import java.nio.ByteBuffer;
+import java.nio.channels.Channels;
+import java.nio.channels.FileLock;
+import java.nio.channels.ServerSocketChannel;
+import java.nio.channels.SocketChannel;
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * A worker process running inst2xsd and xsd2inst for the native module,
+ * which starts it when ZORBA_SCHEMATOOLS_WORKERS is set (worker_pool.h):
+ *
+ *   java -cp &lt;module jars&gt; org.zorbaxquery.modules.schemaTools.Worker
+ *       &lt;socket&gt; &lt;lock file&gt;
+ *
+ * The worker holds a lock on the lock file for its lifetime, so only one
+ * runs per socket; one started while another runs exits at once. It
+ * listens on a Unix domain socket, which needs Java 16 or later, and
+ * serves every connection on a thread of its own, in the order of its
+ * frames. The frames are described in worker_pool.h.
+ */
+public class Worker
+{
+    // frame types, mirrored in worker_pool.h
+    private static final int INST2XSD_OPEN = 1;
+    private static final int INST2XSD_ADD = 2;
+    private static final int INST2XSD_FINISH = 3;
+    private static final int XSD2INST = 4;
+    private static final int RESULT = 16;
+    private static final int ERROR = 17;
+
+    private static final Charset UTF8 = Charset.forName("UTF-8");
+
+    // inst2xsd sessions open and xsd2inst calls running, for all clients
+    private static final AtomicInteger _load = new AtomicInteger();
+
+    public static void main(String[] args)
+        throws Exception
+    {
+        if (args.length != 2)
+        {
+            System.err.println("usage: Worker <socket> <lock file>");
+            System.exit(2);
+        }
+
+        // kept open, and locked, until the process ends
+        RandomAccessFile lockFile = new RandomAccessFile(args[1], "rw");
+        FileLock lock = lockFile.getChannel().tryLock();
+        if (lock == null)
+        {
+            System.err.println("A worker already runs for " + args[0]);
+            return;
+        }
+
+        // the socket of a worker that crashed is left behind
+        File socket = new File(args[0]);
+        socket.delete();
+        ServerSocketChannel server =
+            ServerSocketChannel.open(StandardProtocolFamily.UNIX);
+        server.bind(UnixDomainSocketAddress.of(socket.toPath()));
+        System.err.println("Worker listening on " + args[0]);
+
+        // the first requests need not wait for the warm-up
+        Thread warmUp = new Thread(new Runnable()
+        {
+            public void run()
+            {
+                try
+                {
+                    WarmUp.run(WarmUp.DEFAULT_ROUNDS);
+                }
+                catch (Exception e)
+                {
+                    e.printStackTrace();
+                }
+            }
+        }, "schema-tools-warm-up");
+        warmUp.setDaemon(true);
+        warmUp.start();
+
+        ExecutorService connections = Executors.newCachedThreadPool(
+            new ThreadFactory()
+            {
+                public Thread newThread(Runnable r)
+                {
+                    Thread t = new Thread(r, "schema-tools-connection");
+                    t.setDaemon(true);
+                    return t;
+                }
+            });
+        while (true)
+        {
+            final SocketChannel channel = server.accept();
+            connections.submit(new Runnable()
+            {
+                public void run()
+                {
+                    try
+                    {
+                        serve(channel);
+                    }
+                    catch (IOException e)
+                    {
+                        // the client went away
+                    }
+                    finally
+                    {
+                        try
+                        {
+                            channel.close();
+                        }
+                        catch (IOException e)
+                        {
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    private static void serve(SocketChannel channel)
+        throws IOException
+    {
+        DataInputStream in = new DataInputStream(
+            new BufferedInputStream(Channels.newInputStream(channel), 65536));
+        DataOutputStream out = new DataOutputStream(
+            new BufferedOutputStream(Channels.newOutputStream(channel), 65536));
+
+        // the open inst2xsd session, and the first error adding to it
+        boolean open = false;
+        Inst2XsdSession session = null;
+        Exception error = null;
+        try
+        {
+            while (true)
+            {
+                int type = in.read();
+                if (type < 0)
+                    return;
+                byte[] payload = new byte[in.readInt()];
+                in.readFully(payload);
+                DataInputStream fields = new DataInputStream(
+                    new ByteArrayInputStream(payload));
+
+                switch (type)
+                {
+                case INST2XSD_OPEN:
+                    if (!open)
+                        _load.incrementAndGet();
+                    open = true;
+                    session = null;
+                    error = null;
+                    try
+                    {
+                        Inst2XsdOptions options = new Inst2XsdOptions();
+                        options.setDesign(fields.readInt());
+                        options.setSimpleContentTypes(fields.readInt());
+                        options.setUseEnumeration(fields.readInt());
+                        options.setVerbose(fields.readInt() != 0);
+                        session = new Inst2XsdSession(options);
+                    }
+                    catch (Exception e)
+                    {
+                        error = e;
+                    }
+                    break;
+
+                case INST2XSD_ADD:
+                    // not answered: the errors are reported on finish
+                    if (session == null || error != null)
+                        break;
+                    try
+                    {
+                        session.addDocuments(
+                            new ByteBuffer[] { ByteBuffer.wrap(payload) }, 1);
+                    }
+                    catch (Exception e)
+                    {
+                        error = e;
+                    }
+                    break;
+
+                case INST2XSD_FINISH:
+                    try
+                    {
+                        if (error != null)
+                            throw error;
+                        if (session == null)
+                            throw new IllegalStateException("No open inst2xsd session");
+                        byte[][] xsds = session.finishEvents();
+                        writeResult(out, session.times().take(), xsds);
+                    }
+                    catch (Exception e)
+                    {
+                        writeError(out, e);
+                    }
+                    finally
+                    {
+                        if (open)
+                            _load.decrementAndGet();
+                        open = false;
+                        session = null;
+                        error = null;
+                    }
+                    break;
+
+                case XSD2INST:
+                    _load.incrementAndGet();
+                    try
+                    {
+                        writeResult(out, null, xsd2inst(fields));
+                    }
+                    catch (Exception e)
+                    {
+                        writeError(out, e);
+                    }
+                    finally
+                    {
+                        _load.decrementAndGet();
+                    }
+                    break;
+
+                default:
+                    throw new IOException("Unknown frame type " + type);
+                }
+            }
+        }
+        finally
+        {
+            if (open)
+                _load.decrementAndGet();
+        }
+    }
+
+    private static byte[][] xsd2inst(DataInputStream fields)
+        throws Exception
+    {
+        Xsd2InstHelper.Xsd2InstOptions options =
+            new Xsd2InstHelper.Xsd2InstOptions();
+        options.setNetworkDownloads(fields.readInt() != 0);
+        options.setNopvr(fields.readInt() != 0);
+        options.setNoupa(fields.readInt() != 0);
+
+        String[] xsds = new String[fields.readInt()];
+        for (int i = 0; i < xsds.length; i++)
+            xsds[i] = readString(fields);
+        String[] rootNames = new String[fields.readInt()];
+        for (int i = 0; i < rootNames.length; i++)
+            rootNames[i] = readString(fields);
+
+        // the times of an earlier call of this thread are not this call's
+        PhaseTimes.current().take();
+        Xsd2InstHelper.SampleBatch batch =
+            Xsd2InstHelper.xsd2instAll(xsds, rootNames, options);
+        List<byte[]> samples = new ArrayList<byte[]>();
+        while (batch.hasNext())
+            samples.add(batch.nextEvents());
+        return samples.toArray(new byte[samples.size()][]);
+    }
+
+    private static String readString(DataInputStream fields)
+        throws IOException
+    {
+        byte[] bytes = new byte[fields.readInt()];
+        fields.readFully(bytes);
+        return new String(bytes, UTF8);
+    }
+
+    // times null for the ones of PhaseTimes.current()
+    private static void writeResult(DataOutputStream out, long[] times,
+        byte[][] docs)
+        throws IOException
+    {
+        if (times == null)
+            times = PhaseTimes.current().take();
+
+        ByteArrayOutputStream bytes = new ByteArrayOutputStream();
+        DataOutputStream payload = new DataOutputStream(bytes);
+        payload.writeInt(_load.get());
+        for (int i = 0; i < PhaseTimes.COUNT; i++)
+            payload.writeLong(times[i]);
+        payload.writeInt(docs.length);
+        for (int i = 0; i < docs.length; i++)
+        {
+            payload.writeInt(docs[i].length);
+            payload.write(docs[i]);
+        }
+        writeFrame(out, RESULT, bytes.toByteArray());
+    }
+
+    private static void writeError(DataOutputStream out, Exception e)
+        throws IOException
+    {
+        StringWriter trace = new StringWriter();
+        e.printStackTrace(new PrintWriter(trace));
+        byte[] message = trace.toString().getBytes(UTF8);
+
+        ByteArrayOutputStream bytes = new ByteArrayOutputStream();
+        DataOutputStream payload = new DataOutputStream(bytes);
+        payload.writeInt(_load.get());
+        payload.writeInt(message.length);
+        payload.write(message);
+        writeFrame(out, ERROR, bytes.toByteArray());
+    }
+
+    private static void writeFrame(DataOutputStream out, int type,
+        byte[] payload)
+        throws IOException
+    {
+        out.writeByte(type);
+        out.writeInt(payload.length);
+        out.write(payload);
+        out.flush();
+    }
+}
@@ -3,6 +3,7 @@ package org.zorbaxquery.modules.schemaTools;
 import org.apache.xmlbeans.SchemaType;
 import org.apache.xmlbeans.SchemaTypeSystem;
 import org.apache.xmlbeans.XmlBeans;
+import org.apache.xmlbeans.XmlCursor;
 import org.apache.xmlbeans.XmlException;
 import org.apache.xmlbeans.XmlObject;
 import org.apache.xmlbeans.XmlOptions;
@@ -11,13 +12,44 @@ import org.apache.xmlbeans.impl.xsd2inst.SampleXmlUtil;
 import java.io.IOException;
 import java.io.Reader;
 import java.io.StringReader;
+import java.lang.reflect.Constructor;
+import java.lang.reflect.Method;
 import java.util.ArrayList;
 import java.util.Collection;
+import java.util.HashMap;
 import java.util.Iterator;
 import java.util.List;
+import java.util.Map;
+import java.util.NoSuchElementException;
 
 public class Xsd2InstHelper
 {
+    // SampleXmlUtil fills a cursor with the sample, but only privately; the
+    // public method prints it as text. Null if they are not accessible.
+    private static final Constructor<SampleXmlUtil> _sampleUtilInit;
+    private static final Method _sampleUtilCreate;
+
+    static
+    {
+        Constructor<SampleXmlUtil> init = null;
+        Method create = null;
+        try
+        {
+            init = SampleXmlUtil.class.getDeclaredConstructor(boolean.class);
+            create = SampleXmlUtil.class.getDeclaredMethod("createSampleForType",
+                SchemaType.class, XmlCursor.class);
+            init.setAccessible(true);
+            create.setAccessible(true);
+        }
+        catch (Exception e)
+        {
+            init = null;
+            create = null;
+        }
+        _sampleUtilInit = init;
+        _sampleUtilCreate = create;
+    }
+
     public static class Xsd2InstOptions
     {
         private boolean _downloads = false;
@@ -76,26 +108,185 @@ public class Xsd2InstHelper
         }
     }
 
+    /**
+     * Samples for several global elements of one compiled schema set. Each
+     * sample is only created when next() asks for it.
+     */
+    public static class SampleBatch
+    {
+        private final SchemaType[] _types;
+        private int _next = 0;
+
+        SampleBatch(SchemaType[] types)
+        {
+            _types = types;
+        }
+
+        public int size()
+        {
+            return _types.length;
+        }
+
+        /**
+         * Starts over with the first sample.
+         */
+        public void reset()
+        {
+            _next = 0;
+        }
+
+        public boolean hasNext()
+        {
+            return _next < _types.length;
+        }
+
+        public String next()
+        {
+            if (_next >= _types.length)
+                throw new NoSuchElementException();
+            long start = System.nanoTime();
+            String res = SampleXmlUtil.createSampleForType(_types[_next++]);
+            PhaseTimes.current().add(PhaseTimes.GENERATE, start);
+            return res;
+        }
+
+        /**
+         * Same as next(), with the sample as EventStreamWriter events
+         * instead of printed text.
+         */
+        public byte[] nextEvents()
+            throws Exception
+        {
+            if (_next >= _types.length)
+                throw new NoSuchElementException();
+            long start = System.nanoTime();
+            byte[] res = sampleEvents(_types[_next++]);
+            PhaseTimes.current().add(PhaseTimes.GENERATE, start);
+            return res;
+        }
+    }
+
     public static String xsd2inst(String[] xsds, String rootName, Xsd2InstOptions options)
         throws XmlException, IOException
     {
         //System.out.println("xsd2inst xsd: '" + xsds + "'\n"); System.out.flush();
         //System.out.println( xsds[0] ); System.out.flush();
 
-        Reader[] instReaders = new Reader[xsds.length];
-        for (int i=0; i< xsds.length; i++)
-        {
-            instReaders[i] = new StringReader(xsds[i]);
-        }
+        SchemaTypeSystem sts = compile(xsds, options);
 
-        String res = x2iImpl(instReaders, rootName, options);
+        long start = System.nanoTime();
+        String res = x2iImpl(sts, rootName);
+        PhaseTimes.current().add(PhaseTimes.GENERATE, start);
         //System.out.println("inst2Xsd end result '" + res + "'");
 
         return res;
     }
 
 
-    private static String x2iImpl(Reader[] schemaReaders, String rootName, Xsd2InstOptions options)
+    /**
+     * Same as xsd2inst(), with the sample as EventStreamWriter events
+     * instead of printed text.
+     */
+    public static byte[] xsd2instEvents(String[] xsds, String rootName, Xsd2InstOptions options)
+        throws Exception
+    {
+        return xsd2instAll(xsds, new String[] { rootName }, options).nextEvents();
+    }
+
+
+    /**
+     * Compiles xsds once and returns the samples for rootNames, in that
+     * order, or for all global elements of the schemas if rootNames is
+     * empty. Every root name is checked before the first sample is made.
+     */
+    public static SampleBatch xsd2instAll(String[] xsds, String[] rootNames, Xsd2InstOptions options)
+    {
+        SchemaTypeSystem sts = compile(xsds, options);
+        SchemaType[] globalElems = sts.documentTypes();
+        if (rootNames.length == 0)
+            return new SampleBatch(globalElems);
+
+        // the first global element with a local name wins, as in xsd2inst
+        Map<String, SchemaType> byName = new HashMap<String, SchemaType>();
+        for (int i = 0; i < globalElems.length; i++)
+        {
+            String name = globalElems[i].getDocumentElementName().getLocalPart();
+            if (!byName.containsKey(name))
+                byName.put(name, globalElems[i]);
+        }
+
+        SchemaType[] types = new SchemaType[rootNames.length];
+        for (int i = 0; i < rootNames.length; i++)
+        {
+            types[i] = byName.get(rootNames[i]);
+            if (types[i] == null)
+                throw new RuntimeException("Could not find a global element with name \"" + rootNames[i] + "\"");
+        }
+        return new SampleBatch(types);
+    }
+
+
+    /**
+     * Returns the compiled type system for xsds, from the
+     * SchemaTypeSystemCache if the same schemas were compiled before with the
+     * same options, or else from the SchemaTypeSystemStore if there is one.
+     */
+    static SchemaTypeSystem compile(String[] xsds, Xsd2InstOptions options)
+    {
+        long start = System.nanoTime();
+        try
+        {
+            return compileCached(xsds, options);
+        }
+        finally
+        {
+            PhaseTimes.current().add(PhaseTimes.COMPILE, start);
+        }
+    }
+
+
+    private static SchemaTypeSystem compileCached(String[] xsds, Xsd2InstOptions options)
+    {
+        SchemaTypeSystemCache cache = SchemaTypeSystemCache.getInstance();
+        String key = SchemaTypeSystemCache.key(xsds, options);
+        PhaseTimes times = PhaseTimes.current();
+
+        SchemaTypeSystem sts = cache.get(key);
+        if (sts != null)
+        {
+            times.count(PhaseTimes.SCHEMA_CACHE_HITS, 1);
+            return sts;
+        }
+        times.count(PhaseTimes.SCHEMA_CACHE_MISSES, 1);
+
+        // compiled before, maybe by another process
+        SchemaTypeSystemStore store = SchemaTypeSystemStore.getInstance();
+        if (store != null)
+        {
+            sts = store.load(key);
+            if (sts != null)
+            {
+                times.count(PhaseTimes.SCHEMA_STORE_LOADS, 1);
+                times.count(PhaseTimes.SCHEMA_CACHE_EVICTIONS, cache.put(key, sts));
+                return sts;
+            }
+        }
+
+        Reader[] schemaReaders = new Reader[xsds.length];
+        for (int i=0; i< xsds.length; i++)
+        {
+            schemaReaders[i] = new StringReader(xsds[i]);
+        }
+
+        sts = compileImpl(schemaReaders, options);
+        times.count(PhaseTimes.SCHEMA_CACHE_EVICTIONS, cache.put(key, sts));
+        if (store != null)
+            store.store(key, sts);
+        return sts;
+    }
+
+
+    private static SchemaTypeSystem compileImpl(Reader[] schemaReaders, Xsd2InstOptions options)
     {
         // Process Schema files
         List sdocs = new ArrayList();
@@ -146,6 +337,40 @@ public class Xsd2InstHelper
         {
             throw new RuntimeException("No Schemas to process.");
         }
+
+        return sts;
+    }
+
+
+    /**
+     * The events of the sample SampleXmlUtil.createSampleForType prints,
+     * with the same namespaces.
+     */
+    static byte[] sampleEvents(SchemaType type)
+        throws Exception
+    {
+        XmlObject sample;
+        if (_sampleUtilCreate != null)
+        {
+            sample = XmlObject.Factory.newInstance();
+            XmlCursor cursor = sample.newCursor();
+            // past the document node, as createSampleForType does
+            cursor.toNextToken();
+            _sampleUtilCreate.invoke(_sampleUtilInit.newInstance(Boolean.FALSE),
+                type, cursor);
+            cursor.dispose();
+        }
+        else
+            sample = XmlObject.Factory.parse(SampleXmlUtil.createSampleForType(type));
+
+        XmlOptions options = new XmlOptions();
+        options.put(XmlOptions.SAVE_AGGRESSIVE_NAMESPACES);
+        return EventStreamWriter.save(sample, options);
+    }
+
+
+    private static String x2iImpl(SchemaTypeSystem sts, String rootName)
+    {
         SchemaType[] globalElems = sts.documentTypes();
         SchemaType elem = null;
         for (int i = 0; i < globalElems.length; i++)
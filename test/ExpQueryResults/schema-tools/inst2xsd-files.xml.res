@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><xmlbeans><schemas>1</schemas><paths>true</paths><pattern>true</pattern><parallel>true</parallel></xmlbeans><native><schemas>1</schemas><paths>true</paths><pattern>true</pattern><parallel>true</parallel></native></res>
@@ -0,0 +1,4 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><xs:schema xmlns:xs="http://www.w3.org/2001/XMLSchema" attributeFormDefault="unqualified" elementFormDefault="qualified" targetNamespace="zorba-xquery.com/test/modules/schema-tools.2">
+  <xs:element name="b" type="xs:byte"/>
+</xs:schema></res>
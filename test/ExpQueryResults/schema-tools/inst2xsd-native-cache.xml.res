@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><native><same>true</same><hit>false</hit></native><xmlbeans><same>true</same><hit>true</hit></xmlbeans></res>
@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><xmlbeans>kind=xs:QName other=xs:string ref=xs:QName</xmlbeans><native>kind=xs:QName other=xs:string ref=xs:QName</native></res>
@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><size>10</size><same-seed>true</same-seed><all>true</all></res>
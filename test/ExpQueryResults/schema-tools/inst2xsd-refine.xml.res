@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><vbd>true</vbd><rdd>true</rdd><ssd>true</ssd></res>
@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><large-xml>true</large-xml><large-events>true</large-events><names>données élément</names><values>é中𝄞 𝄞</values></res>
@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><calls>true</calls><instances>true</instances><phases>serialize marshal java-parse infer compile generate print result</phases></res>
@@ -0,0 +1,2 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><count>50</count><same-seed>true</same-seed><varied>true</varied><valid>true</valid></res>
@@ -0,0 +1,6 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<res><sch:c xmlns:sch="zorba-xquery.com/test/modules/schema-tools">string</sch:c><sch:a xmlns:sch="zorba-xquery.com/test/modules/schema-tools">
+  <sch:b>2</sch:b>
+  <!--Zero or more repetitions:-->
+  <sch:c>string</sch:c>
+</sch:a></res>
@@ -0,0 +1,14 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<ord:order xmlns:ord="http://example.com/orders" version="2" ord:rush="true">
+  <!--Optional:-->
+  <ord:order/>
+  <!--You have a CHOICE of the next 2 items at this level-->
+  <ord:status>open</ord:status>
+  <ord:total date="2013-01-01">3</ord:total>
+  <!--1 to 3 repetitions:-->
+  <ord:line no="1">
+    <ord:sku>100</ord:sku>
+    <ord:qty>50</ord:qty>
+  </ord:line>
+  <!--You may enter ANY elements at this point-->
+</ord:order>
@@ -0,0 +1 @@
+Error: http://www.zorba-xquery.com/modules/schema-tools:OPTIONS001
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Infers schemas from a very large instance sequence and checks that the
+// memory of the process stays within a fixed ceiling.
+//
+//   schema-tools-memory [-n instances] [-m megabytes] -p path [-p path ...]
+//
+// Each engine first infers from a small sequence, which loads everything a
+// call needs, and then from n instances; the peak resident set size may
+// not grow by more than m megabytes in between. The instances are made
+// while they are consumed, so only what the module keeps of them counts.
+// The exit code is the number of failed runs.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include <zorba/static_context.h>
+#include <zorba/store_manager.h>
+#include <zorba/zorba.h>
+#include <zorba/zorba_exception.h>
+
+using namespace zorba;
+
+static const char* PROLOG =
+  "import module namespace st = \"http://www.zorba-xquery.com/modules/schema-tools\";\n"
+  "declare namespace sto = \"http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options\";\n";
+
+
+// peak resident set size of the process in kilobytes, 0 if not known
+static long peakKilobytes()
+{
+#ifdef WIN32
+  return 0;
+#else
+  struct rusage lUsage;
+  if (getrusage(RUSAGE_SELF, &lUsage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return lUsage.ru_maxrss / 1024;
+#else
+  return lUsage.ru_maxrss;
+#endif
+#endif
+}
+
+
+static std::string query(const std::string& aEngine, long aInstances)
+{
+  std::ostringstream lQuery;
+  lQuery << PROLOG
+         << "count(st:inst2xsd("
+         << "  for $i in 1 to " << aInstances
+         << "  return <order id=\"{$i}\"><line qty=\"{$i mod 7}\">{$i}</line></order>,"
+         << "  <sto:inst2xsd-options><sto:engine>" << aEngine
+         << "</sto:engine></sto:inst2xsd-options>))";
+  return lQuery.str();
+}
+
+
+static std::string evaluate(Zorba* aZorba, const std::vector<String>& aPath,
+                            const std::string& aQuery)
+{
+  StaticContext_t lSctx = aZorba->createStaticContext();
+  lSctx->setURIPath(aPath);
+  lSctx->setLibPath(aPath);
+
+  XQuery_t lQuery = aZorba->compileQuery(aQuery, lSctx);
+  std::ostringstream lResult;
+  lQuery->execute(lResult);
+  lQuery->close();
+  return lResult.str();
+}
+
+
+int main(int argc, char** argv)
+{
+  long lInstances = 1000000;
+  long lCeiling = 256;
+  std::vector<String> lPath;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-n") == 0)
+      lInstances = atol(argv[i + 1]);
+    else if (strcmp(argv[i], "-m") == 0)
+      lCeiling = atol(argv[i + 1]);
+    else if (strcmp(argv[i], "-p") == 0)
+      lPath.push_back(argv[i + 1]);
+  }
+
+  void* lStore = StoreManager::getStore();
+  Zorba* lZorba = Zorba::getInstance(lStore);
+
+  const char* lEngines[] = { "xmlbeans", "native" };
+  int lFailures = 0;
+  for (size_t e = 0; e < sizeof(lEngines) / sizeof(lEngines[0]); ++e)
+  {
+    try
+    {
+      evaluate(lZorba, lPath, query(lEngines[e], 1000));
+      long lBefore = peakKilobytes();
+
+      evaluate(lZorba, lPath, query(lEngines[e], lInstances));
+      long lGrowth = (peakKilobytes() - lBefore) / 1024;
+
+      std::cout << lEngines[e] << ": " << lInstances << " instances, peak RSS grew by "
+                << lGrowth << " MB (ceiling " << lCeiling << " MB)" << std::endl;
+      if (lGrowth > lCeiling)
+      {
+        std::cerr << lEngines[e] << ": memory grew with the input" << std::endl;
+        ++lFailures;
+      }
+    }
+    catch (ZorbaException& ex)
+    {
+      std::cerr << lEngines[e] << ": " << ex << std::endl;
+      ++lFailures;
+    }
+  }
+
+  lZorba->shutdown();
+  StoreManager::shutdownStore(lStore);
+  return lFailures;
+}
+/* vim:set et sw=2 ts=2: */
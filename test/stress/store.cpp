@@ -0,0 +1,228 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles the schemas of xsd2inst with the SchemaTypeSystemStore in a
+// directory of its own (ZORBA_SCHEMATOOLS_SCHEMA_STORE_DIR) and without
+// the cache in memory, so every call goes to the store.
+//
+//   schema-tools-store -p path [-p path ...]
+//
+// The first call compiles the schemas and stores them, the second must
+// load them from the store. The stored entry is then replaced with bytes
+// that are no type system: the third call must drop it and compile again,
+// and the fourth load the entry the third stored. Every call must
+// give the sample of the first. The exit code is the number of failed
+// checks.
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include <zorba/static_context.h>
+#include <zorba/store_manager.h>
+#include <zorba/zorba.h>
+#include <zorba/zorba_exception.h>
+
+using namespace zorba;
+
+// the type systems the call loaded from the store, and its sample
+static const char* QUERY =
+  "import module namespace st = \"http://www.zorba-xquery.com/modules/schema-tools\";\n"
+  "declare function local:loads() as xs:integer\n"
+  "{\n"
+  "  xs:integer(st:stats()/st:counter[@name eq \"schema-store-loads\"])\n"
+  "};\n"
+  "variable $before := local:loads();\n"
+  "variable $sample := st:xsd2inst(\n"
+  "  <xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\"\n"
+  "      elementFormDefault=\"qualified\"\n"
+  "      targetNamespace=\"zorba-xquery.com/test/modules/schema-tools\"\n"
+  "      xmlns:sch=\"zorba-xquery.com/test/modules/schema-tools\">\n"
+  "    <xs:element name=\"a\" type=\"sch:aType\"/>\n"
+  "    <xs:complexType name=\"aType\">\n"
+  "      <xs:sequence>\n"
+  "        <xs:element type=\"xs:byte\" name=\"b\"/>\n"
+  "        <xs:element type=\"xs:string\" name=\"c\" maxOccurs=\"unbounded\"/>\n"
+  "      </xs:sequence>\n"
+  "      <xs:attribute name=\"id\" type=\"xs:int\"/>\n"
+  "    </xs:complexType>\n"
+  "  </xs:schema>, \"a\", ());\n"
+  "<res><loads>{local:loads() - $before}</loads>{$sample}</res>";
+
+
+static std::string evaluate(Zorba* aZorba, const std::vector<String>& aPath)
+{
+  StaticContext_t lSctx = aZorba->createStaticContext();
+  lSctx->setURIPath(aPath);
+  lSctx->setLibPath(aPath);
+
+  XQuery_t lQuery = aZorba->compileQuery(QUERY, lSctx);
+  std::ostringstream lResult;
+  lQuery->execute(lResult);
+  lQuery->close();
+  return lResult.str();
+}
+
+
+#ifndef WIN32
+// the entries of the store in aDir
+static std::vector<std::string> entries(const std::string& aDir)
+{
+  std::vector<std::string> lEntries;
+  DIR* lDir = opendir(aDir.c_str());
+  if (!lDir)
+    return lEntries;
+  while (struct dirent* lEntry = readdir(lDir))
+  {
+    std::string lName(lEntry->d_name);
+    if (lName.size() > 4 && lName.compare(lName.size() - 4, 4, ".jar") == 0)
+      lEntries.push_back(aDir + "/" + lName);
+  }
+  closedir(lDir);
+  return lEntries;
+}
+
+
+static void removeDirectory(const std::string& aDir)
+{
+  DIR* lDir = opendir(aDir.c_str());
+  if (!lDir)
+    return;
+  while (struct dirent* lEntry = readdir(lDir))
+  {
+    std::string lName(lEntry->d_name);
+    if (lName != "." && lName != "..")
+      unlink((aDir + "/" + lName).c_str());
+  }
+  closedir(lDir);
+  rmdir(aDir.c_str());
+}
+#endif
+
+
+int main(int argc, char** argv)
+{
+#ifdef WIN32
+  std::cout << "the schema store test is not supported on this platform"
+            << std::endl;
+  return 0;
+#else
+  std::vector<String> lPath;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-p") == 0)
+      lPath.push_back(argv[i + 1]);
+  }
+
+  // a store of its own and no cache in memory; set before the JVM starts
+  char lTemplate[] = "/tmp/schema-tools-store-XXXXXX";
+  if (!mkdtemp(lTemplate))
+  {
+    std::cerr << "could not create a store directory: " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  std::string lDir(lTemplate);
+  setenv("ZORBA_SCHEMATOOLS_SCHEMA_STORE_DIR", lDir.c_str(), 1);
+  setenv("ZORBA_SCHEMATOOLS_SCHEMA_CACHE_SIZE", "0", 1);
+  unsetenv("ZORBA_SCHEMATOOLS_WORKERS");
+
+  void* lStore = StoreManager::getStore();
+  Zorba* lZorba = Zorba::getInstance(lStore);
+
+  // the type systems each call must load from the store
+  const char* lExpectedLoads[] = { "0", "1", "0", "1" };
+  std::string lExpected;
+  int lFailures = 0;
+
+  for (int lCall = 0; lCall < 4; ++lCall)
+  {
+    // replaced the way the store replaces entries
+    if (lCall == 2)
+    {
+      std::vector<std::string> lEntries = entries(lDir);
+      for (size_t i = 0; i < lEntries.size(); ++i)
+      {
+        std::string lTemporary = lDir + "/invalid.tmp";
+        {
+          std::ofstream lOut(lTemporary.c_str(), std::ios::binary);
+          lOut << "not a type system";
+        }
+        rename(lTemporary.c_str(), lEntries[i].c_str());
+      }
+    }
+
+    std::string lResult;
+    try
+    {
+      lResult = evaluate(lZorba, lPath);
+    }
+    catch (ZorbaException& e)
+    {
+      std::cerr << "call " << lCall << ": " << e << std::endl;
+      ++lFailures;
+      continue;
+    }
+
+    std::string lLoads = std::string("<loads>") + lExpectedLoads[lCall] + "</loads>";
+    size_t lAt = lResult.find(lLoads);
+    if (lAt == std::string::npos)
+    {
+      std::cerr << "call " << lCall << ": expected " << lLoads << " in "
+                << lResult << std::endl;
+      ++lFailures;
+    }
+
+    size_t lEnd = lResult.find("</loads>");
+    std::string lSample = lEnd == std::string::npos ? lResult :
+        lResult.substr(lEnd + strlen("</loads>"));
+    if (lCall == 0)
+      lExpected = lSample;
+    else if (lSample != lExpected)
+    {
+      std::cerr << "call " << lCall << ": wrong sample " << lSample
+                << std::endl;
+      ++lFailures;
+    }
+
+    if (entries(lDir).size() != 1)
+    {
+      std::cerr << "call " << lCall << ": " << entries(lDir).size()
+                << " entries in " << lDir << ", expected 1" << std::endl;
+      ++lFailures;
+    }
+  }
+
+  std::cout << "4 calls with the schema store, " << lFailures << " failed"
+            << std::endl;
+
+  lZorba->shutdown();
+  StoreManager::shutdownStore(lStore);
+  removeDirectory(lDir);
+  return lFailures;
+#endif
+}
+/* vim:set et sw=2 ts=2: */
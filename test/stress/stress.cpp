@@ -0,0 +1,181 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Evaluates schema-tools queries from many threads at once.
+//
+//   schema-tools-stress [-t threads] [-i iterations] -p path [-p path ...]
+//
+// Every query is first run on the main thread; each thread then runs the
+// queries in turn and compares its results with those. The exit code is
+// the number of failed evaluations.
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zorba/static_context.h>
+#include <zorba/store_manager.h>
+#include <zorba/zorba.h>
+#include <zorba/zorba_exception.h>
+
+using namespace zorba;
+
+static const char* PROLOG =
+  "import module namespace st = \"http://www.zorba-xquery.com/modules/schema-tools\";\n"
+  "declare namespace sto = \"http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options\";\n";
+
+static const char* INSTANCES =
+  "(<a><b>1</b><c>c</c><c>cc</c></a>, <b>2</b>, <c>ccc</c>,"
+  " <order id=\"1\"><line qty=\"2\">x</line><line qty=\"3\">y</line></order>)";
+
+static const char* SCHEMA =
+  "<xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
+  "    elementFormDefault=\"qualified\""
+  "    targetNamespace=\"zorba-xquery.com/test/modules/schema-tools\""
+  "    xmlns:sch=\"zorba-xquery.com/test/modules/schema-tools\">"
+  "  <xs:element name=\"a\" type=\"sch:aType\"/>"
+  "  <xs:element name=\"b\" type=\"xs:byte\"/>"
+  "  <xs:element name=\"c\" type=\"xs:string\"/>"
+  "  <xs:complexType name=\"aType\">"
+  "    <xs:sequence>"
+  "      <xs:element type=\"xs:byte\" name=\"b\"/>"
+  "      <xs:element type=\"xs:string\" name=\"c\" maxOccurs=\"unbounded\" minOccurs=\"0\"/>"
+  "    </xs:sequence>"
+  "  </xs:complexType>"
+  "</xs:schema>";
+
+
+static std::vector<std::string> queries()
+{
+  std::vector<std::string> lQueries;
+  std::string lPrefix(PROLOG);
+
+  lQueries.push_back(lPrefix +
+      "st:inst2xsd(" + INSTANCES + ", ())");
+
+  lQueries.push_back(lPrefix +
+      "st:inst2xsd(" + INSTANCES + ","
+      "  <sto:inst2xsd-options><sto:engine>native</sto:engine></sto:inst2xsd-options>)");
+
+  lQueries.push_back(lPrefix +
+      "st:xsd2inst(" + SCHEMA + ", \"a\", ())");
+
+  lQueries.push_back(lPrefix +
+      "st:xsd2inst-all(" + SCHEMA + ", (),"
+      "  <sto:xsd2inst-options><sto:engine>native</sto:engine></sto:xsd2inst-options>)");
+
+  lQueries.push_back(lPrefix +
+      "st:xsd2inst-all(" + SCHEMA + ", (\"c\", \"a\"), ())");
+
+  lQueries.push_back(lPrefix +
+      "variable $session := st:inst2xsd-open(());\n"
+      "for $i in " + INSTANCES + " return st:inst2xsd-add($session, $i);\n"
+      "st:inst2xsd-close($session)");
+
+  return lQueries;
+}
+
+
+static std::string evaluate(Zorba* aZorba, const std::vector<String>& aPath,
+                            const std::string& aQuery)
+{
+  StaticContext_t lSctx = aZorba->createStaticContext();
+  lSctx->setURIPath(aPath);
+  lSctx->setLibPath(aPath);
+
+  XQuery_t lQuery = aZorba->compileQuery(aQuery, lSctx);
+  std::ostringstream lResult;
+  lQuery->execute(lResult);
+  lQuery->close();
+  return lResult.str();
+}
+
+
+int main(int argc, char** argv)
+{
+  int lThreads = 8;
+  int lIterations = 25;
+  std::vector<String> lPath;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-t") == 0)
+      lThreads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-i") == 0)
+      lIterations = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-p") == 0)
+      lPath.push_back(argv[i + 1]);
+  }
+
+  void* lStore = StoreManager::getStore();
+  Zorba* lZorba = Zorba::getInstance(lStore);
+
+  std::vector<std::string> lQueries = queries();
+  std::vector<std::string> lExpected;
+  try
+  {
+    for (size_t q = 0; q < lQueries.size(); ++q)
+      lExpected.push_back(evaluate(lZorba, lPath, lQueries[q]));
+  }
+  catch (ZorbaException& e)
+  {
+    std::cerr << "single-threaded run failed: " << e << std::endl;
+    return 1;
+  }
+
+  std::atomic<int> lFailures(0);
+  std::vector<std::thread> lWorkers;
+  for (int t = 0; t < lThreads; ++t)
+  {
+    lWorkers.push_back(std::thread([&, t]()
+    {
+      for (int i = 0; i < lIterations; ++i)
+      {
+        size_t q = (t + i) % lQueries.size();
+        try
+        {
+          if (evaluate(lZorba, lPath, lQueries[q]) != lExpected[q])
+          {
+            std::cerr << "thread " << t << ": wrong result for query " << q
+                      << std::endl;
+            ++lFailures;
+          }
+        }
+        catch (ZorbaException& e)
+        {
+          std::cerr << "thread " << t << ": query " << q << ": " << e
+                    << std::endl;
+          ++lFailures;
+        }
+      }
+    }));
+  }
+  for (int t = 0; t < lThreads; ++t)
+    lWorkers[t].join();
+
+  std::cout << lThreads * lIterations << " evaluations on " << lThreads
+            << " threads, " << lFailures << " failed" << std::endl;
+
+  lZorba->shutdown();
+  StoreManager::shutdownStore(lStore);
+  return lFailures;
+}
+/* vim:set et sw=2 ts=2: */
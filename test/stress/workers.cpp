@@ -0,0 +1,309 @@
+/*
+ * Copyright 2006-2008 The FLWOR Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Evaluates schema-tools queries with the XMLBeans engine in a worker
+// process (ZORBA_SCHEMATOOLS_WORKERS=1) in a directory of its own.
+//
+//   schema-tools-workers -p path [-p path ...]
+//
+// Every query is run twice against the worker the first call starts.
+// The worker is then killed, which leaves the connections of the pool
+// stale, and every query is run again: the worker must be restarted and
+// give the same results. Last, queries leave inst2xsd sessions unfinished,
+// one of them in the middle of an add, and inst2xsd must still give its
+// result on the pool they used. The exit code is the number of failed
+// evaluations.
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <zorba/static_context.h>
+#include <zorba/store_manager.h>
+#include <zorba/zorba.h>
+#include <zorba/zorba_exception.h>
+
+using namespace zorba;
+
+static const char* PROLOG =
+  "import module namespace st = \"http://www.zorba-xquery.com/modules/schema-tools\";\n"
+  "declare namespace sto = \"http://www.zorba-xquery.com/modules/schema-tools/schema-tools-options\";\n";
+
+static const char* INSTANCES =
+  "(<a><b>1</b><c>c</c><c>cc</c></a>, <b>2</b>, <c>ccc</c>,"
+  " <order id=\"1\"><line qty=\"2\">x</line><line qty=\"3\">y</line></order>)";
+
+static const char* SCHEMA =
+  "<xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
+  "    elementFormDefault=\"qualified\""
+  "    targetNamespace=\"zorba-xquery.com/test/modules/schema-tools\""
+  "    xmlns:sch=\"zorba-xquery.com/test/modules/schema-tools\">"
+  "  <xs:element name=\"a\" type=\"sch:aType\"/>"
+  "  <xs:element name=\"b\" type=\"xs:byte\"/>"
+  "  <xs:element name=\"c\" type=\"xs:string\"/>"
+  "  <xs:complexType name=\"aType\">"
+  "    <xs:sequence>"
+  "      <xs:element type=\"xs:byte\" name=\"b\"/>"
+  "      <xs:element type=\"xs:string\" name=\"c\" maxOccurs=\"unbounded\" minOccurs=\"0\"/>"
+  "    </xs:sequence>"
+  "  </xs:complexType>"
+  "</xs:schema>";
+
+
+static std::vector<std::string> queries()
+{
+  std::vector<std::string> lQueries;
+  std::string lPrefix(PROLOG);
+
+  lQueries.push_back(lPrefix +
+      "st:inst2xsd(" + INSTANCES + ", ())");
+
+  lQueries.push_back(lPrefix +
+      "st:xsd2inst(" + SCHEMA + ", \"a\", ())");
+
+  lQueries.push_back(lPrefix +
+      "st:xsd2inst-all(" + SCHEMA + ", (\"c\", \"a\"), ())");
+
+  lQueries.push_back(lPrefix +
+      "variable $session := st:inst2xsd-open(());\n"
+      "for $i in " + INSTANCES + " return st:inst2xsd-add($session, $i);\n"
+      "st:inst2xsd-close($session)");
+
+  return lQueries;
+}
+
+
+// queries that leave their inst2xsd session in the worker unfinished
+static std::vector<std::string> abandoningQueries()
+{
+  std::vector<std::string> lQueries;
+  std::string lPrefix(PROLOG);
+
+  lQueries.push_back(lPrefix +
+      "variable $session := st:inst2xsd-open(());\n"
+      "st:inst2xsd-add($session, <x><y>abandoned</y></x>);\n"
+      "<abandoned/>");
+
+  // the error comes while the instances are sent
+  lQueries.push_back(lPrefix +
+      "variable $session := st:inst2xsd-open(());\n"
+      "st:inst2xsd-add($session, (<x><z>1</z></x>, error()));\n"
+      "<abandoned/>");
+
+  return lQueries;
+}
+
+
+static std::string evaluate(Zorba* aZorba, const std::vector<String>& aPath,
+                            const std::string& aQuery)
+{
+  StaticContext_t lSctx = aZorba->createStaticContext();
+  lSctx->setURIPath(aPath);
+  lSctx->setLibPath(aPath);
+
+  XQuery_t lQuery = aZorba->compileQuery(aQuery, lSctx);
+  std::ostringstream lResult;
+  lQuery->execute(lResult);
+  lQuery->close();
+  return lResult.str();
+}
+
+
+#ifndef WIN32
+// the process holding the lock of worker 0 in aDir, 0 if there is none
+static pid_t workerPid(const std::string& aDir)
+{
+  int lFd = open((aDir + "/worker-0.lock").c_str(), O_RDWR);
+  if (lFd < 0)
+    return 0;
+  struct flock lTest;
+  memset(&lTest, 0, sizeof(lTest));
+  lTest.l_type = F_WRLCK;
+  lTest.l_whence = SEEK_SET;
+  pid_t lPid = 0;
+  if (fcntl(lFd, F_GETLK, &lTest) == 0 && lTest.l_type != F_UNLCK)
+    lPid = lTest.l_pid;
+  close(lFd);
+  return lPid;
+}
+
+
+// kills the worker and waits until it is gone; false if there was none
+static bool killWorker(const std::string& aDir)
+{
+  pid_t lPid = workerPid(aDir);
+  if (lPid <= 0 || kill(lPid, SIGKILL) != 0)
+    return false;
+  for (int i = 0; i < 500 && workerPid(aDir) != 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  return true;
+}
+
+
+static void removeDirectory(const std::string& aDir)
+{
+  DIR* lDir = opendir(aDir.c_str());
+  if (!lDir)
+    return;
+  while (struct dirent* lEntry = readdir(lDir))
+  {
+    std::string lName(lEntry->d_name);
+    if (lName != "." && lName != "..")
+      unlink((aDir + "/" + lName).c_str());
+  }
+  closedir(lDir);
+  rmdir(aDir.c_str());
+}
+#endif
+
+
+int main(int argc, char** argv)
+{
+#ifdef WIN32
+  std::cout << "schema-tools workers are not supported on this platform"
+            << std::endl;
+  return 0;
+#else
+  std::vector<String> lPath;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-p") == 0)
+      lPath.push_back(argv[i + 1]);
+  }
+
+  // a worker of its own, not the one of the user's other processes; set
+  // before the module reads it
+  char lTemplate[] = "/tmp/schema-tools-workers-XXXXXX";
+  if (!mkdtemp(lTemplate))
+  {
+    std::cerr << "could not create a worker directory: " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  std::string lDir(lTemplate);
+  setenv("ZORBA_SCHEMATOOLS_WORKERS", "1", 1);
+  setenv("ZORBA_SCHEMATOOLS_WORKER_DIR", lDir.c_str(), 1);
+
+  void* lStore = StoreManager::getStore();
+  Zorba* lZorba = Zorba::getInstance(lStore);
+
+  std::vector<std::string> lQueries = queries();
+  std::vector<std::string> lExpected(lQueries.size());
+  int lFailures = 0;
+
+  // the first round starts the worker, the second reuses its connections,
+  // the third finds them stale and restarts it
+  for (int lRound = 0; lRound < 3; ++lRound)
+  {
+    if (lRound == 2 && !killWorker(lDir))
+    {
+      std::cerr << "no worker runs in " << lDir << std::endl;
+      ++lFailures;
+    }
+
+    for (size_t q = 0; q < lQueries.size(); ++q)
+    {
+      try
+      {
+        std::string lResult = evaluate(lZorba, lPath, lQueries[q]);
+        if (lRound == 0)
+        {
+          lExpected[q] = lResult;
+          if (lResult.find('<') == std::string::npos)
+          {
+            std::cerr << "query " << q << ": no result" << std::endl;
+            ++lFailures;
+          }
+        }
+        else if (lResult != lExpected[q])
+        {
+          std::cerr << "round " << lRound << ": wrong result for query " << q
+                    << std::endl;
+          ++lFailures;
+        }
+      }
+      catch (ZorbaException& e)
+      {
+        std::cerr << "round " << lRound << ": query " << q << ": " << e
+                  << std::endl;
+        ++lFailures;
+      }
+    }
+
+    struct stat lStat;
+    if (lRound == 0 &&
+        stat((lDir + "/worker-0.sock").c_str(), &lStat) != 0)
+    {
+      std::cerr << "the queries did not run in a worker" << std::endl;
+      ++lFailures;
+    }
+  }
+
+  // the connections of abandoned sessions must not be reused
+  std::vector<std::string> lAbandoning = abandoningQueries();
+  for (size_t q = 0; q < lAbandoning.size(); ++q)
+  {
+    try
+    {
+      evaluate(lZorba, lPath, lAbandoning[q]);
+    }
+    catch (ZorbaException&)
+    {
+      // the error of the second query is expected
+    }
+
+    try
+    {
+      if (evaluate(lZorba, lPath, lQueries[0]) != lExpected[0])
+      {
+        std::cerr << "abandoned session " << q
+                  << ": wrong result for the next inst2xsd" << std::endl;
+        ++lFailures;
+      }
+    }
+    catch (ZorbaException& e)
+    {
+      std::cerr << "abandoned session " << q << ": " << e << std::endl;
+      ++lFailures;
+    }
+  }
+
+  std::cout << 3 * lQueries.size() << " evaluations and "
+            << lAbandoning.size() << " abandoned sessions in a worker, "
+            << lFailures << " failed" << std::endl;
+
+  lZorba->shutdown();
+  StoreManager::shutdownStore(lStore);
+  killWorker(lDir);
+  removeDirectory(lDir);
+  return lFailures;
+#endif
+}
+/* vim:set et sw=2 ts=2: */